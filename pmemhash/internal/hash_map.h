@@ -99,6 +99,7 @@ public:
 		for (uint32_t idx = 0; idx < bucket_count; idx++) {
 			buckets_[idx].hdr_.valid_ = 0;
             memset(&buckets_[idx].sig_, 0xFF, sizeof(__m256));
+            memset(buckets_[idx].ptr_, 0, sizeof(buckets_[idx].ptr_));
 		}
         lossy_mode_ = lossy_mode;
         evict_ctr_ = insert_ctr_ = update_ctr_ = 0;
@@ -307,6 +308,24 @@ public:
         return elem_pointer<Elem>(0, 0, NULL);
     }
 
+    // Call fn(ptr) for each element in buckets [first, last). An element put
+    // meanwhile may or may not be visited; a slot claimed but not yet filled
+    // still reads NULL and is skipped.
+    template <typename F>
+    void for_each(uint32_t first, uint32_t last, F fn) {
+        for (uint32_t bucket = first; bucket < last && bucket < bucket_count_; bucket++) {
+            uint32_t valid = __atomic_load_n(&buckets_[bucket].hdr_.valid_, __ATOMIC_ACQUIRE);
+            while (valid) {
+                uint32_t slot = __builtin_ctz(valid);
+                valid &= valid - 1;
+                Elem *ptr = __atomic_load_n(&buckets_[bucket].ptr_[slot], __ATOMIC_ACQUIRE);
+                if (ptr)
+                    fn(ptr);
+            }
+        }
+    }
+
+    uint32_t get_bucket_count() { return bucket_count_; }
     uint32_t get_evict_count() { return evict_ctr_; }
     uint32_t get_insert_count() { return insert_ctr_; }
     uint32_t get_update_count() { return update_ctr_; }
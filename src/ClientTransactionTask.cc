@@ -308,7 +308,8 @@ ClientTransactionTask::initTaskQDB()
         nextCacheEntry++;
     }
     assert(participantCount > 0);
-    dssnCTS = ramcloud->getCTS();
+    dssnShardSet = std::hash<std::bitset<4096>>()(participantSet);
+    dssnCTS = ramcloud->getCTS(dssnShardSet, dssnDelta);
 }
 /**
  * Process any decision rpcs that have completed.  Used in performTask.
@@ -871,6 +872,14 @@ ClientTransactionTask::PrepareRpc::wait()
         ClientException::throwException(HERE, responseHeader->status);
     }
 
+#ifdef QDBTX
+    if (response->size() >= sizeof(WireFormat::TxCommitDSSN::Response)) {
+        WireFormat::TxCommitDSSN::Response* dssnHdr =
+                response->getStart<WireFormat::TxCommitDSSN::Response>();
+        ramcloud->reportSlack(task->dssnShardSet, task->dssnDelta, dssnHdr->slack);
+    }
+#endif
+
     WireFormat::TxPrepare::Response* respHdr =
             response->getStart<WireFormat::TxPrepare::Response>();
     return respHdr->vote;
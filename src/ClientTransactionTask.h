@@ -120,6 +120,8 @@ class ClientTransactionTask : public RpcTracker::TrackedRpc {
     // DSSN TX metadata
     WireFormat::QDBXmitMeta mMeta;
     __uint128_t dssnCTS;
+    uint64_t dssnShardSet;  // hash of the participant set, keys the sequencer delta
+    uint64_t dssnDelta;     // delta dssnCTS was issued with
 
   PUBLIC:
     /// Flag that can be set indicating that the transaction is read-only and
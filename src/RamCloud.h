@@ -189,6 +189,19 @@ class RamCloud {
 #endif
 	return cts;
     }
+    __uint128_t getCTS(uint64_t shardSet, uint64_t &delta) {
+        __uint128_t cts = 0;
+        delta = 0;
+#if QDBTX
+        cts = sequencer.getCTS(shardSet, delta);
+#endif
+	return cts;
+    }
+    void reportSlack(uint64_t shardSet, uint64_t delta, int64_t slack) {
+#if QDBTX
+        sequencer.reportSlack(shardSet, delta, slack);
+#endif
+    }
     explicit RamCloud(CommandLineOptions* options);
     explicit RamCloud(Context* context);
     explicit RamCloud(const char* serviceLocator,
@@ -142,6 +142,8 @@ opcodeSymbol(uint32_t opcode)
         case DSSN_COMMIT:                  return "DSSN_COMMIT";
         case DSSN_SEND_INFO_ASYNC:          return "DSSN_SEND_SSN_ASYNC";
         case DSSN_REQUEST_INFO_ASYNC:       return "DSSN_REQUEST_SSN_ASYNC";
+        case DSSN_INFO_BATCH_ASYNC:         return "DSSN_SSN_BATCH_ASYNC";
+        case DSSN_READ_ONLY_INFO_ASYNC:     return "DSSN_READ_ONLY_SSN_ASYNC";
         case ILLEGAL_RPC_TYPE:             return "ILLEGAL_RPC_TYPE";
     }
 
@@ -150,7 +150,9 @@ enum Opcode {
     DSSN_COMMIT                 = 82,
     DSSN_SEND_INFO_ASYNC         = 83,
     DSSN_REQUEST_INFO_ASYNC      = 84,
-    ILLEGAL_RPC_TYPE            = 85, // 1 + the highest legitimate Opcode
+    DSSN_INFO_BATCH_ASYNC        = 85,
+    DSSN_READ_ONLY_INFO_ASYNC    = 86,
+    ILLEGAL_RPC_TYPE            = 87, // 1 + the highest legitimate Opcode
 };
 const int totalOps = ILLEGAL_RPC_TYPE + 1;
 /**
@@ -691,6 +693,32 @@ struct DSSNSendInfoAsync {
     } __attribute__((packed));
 };
 
+/*
+ * SSN info records of many txs bound for one peer, coalesced into one
+ * notification. 'count' records follow the header; each one carries what a
+ * DSSNSendInfoAsync or a DSSNRequestInfoAsync would, as told by its opcode.
+ * A DSSN_READ_ONLY_INFO_ASYNC record carries the stamps of a cross-shard
+ * read-only tx instead; it is sent in batches only.
+ */
+struct DSSNInfoBatchAsync {
+    static const Opcode opcode = DSSN_INFO_BATCH_ASYNC;
+    static const ServiceType service = DSSN_SERVICE;
+    struct Request {
+        RequestCommon common; //must match struct Notification
+        uint32_t length; //must match struct Notification -- indicating length of following
+        uint64_t senderPeerId;
+        uint32_t count;
+    } __attribute__((packed));
+    struct Record {
+        uint8_t opcode; //DSSN_SEND_INFO_ASYNC, DSSN_REQUEST_INFO_ASYNC or DSSN_READ_ONLY_INFO_ASYNC
+        uint8_t txState;
+        uint8_t senderPeerPosition;
+        __uint128_t cts;
+        uint64_t pstamp;
+        uint64_t sstamp;
+    } __attribute__((packed));
+};
+
 struct Echo {
     static const Opcode opcode = ECHO;
     static const ServiceType service = MASTER_SERVICE;
@@ -2044,6 +2072,12 @@ struct TxPrepare {
 struct TxCommitDSSN : TxPrepare {
     static const Opcode opcode = Opcode::DSSN_COMMIT;
     static const ServiceType service = DSSN_SERVICE;
+
+    struct Response {
+        ResponseCommon common;
+        Vote vote;
+        int64_t slack;  // CTS minus the validator local time on arrival, in ns
+    } __attribute__((packed));
 };
 
 struct TxRequestAbort {
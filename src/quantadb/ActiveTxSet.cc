@@ -13,6 +13,8 @@
  *  limitations under the License.
  */
 
+#include <algorithm>
+#include <unordered_set>
 #include "ActiveTxSet.h"
 #include "Validator.h"
 
@@ -20,45 +22,147 @@ namespace QDB {
 
 bool
 ActiveTxSet::add(TxEntry *txEntry) {
+    //scratch space reused across calls by the same thread
+    static thread_local std::vector<Filter::Lock> txKeys;
+    txKeys.clear();
     for (uint32_t i = 0; i < txEntry->getReadSetSize(); i++) {
         if (txEntry->isReadTupleSkipLock(i)) continue;
-        bool success = cbm.add(txEntry->getReadSetHash()[i]);
-        assert(success);
-        if (!success) {
-            // undo effects
-            for (int j = i - 1; j >= 0; j--) {
-	        if (txEntry->isReadTupleSkipLock(j)) continue;
-                cbm.remove(txEntry->getReadSetHash()[j]);
-            }
-            return false;
-        }
+        txKeys.push_back(filter.locate(txEntry->getReadSetHash()[i]));
     }
     for (uint32_t i = 0; i < txEntry->getWriteSetSize(); i++) {
         if (txEntry->isWriteTupleSkipLock(i)) continue;
-        bool success = cbm.add(txEntry->getWriteSetHash()[i]);
-        assert(success);
-        if (!success) {
-            // undo effects
-            for (int j = i - 1; j >= 0; j--) {
-	        if (txEntry->isWriteTupleSkipLock(j)) continue;
-                cbm.remove(txEntry->getWriteSetHash()[j]);
-            }
-            for (uint32_t j = 0; j < txEntry->getReadSetSize(); j++) {
-	        if (txEntry->isReadTupleSkipLock(j)) continue;
-                cbm.remove(txEntry->getReadSetHash()[j]);
+        txKeys.push_back(filter.locate(txEntry->getWriteSetHash()[i]));
+    }
+    std::sort(txKeys.begin(), txKeys.end(),
+            [](const Filter::Lock &a, const Filter::Lock &b) { return a.slot < b.slot; });
+
+    //one CAS per word, testing presence against the word as it was before this tx,
+    //as the tx's own keys may cover the counters of its other keys of the word
+    for (size_t g = 0; g < txKeys.size(); ) {
+        uint64_t slot = txKeys[g].slot;
+        size_t end = g;
+        while (end < txKeys.size() && txKeys[end].slot == slot)
+            end++;
+        bool isTaken, isDone;
+        do {
+            uint64_t oldWord = filter.loadWord(slot);
+            uint64_t newWord = oldWord;
+            isTaken = false;
+            for (size_t i = g; i < end && !isTaken; i++) {
+                isTaken = Filter::isPresent(oldWord, txKeys[i].ones)
+                        || (Filter::fullCounters(newWord) & txKeys[i].ones);
+                newWord += txKeys[i].ones;
             }
+            isDone = isTaken || filter.casWord(slot, oldWord, newWord);
+        } while (!isDone);
+        if (isTaken) {
+            // taken by another tx, possibly admitted by another partition: undo effects
+            for (size_t i = 0; i < g; i++)
+                filter.subtractWord(txKeys[i].slot, txKeys[i].ones);
             return false;
         }
+        g = end;
     }
     addedTxCount.fetch_add(1);
     return true;
 }
 
+uint32_t
+ActiveTxSet::addBatch(TxEntry **txEntries, uint32_t count, bool *admitted) {
+    struct WantedKey {
+        Filter::Lock lock;
+        uint32_t tx;
+        bool isSet;
+        bool operator<(const WantedKey &other) const { return lock.slot < other.lock.slot; }
+    };
+    //scratch space reused across calls by the same serialize thread
+    static thread_local std::vector<WantedKey> wanted;
+    static thread_local std::vector<Filter::Lock> txKeys;
+    static thread_local std::unordered_set<uint64_t> claimed;
+    wanted.clear();
+    claimed.clear();
+
+    //pass 1: pick the txs free of conflict, against the filter and the window so far
+    for (uint32_t t = 0; t < count; t++) {
+        TxEntry *txEntry = txEntries[t];
+        txKeys.clear();
+        for (uint32_t i = 0; i < txEntry->getReadSetSize(); i++) {
+            if (txEntry->isReadTupleSkipLock(i)) continue;
+            txKeys.push_back(filter.locate(txEntry->getReadSetHash()[i]));
+        }
+        for (uint32_t i = 0; i < txEntry->getWriteSetSize(); i++) {
+            if (txEntry->isWriteTupleSkipLock(i)) continue;
+            txKeys.push_back(filter.locate(txEntry->getWriteSetHash()[i]));
+        }
+
+        admitted[t] = true;
+        for (uint32_t i = 0; i < txKeys.size() && admitted[t]; i++) {
+            if (Filter::isPresent(filter.loadWord(txKeys[i].slot), txKeys[i].ones)
+                    || !claimed.insert(Filter::lockId(txKeys[i])).second) {
+                admitted[t] = false;
+                for (uint32_t j = 0; j < i; j++)
+                    claimed.erase(Filter::lockId(txKeys[j]));
+            }
+        }
+        if (admitted[t]) {
+            for (auto &lock : txKeys)
+                wanted.push_back({lock, t, false});
+        }
+    }
+
+    //pass 2: one CAS per word; a key lost to another serializer fails its tx
+    std::sort(wanted.begin(), wanted.end());
+    bool hasLoser = false;
+    for (size_t g = 0; g < wanted.size(); ) {
+        uint64_t slot = wanted[g].lock.slot;
+        size_t end = g;
+        while (end < wanted.size() && wanted[end].lock.slot == slot)
+            end++;
+        bool isDone;
+        do {
+            uint64_t oldWord = filter.loadWord(slot);
+            uint64_t newWord = oldWord;
+            for (size_t i = g; i < end; i++) {
+                if (!admitted[wanted[i].tx])
+                    continue;
+                //distinct keys sharing counters may both be held; only overflow stops them
+                if (Filter::isPresent(oldWord, wanted[i].lock.ones)
+                        || (Filter::fullCounters(newWord) & wanted[i].lock.ones)) {
+                    admitted[wanted[i].tx] = false;
+                    hasLoser = true;
+                    continue;
+                }
+                newWord += wanted[i].lock.ones;
+            }
+            isDone = (newWord == oldWord) || filter.casWord(slot, oldWord, newWord);
+        } while (!isDone);
+        for (size_t i = g; i < end; i++)
+            wanted[i].isSet = admitted[wanted[i].tx];
+        g = end;
+    }
+
+    //undo effects of the txs that lost a key after having added others
+    if (hasLoser) {
+        for (auto &w : wanted) {
+            if (w.isSet && !admitted[w.tx])
+                filter.subtractWord(w.lock.slot, w.lock.ones);
+        }
+    }
+
+    uint32_t added = 0;
+    for (uint32_t t = 0; t < count; t++) {
+        if (admitted[t])
+            added++;
+    }
+    addedTxCount.fetch_add(added);
+    return added;
+}
+
 bool
 ActiveTxSet::remove(TxEntry *txEntry) {
     for (uint32_t i = 0; i < txEntry->getReadSetSize(); i++) {
         if (txEntry->isReadTupleSkipLock(i)) continue;
-        if (!cbm.remove(txEntry->getReadSetHash()[i])) {
+        if (!filter.remove(txEntry->getReadSetHash()[i])) {
             //abort();
             RAMCLOUD_LOG(ERROR, "CBF failed to remove entry: %lu, readset %d", (uint64_t)(txEntry->getCTS() >> 64), i);
             return false;
@@ -66,7 +170,7 @@ ActiveTxSet::remove(TxEntry *txEntry) {
     }
     for (uint32_t i = 0; i < txEntry->getWriteSetSize(); i++) {
         if (txEntry->isWriteTupleSkipLock(i)) continue;
-        if (!cbm.remove(txEntry->getWriteSetHash()[i])) {
+        if (!filter.remove(txEntry->getWriteSetHash()[i])) {
             //abort();
             RAMCLOUD_LOG(ERROR, "CBF failed to remove entry: %lu, writeset %d", (uint64_t)(txEntry->getCTS() >> 64), i);
             return false;
@@ -78,37 +182,34 @@ ActiveTxSet::remove(TxEntry *txEntry) {
 
 bool
 ActiveTxSet::blocks(TxEntry *txEntry) {
-    for (uint32_t i = txEntry->getReadSetIndex(); i < txEntry->getReadSetSize(); i++) {
-        if (txEntry->isReadTupleSkipLock(i)) continue;
-        if (cbm.shouldNotAdd(txEntry->getReadSetHash()[i])) {
-            txEntry->getReadSetIndex() = i;
-            return true;
-        }
+    //Keys skipped for locking share the lock of an earlier key, so they test
+    //the same and need no filtering. Start from the key that blocked last time.
+    uint64_t *hashes = txEntry->getReadSetHash();
+    uint32_t size = txEntry->getReadSetSize();
+    uint32_t &readIndex = txEntry->getReadSetIndex();
+    uint32_t i;
+    if ((i = filter.containsAny(hashes + readIndex, size - readIndex)) < size - readIndex) {
+        readIndex += i;
+        return true;
     }
-    for (uint32_t i = 0; i < txEntry->getReadSetIndex(); i++) {
-        if (txEntry->isReadTupleSkipLock(i)) continue;
-        if (cbm.shouldNotAdd(txEntry->getReadSetHash()[i])) {
-            txEntry->getReadSetIndex() = i;
-            return true;
-        }
+    if ((i = filter.containsAny(hashes, readIndex)) < readIndex) {
+        readIndex = i;
+        return true;
     }
-    for (uint32_t i = txEntry->getWriteSetIndex(); i < txEntry->getWriteSetSize(); i++) {
-        if (txEntry->isWriteTupleSkipLock(i)) continue;
-        if (cbm.shouldNotAdd(txEntry->getWriteSetHash()[i])) {
-            txEntry->getWriteSetIndex() = i;
-            return true;
-        }
+
+    hashes = txEntry->getWriteSetHash();
+    size = txEntry->getWriteSetSize();
+    uint32_t &writeIndex = txEntry->getWriteSetIndex();
+    if ((i = filter.containsAny(hashes + writeIndex, size - writeIndex)) < size - writeIndex) {
+        writeIndex += i;
+        return true;
     }
-    for (uint32_t i = 0; i < txEntry->getWriteSetIndex(); i++) {
-        if (txEntry->isWriteTupleSkipLock(i)) continue;
-        if (cbm.shouldNotAdd(txEntry->getWriteSetHash()[i])) {
-            txEntry->getWriteSetIndex() = i;
-            return true;
-        }
+    if ((i = filter.containsAny(hashes, writeIndex)) < writeIndex) {
+        writeIndex = i;
+        return true;
     }
     return false;
 }
 
 
 } // end ActiveTxSet class
-
@@ -16,42 +16,82 @@
 #ifndef ACTIVE_TX_SET_H
 #define ACTIVE_TX_SET_H
 
-#include "ConcurrentBitmap.h"
+#include "BlockedBloomFilter.h"
 #include "TxEntry.h"
 
 namespace QDB {
 
+//geometry of the active tx filter: 2MB of 16 4-bit counters per word, 3 per key
+#ifndef ACTIVE_TX_FILTER_WORDS
+#define ACTIVE_TX_FILTER_WORDS (1 << 18)
+#endif
+#ifndef ACTIVE_TX_FILTER_HASHES
+#define ACTIVE_TX_FILTER_HASHES 3
+#endif
+
 /**
  * It is an approximate membership set of transactions undergoing validation.
  * Instead of using fine grain locks of tuples, using approximate membership
  * reduces the amount of locks at the cost of a small amount of false positives.
- * It supports single incrementer and multi decrementers.
+ * It supports multiple incrementers and multiple decrementers: add() is
+ * all-or-nothing, backing out its own keys when it finds a key already taken,
+ * so two serializers racing for the same key cannot both win it.
+ *
+ * The keys are held in a blocked counting Bloom filter: each key lives in one
+ * word, so testing a tx costs about one cache miss per key, and the filter is
+ * small enough to stay mostly cache resident. The false-blocking rate is traded
+ * against memory with ACTIVE_TX_FILTER_WORDS and ACTIVE_TX_FILTER_HASHES.
  *
+ * The filter may be cut into slices of words, one per serialize partition;
+ * a key belongs to the partition whose slice holds its word.
  */
 class ActiveTxSet {
     PROTECTED:
-    ConcurrentBitmap cbm;
+    typedef BlockedBloomFilter<4> Filter;
+    Filter filter{ACTIVE_TX_FILTER_WORDS, ACTIVE_TX_FILTER_HASHES};
     std::atomic<uint64_t> removedTxCount{0};
     std::atomic<uint64_t> addedTxCount{0};
 
     PUBLIC:
-    // false if the key is failed to be added due to overflow
+    // false, with none of its keys added, if a key is held by another tx or would overflow
     bool add(TxEntry *txEntry);
 
+    /*
+     * Admit a window of txs at once, in window order, skipping any tx that conflicts
+     * with the filter or with an earlier admitted tx of the window. The admitted txs'
+     * keys are added one CAS per filter word. Returns the number admitted, and admitted[i]
+     * tells whether txEntries[i] has been added.
+     */
+    uint32_t addBatch(TxEntry **txEntries, uint32_t count, bool *admitted);
+
     // for performance, the key is assumed to have been added
     bool remove(TxEntry *txEntry);
 
     bool blocks(TxEntry *txEntry);
 
-    bool blocks(uint64_t hash) { return cbm.shouldNotAdd(hash); }
+    bool blocks(uint64_t hash) { return filter.contains(hash); }
+
+    // keys of a tx with the same lock id share one lock; see TxEntry::insertReadSet()
+    static uint64_t getLockId(uint64_t hash) {
+        return Filter::lockId(Filter::locate(hash, ACTIVE_TX_FILTER_WORDS, ACTIVE_TX_FILTER_HASHES));
+    }
+
+    // the slice of the filter, out of 'partitions', that the key hash falls in
+    static uint32_t getPartition(uint64_t hash, uint32_t partitions) {
+        uint64_t sliceWords = (ACTIVE_TX_FILTER_WORDS + partitions - 1) / partitions;
+        return (uint32_t)(Filter::locate(hash, ACTIVE_TX_FILTER_WORDS, 1).slot / sliceWords);
+    }
+
+    // estimated chance that a key not held by any active tx blocks nonetheless
+    double getFalsePositiveRate() { return filter.estimateFalsePositiveRate(); }
 
     // for testing
     uint64_t getRemovedTxCount() { return removedTxCount; }
     uint64_t getCount() { return addedTxCount - removedTxCount; }
 
     // for testing
-    bool clear() { return cbm.clear(); }
-    bool isClean() { return cbm.isClean(); }
+    bool clear() { return filter.clear(); }
+    bool isClean() { return filter.isClean(); }
 
     ActiveTxSet() {}
 
@@ -60,4 +100,3 @@ class ActiveTxSet {
 } // end namespace QDB
 
 #endif  /* ACTIVE_TX_SET_H */
-
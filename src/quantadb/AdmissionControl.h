@@ -0,0 +1,163 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include <algorithm>
+#include <atomic>
+#include "Common.h"
+#include "CtsHash.h"
+
+namespace QDB {
+
+//bounds of the credit limit, i.e., of the CIs in the validation pipeline at a time
+#ifndef ADMISSION_MAX_CREDITS
+#define ADMISSION_MAX_CREDITS 65536
+#endif
+#define ADMISSION_MIN_CREDITS 64
+
+//credits beyond the limit that only retries of deferred CIs may take
+#define ADMISSION_RETRY_RESERVE 1024
+
+//pipeline sojourn time above which the credit limit backs off
+#define ADMISSION_TARGET_USEC 2000
+
+//concluded CIs per adjustment of the credit limit
+#define ADMISSION_ADAPT_WINDOW 256
+
+//slots of the lossy table of deferred CTSs
+#define ADMISSION_DEFERRED_SLOTS 4096
+
+/**
+ * Credit-based admission of commit-intents (CI) into the validation pipeline.
+ *
+ * A CI takes a credit when queued and returns it when concluded. A CI finding
+ * no credit left is deferred: its client is asked to retry after a delay that
+ * grows with the backlog, instead of the CI being aborted. The CTSs of deferred
+ * CIs are remembered, so that their retries may also take from a reserve that
+ * first attempts cannot, and get in ahead of newcomers.
+ *
+ * The credit limit follows the time CIs spend in the pipeline (AIMD): it is cut
+ * by an eighth when most CIs of an adjustment window took longer than the
+ * target, and grows when none did while CIs were being deferred.
+ */
+class AdmissionControl {
+    PUBLIC:
+    AdmissionControl(uint64_t minCredits = ADMISSION_MIN_CREDITS,
+            uint64_t maxCredits = ADMISSION_MAX_CREDITS,
+            uint64_t targetUsec = ADMISSION_TARGET_USEC)
+        : minCredits(minCredits), maxCredits(maxCredits), targetUsec(targetUsec),
+          limit(maxCredits) {
+        for (auto &slot : deferredCts)
+            slot.store(0, std::memory_order_relaxed);
+    }
+
+    // take a credit for the CI of cts, unless forced only if one is left;
+    // false if the CI is deferred
+    bool admit(__uint128_t cts, bool force = false) {
+        bool isRetry = forget(cts);
+        uint64_t cap = limit.load() + (isRetry ? ADMISSION_RETRY_RESERVE : 0);
+        uint64_t n = inFlight.load();
+        do {
+            if (n >= cap && !force) {
+                remember(cts);
+                deferrals++;
+                deferredSinceAdapt.store(true, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!inFlight.compare_exchange_weak(n, n + 1));
+        if (isRetry)
+            retriesAdmitted++;
+        return true;
+    }
+
+    // return the credit of a CI concluded sojournUsec after being admitted
+    void release(uint64_t sojournUsec) {
+        assert(inFlight.load() > 0);
+        inFlight.fetch_sub(1);
+        if (sojournUsec > targetUsec)
+            slowInWindow++;
+        if (++released % ADMISSION_ADAPT_WINDOW == 0)
+            adapt();
+    }
+
+    // client delay suggested for a deferred CI, about the time to work off the backlog
+    void retryDelay(uint32_t &minDelayMicros, uint32_t &maxDelayMicros) {
+        uint64_t backlog = inFlight.load();
+        uint64_t l = limit.load();
+        uint64_t delay = targetUsec * backlog / l;
+        delay = std::max<uint64_t>(delay, targetUsec / 4);
+        delay = std::min<uint64_t>(delay, targetUsec * 8);
+        minDelayMicros = (uint32_t)delay;
+        maxDelayMicros = (uint32_t)(delay * 2);
+    }
+
+    uint64_t getLimit() { return limit.load(); }
+    uint64_t getInFlight() { return inFlight.load(); }
+    uint64_t getDeferrals() { return deferrals.load(); }
+    uint64_t getRetriesAdmitted() { return retriesAdmitted.load(); }
+
+    PROTECTED:
+    void adapt() {
+        uint64_t slow = slowInWindow.exchange(0);
+        bool wanted = deferredSinceAdapt.exchange(false);
+        uint64_t l = limit.load();
+        if (slow > ADMISSION_ADAPT_WINDOW / 2)
+            l = std::max(minCredits, l - (l + 7) / 8);
+        else if (slow == 0 && wanted)
+            l = std::min(maxCredits, l + l / 16 + 1);
+        limit.store(l);
+    }
+
+    //a nonzero fingerprint of the CTS; 0 marks an empty slot
+    static inline uint64_t fingerprint(__uint128_t cts) {
+        return hashCts(cts) | 1;
+    }
+
+    void remember(__uint128_t cts) {
+        if (cts == 0)
+            return; //e.g., a backdoor write, which is not told apart from its retries
+        uint64_t fp = fingerprint(cts);
+        deferredCts[(fp >> 1) % ADMISSION_DEFERRED_SLOTS].store(fp, std::memory_order_relaxed);
+    }
+
+    // true if the CI of cts was deferred before
+    bool forget(__uint128_t cts) {
+        if (cts == 0)
+            return false;
+        uint64_t fp = fingerprint(cts);
+        std::atomic<uint64_t> &slot = deferredCts[(fp >> 1) % ADMISSION_DEFERRED_SLOTS];
+        return slot.load(std::memory_order_relaxed) == fp && slot.compare_exchange_strong(fp, 0);
+    }
+
+    const uint64_t minCredits;
+    const uint64_t maxCredits;
+    const uint64_t targetUsec;
+    std::atomic<uint64_t> limit;
+    std::atomic<uint64_t> inFlight{0};
+    std::atomic<uint64_t> released{0};
+    std::atomic<uint64_t> slowInWindow{0};
+    std::atomic<bool> deferredSinceAdapt{false};
+    std::atomic<uint64_t> deferrals{0};
+    std::atomic<uint64_t> retriesAdmitted{0};
+    std::atomic<uint64_t> deferredCts[ADMISSION_DEFERRED_SLOTS];
+
+    DISALLOW_COPY_AND_ASSIGN(AdmissionControl);
+}; // end AdmissionControl class
+
+} // end namespace QDB
+
+#endif  /* ADMISSION_CONTROL_H */
@@ -0,0 +1,134 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "AdmissionControl.h"
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static inline __uint128_t
+makeCTS(uint64_t nsec, uint64_t id)
+{
+    return ((__uint128_t)nsec << 64) + id;
+}
+
+class AdmissionControlTest : public ::testing::Test {
+  public:
+  AdmissionControlTest() : admission(4, 16, 1000) {};
+  ~AdmissionControlTest() {};
+
+  AdmissionControl admission;
+
+  DISALLOW_COPY_AND_ASSIGN(AdmissionControlTest);
+};
+
+TEST_F(AdmissionControlTest, creditsBound) {
+    for (uint64_t i = 1; i <= 16; i++)
+        EXPECT_TRUE(admission.admit(makeCTS(i, 1)));
+    EXPECT_FALSE(admission.admit(makeCTS(17, 1)));
+    EXPECT_EQ(1u, admission.getDeferrals());
+    EXPECT_EQ(16u, admission.getInFlight());
+
+    // recovered CIs are forced in
+    EXPECT_TRUE(admission.admit(makeCTS(18, 1), true));
+    admission.release(0);
+
+    admission.release(0);
+    EXPECT_TRUE(admission.admit(makeCTS(19, 1)));
+}
+
+TEST_F(AdmissionControlTest, retryTakesReserve) {
+    for (uint64_t i = 1; i <= 16; i++)
+        EXPECT_TRUE(admission.admit(makeCTS(i, 1)));
+    EXPECT_FALSE(admission.admit(makeCTS(17, 1)));
+    EXPECT_FALSE(admission.admit(makeCTS(18, 1)));
+
+    // the retry of a deferred CI gets in ahead of newcomers, once
+    EXPECT_TRUE(admission.admit(makeCTS(17, 1)));
+    EXPECT_EQ(1u, admission.getRetriesAdmitted());
+    EXPECT_FALSE(admission.admit(makeCTS(19, 1)));
+    EXPECT_FALSE(admission.admit(makeCTS(0, 0)));
+    EXPECT_FALSE(admission.admit(makeCTS(0, 0)));
+}
+
+TEST_F(AdmissionControlTest, limitFollowsSojournTime) {
+    // slow conclusions shrink the limit down to the minimum
+    for (int round = 0; round < 32; round++) {
+        for (int i = 0; i < ADMISSION_ADAPT_WINDOW; i++) {
+            ASSERT_TRUE(admission.admit(0, true));
+            admission.release(5000);
+        }
+    }
+    EXPECT_EQ(4u, admission.getLimit());
+
+    // fast conclusions grow it back only while CIs are being deferred
+    for (int i = 0; i < ADMISSION_ADAPT_WINDOW; i++) {
+        ASSERT_TRUE(admission.admit(0, true));
+        admission.release(10);
+    }
+    EXPECT_EQ(4u, admission.getLimit());
+    while (admission.getLimit() < 16) {
+        uint64_t limit = admission.getLimit();
+        for (uint64_t i = 0; i <= limit; i++)
+            admission.admit(makeCTS(i + 1, 2));
+        while (admission.getInFlight() > 0)
+            admission.release(10);
+        for (int i = 0; i < ADMISSION_ADAPT_WINDOW; i++) {
+            ASSERT_TRUE(admission.admit(0, true));
+            admission.release(10);
+        }
+        ASSERT_GT(admission.getLimit(), limit);
+    }
+    EXPECT_EQ(16u, admission.getLimit());
+}
+
+TEST_F(AdmissionControlTest, retryDelayGrowsWithBacklog) {
+    uint32_t minDelay, maxDelay;
+    admission.retryDelay(minDelay, maxDelay);
+    EXPECT_EQ(250u, minDelay);
+    EXPECT_EQ(2 * minDelay, maxDelay);
+
+    for (uint64_t i = 1; i <= 32; i++)
+        admission.admit(makeCTS(i, 1), true);
+    uint32_t busyMinDelay;
+    admission.retryDelay(busyMinDelay, maxDelay);
+    EXPECT_GT(busyMinDelay, minDelay);
+    EXPECT_LE(busyMinDelay, 8000u);
+}
+
+TEST_F(AdmissionControlTest, concurrentAdmitRelease) {
+    std::atomic<uint64_t> admitted{0};
+    std::thread threads[4];
+    for (int t = 0; t < 4; t++) {
+        threads[t] = std::thread([&, t]() {
+            for (uint64_t i = 1; i <= 10000; i++) {
+                if (admission.admit(makeCTS(i, t))) {
+                    EXPECT_LE(admission.getInFlight(), 16u + ADMISSION_RETRY_RESERVE);
+                    admitted++;
+                    admission.release(0);
+                }
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    EXPECT_EQ(0u, admission.getInFlight());
+    EXPECT_EQ(40000u, admitted.load() + admission.getDeferrals());
+}
+
+}  // namespace RAMCloud
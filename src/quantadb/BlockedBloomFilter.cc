@@ -0,0 +1,175 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <immintrin.h>
+#include "BlockedBloomFilter.h"
+
+namespace QDB {
+
+template <uint32_t BITS> const uint32_t BlockedBloomFilter<BITS>::SLOTS;
+template <uint32_t BITS> const uint64_t BlockedBloomFilter<BITS>::MAX_COUNT;
+template <uint32_t BITS> const uint64_t BlockedBloomFilter<BITS>::LOW;
+
+template <uint32_t BITS>
+BlockedBloomFilter<BITS>::BlockedBloomFilter(uint64_t _numWords, uint32_t _numHashes) {
+    assert(_numHashes >= 1 && _numHashes <= SLOTS);
+    assert(_numWords < (1ul << 32));
+    numWords = _numWords;
+    numHashes = _numHashes;
+    words = new uint64_t[numWords]();
+}
+
+template <uint32_t BITS>
+BlockedBloomFilter<BITS>::~BlockedBloomFilter() {
+    delete[] words;
+}
+
+template <uint32_t BITS>
+bool
+BlockedBloomFilter<BITS>::clear() {
+    for (uint64_t i = 0; i < numWords; i++) {
+        words[i] = 0;
+    }
+    return true;
+}
+
+template <uint32_t BITS>
+bool
+BlockedBloomFilter<BITS>::isClean() {
+    uint64_t val = 0;
+    for (uint64_t i = 0; i < numWords; i++) {
+        val |= words[i];
+    }
+    return (val == 0);
+}
+
+template <uint32_t BITS>
+uint32_t
+BlockedBloomFilter<BITS>::containsAny(const uint64_t *hashes, uint32_t count) {
+    uint32_t i = 0;
+#ifdef __AVX2__
+    //test four keys at a time: gather their words and compare the folded counters
+    const __m256i low = _mm256_set1_epi64x(LOW);
+    for (; i + 4 <= count; i += 4) {
+        Lock l0 = locate(hashes[i]), l1 = locate(hashes[i + 1]);
+        Lock l2 = locate(hashes[i + 2]), l3 = locate(hashes[i + 3]);
+        __m256i slots = _mm256_set_epi64x(l3.slot, l2.slot, l1.slot, l0.slot);
+        __m256i ones = _mm256_set_epi64x(l3.ones, l2.ones, l1.ones, l0.ones);
+        __m256i w = _mm256_i64gather_epi64((const long long *)words, slots, 8);
+        for (uint32_t s = 1; s < BITS; s <<= 1)
+            w = _mm256_or_si256(w, _mm256_srlv_epi64(w, _mm256_set1_epi64x(s)));
+        w = _mm256_and_si256(_mm256_and_si256(w, low), ones);
+        int hits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(w, ones)));
+        if (hits)
+            return i + __builtin_ctz(hits);
+    }
+#endif
+    for (; i < count; i++) {
+        if (contains(hashes[i]))
+            return i;
+    }
+    return count;
+}
+
+template <uint32_t BITS>
+bool
+BlockedBloomFilter<BITS>::add(uint64_t hash) {
+    Lock lock = locate(hash);
+    uint64_t oldWord;
+    do {
+        oldWord = words[lock.slot];
+        if (fullCounters(oldWord) & lock.ones)
+            return false;
+    } while (!casWord(lock.slot, oldWord, oldWord + lock.ones));
+    return true;
+}
+
+template <uint32_t BITS>
+bool
+BlockedBloomFilter<BITS>::tryAcquire(uint64_t hash) {
+    Lock lock = locate(hash);
+    uint64_t oldWord;
+    do {
+        oldWord = words[lock.slot];
+        if (isPresent(oldWord, lock.ones) || (fullCounters(oldWord) & lock.ones))
+            return false;
+    } while (!casWord(lock.slot, oldWord, oldWord + lock.ones));
+    return true;
+}
+
+template <uint32_t BITS>
+bool
+BlockedBloomFilter<BITS>::remove(uint64_t hash) {
+    Lock lock = locate(hash);
+    uint64_t oldWord;
+    do {
+        oldWord = words[lock.slot];
+        // assume that the key has actually been added
+        if (!isPresent(oldWord, lock.ones))
+            return false;
+    } while (!casWord(lock.slot, oldWord, oldWord - lock.ones));
+    return true;
+}
+
+template <uint32_t BITS>
+bool
+BlockedBloomFilter<BITS>::shouldNotAdd(uint64_t hash) {
+    Lock lock = locate(hash);
+    uint64_t word = words[lock.slot];
+    // Return true on any one of the two conditions
+    /// the first: the key is in the BF
+    /// the second: if the key is added to the BF, a BF counter will overflow
+    return isPresent(word, lock.ones) || (fullCounters(word) & lock.ones);
+}
+
+template <uint32_t BITS>
+uint64_t
+BlockedBloomFilter<BITS>::hitCount(uint64_t hash) {
+    Lock lock = locate(hash);
+    uint64_t word = words[lock.slot];
+    if (!isPresent(word, lock.ones))
+        return 0;
+    uint64_t count = MAX_COUNT;
+    for (uint64_t ones = lock.ones; ones; ones &= ones - 1) {
+        uint32_t shift = __builtin_ctzl(ones);
+        count = std::min(count, (word >> shift) & MAX_COUNT);
+    }
+    return count;
+}
+
+template <uint32_t BITS>
+double
+BlockedBloomFilter<BITS>::estimateFalsePositiveRate(uint32_t samples) {
+    //an absent key hits when its numHashes distinct counters are all among the
+    //non-zero ones of its word: C(nonZero, k) / C(SLOTS, k)
+    static thread_local uint64_t offset = 0;
+    uint64_t stride = std::max(1ul, numWords / samples);
+    double sum = 0;
+    uint32_t n = 0;
+    for (uint64_t slot = offset++ % stride; slot < numWords && n < samples; slot += stride, n++) {
+        uint32_t nonZero = __builtin_popcountl(nonZeroCounters(words[slot]));
+        double p = 1;
+        for (uint32_t i = 0; i < numHashes; i++)
+            p *= (nonZero > i) ? (double)(nonZero - i) / (SLOTS - i) : 0;
+        sum += p;
+    }
+    return n ? sum / n : 0;
+}
+
+template class BlockedBloomFilter<4>;
+template class BlockedBloomFilter<8>;
+template class BlockedBloomFilter<16>;
+
+} // end BlockedBloomFilter class
@@ -0,0 +1,146 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef BLOCKED_BLOOM_FILTER_H
+#define BLOCKED_BLOOM_FILTER_H
+
+#include "Common.h"
+
+namespace QDB {
+
+/**
+ * Register-blocked counting Bloom filter
+ *
+ * Each key maps to one 64-bit word and to numHashes distinct counters of
+ * BITS bits within that word, so a test touches one cache line and an
+ * update is a single CAS. A key is present when all its counters are
+ * non-zero. Adding a key increments its counters; adding fails rather than
+ * overflow a counter, which also bounds countLimit().
+ *
+ * tryAcquire() is the exclusive flavor of add(): it fails when the key is
+ * already present. It is safe with any number of concurrent callers.
+ * ActiveTxSet, which uses the filter as a set of key locks, takes the keys of
+ * a tx through the word accessors instead, so they do not block each other.
+ */
+template <uint32_t BITS>
+class BlockedBloomFilter {
+    PUBLIC:
+    static const uint32_t SLOTS = 64 / BITS; //counters per word
+    static const uint64_t MAX_COUNT = (1ul << BITS) - 1;
+    static const uint64_t LOW = ~0ul / MAX_COUNT; //the lowest bit of every counter
+
+    // the word of a key and the lowest bit of each of its counters
+    struct Lock {
+        uint64_t slot;
+        uint64_t ones;
+    };
+
+    BlockedBloomFilter(uint64_t numWords, uint32_t numHashes);
+    ~BlockedBloomFilter();
+
+    static inline Lock locate(uint64_t hash, uint64_t numWords, uint32_t numHashes) {
+        Lock lock;
+        //the high half picks the word; the whole hash, remixed, picks the counters
+        lock.slot = ((hash >> 32) * numWords) >> 32;
+        lock.ones = 0;
+        uint64_t h = hash;
+        for (uint32_t i = 0; i < numHashes; i++) {
+            h = h * 0x9E3779B97F4A7C15ul + i;
+            uint32_t lane = (uint32_t)(h >> 32) % SLOTS;
+            while (lock.ones & (1ul << (lane * BITS)))
+                lane = (lane + 1) % SLOTS;
+            lock.ones |= 1ul << (lane * BITS);
+        }
+        return lock;
+    }
+    inline Lock locate(uint64_t hash) { return locate(hash, numWords, numHashes); }
+
+    // identifies the counters of a key: two keys with the same id are indistinguishable
+    static inline uint64_t lockId(const Lock &lock) {
+        uint64_t lanes = 0;
+        for (uint64_t ones = lock.ones; ones; ones &= ones - 1)
+            lanes |= 1ul << (__builtin_ctzl(ones) / BITS);
+        return (lock.slot << SLOTS) | lanes;
+    }
+
+    static inline uint64_t nonZeroCounters(uint64_t word) {
+        for (uint32_t s = 1; s < BITS; s <<= 1)
+            word |= word >> s;
+        return word & LOW;
+    }
+    static inline uint64_t fullCounters(uint64_t word) {
+        for (uint32_t s = 1; s < BITS; s <<= 1)
+            word &= word >> s;
+        return word & LOW;
+    }
+    static inline bool isPresent(uint64_t word, uint64_t ones) {
+        return (nonZeroCounters(word) & ones) == ones;
+    }
+
+    inline bool contains(uint64_t hash) {
+        Lock lock = locate(hash);
+        return isPresent(words[lock.slot], lock.ones);
+    }
+
+    // index of the first of the keys present, or count if none is
+    uint32_t containsAny(const uint64_t *hashes, uint32_t count);
+
+    // false if the key is failed to be added due to overflow
+    bool add(uint64_t hash);
+
+    // false if the key is present or if adding it would overflow
+    bool tryAcquire(uint64_t hash);
+
+    // for performance, the key is assumed to have been added
+    bool remove(uint64_t hash);
+
+    // test whether ok to add
+    bool shouldNotAdd(uint64_t hash);
+
+    // return the minimum of the key's counters when there is a hit; otherwise, 0
+    uint64_t hitCount(uint64_t hash);
+
+    uint64_t countLimit() { return MAX_COUNT; }
+
+    // word access, for callers updating several keys of a word with one CAS
+    inline uint64_t loadWord(uint64_t slot) { return words[slot]; }
+    inline bool casWord(uint64_t slot, uint64_t oldWord, uint64_t newWord) {
+        return __sync_bool_compare_and_swap(&words[slot], oldWord, newWord);
+    }
+    inline void subtractWord(uint64_t slot, uint64_t ones) {
+        __sync_fetch_and_sub(&words[slot], ones);
+    }
+
+    // chance that an absent key tests present, estimated from a sample of the words
+    double estimateFalsePositiveRate(uint32_t samples = 1024);
+
+    uint64_t getNumWords() { return numWords; }
+    uint32_t getNumHashes() { return numHashes; }
+
+    bool clear();
+
+    bool isClean();
+
+    PRIVATE:
+    uint64_t *words;
+    uint64_t numWords;
+    uint32_t numHashes;
+
+    DISALLOW_COPY_AND_ASSIGN(BlockedBloomFilter);
+}; // end BlockedBloomFilter class
+
+} // end namespace QDB
+
+#endif  /* BLOCKED_BLOOM_FILTER_H */
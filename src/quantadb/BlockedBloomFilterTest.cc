@@ -0,0 +1,183 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "BlockedBloomFilter.h"
+#include "Cycles.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static uint64_t
+keyHash(uint64_t i)
+{
+    //a stand-in for the clhash of a key
+    i ^= i >> 33;
+    i *= 0xff51afd7ed558ccdul;
+    i ^= i >> 33;
+    i *= 0xc4ceb9fe1a85ec53ul;
+    return i ^ (i >> 33);
+}
+
+class BlockedBloomFilterTest : public ::testing::Test {
+  public:
+  BlockedBloomFilterTest() : filter(1 << 16, 3) {};
+  ~BlockedBloomFilterTest() {};
+
+  BlockedBloomFilter<4> filter;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockedBloomFilterTest);
+};
+
+TEST_F(BlockedBloomFilterTest, locate) {
+    for (uint64_t i = 0; i < 10000; i++) {
+        BlockedBloomFilter<4>::Lock lock = filter.locate(keyHash(i));
+        EXPECT_LT(lock.slot, filter.getNumWords());
+        EXPECT_EQ(3, __builtin_popcountl(lock.ones));
+        EXPECT_EQ(0u, lock.ones & ~BlockedBloomFilter<4>::LOW);
+    }
+}
+
+TEST_F(BlockedBloomFilterTest, addRemove) {
+    uint64_t hash = keyHash(1);
+    EXPECT_FALSE(filter.contains(hash));
+    EXPECT_TRUE(filter.add(hash));
+    EXPECT_TRUE(filter.add(hash));
+    EXPECT_TRUE(filter.contains(hash));
+    EXPECT_EQ(2u, filter.hitCount(hash));
+    EXPECT_TRUE(filter.remove(hash));
+    EXPECT_TRUE(filter.contains(hash));
+    EXPECT_TRUE(filter.remove(hash));
+    EXPECT_FALSE(filter.contains(hash));
+    EXPECT_FALSE(filter.remove(hash));
+    EXPECT_TRUE(filter.isClean());
+}
+
+TEST_F(BlockedBloomFilterTest, tryAcquire) {
+    uint64_t hash = keyHash(2);
+    EXPECT_TRUE(filter.tryAcquire(hash));
+    EXPECT_FALSE(filter.tryAcquire(hash));
+    EXPECT_TRUE(filter.shouldNotAdd(hash));
+    EXPECT_TRUE(filter.remove(hash));
+    EXPECT_TRUE(filter.tryAcquire(hash));
+    EXPECT_TRUE(filter.remove(hash));
+    EXPECT_TRUE(filter.isClean());
+}
+
+TEST_F(BlockedBloomFilterTest, overflow) {
+    uint64_t hash = keyHash(3);
+    for (uint64_t i = 0; i < filter.countLimit(); i++)
+        EXPECT_TRUE(filter.add(hash));
+    EXPECT_TRUE(filter.shouldNotAdd(hash));
+    EXPECT_FALSE(filter.add(hash));
+    EXPECT_EQ(filter.countLimit(), filter.hitCount(hash));
+    for (uint64_t i = 0; i < filter.countLimit(); i++)
+        EXPECT_TRUE(filter.remove(hash));
+    EXPECT_TRUE(filter.isClean());
+}
+
+TEST_F(BlockedBloomFilterTest, containsAny) {
+    uint64_t hashes[11];
+    for (uint64_t i = 0; i < 11; i++)
+        hashes[i] = keyHash(100 + i);
+    EXPECT_EQ(11u, filter.containsAny(hashes, 11));
+    for (uint32_t hit = 0; hit < 11; hit++) {
+        EXPECT_TRUE(filter.add(hashes[hit]));
+        EXPECT_EQ(hit, filter.containsAny(hashes, 11));
+        EXPECT_EQ(hit, filter.containsAny(hashes, hit + 1));
+        EXPECT_EQ(hit, filter.containsAny(hashes, hit));
+        EXPECT_TRUE(filter.remove(hashes[hit]));
+    }
+}
+
+TEST_F(BlockedBloomFilterTest, counterWidths) {
+    BlockedBloomFilter<8> filter8(1 << 10, 2);
+    BlockedBloomFilter<16> filter16(1 << 10, 2);
+    uint64_t hash = keyHash(4);
+    for (uint32_t i = 0; i < 300; i++) {
+        EXPECT_EQ(i < 255, filter8.add(hash));
+        EXPECT_TRUE(filter16.add(hash));
+    }
+    EXPECT_EQ(255u, filter8.hitCount(hash));
+    EXPECT_EQ(300u, filter16.hitCount(hash));
+}
+
+TEST_F(BlockedBloomFilterTest, falsePositiveRate) {
+    //hold 10% as many keys as there are words, then probe with keys never added
+    const uint64_t held = filter.getNumWords() / 10;
+    for (uint64_t i = 0; i < held; i++)
+        EXPECT_TRUE(filter.add(keyHash(i)));
+    uint64_t hits = 0;
+    const uint64_t probes = 1000000;
+    for (uint64_t i = 0; i < probes; i++) {
+        if (filter.contains(keyHash(held + i)))
+            hits++;
+    }
+    double measured = (double)hits / probes;
+    double estimated = filter.estimateFalsePositiveRate(filter.getNumWords());
+    GTEST_COUT << "false positive rate: measured " << measured
+            << " estimated " << estimated << std::endl;
+    EXPECT_LT(measured, 0.001);
+    EXPECT_NEAR(measured, estimated, 0.0005);
+}
+
+TEST_F(BlockedBloomFilterTest, concurrentAcquire) {
+    //threads race for the same keys: each key is held by at most one at a time
+    std::atomic<uint64_t> violations{0};
+    std::atomic<int> owners[64];
+    for (auto &o : owners)
+        o = 0;
+    auto worker = [&]() {
+        for (uint32_t round = 0; round < 20000; round++) {
+            uint32_t k = round % 64;
+            if (filter.tryAcquire(keyHash(k))) {
+                if (owners[k].fetch_add(1) != 0)
+                    violations++;
+                owners[k].fetch_sub(1);
+                filter.remove(keyHash(k));
+            }
+        }
+    };
+    std::thread t1(worker), t2(worker), t3(worker), t4(worker);
+    t1.join();
+    t2.join();
+    t3.join();
+    t4.join();
+    EXPECT_EQ(0u, violations.load());
+    EXPECT_TRUE(filter.isClean());
+}
+
+TEST_F(BlockedBloomFilterTest, bench) {
+    const uint64_t count = 1000000;
+    uint64_t hashes[8];
+    for (uint64_t i = 0; i < 8; i++)
+        hashes[i] = keyHash(1000 + i);
+    uint64_t start = Cycles::rdtsc();
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        hashes[i % 8] += 8;
+        found += filter.containsAny(hashes, 8);
+    }
+    uint64_t stop = Cycles::rdtsc();
+    EXPECT_EQ(8 * count, found);
+    GTEST_COUT << "containsAny(8 keys): "
+            << Cycles::toNanoseconds(stop - start) / count << " nano sec per call" << std::endl;
+}
+
+}  // namespace RAMCloud
@@ -229,10 +229,36 @@ unsigned int intel_model_duplicates(unsigned int model)
     return model;
 }
 
-#if (0) // DISABLE TS_TRACKER
+// calibrate the TSC against the system clock over about 10ms
+static double measureTSCHz()
+{
+    timespec ts1, ts2;
+    uint32_t aux;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts1);
+    uint64_t tsc1 = __rdtscp(&aux);
+    usleep(10000);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts2);
+    uint64_t tsc2 = __rdtscp(&aux);
+    double ns = (double)(ts2.tv_sec - ts1.tv_sec) * 1e9 + (double)(ts2.tv_nsec - ts1.tv_nsec);
+    return (double)(tsc2 - tsc1) * 1e9 / ns;
+}
+
+// whether the TSC runs at a constant rate in all ACPI P-, C- and T-states
+static bool isTSCInvariant()
+{
+    uint32_t max_extended_level, eax, ebx, ecx, edx;
+    ebx = ecx = edx = 0;
+    __cpuid(0x80000000, max_extended_level, ebx, ecx, edx);
+    if (max_extended_level < 0x80000007)
+        return false;
+    ebx = ecx = edx = 0;
+    __cpuid(0x80000007, eax, ebx, ecx, edx);
+    return (edx & (1 << 8)) != 0;
+}
+
 static double getTSCHz()
 {
-    uint32_t max_level, genuine_intel, max_extended_level, crystal_hz;
+    uint32_t max_level, genuine_intel = 0, max_extended_level, crystal_hz;
     double tsc_hz = 0;
 
     unsigned int ebx, ecx, edx;
@@ -313,131 +339,122 @@ static double getTSCHz()
     }
 
     if (tsc_hz == 0)
-        tsc_hz = Cycles::perSecond();
+        tsc_hz = measureTSCHz();
 
     // printf("tsc_hz = %f\n", tsc_hz);
 
     return tsc_hz;
 }
-#endif // DISABLE TS_TRACKER
 
 namespace QDB {
 using namespace RAMCloud;
 
-#define TRACKER_SLEEP_USEC  1
+ClusterTimeService::TimePage ClusterTimeService::page;
+std::mutex ClusterTimeService::pageLock;
+uint32_t ClusterTimeService::users = 0;
+std::thread *ClusterTimeService::updater = NULL;
+std::atomic<bool> ClusterTimeService::isUpdating(false);
 
-#if (0) // DISABLE TS_TRACKER
-void * ClusterTimeService::update_ts_tracker(void *arg)
+void
+ClusterTimeService::initPage()
 {
-    ClusterTimeService *ctsp = (ClusterTimeService*)arg;
-    ts_tracker_t *tp = ctsp->tp;
-
-
-    // See if a tracker already running, by detecting its heartbeat.
-    uint32_t heartbeat;
-    int loop = 5;
-    while(loop-- > 0) {
-        heartbeat = tp->heartbeat;
-        usleep(TRACKER_SLEEP_USEC+10);
-        if (heartbeat != tp->heartbeat) { // alive
-            ctsp->tracker_init = true;
-            return NULL;
-        }
-    }
-    
-    // Init ts_tracker
-    tp->tracker_id = ctsp->my_tracker_id;
-    tp->pingpong = 0;
-
-    #ifdef USE_PTP_CLOCK
-    tp->clockid = get_ptp_clock_id(); // Use PTP clock
-    if (tp->clockid == CLOCK_INVALID) {
-        printf("FatalError: failed to get PTP clock id.\n");
-        exit(10);
-    }
-    #else // Use SYS clock
-    tp->clockid = CLOCK_REALTIME;
-    #endif
-    printf("Clock Source: %s clock\n", (tp->clockid == CLOCK_REALTIME)? "SYS" : "PTP");
-
-    tp->cyclesPerSec = getTSCHz();
-    tp->nt[0].last_clock       = tp->nt[1].last_clock       = ctsp->getnsec();
-    tp->nt[0].last_clock_tsc   = tp->nt[1].last_clock_tsc   = rdtscp();
-
-    //
-    ctsp->tracker_init = true;
-    ctsp->uctr = ctsp->nctr = 0;
-
-    // uint64_t max_delay = 0;
-    while (ctsp->thread_run_run && tp->tracker_id == ctsp->my_tracker_id) {
-        tp->heartbeat++;
-
-        nt_pair_t *ntp = &tp->nt[tp->pingpong];
-        uint64_t tsc;
-        uint64_t nsec = ctsp->getnsec(&tsc);
-        if (nsec >
-            (ntp->last_clock + Cycles::toNanoseconds(tsc - ntp->last_clock_tsc, tp->cyclesPerSec))) {
-            int nidx = 1 - tp->pingpong;
-            tp->nt[nidx].last_clock_tsc = tsc;
-            tp->nt[nidx].last_clock = nsec;
-            tp->pingpong = nidx;
-            ctsp->uctr++;
-        } else
-            ctsp->nctr++;
-
-        if (tp->tracker_id == ctsp->my_tracker_id) {
-            Cycles::sleep(TRACKER_SLEEP_USEC);
-        }
+    page.isTscReliable = isTSCInvariant();
+    if (!page.isTscReliable) {
+        printf("Warning: no invariant TSC; using clock_gettime for local time.\n");
+        return;
     }
-    return NULL;
+    uint64_t tsc;
+    uint64_t nsec = getnsec(&tsc);
+    page.nominalMult = (uint64_t)(1e9 * (double)(1ul << CLUSTER_TIME_SHIFT) / getTSCHz());
+    page.firstNsec = nsec;
+    page.firstTsc = tsc;
+    page.nsec = nsec;
+    page.tsc = tsc;
+    page.mult = page.nominalMult;
 }
-#endif // DISABLE TS_TRACKER
 
-ClusterTimeService::ClusterTimeService()
+void
+ClusterTimeService::updatePage()
 {
-#if (0) // DISABLE TS_TRACKER
-    int fd;
-
-    // attached to shared delta tracker
-    if ((fd = shm_open(TS_TRACKER_NAME, O_CREAT|O_RDWR, 0666)) == -1) {
-        printf("Fatal Error: shm_open failed. Errno=%d\n", errno);
-        *(int *)0 = 0;  // panic
+    uint64_t sysTsc;
+    uint64_t sysNsec = getnsec(&sysTsc);
+
+    //the long run ratio of system time to TSC, once the baseline is long enough
+    if (sysNsec > page.firstNsec + 1000000000 && sysTsc > page.firstTsc)
+        page.nominalMult = (uint64_t)((((__uint128_t)(sysNsec - page.firstNsec)) << CLUSTER_TIME_SHIFT)
+                / (sysTsc - page.firstTsc));
+
+    page.seq.fetch_add(1, std::memory_order_acq_rel); //odd: readers wait
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    //a reader done with the old tuple has read the TSC before this point
+    uint64_t tsc = rdtscp();
+    uint64_t mult = page.mult.load(std::memory_order_relaxed);
+    uint64_t ours = page.nsec.load(std::memory_order_relaxed)
+            + extrapolate(tsc, page.tsc.load(std::memory_order_relaxed), mult);
+    uint64_t sys = sysNsec + extrapolate(tsc, sysTsc, mult);
+    int64_t drift = (int64_t)(sys - ours);
+
+    //cancel the drift by the next update, within half the rate either way
+    const int64_t period = CLUSTER_TIME_UPDATE_USEC * 1000;
+    int64_t slew = drift;
+    uint64_t nsec = ours;
+    if (drift > CLUSTER_TIME_MAX_SLEW_NS) {
+        nsec = sys; //too far behind to catch up with by slewing
+        slew = 0;
+        page.steps++;
+    } else if (drift < -period / 2) {
+        slew = -period / 2;
+        page.holds++;
+    } else if (drift > period / 2) {
+        slew = period / 2;
     }
+    page.nsec.store(nsec, std::memory_order_relaxed);
+    page.tsc.store(tsc, std::memory_order_relaxed);
+    page.mult.store((uint64_t)((__int128_t)page.nominalMult * (period + slew) / period),
+            std::memory_order_relaxed);
+
+    page.seq.fetch_add(1, std::memory_order_release); //even: published
+
+    uint64_t absDrift = drift < 0 ? -drift : drift;
+    page.lastDrift = drift;
+    if (absDrift > page.maxDrift)
+        page.maxDrift = absDrift;
+    page.updates++;
+}
 
-    struct stat st;
-    int ret = fstat(fd, &st); assert(ret == 0); 
-    if (st.st_size == 0) {
-        ret = ftruncate(fd, sizeof(ts_tracker_t));
-        assert(ret == 0);
+void
+ClusterTimeService::updaterMain()
+{
+    while (isUpdating) {
+        usleep(CLUSTER_TIME_UPDATE_USEC);
+        updatePage();
     }
+}
 
-    tp = (ts_tracker_t *)mmap(NULL, sizeof(ts_tracker_t), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-    assert(tp);
-    close(fd);
-
-    // Start tracker thread
-    thread_run_run = true;
-    tracker_init = false;
-	pthread_create(&tid, NULL, update_ts_tracker, (void *)this);
-    srand(tid);
-    my_tracker_id = rand();
-
-    while(!tracker_init)
-        usleep(1);
-#endif // DISABLE TS_TRACKER
+ClusterTimeService::ClusterTimeService()
+{
+    std::lock_guard<std::mutex> lock(pageLock);
+    if (users++ > 0)
+        return;
+    if (page.seq.load() == 0 && page.mult.load() == 0)
+        initPage();
+    if (page.isTscReliable) {
+        isUpdating = true;
+        updater = new std::thread(updaterMain);
+    }
 }
 
 ClusterTimeService::~ClusterTimeService()
 {
-#if (0) // DISABLE TS_TRACKER
-    if (thread_run_run && tp->tracker_id == my_tracker_id) {
-        void * ret;
-        thread_run_run = false;
-	    pthread_join(tid, &ret);
-    }
-    // printf("~ClusterTimeService uctr=%ld nctr=%ld\n", uctr, nctr);
-    munmap(tp, sizeof(ts_tracker_t));
-#endif // DISABLE TS_TRACKER
+    std::lock_guard<std::mutex> lock(pageLock);
+    if (--users > 0 || updater == NULL)
+        return;
+    //the page stays valid; it is only no longer corrected
+    isUpdating = false;
+    updater->join();
+    delete updater;
+    updater = NULL;
 }
 
 } // QDB
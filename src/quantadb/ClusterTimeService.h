@@ -25,6 +25,8 @@
 #include <sys/stat.h>
 #include <atomic>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include "Cycles.h"
 
 using namespace RAMCloud;
@@ -58,21 +60,28 @@ namespace QDB {
  * fast (about ~25ns) but only returns micro-second precision. The other  is clock_gettime(3) which returns
  * nanoseconds time stamp, yet could take ~500ns per call.
  *
- * To generate fast nanosecond time stamps, ClusterTimeService uses a background deamon process (or can also be
- * a background thread which is easier for deployment and testing purpose). The background thread maintais a
- * shared memory area which holds a nano-seond system timestamp along with a TSC counter which notes the cputime
- * when the system timestamp was last updated. The ClusterTimeService library reads the nano-second system
- * timestamp on the shared memory and uses TSC to calculate how much time had passed since the last update to
- * get the current time.
+ * To generate fast nanosecond time stamps, ClusterTimeService keeps a time page shared by all its instances
+ * in the process. A background updater thread publishes on it a (nsec, tsc, mult) tuple under a sequence lock
+ * every CLUSTER_TIME_UPDATE_USEC. A reader takes the tuple and the TSC in one read section and extrapolates,
+ * nsec + (((tsc - tsc of the tuple) * mult) >> CLUSTER_TIME_SHIFT), without a system call or a shared write.
+ *
+ * Each update measures the drift of the extrapolated time from the system clock and picks the mult that
+ * cancels it by the next update, so the time is slewed, not stepped, toward the system clock. A new tuple
+ * starts where the old one stands at the time of the update, so the time never goes backward; a clock
+ * stepped backward is caught up with by running slower, and only a forward step of more than
+ * CLUSTER_TIME_MAX_SLEW_NS is taken at once. The drift, the holds and the steps are kept for telemetry.
  *
  * EXTRA NOTE.
  * Using TSC to calculate time is hard to be reliable.
- * ref: http://oliveryang.net/2015/09/pitfalls-of-TSC-usage/#312-tsc-sync-behaviors-on-smp-system. 
- *
- * An alternative way to use an atomic counter to replace the TSC counter. This way could generate reliable
- * monotonically increasing timestamps.
+ * ref: http://oliveryang.net/2015/09/pitfalls-of-TSC-usage/#312-tsc-sync-behaviors-on-smp-system.
+ * The time page is used only if the CPU reports an invariant TSC, which is then taken to be in sync
+ * across the cores; otherwise getLocalTime() falls back to clock_gettime(3).
  */
 
+#define CLUSTER_TIME_UPDATE_USEC    1000
+#define CLUSTER_TIME_SHIFT          32
+#define CLUSTER_TIME_MAX_SLEW_NS    1000000
+
 // ClusterTimeService
 class ClusterTimeService {
     public:
@@ -82,18 +91,64 @@ class ClusterTimeService {
     // return a local system clock time stamp
     inline uint64_t getLocalTime()
     {
-        return getnsec();
-        /*
-        nt_pair_t *ntp = &tp->nt[tp->pingpong];
-        uint64_t last_clock      = ntp->last_clock;
-        uint64_t last_clock_tsc  = ntp->last_clock_tsc;
-        return last_clock + Cycles::toNanoseconds(rdtscp() - last_clock_tsc, tp->cyclesPerSec);
-        */
+        if (!page.isTscReliable)
+            return getnsec();
+
+        uint64_t seq, nsec, tsc0, mult, tsc;
+        do {
+            seq = page.seq.load(std::memory_order_acquire);
+            nsec = page.nsec.load(std::memory_order_relaxed);
+            tsc0 = page.tsc.load(std::memory_order_relaxed);
+            mult = page.mult.load(std::memory_order_relaxed);
+            tsc = rdtscp(); //waits for the loads above
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != page.seq.load(std::memory_order_relaxed));
+        return nsec + extrapolate(tsc, tsc0, mult);
     }
 
+    // telemetry of the time page
+    inline bool isTscClock() { return page.isTscReliable; }
+    inline uint64_t getUpdateCount() { return page.updates.load(); }
+    inline int64_t getLastDrift() { return page.lastDrift.load(); }   //system clock minus ours, in nsec
+    inline uint64_t getMaxDrift() { return page.maxDrift.load(); }    //largest absolute drift seen
+    inline uint64_t getHoldCount() { return page.holds.load(); }      //updates slowed down for monotonicity
+    inline uint64_t getStepCount() { return page.steps.load(); }      //forward steps taken at once
+
     private:
+    // the time page; fields other than seq are written under the odd seq only
+    struct TimePage {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> nsec{0};
+        std::atomic<uint64_t> tsc{0};
+        std::atomic<uint64_t> mult{0};  //nsec per cycle, scaled by 2^CLUSTER_TIME_SHIFT
+        uint64_t nominalMult = 0;       //mult from the long run ratio of system time to TSC
+        uint64_t firstNsec = 0;
+        uint64_t firstTsc = 0;
+        bool isTscReliable = false;
+
+        std::atomic<uint64_t> updates{0};
+        std::atomic<int64_t> lastDrift{0};
+        std::atomic<uint64_t> maxDrift{0};
+        std::atomic<uint64_t> holds{0};
+        std::atomic<uint64_t> steps{0};
+    };
+
+    static TimePage page;
+    static std::mutex pageLock;         //serializes the start and stop of the updater
+    static uint32_t users;
+    static std::thread *updater;
+    static std::atomic<bool> isUpdating;
+
+    static inline uint64_t extrapolate(uint64_t tsc, uint64_t tsc0, uint64_t mult)
+    {
+        if (tsc <= tsc0)
+            return 0;
+        return (uint64_t)(((__uint128_t)(tsc - tsc0) * mult) >> CLUSTER_TIME_SHIFT);
+    }
 
-    // static void* update_ts_tracker(void *);
+    static void initPage();
+    static void updatePage();
+    static void updaterMain();
 
     // Fast (~25ns) about only at usec precision
     static inline uint64_t getusec()
@@ -104,7 +159,7 @@ class ClusterTimeService {
     }
 
     // Slow (~500ns) about at nsec precision
-    inline uint64_t getnsec()
+    static inline uint64_t getnsec()
     {
         timespec ts;
         clock_gettime(CLOCK_REALTIME, &ts);
@@ -112,7 +167,7 @@ class ClusterTimeService {
     }
 
     // Slow (~500ns) about at nsec precision
-    inline uint64_t getnsec(uint64_t *tsc)
+    static inline uint64_t getnsec(uint64_t *tsc)
     {
         timespec ts;
         uint64_t tsc1 = rdtscp();
@@ -127,30 +182,6 @@ class ClusterTimeService {
         uint32_t aux;
         return __rdtscp(&aux);
     }
-#if (0) // DISABLE TS_TRACKER
-    #define TS_TRACKER_NAME  "DSSN_TS_Tracker"
-    typedef struct {
-        uint64_t last_clock;           // nano-sec from the last update
-        uint64_t last_clock_tsc;       // TSC counter value of the last_clock
-    } nt_pair_t;
-
-    typedef struct {
-        volatile uint32_t pingpong;    // Ping-pong index. Eiter 0 or 1.
-        nt_pair_t nt[2];
-        double cyclesPerSec;
-        std::atomic<int> tracker_id;
-        uint32_t heartbeat;
-        clockid_t clockid;             //
-    } ts_tracker_t;
-
-    
-    ts_tracker_t * tp;                // pointing to a shared ts_tracker
-    pthread_t tid;
-    int my_tracker_id;
-    bool thread_run_run;
-    bool tracker_init;
-#endif
-    uint64_t uctr, nctr;              // statistics
 }; // ClusterTimeService
 
 } // end namespace QDB
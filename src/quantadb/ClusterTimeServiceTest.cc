@@ -85,6 +85,39 @@ TEST_F(ClusterTimeServiceTest, MTClockTest) {
     t3.join();
 }
 
+TEST_F(ClusterTimeServiceTest, tracksSystemClock) {
+    if (!clock.isTscClock())
+        return;
+    usleep(CLUSTER_TIME_UPDATE_USEC * 5);
+    EXPECT_LT(0u, clock.getUpdateCount());
+    for (int ii = 0; ii < 100; ii++) {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        int64_t sys = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+        int64_t ours = (int64_t)clock.getLocalTime();
+        EXPECT_GT(CLUSTER_TIME_MAX_SLEW_NS, std::abs(ours - sys));
+        usleep(100);
+    }
+    GTEST_COUT << "updates: " << clock.getUpdateCount()
+    << ", last drift: " << clock.getLastDrift() << " ns, max drift: " << clock.getMaxDrift()
+    << " ns, holds: " << clock.getHoldCount() << ", steps: " << clock.getStepCount() << std::endl;
+}
+
+TEST_F(ClusterTimeServiceTest, monotonicAcrossUpdates) {
+    //readers keep running across many updates of the time page
+    uint64_t last = clock.getLocalTime();
+    uint64_t updates = clock.getUpdateCount();
+    uint64_t start = Cycles::rdtsc();
+    while (Cycles::toNanoseconds(Cycles::rdtsc() - start) < 20000000) {
+        uint64_t now = clock.getLocalTime();
+        EXPECT_LE(last, now);
+        last = now;
+    }
+    if (clock.isTscClock()) {
+        EXPECT_LT(updates, clock.getUpdateCount());
+    }
+}
+
 #define OP_WAIT     0
 #define OP_START    1
 #define OP_END      2
@@ -148,6 +181,14 @@ TEST_F(ClusterTimeServiceTest, benchGenClusterTime) {
     stop = Cycles::rdtscp();
     GTEST_COUT << "4th getLocalTime: "
     << Cycles::toNanoseconds(stop - start) << " nano sec " << std::endl;
+
+    loop = 1024*1024;
+    start = Cycles::rdtscp();
+    for (int ii = 0; ii < loop; ii++)
+        clock.getLocalTime();
+    stop = Cycles::rdtscp();
+    GTEST_COUT << "getLocalTime avg: "
+    << Cycles::toNanoseconds(stop - start)/loop << " nano sec " << std::endl;
 }
 
 }  // namespace RAMCloud
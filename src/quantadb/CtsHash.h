@@ -0,0 +1,46 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTS_HASH_H
+#define CTS_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace QDB {
+
+/**
+ * Hash of a CTS, for the tables and shards keyed by one. Both halves are
+ * mixed, as the CIs of one sequencer tick share the upper one and are told
+ * apart by the id in the lower one; the mixer is the murmur3 finalizer.
+ */
+static inline uint64_t
+hashCts(__uint128_t cts)
+{
+    uint64_t h = (uint64_t)cts ^ (uint64_t)(cts >> 64);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdul;
+    h ^= h >> 33;
+    return h;
+}
+
+// hashCts() for the standard containers
+struct CtsHash {
+    size_t operator()(const __uint128_t &cts) const { return hashCts(cts); }
+};
+
+} // end namespace QDB
+
+#endif  /* CTS_HASH_H */
@@ -0,0 +1,229 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTS_INDEX_H
+#define CTS_INDEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "Common.h"
+#include "CtsHash.h"
+#include "EpochManager.h"
+
+namespace QDB {
+
+/**
+ * Lock-free map from a CTS to the log position of the latest record logged
+ * for it, so that TxLog answers tx state queries without scanning the log.
+ *
+ * The map is a chain of open-addressing hash tables (segments), newest first.
+ * Inserts go to the newest segment; once it is 3/4 full a segment sized for
+ * the entries not yet trimmed is pushed in front of it, so there are O(log n)
+ * segments, the old ones are never rehashed, and the index follows the size
+ * of the untrimmed log rather than the number of records ever indexed. A
+ * lookup probes the segments newest first. Records of one CTS are expected to
+ * be indexed in log order, as a tx state is logged only after its previous
+ * one.
+ *
+ * A slot is claimed with one CAS and published with a release store of its
+ * state; readers never block writers. Segments whose records have all been
+ * trimmed from the log are unlinked by dropBelow() and freed through the
+ * EpochManager.
+ */
+class CtsIndex {
+    PUBLIC:
+    static const uint64_t INIT_SLOTS = 1 << 16;
+
+    CtsIndex() {
+        newest = new Segment(INIT_SLOTS, NULL);
+    }
+
+    ~CtsIndex() {
+        Segment *seg = newest.load();
+        while (seg) {
+            Segment *older = seg->older.load();
+            delete seg;
+            seg = older;
+        }
+    }
+
+    // index pos as the latest log position of cts
+    void put(__uint128_t cts, uint64_t pos) {
+        EpochGuard guard;
+        while (true) {
+            Segment *seg = newest.load(std::memory_order_acquire);
+            if (seg->used.load() >= seg->mask - (seg->mask >> 2)) {
+                grow(seg);
+                continue;
+            }
+            if (seg->put(cts, pos))
+                return;
+            grow(seg); //filled up by racing inserts
+        }
+    }
+
+    // the latest log position of cts; false if it has not been indexed
+    bool get(__uint128_t cts, uint64_t &pos) {
+        EpochGuard guard;
+        for (Segment *seg = newest.load(std::memory_order_acquire); seg; seg = seg->older.load())
+            if (seg->get(cts, pos))
+                return true;
+        return false;
+    }
+
+    // forget the segments holding positions below pos only; the newest is kept
+    void dropBelow(uint64_t pos) {
+        std::lock_guard<std::mutex> lock(growLock);
+        trimmed = std::max(trimmed, pos);
+        Segment *seg = newest.load();
+        while (Segment *older = seg->older.load()) {
+            if (older->maxPos.load() < pos) {
+                seg->older.store(NULL);
+                while (older) {
+                    Segment *next = older->older.load();
+                    EpochManager::instance().retireObject(older);
+                    older = next;
+                }
+                break;
+            }
+            seg = older;
+        }
+    }
+
+    // number of entries; a CTS updated after a growth has one in each of two segments
+    inline uint64_t size() {
+        EpochGuard guard;
+        uint64_t n = 0;
+        for (Segment *seg = newest.load(); seg; seg = seg->older.load())
+            n += seg->used.load();
+        return n;
+    }
+
+    inline uint64_t getSegmentCount() {
+        EpochGuard guard;
+        uint64_t n = 0;
+        for (Segment *seg = newest.load(); seg; seg = seg->older.load())
+            n++;
+        return n;
+    }
+
+    PROTECTED:
+    struct Slot {
+        #define CTS_SLOT_EMPTY  0
+        #define CTS_SLOT_BUSY   1
+        #define CTS_SLOT_READY  2
+        std::atomic<uint32_t> state{CTS_SLOT_EMPTY};
+        __uint128_t cts;
+        std::atomic<uint64_t> pos;
+    };
+
+    struct Segment {
+        uint64_t mask;
+        std::atomic<uint64_t> used{0};
+        std::atomic<uint64_t> maxPos{0};
+        std::atomic<Segment *> older;
+        Slot *slots;
+
+        Segment(uint64_t nslots, Segment *next) : mask(nslots - 1), older(next) {
+            slots = new Slot[nslots];
+        }
+        ~Segment() { delete[] slots; }
+
+        bool put(__uint128_t cts, uint64_t pos) {
+            uint64_t idx = hashCts(cts) & mask;
+            for (uint64_t probe = 0; probe <= mask; probe++, idx = (idx + 1) & mask) {
+                Slot &slot = slots[idx];
+                uint32_t state = slot.state.load(std::memory_order_acquire);
+                if (state == CTS_SLOT_EMPTY &&
+                        slot.state.compare_exchange_strong(state, CTS_SLOT_BUSY)) {
+                    slot.cts = cts;
+                    slot.pos.store(pos, std::memory_order_relaxed);
+                    slot.state.store(CTS_SLOT_READY, std::memory_order_release);
+                    used++;
+                    raise(maxPos, pos);
+                    return true;
+                }
+                //taken, possibly by a racing insert of the same cts
+                while (state == CTS_SLOT_BUSY)
+                    state = slot.state.load(std::memory_order_acquire);
+                if (slot.cts == cts) {
+                    raise(slot.pos, pos);
+                    raise(maxPos, pos);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool get(__uint128_t cts, uint64_t &pos) {
+            uint64_t idx = hashCts(cts) & mask;
+            for (uint64_t probe = 0; probe <= mask; probe++, idx = (idx + 1) & mask) {
+                Slot &slot = slots[idx];
+                uint32_t state = slot.state.load(std::memory_order_acquire);
+                if (state == CTS_SLOT_EMPTY)
+                    return false;
+                while (state == CTS_SLOT_BUSY)
+                    state = slot.state.load(std::memory_order_acquire);
+                if (slot.cts == cts) {
+                    pos = slot.pos.load();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // number of entries at positions from pos on
+        uint64_t countFrom(uint64_t pos) {
+            if (maxPos.load() < pos)
+                return 0;
+            uint64_t n = 0;
+            for (uint64_t idx = 0; idx <= mask; idx++)
+                if (slots[idx].state.load(std::memory_order_acquire) == CTS_SLOT_READY
+                        && slots[idx].pos.load(std::memory_order_relaxed) >= pos)
+                    n++;
+            return n;
+        }
+
+        static inline void raise(std::atomic<uint64_t> &val, uint64_t to) {
+            uint64_t old = val.load();
+            while (old < to && !val.compare_exchange_weak(old, to));
+        }
+    };
+
+    void grow(Segment *full) {
+        std::lock_guard<std::mutex> lock(growLock);
+        if (newest.load() != full)
+            return; //grown by another thread
+        //the chain is stable, as dropBelow() takes the lock too
+        uint64_t live = 0;
+        for (Segment *seg = full; seg; seg = seg->older.load())
+            live += seg->countFrom(trimmed);
+        uint64_t nslots = INIT_SLOTS;
+        while (nslots < live + live / 2)
+            nslots <<= 1;
+        newest.store(new Segment(nslots, full), std::memory_order_release);
+    }
+
+    std::atomic<Segment *> newest;
+    std::mutex growLock;
+    uint64_t trimmed = 0;   // highest position given to dropBelow(), under growLock
+
+    DISALLOW_COPY_AND_ASSIGN(CtsIndex);
+}; // end CtsIndex class
+
+} // end namespace QDB
+
+#endif  /* CTS_INDEX_H */
@@ -0,0 +1,142 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "CtsIndex.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static inline __uint128_t
+makeCTS(uint64_t nsec, uint64_t id)
+{
+    return ((__uint128_t)nsec << 64) + id;
+}
+
+class CtsIndexTest : public ::testing::Test {
+  public:
+  CtsIndexTest() {};
+  ~CtsIndexTest() {};
+
+  CtsIndex index;
+
+  DISALLOW_COPY_AND_ASSIGN(CtsIndexTest);
+};
+
+TEST_F(CtsIndexTest, putGet) {
+    uint64_t pos;
+    EXPECT_FALSE(index.get(makeCTS(1, 1), pos));
+    index.put(makeCTS(1, 1), 100);
+    index.put(makeCTS(1, 2), 200);
+    EXPECT_TRUE(index.get(makeCTS(1, 1), pos));
+    EXPECT_EQ(100u, pos);
+    EXPECT_TRUE(index.get(makeCTS(1, 2), pos));
+    EXPECT_EQ(200u, pos);
+    EXPECT_FALSE(index.get(makeCTS(2, 1), pos));
+
+    //the latest position wins, whatever the order of the updates
+    index.put(makeCTS(1, 1), 300);
+    index.put(makeCTS(1, 1), 250);
+    EXPECT_TRUE(index.get(makeCTS(1, 1), pos));
+    EXPECT_EQ(300u, pos);
+    EXPECT_EQ(2u, index.size());
+}
+
+TEST_F(CtsIndexTest, growAndDrop) {
+    const uint64_t n = CtsIndex::INIT_SLOTS * 4;
+    for (uint64_t i = 0; i < n; i++)
+        index.put(makeCTS(1000 + i / 8, i), i);
+    EXPECT_EQ(n, index.size());
+    EXPECT_EQ(3u, index.getSegmentCount());
+    uint64_t pos;
+    for (uint64_t i = 0; i < n; i++) {
+        EXPECT_TRUE(index.get(makeCTS(1000 + i / 8, i), pos));
+        EXPECT_EQ(i, pos);
+    }
+
+    //an update lands in the newest segment and hides the older entry
+    index.put(makeCTS(1000, 0), n);
+    EXPECT_TRUE(index.get(makeCTS(1000, 0), pos));
+    EXPECT_EQ(n, pos);
+
+    //the first segment holds positions below INIT_SLOTS * 3/4 only
+    index.dropBelow(CtsIndex::INIT_SLOTS);
+    EXPECT_EQ(2u, index.getSegmentCount());
+    EXPECT_FALSE(index.get(makeCTS(1000, 1), pos));
+    EXPECT_TRUE(index.get(makeCTS(1000, 0), pos));
+    EXPECT_TRUE(index.get(makeCTS(1000 + (n - 1) / 8, n - 1), pos));
+    index.dropBelow(~0ul);
+    EXPECT_EQ(1u, index.getSegmentCount());
+    EXPECT_FALSE(index.get(makeCTS(1000 + CtsIndex::INIT_SLOTS / 8, CtsIndex::INIT_SLOTS), pos));
+    EXPECT_TRUE(index.get(makeCTS(1000 + (n - 1) / 8, n - 1), pos));
+}
+
+TEST_F(CtsIndexTest, shrinkAfterDrop) {
+    //a steady stream of records trimmed behind: the segments stay as small
+    //as the live entries need, however many records have been indexed
+    const uint64_t live = CtsIndex::INIT_SLOTS;
+    for (uint64_t i = 0; i < live * 16; i++) {
+        index.put(makeCTS(1000 + i, 0), i);
+        if (i >= live)
+            index.dropBelow(i - live);
+    }
+    EXPECT_LE(index.getSegmentCount(), 3u);
+    EXPECT_LE(index.newest.load()->mask + 1, live * 2);
+    uint64_t pos;
+    EXPECT_TRUE(index.get(makeCTS(1000 + live * 16 - 1, 0), pos));
+    EXPECT_EQ(live * 16 - 1, pos);
+}
+
+void indexWriter(CtsIndex *index, uint32_t id, uint32_t writers, uint64_t len)
+{
+    for (uint64_t i = id; i < len; i += writers) {
+        index->put(makeCTS(i, 0), i);
+        index->put(makeCTS(i, 0), i + len); //a later record of the same tx
+    }
+}
+
+TEST_F(CtsIndexTest, MtPutGet) {
+    const uint64_t len = 400000;
+    std::thread t1(indexWriter, &index, 0, 4, len);
+    std::thread t2(indexWriter, &index, 1, 4, len);
+    std::thread t3(indexWriter, &index, 2, 4, len);
+    std::thread t4(indexWriter, &index, 3, 4, len);
+
+    //lookups racing with the writers and the growth of the index
+    uint64_t pos, hits = 0;
+    for (uint64_t i = 0; i < len; i++) {
+        if (index.get(makeCTS(i, 0), pos)) {
+            EXPECT_TRUE(pos == i || pos == i + len);
+            hits++;
+        }
+    }
+    t1.join();
+    t2.join();
+    t3.join();
+    t4.join();
+
+    EXPECT_LE(len, index.size());
+    for (uint64_t i = 0; i < len; i++) {
+        EXPECT_TRUE(index.get(makeCTS(i, 0), pos));
+        EXPECT_EQ(i + len, pos);
+    }
+    GTEST_COUT << "segments: " << index.getSegmentCount() << ", hits while writing: " << hits << std::endl;
+}
+
+}  // namespace RAMCloud
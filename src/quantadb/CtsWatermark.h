@@ -0,0 +1,92 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTS_WATERMARK_H
+#define CTS_WATERMARK_H
+
+#include <mutex>
+#include <set>
+#include "Common.h"
+#include "CtsHash.h"
+
+namespace QDB {
+
+/**
+ * The set of CTSs still open, e.g., of the CIs logged but not concluded yet,
+ * and its minimum, the low watermark below which nothing is open.
+ *
+ * The CTSs are spread over CTS_WATERMARK_SHARDS ordered sets, each with its
+ * own lock, so that the peer threads adding and removing them rarely contend.
+ * low() looks at the smallest CTS of every shard, which is meant for a
+ * background thread polling now and then.
+ */
+class CtsWatermark {
+    #define CTS_WATERMARK_SHARDS 16
+    PUBLIC:
+    CtsWatermark() {}
+
+    void add(__uint128_t cts) {
+        Shard &shard = shards[hash(cts)];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        shard.open.insert(cts);
+    }
+
+    // false if cts is not open
+    bool remove(__uint128_t cts) {
+        Shard &shard = shards[hash(cts)];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        return shard.open.erase(cts) > 0;
+    }
+
+    // the smallest open CTS, none if nothing is open
+    __uint128_t low(__uint128_t none) {
+        __uint128_t min = none;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            if (!shard.open.empty() && *shard.open.begin() < min)
+                min = *shard.open.begin();
+        }
+        return min;
+    }
+
+    uint64_t size() {
+        uint64_t n = 0;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            n += shard.open.size();
+        }
+        return n;
+    }
+
+    PROTECTED:
+    //a cache line of padding keeps neighbouring shards apart without over-aligning the owner
+    struct Shard {
+        std::mutex lock;
+        std::set<__uint128_t> open;
+        char pad[64];
+    };
+
+    static inline uint32_t hash(__uint128_t cts) {
+        return (uint32_t)(hashCts(cts) % CTS_WATERMARK_SHARDS);
+    }
+
+    Shard shards[CTS_WATERMARK_SHARDS];
+
+    DISALLOW_COPY_AND_ASSIGN(CtsWatermark);
+}; // end CtsWatermark class
+
+} // end namespace QDB
+
+#endif  /* CTS_WATERMARK_H */
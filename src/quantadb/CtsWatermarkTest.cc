@@ -0,0 +1,87 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "CtsWatermark.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static inline __uint128_t
+makeCTS(uint64_t nsec, uint64_t id)
+{
+    return ((__uint128_t)nsec << 64) + id;
+}
+
+class CtsWatermarkTest : public ::testing::Test {
+  public:
+  CtsWatermarkTest() {};
+  ~CtsWatermarkTest() {};
+
+  CtsWatermark watermark;
+
+  DISALLOW_COPY_AND_ASSIGN(CtsWatermarkTest);
+};
+
+TEST_F(CtsWatermarkTest, addRemove) {
+    __uint128_t none = makeCTS(1000, 0);
+    EXPECT_TRUE(watermark.low(none) == none);
+
+    watermark.add(makeCTS(30, 1));
+    watermark.add(makeCTS(10, 2));
+    watermark.add(makeCTS(20, 3));
+    EXPECT_EQ(3u, watermark.size());
+    EXPECT_TRUE(watermark.low(none) == makeCTS(10, 2));
+    EXPECT_TRUE(watermark.low(makeCTS(5, 0)) == makeCTS(5, 0));
+
+    EXPECT_TRUE(watermark.remove(makeCTS(10, 2)));
+    EXPECT_FALSE(watermark.remove(makeCTS(10, 2)));
+    EXPECT_TRUE(watermark.low(none) == makeCTS(20, 3));
+    EXPECT_TRUE(watermark.remove(makeCTS(20, 3)));
+    EXPECT_TRUE(watermark.remove(makeCTS(30, 1)));
+    EXPECT_TRUE(watermark.low(none) == none);
+    EXPECT_EQ(0u, watermark.size());
+}
+
+TEST_F(CtsWatermarkTest, MtAddRemove) {
+    //each thread keeps a window of open CTSs sliding up
+    const uint64_t n = 100000, window = 64;
+    auto worker = [&](uint64_t tid) {
+        for (uint64_t i = 0; i < n; i++) {
+            watermark.add(makeCTS(i, tid));
+            if (i >= window) {
+                EXPECT_TRUE(watermark.remove(makeCTS(i - window, tid)));
+            }
+        }
+    };
+    uint64_t start = Cycles::rdtsc();
+    std::thread t1(worker, 1), t2(worker, 2), t3(worker, 3), t4(worker, 4);
+    t1.join();
+    t2.join();
+    t3.join();
+    t4.join();
+    uint64_t stop = Cycles::rdtsc();
+    EXPECT_EQ(4 * window, watermark.size());
+    EXPECT_TRUE(watermark.low(0) == 0);
+    EXPECT_TRUE(watermark.low(makeCTS(n, 0)) == makeCTS(n - window, 1));
+    GTEST_COUT << "add and remove: " << Cycles::toNanoseconds(stop - start) / n << " nsec per pair" << std::endl;
+}
+
+}  // namespace RAMCloud
@@ -20,8 +20,14 @@
 #include <dirent.h>
 #include <string.h>
 #include <libgen.h>
+#include <algorithm>
 #include <mutex>
 #include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <immintrin.h>
+#include "Crc32C.h"
+#include "EpochManager.h"
 
 namespace QDB {
 /*
@@ -53,10 +59,21 @@ namespace QDB {
  * - uint64_t trim (uint64_t len)
  *
  *   Trim the log from the beginning for 'len' bytes.
- *   Trim will also delete the associated backing store files.
+ *   Trim will also delete the associated backing store files. A trimmed chunk is retired to the
+ *   EpochManager and stays mapped until no reader inside an EpochGuard may still be on it.
  *   Return the size that was actually trimmed.
  *   Note that trim() will not trim active (i.e., unsealed) chunk files.
  *
+ * - uint64_t truncate (uint64_t len)
+ *
+ *   Keep the first 'len' bytes of the log and drop the rest, e.g., behind a torn record found
+ *   on recovery. Not to be called while appending.
+ *
+ * - uint64_t chunk_aligned (uint64_t len)
+ *
+ *   Return the longest prefix of the first 'len' bytes that is made of whole sealed chunks,
+ *   i.e., a trim length that releases backing store files without leaving partial chunks behind.
+ *
  * - uint32_t read (uint64_t off, void *obuf, uint32_t len)
  *
  *   Read 'len' bytes from 'off' offset into 'obuf'. Return bytes read.
@@ -64,8 +81,52 @@ namespace QDB {
  * - void * getaddr(uint64_t off, uint32_t *len)
  *
  *   Return log buffer address at offset 'off'. The output argument 'len' stores buffer length
+ *   Constant time: see 'Chunk directory' below.
+ *
+ * - uint64_t offset_of(void *addr)
+ *
+ *   Return the log offset of the appended data at 'addr', e.g., of space reserved before a trim.
+ *
+ * - void persist (void *addr, uint64_t len)
+ *
+ *   Make the appended data at [addr, addr + len), and the size of the chunk it is in, durable
+ *   before returning. What that takes depends on the DLogBackend the log was created with.
+ *
+ * - void sync ()
+ *
+ *   Persist what has been appended since the previous sync(), and what was still being written
+ *   at the previous sync(). For logs whose appends are not persisted one by one.
+ *
+ * - static uint32_t checksum (const void *data, uint64_t len)
+ *
+ *   CRC32C of a record, for the log users to detect records torn by a crash.
+ *
+ * Durability
+ * - The chunk header carries a checksum of its fixed fields. On recovery, a chunk with a bad
+ *   header or past a gap in the chunk sequence numbers is dropped, with the chunks after it.
+ * - The data size in the header is set on reservation, so a chunk loaded on recovery may end
+ *   in space reserved but never written. DLog does not know the record boundaries; its users
+ *   check their records and truncate() the log behind the last intact one.
+ *
+ * Chunk directory
+ * - Each chunk knows its base, the position of its first data byte counted from the start of
+ *   the log before any trim. The log offset of a chunk is its base less the base of the head.
+ *   The base of a chunk is set as the tail moves onto it, when the chunk before it is sealed.
+ * - The chunks from the head on are also in an array, copied and republished on chunk add and
+ *   trim, the old copy going to the EpochManager. As a chunk holds at most its capacity, the
+ *   chunk of a position is at or past the index (position - head base) / capacity; getaddr()
+ *   starts there and steps forward past the chunks sealed short, which is none for logs of
+ *   records much smaller than a chunk.
+ * - Free space is kept as a counter, updated on reserve, seal, chunk add and trim.
  */
 
+// where the chunk files are, which decides what DLog::persist() takes
+enum DLogBackend {
+    DLOG_BACKEND_SHM,   // tmpfs: survives a process crash but not a reboot, nothing to persist
+    DLOG_BACKEND_FILE,  // a file system on a block device: msync the pages
+    DLOG_BACKEND_DAX,   // a DAX file on persistent memory: write back the cache lines, and fence
+};
+
 template <uint64_t CHUNK_SIZE = (16*1024*1024), uint32_t INIT_CHUNKS = 1>
 class DLog {
   private:
@@ -75,13 +136,21 @@ class DLog {
     // ondisk chunk header
     typedef struct ondisk_chunk_header {
         #define DLOG_SIGNATURE    0xF0F05A5A
+        #define DLOG_VERSION      2
         uint32_t    Sig;
         uint8_t     version;// header version
-        uint8_t     sealed; // bool
+        uint8_t     pad[3];
         uint32_t    fsize;  // chunk file size
         uint32_t    bgn_off;// beginning offset of data
-        uint32_t    dsize;  // data size
+        union {
+            struct {
+                uint32_t dsize;  // data size
+                uint32_t sealed; // bool
+            };
+            uint64_t fill;  // both, so that a reservation can not land in a sealed chunk
+        };
         uint32_t    seqno;
+        uint32_t    hcrc;   // checksum of the fields that never change: Sig, version, fsize, seqno
     } chunk_hdr_t;
 
     // incore chunk
@@ -90,6 +159,10 @@ class DLog {
         std::string path;
         void *          maddr;
         chunk_hdr_t *   hdr;
+        uint32_t        synced = 0;     // end of the data persisted by sync()
+        uint32_t        syncing = 0;    // end of the data at the last sync(), maybe still being written
+        #define DLOG_NO_BASE    UINT64_MAX
+        std::atomic<uint64_t> base{DLOG_NO_BASE}; // position of the first data byte, see chunk directory
         ~chunk() {
             munmap(maddr, hdr->fsize);
         }
@@ -101,13 +174,41 @@ class DLog {
             }
             delete this; 
         }
+        // like remove(), but the mapping goes once the readers may have left it
+        void retire() {
+            if (unlink(path.c_str()) != 0) {
+                printf("FatalError: failed to delete log file %s at %s::%d\n", path.c_str(), __FILE__, __LINE__);
+                exit (1);
+            }
+            EpochManager::instance().retireObject(this);
+        }
     } chunk_t;
 
+    // the chunks from chunk_head on, for getaddr() to index
+    typedef struct chunk_dir {
+        std::vector<chunk_t *> chunks;
+        uint64_t    max_dsize = 1;  // the largest chunk data capacity
+    } chunk_dir_t;
+
+    // 'fill' of a chunk header, by halves
+    typedef union {
+        struct {
+            uint32_t dsize;
+            uint32_t sealed;
+        };
+        uint64_t fill;
+    } chunk_fill_t;
+
   public:
-    DLog(std::string logdir = "/tmp", bool recovery_mode = false) : topdir(logdir)
+    DLog(std::string logdir = "/tmp", bool recovery_mode = false, DLogBackend backend = DLOG_BACKEND_SHM)
+    : topdir(logdir), backend(backend)
     {
         next_seqno = 0;
         chunk_head = chunk_tail = NULL;
+        chunk_dir = NULL;
+        head_base = 0;
+        data_size = 0;
+        free_bytes = 0;
 
         // If logdir not already exists, create it.
         struct stat st;
@@ -118,6 +219,7 @@ class DLog {
 
         if (recovery_mode) {
             load_chunk_files(topdir.c_str()); // Load existing logs
+            rebuild_index();
         } else {
             clean_chunk_files(topdir.c_str());
         }
@@ -130,8 +232,6 @@ class DLog {
         }
         assert(chunk_head);
 
-        data_size = count_data_size();
-
         // Start the replenisher thread
 	    pthread_create(&tid, NULL, chunk_replenisher, (void *)this);
 
@@ -144,6 +244,7 @@ class DLog {
     ~DLog()
     {
         cleanup();
+        delete chunk_dir.load();
     }
 
     // Return log data size
@@ -155,18 +256,14 @@ class DLog {
     // Return free space
     inline uint64_t free_space(void)
     {
-        uint64_t free_size = 0;
-        for (chunk_t *tmp = chunk_tail; tmp; tmp = tmp->next) {
-            free_size += tmp->hdr->fsize - tmp->hdr->dsize - tmp->hdr->bgn_off;
-        }
-        return free_size;
+        return free_bytes;
     }
 
     // Reserve 'len' bytes append space in log.
     // Return starting address of the reserved (continuous) space.
     void * reserve(uint32_t len, /* log offset out */ uint64_t * offset = NULL )
     {
-        uint32_t oldsize;
+        chunk_fill_t fill, upd;
         chunk_t * chunk;
 
         if (len >= chunk_size - sizeof(chunk_hdr_t)) {
@@ -178,7 +275,8 @@ class DLog {
 
         do {
             chunk = chunk_tail;
-            if (chunk->hdr->sealed) {
+            fill.fill = __atomic_load_n(&chunk->hdr->fill, __ATOMIC_ACQUIRE);
+            if (fill.sealed) {
                 while (!chunk->next) {
                     // If replenisher is working right, we should not come to here
                     min_free_space += chunk_size;
@@ -186,30 +284,74 @@ class DLog {
                     wakeup_replenisher();
                     usleep(1);
                 }
-                // move chunk_tail to the next
-                __sync_bool_compare_and_swap(&chunk_tail, chunk, chunk->next);
+                advance_tail(chunk);
                 continue;
             }
 
             // If chunk free space too small, seal the chunk
-            uint64_t free_space = chunk->hdr->fsize - chunk->hdr->bgn_off - chunk->hdr->dsize;
+            uint64_t free_space = chunk->hdr->fsize - chunk->hdr->bgn_off - fill.dsize;
+            upd = fill;
             if (free_space < len) {
-                chunk->hdr->sealed = true; // insufficient space, sealed it.
-                wakeup_replenisher();
+                upd.sealed = true; // insufficient space, sealed it.
+                if (__sync_bool_compare_and_swap(&chunk->hdr->fill, fill.fill, upd.fill)) {
+                    free_bytes -= free_space;
+                    wakeup_replenisher();
+                }
                 continue;
             }
 
-            oldsize = chunk->hdr->dsize;;
-            if (__sync_bool_compare_and_swap(&chunk->hdr->dsize, oldsize, oldsize+len)) {
+            upd.dsize += len;
+            if (__sync_bool_compare_and_swap(&chunk->hdr->fill, fill.fill, upd.fill)) {
+                free_bytes -= len;
                 data_size += len;
                 break; // done
             }
         } while (true);
 
         if (offset)
-            *offset = chunk_offset(chunk) + oldsize;
+            *offset = chunk_offset(chunk) + fill.dsize;
 
-        return (char *)chunk->maddr + chunk->hdr->bgn_off + oldsize; 
+        return (char *)chunk->maddr + chunk->hdr->bgn_off + fill.dsize;
+    }
+
+    // Make the log content at [addr, addr + len) durable, with the data size of its chunk
+    void persist(void *addr, uint64_t len)
+    {
+        if (backend == DLOG_BACKEND_SHM)
+            return;
+        chunk_t *chunk = find_chunk(addr);
+        assert(chunk);
+        persist_range(addr, len);
+        persist_range(chunk->hdr, sizeof(chunk_hdr_t));
+        persist_fence();
+    }
+
+    // Persist what was appended since the last sync(), and what was being written then
+    void sync()
+    {
+        if (backend == DLOG_BACKEND_SHM)
+            return;
+        Omtx.lock();
+        for (chunk_t *tmp = chunk_head; tmp; tmp = tmp->next) {
+            uint32_t end = tmp->hdr->bgn_off + tmp->hdr->dsize;
+            uint32_t from = std::max(tmp->synced, tmp->hdr->bgn_off);
+            if (end > from) {
+                persist_range((char *)tmp->maddr + from, end - from);
+                persist_range(tmp->hdr, sizeof(chunk_hdr_t));
+            }
+            tmp->synced = std::max(tmp->syncing, tmp->hdr->bgn_off);
+            tmp->syncing = end;
+            if (tmp == chunk_tail)
+                break; // the rest are stand-by chunks
+        }
+        Omtx.unlock();
+        persist_fence();
+    }
+
+    // CRC32C of a log record, with the SSE4.2 code of Crc32C
+    static inline uint32_t checksum(const void *data, uint64_t len)
+    {
+        return ~RAMCloud::intelCrc32C(~0u, data, len);
     }
 
     // Append to log. Return log offset of the appended data.
@@ -234,9 +376,23 @@ class DLog {
         chunk_t * tmp, *old_tmp, * old_head;
         tmp = old_head = chunk_head;
         while (tmp) {
-            if (tmp->hdr->dsize >= remain) {
-                tmp->hdr->dsize -= remain;
-                tmp->hdr->bgn_off = (tmp->hdr->dsize == 0)? sizeof(chunk_hdr_t) : tmp->hdr->bgn_off + remain;
+            // a sealed chunk trimmed to its end goes too, unless appenders may still be on it
+            if (tmp->hdr->dsize > remain || (tmp->hdr->dsize == remain
+                    && (!tmp->hdr->sealed || tmp == chunk_tail || !tmp->next))) {
+                chunk_fill_t fill, upd;
+                do { // appenders may be reserving in this chunk
+                    fill.fill = __atomic_load_n(&tmp->hdr->fill, __ATOMIC_ACQUIRE);
+                    upd = fill;
+                    upd.dsize -= remain;
+                } while (!__sync_bool_compare_and_swap(&tmp->hdr->fill, fill.fill, upd.fill));
+                tmp->base += remain;
+                if (upd.dsize == 0) {
+                    if (!tmp->hdr->sealed)
+                        free_bytes += tmp->hdr->bgn_off + remain - sizeof(chunk_hdr_t);
+                    tmp->hdr->bgn_off = sizeof(chunk_hdr_t);
+                } else {
+                    tmp->hdr->bgn_off += remain;
+                }
                 remain = 0;
                 break;
             }
@@ -245,19 +401,76 @@ class DLog {
             tmp = tmp->next;
         }
         chunk_head = tmp;
+        head_base += length - remain;
+        if (tmp != old_head)
+            publish_dir();
 
         // Remove trim'ed chunks
         tmp = old_head;
         while (tmp && (tmp != chunk_head)) {
             old_tmp = tmp;
             tmp = tmp->next;
-            old_tmp->remove();
+            old_tmp->retire();
+        }
+        if (backend != DLOG_BACKEND_SHM) {
+            persist_range(chunk_head->hdr, sizeof(chunk_hdr_t));
+            persist_fence();
+            sync_dir();
         }
         Omtx.unlock();
         data_size -= (length - remain);
         return length - remain;
     }
 
+    // Keep the first 'length' bytes of the log and drop the rest.
+    // The dropped data is zeroed, so that no stale record shows up behind the new ones.
+    // Return the bytes dropped.
+    uint64_t truncate (uint64_t length)
+    {
+        Omtx.lock();
+        uint64_t remain = length;
+        uint64_t dropped = 0;
+        chunk_t * tmp = chunk_head;
+        while (tmp && tmp->hdr->dsize <= remain) {
+            remain -= tmp->hdr->dsize;
+            tmp = tmp->next;
+        }
+        for (; tmp; tmp = tmp->next, remain = 0) {
+            char *data = (char *)tmp->maddr + tmp->hdr->bgn_off;
+            uint32_t cut = tmp->hdr->dsize - remain;
+            memset(data + remain, 0, cut);
+            dropped += cut;
+            if (remain == 0)
+                tmp->hdr->bgn_off = sizeof(chunk_hdr_t);
+            tmp->hdr->dsize = remain;
+            tmp->hdr->sealed = false; // appends go on from the cut
+            tmp->synced = tmp->syncing = 0;
+            if (backend != DLOG_BACKEND_SHM) {
+                persist_range(data + remain, cut);
+                persist_range(tmp->hdr, sizeof(chunk_hdr_t));
+            }
+        }
+        persist_fence();
+
+        rebuild_index();
+        Omtx.unlock();
+        return dropped;
+    }
+
+    // Return the longest prefix of the first 'length' bytes made of whole sealed chunks
+    uint64_t chunk_aligned (uint64_t length)
+    {
+        Omtx.lock();
+        uint64_t aligned = 0;
+        for (chunk_t *tmp = chunk_head; tmp && tmp != chunk_tail && tmp->hdr->sealed; tmp = tmp->next) {
+            if (aligned + tmp->hdr->dsize > length)
+                break;
+            aligned += tmp->hdr->dsize;
+        }
+        Omtx.unlock();
+        return aligned;
+    }
+
     // Delete all chunks
     inline void cleanup(void)
     {
@@ -275,31 +488,38 @@ class DLog {
     // The output argument 'len' stores continuous buffer length
     void * getaddr (uint64_t off, uint32_t *len = NULL)
     {
-        assert(off >= 0);
-
         if (off >= data_size) {
             if (len)
                 *len = 0;
             return NULL;
         }
 
-        chunk_t * tmp = chunk_head;
-        uint64_t remain = off;
-
-        assert(tmp);
-        while (tmp && (remain > 0)) {
-            if ((tmp->hdr->dsize) > remain) {
-                break;
-            }
-            remain -= tmp->hdr->dsize;
-            tmp = tmp->next;
+        EpochGuard guard;
+        chunk_dir_t *dir = chunk_dir.load(std::memory_order_acquire);
+        uint64_t pos = head_base + off;
+        uint64_t first = dir->chunks[0]->base;
+        size_t last = dir->chunks.size() - 1;
+        size_t idx = std::min<uint64_t>((pos > first)? (pos - first) / dir->max_dsize : 0, last);
+        while (idx < last && dir->chunks[idx + 1]->base <= pos) {
+            idx++;
         }
+        chunk_t * tmp = dir->chunks[idx];
+        uint64_t remain = pos - tmp->base;
 
         if (len)
             *len = tmp->hdr->dsize - remain;
         return (char *)tmp->maddr + tmp->hdr->bgn_off + remain;
     }
 
+    // Return the log offset of the appended data at 'addr'
+    uint64_t offset_of (void *addr)
+    {
+        EpochGuard guard;
+        chunk_t *tmp = find_chunk(addr);
+        assert(tmp);
+        return chunk_offset(tmp) + ((char *)addr - ((char *)tmp->maddr + tmp->hdr->bgn_off));
+    }
+
     uint32_t read (uint64_t off, void *obuf, uint32_t len)
     {
         uint32_t todo, remain;
@@ -346,7 +566,7 @@ class DLog {
             exit (1);
         }
 
-        void * maddr = mmap(NULL, current_chunk_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);  
+        void * maddr = map_chunk(fd, current_chunk_size);
 
         if (maddr == MAP_FAILED) {
             printf("FatalError: mmap(2) failed in %s::%d\n", __FILE__, __LINE__);
@@ -357,12 +577,20 @@ class DLog {
 
         chunk_hdr_t * hdr = (chunk_hdr_t *)maddr;
         hdr->Sig =      DLOG_SIGNATURE;
-        hdr->version =  0;
+        hdr->version =  DLOG_VERSION;
+        memset(hdr->pad, 0, sizeof(hdr->pad));
         hdr->seqno =    seqno;
-        hdr->sealed =   false;
-        hdr->dsize =    0;
+        hdr->fill =     0;
         hdr->bgn_off =  sizeof(chunk_hdr_t);
         hdr->fsize =    current_chunk_size;
+        hdr->hcrc =     header_crc(hdr);
+
+        // the chunk is to be found on recovery before any record goes into it
+        if (backend != DLOG_BACKEND_SHM) {
+            persist_range(hdr, sizeof(chunk_hdr_t));
+            persist_fence();
+            sync_dir();
+        }
 
         // Setup chunk_t
         chunk_t * chunkp = new chunk_t;
@@ -404,11 +632,17 @@ class DLog {
             return NULL;
         }
 
-        void * maddr = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);  
+        if ((size_t)st.st_size < sizeof(chunk_hdr_t)) {
+            std::cout << "Error: log file: " << logpath << " : torn header " << std::endl;
+            close(fd);
+            return NULL;
+        }
+
+        void * maddr = map_chunk(fd, st.st_size);
 
         close(fd);
 
-        if (!maddr) {
+        if (maddr == MAP_FAILED) {
             std::cout << "Mmap failed: " << logpath << std::endl;
             return NULL;
         }
@@ -417,10 +651,17 @@ class DLog {
 
         if (hdr->Sig != DLOG_SIGNATURE) {
             std::cout << "Error: log file: " << logpath << " : bad magic " << std::endl;
+            munmap(maddr, st.st_size);
+            return NULL;
+        }
+        // created but not durable yet at the crash, or overwritten
+        if (hdr->version != DLOG_VERSION || hdr->hcrc != header_crc(hdr) || hdr->seqno != logno
+                || hdr->fsize != st.st_size || hdr->bgn_off < sizeof(chunk_hdr_t)
+                || (uint64_t)hdr->bgn_off + hdr->dsize > hdr->fsize) {
+            std::cout << "Error: log file: " << logpath << " : torn header " << std::endl;
+            munmap(maddr, st.st_size);
             return NULL;
         }
-        assert(hdr->seqno == logno);
-        assert(hdr->fsize == st.st_size);
 
         // Setup chunk_t
         chunk_t * chunkp = new chunk_t;
@@ -450,7 +691,8 @@ class DLog {
         chunkp->next = (*cur);
         *cur = chunkp;
 
-        bool runtime_adding_new_chunk = (chunk_tail && (chunk_tail->hdr->seqno + 1 == chunkp->hdr->seqno));
+        // a stand-by chunk at the end, which reserve() moves chunk_tail on to with its base
+        bool runtime_adding_new_chunk = (chunk_tail && !chunkp->next);
         /*
          * Update chunk_tail for two special conditions:
          * 1) Loading the very first chunk, and
@@ -466,28 +708,138 @@ class DLog {
         if (next_seqno <= chunkp->hdr->seqno) {
             next_seqno = chunkp->hdr->seqno + 1;
         }
+
+        if (chunkp == chunk_head && !chunkp->next)
+            chunkp->base = head_base.load();
+        if (!chunkp->hdr->sealed)
+            free_bytes += chunkp->hdr->fsize - chunkp->hdr->bgn_off - chunkp->hdr->dsize;
+        publish_dir();
         Omtx.unlock();
     }
 
-    inline uint64_t count_data_size(void)
+    // Move chunk_tail past the sealed 'chunk', giving the next chunk its base
+    void advance_tail(chunk_t *chunk)
     {
-        uint64_t lsize = 0;
+        Omtx.lock(); // for the final dsize, which trim() may still take from
+        if (chunk_tail == chunk) {
+            if (chunk->next->base == DLOG_NO_BASE)
+                chunk->next->base = chunk->base + chunk->hdr->dsize;
+            chunk_tail = chunk->next;
+        }
+        Omtx.unlock();
+    }
+
+    // Publish a chunk directory of the chunk list. Caller holds Omtx.
+    void publish_dir()
+    {
+        chunk_dir_t *dir = new chunk_dir_t;
         for (chunk_t *tmp = chunk_head; tmp; tmp = tmp->next) {
-            lsize += tmp->hdr->dsize;
+            dir->chunks.push_back(tmp);
+            dir->max_dsize = std::max<uint64_t>(dir->max_dsize, tmp->hdr->fsize - sizeof(chunk_hdr_t));
         }
-        return lsize;
+        chunk_dir_t *old = chunk_dir.exchange(dir, std::memory_order_acq_rel);
+        if (old)
+            EpochManager::instance().retireObject(old);
+    }
+
+    // Recompute chunk_tail, chunk bases, data size and free space from the chunk headers,
+    // on loading and truncating, i.e., with no appenders.
+    void rebuild_index()
+    {
+        uint64_t base = head_base, free = 0;
+        chunk_tail = chunk_head;
+        while (chunk_tail && chunk_tail->next && chunk_tail->hdr->sealed) {
+            chunk_tail = chunk_tail->next;
+        }
+        bool past_tail = false;
+        for (chunk_t *tmp = chunk_head; tmp; tmp = tmp->next) {
+            tmp->base = past_tail? DLOG_NO_BASE : base;
+            base += tmp->hdr->dsize;
+            if (!tmp->hdr->sealed)
+                free += tmp->hdr->fsize - tmp->hdr->bgn_off - tmp->hdr->dsize;
+            past_tail |= (tmp == chunk_tail);
+        }
+        data_size = base - head_base;
+        free_bytes = free;
+        if (chunk_head)
+            publish_dir();
     }
 
     // Return starting log offset of the chunk
     inline uint64_t chunk_offset(chunk_t *c)
     {
-        chunk_t * tmp = chunk_head;
-        uint64_t off = 0;
-        while (tmp && tmp != c) {
-            off += tmp->hdr->dsize;
-            tmp = tmp->next;
+        return c->base - head_base;
+    }
+
+    // Return the chunk whose mapping holds 'addr'; appends are mostly to the tail chunk
+    chunk_t * find_chunk(void *addr)
+    {
+        for (chunk_t *tmp = chunk_tail; tmp; tmp = tmp->next) {
+            if ((char *)addr >= (char *)tmp->maddr && (char *)addr < (char *)tmp->maddr + tmp->hdr->fsize)
+                return tmp;
+        }
+        EpochGuard guard;
+        for (chunk_t *tmp = chunk_head; tmp; tmp = tmp->next) {
+            if ((char *)addr >= (char *)tmp->maddr && (char *)addr < (char *)tmp->maddr + tmp->hdr->fsize)
+                return tmp;
+        }
+        return NULL;
+    }
+
+    void * map_chunk(int fd, uint64_t size)
+    {
+#ifdef MAP_SYNC
+        if (backend == DLOG_BACKEND_DAX) {
+            // with MAP_SYNC, the file system metadata is durable on a page fault, and flushing
+            // the CPU caches is enough to persist data
+            void * maddr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED_VALIDATE|MAP_SYNC, fd, 0);
+            if (maddr == MAP_FAILED)
+                printf("FatalError: %s is not on a DAX file system\n", topdir.c_str());
+            return maddr;
+        }
+#endif
+        return mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    static inline uint32_t header_crc(chunk_hdr_t *hdr)
+    {
+        uint32_t fixed[] = {hdr->Sig, hdr->version, hdr->fsize, hdr->seqno};
+        return checksum(fixed, sizeof(fixed));
+    }
+
+    // Start writing [addr, addr + len) back to the media; persist_fence() waits for it
+    void persist_range(void *addr, uint64_t len)
+    {
+        if (backend == DLOG_BACKEND_DAX) {
+            for (uintptr_t line = (uintptr_t)addr & ~63ul; line < (uintptr_t)addr + len; line += 64) {
+#ifdef __CLWB__
+                _mm_clwb((void *)line);
+#else
+                _mm_clflush((void *)line);
+#endif
+            }
+        } else if (backend == DLOG_BACKEND_FILE) {
+            uintptr_t page = (uintptr_t)addr & ~((uintptr_t)getpagesize() - 1);
+            msync((void *)page, (uintptr_t)addr + len - page, MS_SYNC);
+        }
+    }
+
+    inline void persist_fence()
+    {
+        if (backend == DLOG_BACKEND_DAX)
+            _mm_sfence();
+    }
+
+    // Make chunk file creation and removal durable
+    void sync_dir()
+    {
+        if (backend == DLOG_BACKEND_SHM)
+            return;
+        int fd = open(topdir.c_str(), O_RDONLY|O_DIRECTORY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
         }
-        return off;
     }
 
     int mkpath(const char *dir, mode_t mode)
@@ -517,16 +869,44 @@ class DLog {
 
         // Scan chunk files
         struct dirent *dent;
+        std::vector<std::string> bad;
         while ((dent = readdir(dir)) != NULL) {
             uint32_t logno;
             if (sscanf(dent->d_name, "DLog-%d", &logno) == 1) {
                 chunk_t * chunkp = load_one_chunk(logdir, dent->d_name);
                 if (chunkp)
                     insert_chunk(chunkp);
+                else
+                    bad.push_back(std::string(logdir) + "/" + std::string(dent->d_name));
            }
         }
 
         closedir(dir);
+
+        // The log is whatever is in front of the first missing or bad chunk
+        for (chunk_t **cur = &chunk_head; *cur; cur = &(*cur)->next) {
+            if ((*cur)->next && (*cur)->next->hdr->seqno != (*cur)->hdr->seqno + 1) {
+                chunk_t *tmp = (*cur)->next;
+                (*cur)->next = NULL;
+                std::cout << "Error: log files from " << tmp->path << " on : behind a gap, dropped " << std::endl;
+                while (tmp) {
+                    chunk_t *next = tmp->next;
+                    tmp->remove();
+                    tmp = next;
+                }
+                break;
+            }
+        }
+        for (std::string &path : bad)
+            unlink(path.c_str());
+        chunk_tail = chunk_head;
+        while (chunk_tail && chunk_tail->next && chunk_tail->hdr->sealed) {
+            chunk_tail = chunk_tail->next;
+        }
+        next_seqno = 0;
+        for (chunk_t *tmp = chunk_head; tmp; tmp = tmp->next) {
+            next_seqno = tmp->hdr->seqno + 1;
+        }
     }
 
     void clean_chunk_files (const char *logdir)
@@ -563,8 +943,10 @@ class DLog {
 
     inline void kill_replenisher()
     {
+        pthread_mutex_lock(&mtx);
         thread_run_run = false;
-        wakeup_replenisher();
+        pthread_cond_signal(&cond);
+        pthread_mutex_unlock(&mtx);
 	    pthread_join(tid, NULL);
     }
 
@@ -583,8 +965,10 @@ class DLog {
             if (!dlog->thread_run_run)
                 break;
 
+            // checked under the lock, or the wakeup of kill_replenisher() may be missed
             pthread_mutex_lock(&dlog->mtx);
-            pthread_cond_wait(&dlog->cond, &dlog->mtx);
+            if (dlog->thread_run_run)
+                pthread_cond_wait(&dlog->cond, &dlog->mtx);
             pthread_mutex_unlock(&dlog->mtx);
         }
         return NULL;
@@ -593,8 +977,12 @@ class DLog {
     // private variables
     std::mutex Omtx;
     std::string topdir;
+    DLogBackend backend;
     std::atomic<uint32_t> next_seqno;
     std::atomic<uint64_t> data_size;
+    std::atomic<uint64_t> free_bytes;   // of the unsealed chunks
+    std::atomic<uint64_t> head_base;    // base of chunk_head, i.e., the bytes trimmed so far
+    std::atomic<chunk_dir_t *> chunk_dir;
     chunk_t * chunk_head, * chunk_tail;
     uint64_t chunk_size;
     uint64_t min_free_space = 0;
@@ -13,6 +13,8 @@
  *  limitations under the License.
  */
 
+#include <dirent.h>
+#include <fstream>
 #include "TestUtil.h"
 #include "DLog.h"
 #include "Cycles.h"
@@ -90,6 +92,184 @@ TEST_F(DLogTest, DLogUnitTest)
     EXPECT_EQ(log->size(), (uint64_t)0);
 }
 
+static uint32_t
+countChunkFiles(const char *dir)
+{
+    uint32_t n = 0;
+    DIR *d = opendir(dir);
+    while (struct dirent *dent = readdir(d)) {
+        if (strncmp(dent->d_name, "DLog-", 5) == 0)
+            n++;
+    }
+    closedir(d);
+    return n;
+}
+
+TEST_F(DLogTest, DLogChunkAlignedTrim)
+{
+    log->set_chunk_size(1024);
+    for(uint32_t idx = 0; idx < 1024; idx++)
+        log->append("abcdefgh", 8);
+
+    uint64_t dsize = log->size();
+    uint64_t aligned = log->chunk_aligned(dsize / 2);
+    EXPECT_GT(aligned, (uint64_t)0);
+    EXPECT_LE(aligned, dsize / 2);
+    EXPECT_EQ(aligned, log->chunk_aligned(aligned));
+    EXPECT_GT(aligned, log->chunk_aligned(aligned - 1));
+
+    // the trimmed chunks go with their files, none is left partially trimmed
+    uint32_t files = countChunkFiles("/dev/shm/dlog");
+    EXPECT_EQ(aligned, log->trim(aligned));
+    EXPECT_LT(countChunkFiles("/dev/shm/dlog"), files);
+    EXPECT_EQ(dsize - aligned, log->size());
+    EXPECT_EQ((uint64_t)0, log->chunk_aligned(0));
+
+    char buf[8];
+    for (uint64_t off = 0; off < log->size(); off += sizeof(buf)) {
+        EXPECT_EQ(sizeof(buf), log->read(off, buf, sizeof(buf)));
+        EXPECT_EQ("abcdefgh", std::string(buf, 8));
+    }
+
+    // the active chunk is never part of it
+    EXPECT_LT(log->chunk_aligned(log->size()), log->size());
+}
+
+// the mappings of deleted chunk files still in the process
+static uint32_t
+countDeletedChunkMaps(const char *dir)
+{
+    uint32_t n = 0;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (line.find(dir) != std::string::npos && line.find("(deleted)") != std::string::npos)
+            n++;
+    }
+    return n;
+}
+
+TEST_F(DLogTest, DLogTrimReleasesChunks)
+{
+    log->set_chunk_size(1024);
+    for(uint32_t idx = 0; idx < 1024; idx++)
+        log->append("abcdefgh", 8);
+
+    // the trimmed chunks stay mapped for the readers until reclaimed
+    EpochManager &mgr = EpochManager::instance();
+    mgr.reclaim();
+    uint64_t freed = mgr.getFreedCount();
+    uint64_t aligned = log->chunk_aligned(log->size() / 2);
+    EXPECT_EQ(aligned, log->trim(aligned));
+    EXPECT_GT(countDeletedChunkMaps("/dev/shm/dlog"), 0u);
+
+    mgr.reclaim();
+    EXPECT_GT(mgr.getFreedCount(), freed);
+    EXPECT_EQ(0u, countDeletedChunkMaps("/dev/shm/dlog"));
+}
+
+TEST_F(DLogTest, DLogTruncate)
+{
+    log->set_chunk_size(1024);
+    for(uint32_t idx = 0; idx < 256; idx++)
+        log->append("abcdefgh", 8);
+
+    // cut within a chunk, and drop the chunks behind
+    uint64_t dsize = log->size();
+    uint64_t keep = dsize / 2 + 3;
+    EXPECT_EQ(dsize - keep, log->truncate(keep));
+    EXPECT_EQ(keep, log->size());
+    EXPECT_EQ(0u, log->truncate(keep));
+
+    // appends go on from the cut
+    EXPECT_EQ(keep, log->append("12345678", 8));
+    char buf[8];
+    EXPECT_EQ(sizeof(buf), log->read(keep, buf, sizeof(buf)));
+    EXPECT_EQ("12345678", std::string(buf, 8));
+    EXPECT_EQ(sizeof(buf), log->read(keep - 11, buf, sizeof(buf)));
+    EXPECT_EQ("abcdefgh", std::string(buf, 8));
+}
+
+TEST_F(DLogTest, DLogChunkDirectory)
+{
+    // records of all sizes, so that chunks are sealed short of their capacity
+    std::vector<std::pair<uint64_t, std::string>> recs;
+    for(uint32_t idx = 0; idx < 2048; idx++) {
+        std::string rec(1 + (idx * 7) % 60, 'a' + idx % 26);
+        recs.push_back(std::make_pair(log->append(rec.data(), rec.size()), rec));
+    }
+    EXPECT_GT(log->free_space(), (uint64_t)0);
+
+    // into the middle of a chunk
+    uint64_t trimmed = log->trim(recs[1000].first + 5);
+    EXPECT_EQ(recs[1000].first + 5, trimmed);
+
+    for (size_t idx = 1001; idx < recs.size(); idx++) {
+        uint32_t dlen;
+        char *data = (char *)log->getaddr(recs[idx].first - trimmed, &dlen);
+        ASSERT_TRUE(data != NULL);
+        EXPECT_GE(dlen, recs[idx].second.size());
+        EXPECT_EQ(recs[idx].second, std::string(data, recs[idx].second.size()));
+        EXPECT_EQ(recs[idx].first - trimmed, log->offset_of(data));
+    }
+    char buf[5];
+    EXPECT_EQ(sizeof(buf), log->read(recs[1000].second.size() - 5, buf, sizeof(buf)));
+    EXPECT_EQ(recs[1001].second.substr(0, 5), std::string(buf, 5));
+    EXPECT_TRUE(log->getaddr(log->size()) == NULL);
+
+    // appends go on at the end
+    uint64_t end = log->size();
+    EXPECT_EQ(end, log->append("abcdefgh", 8));
+    EXPECT_EQ(0, memcmp("abcdefgh", log->getaddr(end), 8));
+}
+
+static void
+copyChunkFiles(const char *from, const char *to)
+{
+    mkdir(to, 0777);
+    DIR *d = opendir(from);
+    while (struct dirent *dent = readdir(d)) {
+        if (strncmp(dent->d_name, "DLog-", 5) != 0)
+            continue;
+        std::string src = std::string(from) + "/" + dent->d_name;
+        std::string dst = std::string(to) + "/" + dent->d_name;
+        std::ifstream in(src, std::ios::binary);
+        std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+        out << in.rdbuf();
+    }
+    closedir(d);
+}
+
+TEST_F(DLogTest, DLogTornChunkHeader)
+{
+    DLog<256> *log2 = new DLog<256>("/dev/shm/dlog-durable", false, DLOG_BACKEND_FILE);
+    for(uint32_t idx = 0; idx < 64; idx++)
+        log2->append("abcdefgh", 8);
+    log2->sync();
+    uint32_t dlen;
+    log2->getaddr(0, &dlen); // the data of the first chunk
+    copyChunkFiles("/dev/shm/dlog-durable", "/dev/shm/dlog-crashed");
+    delete log2;
+
+    // a bad header in the second chunk, as if its creation was torn
+    int fd = open("/dev/shm/dlog-crashed/DLog-000001", O_RDWR);
+    uint32_t garbage = 0xDEADBEEF;
+    EXPECT_EQ((ssize_t)sizeof(garbage), pwrite(fd, &garbage, sizeof(garbage), 8));
+    close(fd);
+
+    // the log is what is in front of it
+    log2 = new DLog<256>("/dev/shm/dlog-crashed", true, DLOG_BACKEND_FILE);
+    EXPECT_EQ(dlen, log2->size());
+    char buf[8];
+    for (uint64_t off = 0; off < log2->size(); off += sizeof(buf)) {
+        EXPECT_EQ(sizeof(buf), log2->read(off, buf, sizeof(buf)));
+        EXPECT_EQ("abcdefgh", std::string(buf, 8));
+    }
+    uint64_t end = log2->size();
+    EXPECT_EQ(end, log2->append("12345678", 8));
+    delete log2;
+}
+
 TEST_F(DLogBench, DLogBench) {
     uint32_t loop = 1024*1024;
     uint64_t start, stop;
@@ -20,6 +20,50 @@
 
 namespace QDB {
 
+/**
+ * A reply chunk referring to a value in the KV store. The chunk holds an
+ * epoch pin so that the value is not reclaimed before the transport has sent
+ * the reply and reset the reply buffer, which may happen on another thread.
+ */
+class PinnedValueChunk : public Buffer::Chunk {
+  public:
+    PinnedValueChunk(const void* data, uint32_t length, uint32_t pin)
+        : Buffer::Chunk(data, length), pin(pin) {}
+    ~PinnedValueChunk() { EpochManager::instance().unpin(pin); }
+
+  private:
+    uint32_t pin;
+    DISALLOW_COPY_AND_ASSIGN(PinnedValueChunk);
+};
+
+/*
+ * Append a value read inside an EpochGuard to a reply, by reference if it
+ * is long enough and a pin is available, otherwise by copy.
+ */
+static void
+appendValue(Buffer* reply, const void* valuePtr, uint32_t valueLength)
+{
+    if (valueLength >= DSSN_REPLY_BY_REFERENCE_MIN) {
+        uint32_t pin = EpochManager::instance().pin();
+        if (pin != EpochManager::NO_PIN) {
+            reply->appendChunk(reply->allocAux<PinnedValueChunk>(valuePtr, valueLength, pin));
+            return;
+        }
+    }
+    reply->appendCopy(valuePtr, valueLength);
+}
+
+/*
+ * Append the key info and key of a single-key object followed by its value,
+ * in the layout of Object::appendKeysAndValueToBuffer().
+ */
+static void
+appendKeysAndValue(Key& key, const void* valuePtr, uint32_t valueLength, Buffer* reply)
+{
+    Object::appendKeysAndValueToBuffer(key, valuePtr, 0, reply, true);
+    appendValue(reply, valuePtr, valueLength);
+}
+
 DSSNService::DSSNService(Context* context, ServerList* serverList,
         const ServerConfig* serverConfig)
 : context(context)
@@ -27,6 +71,7 @@ DSSNService::DSSNService(Context* context, ServerList* serverList,
 , serverConfig(serverConfig)
 {
     kvStore = new HashmapKVStore();
+    peerChannel = new PeerChannel(context);
     validator = new Validator(*kvStore, this, serverConfig->master.isTesting);
     tabletManager = new TabletManager();
     mMonitor = new DSSNServiceMonitor(this, context->metricExposer);
@@ -38,12 +83,17 @@ DSSNService::~DSSNService()
     context->services[WireFormat::DSSN_SERVICE] = NULL;
     delete kvStore;
     delete validator;
+    delete peerChannel;
     delete tabletManager;
 }
 
 void
 DSSNService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
 {
+    //Registers this RPC worker thread with the reclamation subsystem on first
+    //use; TxEntries and values retired meanwhile are freed after we return.
+    EpochGuard guard;
+
     switch (opcode){
     case WireFormat::TxCommitDSSN::opcode:
       {
@@ -109,6 +159,14 @@ DSSNService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
 	rpc->setNoRsp();
       }
       break;
+    case WireFormat::DSSNInfoBatchAsync::opcode:
+      {
+	Metric* m = mMonitor->getOpMetric(DSSNServiceRecvDSSNInfoBatch);
+        OpTrace t(m);
+        handleInfoBatchAsync(rpc);
+	rpc->setNoRsp();
+      }
+      break;
     default:
         throw UnimplementedRequestError(HERE);
     }
@@ -135,26 +193,19 @@ DSSNService::read(const WireFormat::ReadDSSN::Request* reqHdr,
     k.setkey(&tableId, sizeof(tableId), 0);
     k.setkey(stringKey, reqHdr->keyLength, sizeof(tableId));
 
-    KVLayout *kv;
-    if (!validator->read(k, kv)) {
+    EpochGuard guard;
+    VLayout v;
+    if (!validator->read(k, v)) {
         respHdr->common.status = RAMCloud::STATUS_OBJECT_DOESNT_EXIST;
         return;
     }
 
     uint32_t initialLength = rpc->replyPayload->size();
-    Buffer buffer;
-    if (kv->getVLayout().valueLength > 0) {
-        buffer.alloc(kv->getVLayout().valueLength);
-        buffer.append(kv->getVLayout().valuePtr, kv->getVLayout().valueLength);
-    }
-
-    Key key(tableId, stringKey, reqHdr->keyLength);
-    Object object(key, kv->getVLayout().valuePtr, kv->getVLayout().valueLength, 0, 0, buffer);
-    object.appendValueToBuffer(rpc->replyPayload);
+    appendValue(rpc->replyPayload, v.valuePtr, v.valueLength);
 
-    respHdr->meta.pstamp = kv->getVLayout().meta.pStamp;
-    respHdr->meta.sstamp = kv->getVLayout().meta.sStamp;
-    respHdr->meta.cstamp = kv->getVLayout().meta.cStamp;
+    respHdr->meta.pstamp = v.meta.pStamp;
+    respHdr->meta.sstamp = v.meta.sStamp;
+    respHdr->meta.cstamp = v.meta.cStamp;
     respHdr->length = rpc->replyPayload->size() - initialLength;
 }
 
@@ -180,27 +231,20 @@ DSSNService::readKeysAndValue(const WireFormat::ReadKeysAndValueDSSN::Request* r
     k.setkey(&tableId, sizeof(tableId), 0);
     k.setkey(stringKey, reqHdr->keyLength, sizeof(tableId));
 
-    KVLayout *kv;
-    if (!validator->read(k, kv)) {
+    EpochGuard guard;
+    VLayout v;
+    if (!validator->read(k, v)) {
         respHdr->common.status = RAMCloud::STATUS_OBJECT_DOESNT_EXIST;
         return;
     }
 
     Key key(tableId, stringKey, reqHdr->keyLength);
     uint32_t initialLength = rpc->replyPayload->size();
+    appendKeysAndValue(key, v.valuePtr, v.valueLength, rpc->replyPayload);
 
-    Buffer buffer;
-    if (kv->getVLayout().valueLength > 0) {
-        buffer.alloc(kv->getVLayout().valueLength);
-        buffer.append(kv->getVLayout().valuePtr, kv->getVLayout().valueLength);
-    }
-
-    Object object(key, kv->getVLayout().valuePtr, kv->getVLayout().valueLength, 0, 0, buffer);
-    object.appendKeysAndValueToBuffer(*(rpc->replyPayload));
-
-    respHdr->meta.pstamp = kv->getVLayout().meta.pStamp;
-    respHdr->meta.sstamp = kv->getVLayout().meta.sStamp;
-    respHdr->meta.cstamp = kv->getVLayout().meta.cStamp;
+    respHdr->meta.pstamp = v.meta.pStamp;
+    respHdr->meta.sstamp = v.meta.sStamp;
+    respHdr->meta.cstamp = v.meta.cStamp;
     respHdr->length = rpc->replyPayload->size() - initialLength;
 }
 
@@ -308,8 +352,9 @@ DSSNService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
         k.setkey(&tableId, sizeof(tableId), 0);
         k.setkey(stringKey, currentReq->keyLength, sizeof(tableId));
 
-        KVLayout *kv = NULL;
-        if (!validator->read(k, kv)) {
+        EpochGuard guard;
+        VLayout v;
+        if (!validator->read(k, v)) {
             currentResp->status = RAMCloud::STATUS_OBJECT_DOESNT_EXIST;
             continue;
         }
@@ -321,17 +366,11 @@ DSSNService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
         // std::cout << " replyPayloadSize: " << initialLength; // XXX
 
         Key key(tableId, stringKey, currentReq->keyLength);
-        Buffer buffer;
-        if (kv->getVLayout().valueLength > 0) {
-            buffer.alloc(kv->getVLayout().valueLength);
-            buffer.append(kv->getVLayout().valuePtr, kv->getVLayout().valueLength);
-        }
-        Object object(key, kv->getVLayout().valuePtr, kv->getVLayout().valueLength, 0, 0, buffer);
-        object.appendKeysAndValueToBuffer(*(rpc->replyPayload));
+        appendKeysAndValue(key, v.valuePtr, v.valueLength, rpc->replyPayload);
 
-        currentResp->meta.pstamp = kv->getVLayout().meta.pStamp; // eta
-        currentResp->meta.sstamp = kv->getVLayout().meta.sStamp; // pi
-        currentResp->meta.cstamp = kv->getVLayout().meta.cStamp; // cts
+        currentResp->meta.pstamp = v.meta.pStamp; // eta
+        currentResp->meta.sstamp = v.meta.sStamp; // pi
+        currentResp->meta.cstamp = v.meta.cStamp; // cts
         currentResp->length = rpc->replyPayload->size() - initialLength;
 
         // std::cout << "repLen: " << currentResp->length << std::endl; // XXX
@@ -436,25 +475,7 @@ DSSNService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
                 reqOffset, currentReq->length);
 
         // ---- write the object ----
-        KeyLength pKeyLen;
-        uint32_t pValLen;
-        uint64_t tableId = object.getTableId();
-        const void* pVal = object.getValue(&pValLen);
-        const void* pKey = object.getKey(0, &pKeyLen);
-
-        KVLayout pkv(pKeyLen + sizeof(tableId)); //make room for composite key in KVStore
-        pkv.k.setkey(&tableId, sizeof(tableId), 0);
-        pkv.k.setkey(pKey, pKeyLen, sizeof(tableId));
-        pkv.v.valueLength = pValLen;
-        pkv.v.valuePtr = (uint8_t*)const_cast<void*>(pVal);
-
-        if (pValLen == 0) {
-            pkv.getVLayout().isTombstone = true;
-        } else {
-            pkv.getVLayout().valueLength = pValLen;
-            pkv.getVLayout().valuePtr = (uint8_t*)const_cast<void*>(pVal);
-        }
-        KVLayout *nkv = kvStore->preput(pkv);
+        KVLayout *nkv = preputObject(object, *(rpc->requestPayload), reqOffset);
         if (nkv != NULL) {
             txEntry->insertWriteSet(nkv, index);
             currentResp->status = STATUS_OK;
@@ -484,7 +505,8 @@ DSSNService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
 
         return; //delay reply and freeing memory
     }
-    respHdr->common.status = STATUS_INTERNAL_ERROR;
+    if (!replyRetryIfDeferred(txEntry, rpc))
+        respHdr->common.status = STATUS_INTERNAL_ERROR;
     handle->sendReplyAsync();
     delete txEntry;
 }
@@ -537,13 +559,10 @@ DSSNService::write(const WireFormat::WriteDSSN::Request* reqHdr,
     Object object(reqHdr->tableId, 0, 0, *(rpc->requestPayload),
             sizeof32(*reqHdr));
 
+#if (0) // No table check. DSSN does not (yet) support the RamCloud style Table Mgmt
     KeyLength pKeyLen;
     const void* pKey = object.getKey(0, &pKeyLen);
-    uint32_t pValLen;
-    const void* pVal = object.getValue(&pValLen);
     uint64_t tableId = object.getTableId();
-
-#if (0) // No table check. DSSN does not (yet) support the RamCloud style Table Mgmt
     Key key(tableId, pKey, pKeyLen);
     // If the tablet doesn't exist in the NORMAL state, we must plead ignorance.
     TabletManager::Tablet tablet;
@@ -562,27 +581,11 @@ DSSNService::write(const WireFormat::WriteDSSN::Request* reqHdr,
 #endif // 0
 
 
-    KVLayout pkv(pKeyLen + sizeof(tableId)); //make room composite key in KVStore
-    pkv.k.setkey(&tableId, sizeof(tableId), 0);
-    pkv.k.setkey(pKey, pKeyLen, sizeof(tableId));
-    pkv.v.valueLength = pValLen;
-    pkv.v.valuePtr = (uint8_t*)const_cast<void*>(pVal);
-
-    // std::string k((const char*)pKey, (uint32_t)pKeyLen); //DBG
-    // std::string v((const char*)pVal, (uint32_t)pValLen);
-    // std::cout << "write: key: " << k << " vallen: " << pValLen << " val: " << v << std::endl; 
-
     //prepare a single write local tx
     TxEntry *txEntry = new TxEntry(0, 1);
     RpcHandle* handle = rpc->enableAsync();
     txEntry->setRpcHandle(handle);
-    if (pValLen == 0) {
-        pkv.getVLayout().isTombstone = true;
-    } else {
-        pkv.getVLayout().valueLength = pValLen;
-        pkv.getVLayout().valuePtr = (uint8_t*)const_cast<void*>(pVal);
-    }
-    KVLayout *nkv = kvStore->preput(pkv);
+    KVLayout *nkv = preputObject(object, *(rpc->requestPayload), sizeof32(*reqHdr));
     if (nkv != NULL) {
         txEntry->insertWriteSet(nkv, 0);
 	Transport::ServerRpc* srpc = handle->getServerRpc();
@@ -596,6 +599,11 @@ DSSNService::write(const WireFormat::WriteDSSN::Request* reqHdr,
 
             return; //delay reply and freeing memory
         }
+        if (replyRetryIfDeferred(txEntry, rpc)) {
+            handle->sendReplyAsync();
+            delete txEntry;
+            return;
+        }
     }
     respHdr->common.status = STATUS_INTERNAL_ERROR;
     handle->sendReplyAsync();
@@ -637,22 +645,13 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
     assert(numRequests > 0);
     assert(numReadRequests <= numRequests);
 
-    /* Fixme: add a better indicator of read-only tx later
-    const WireFormat::TxPrepare::OpType *type =
-            rpc->requestPayload->getOffset<
-            WireFormat::TxPrepare::OpType>(reqOffset);
-
-    if (*type == WireFormat::TxPrepare::READONLY) {
-    	assert(0);
-    	//read-only transaction needs no validation
-        respHdr->common.status = STATUS_RETRY;
-        respHdr->vote = WireFormat::TxPrepare::COMMITTED;
-        rpc->sendReply();
-        return;
-    }*/
-
     validator->getCounters().serverId = getServerId();
 
+    //how early the CI arrived, for the sequencer to adapt its delta
+    respHdr->slack = (int64_t)((uint64_t)(reqHdr->meta.cts >> 64) - validator->getClockValue());
+    if (participantCount > 1)
+        mMonitor->collectArrivalSlack(respHdr->slack);
+
     //We are over-provisioning the read set to accommodate the potential RMWs
     TxEntry *txEntry = new TxEntry(numRequests, numRequests - numReadRequests);
 
@@ -669,19 +668,20 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
     }
     uint32_t readSetIdx = 0;
     uint32_t writeSetIdx = 0;
+    bool isReadOnlyTx = true; //as a whole, as the client tells by marking all its reads READONLY
 
     for (uint32_t i = 0; i < numRequests; i++) {
-        Tub<PreparedOp> op;
-        uint64_t tableId, rpcId;
+        uint64_t tableId;
         RejectRules rejectRules;
 
         respHdr->common.status = STATUS_OK;
         respHdr->vote = WireFormat::TxPrepare::PREPARED;
 
-        Buffer buffer;
         const WireFormat::TxPrepare::OpType *type =
                 rpc->requestPayload->getOffset<
                 WireFormat::TxPrepare::OpType>(reqOffset);
+        if (*type != WireFormat::TxPrepare::READONLY)
+            isReadOnlyTx = false;
         if (*type == WireFormat::TxPrepare::READ
                 || *type == WireFormat::TxPrepare::READONLY) {
             const WireFormat::TxPrepare::Request::ReadOp *currentReq =
@@ -697,7 +697,6 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
                 break;
             }
             tableId = currentReq->tableId;
-            rpcId = currentReq->rpcId;
             rejectRules = currentReq->rejectRules;
 
             const void* stringKey = rpc->requestPayload->getRange(
@@ -741,7 +740,6 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
                 break;
             }
             tableId = currentReq->tableId;
-            rpcId = currentReq->rpcId;
             rejectRules = currentReq->rejectRules;
 
             const void* stringKey = rpc->requestPayload->getRange(
@@ -785,43 +783,25 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
                 break;
             }
             tableId = currentReq->tableId;
-            rpcId = currentReq->rpcId;
             rejectRules = currentReq->rejectRules;
-            op.construct(*type, 0 /*irrelevant*/, 0 /*irrelevant*/,
-                    rpcId,
-                    tableId, 0, 0,
-                    *(rpc->requestPayload), reqOffset,
+            Object object(tableId, 0, 0, *(rpc->requestPayload), reqOffset,
                     currentReq->length);
+            uint32_t objectOffset = reqOffset;
             reqOffset += currentReq->length;
 
-            KeyLength keyLen;
-            const void* pKey = op.get()->object.getKey(0, &keyLen);
-            uint32_t valLen;
-            const void* pVal = op.get()->object.getValue(&valLen);
-            uint64_t tableId = op.get()->object.getTableId();
-
-            if (keyLen == 0) {
+            if (object.getKeyLength(0) == 0) {
                 respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
                 respHdr->vote = WireFormat::TxPrepare::ABORT;
                 break;
             }
 
-            KVLayout pkv(keyLen + sizeof(tableId)); //make room composite key in KVStore
-            pkv.k.setkey(&tableId, sizeof(tableId), 0);
-            pkv.k.setkey( pKey, keyLen, sizeof(tableId));
-            if (valLen == 0) {
-                pkv.getVLayout().isTombstone = true;
-            } else {
-                pkv.getVLayout().valueLength = valLen;
-                pkv.getVLayout().valuePtr = (uint8_t*)const_cast<void*>(pVal);
-            }
-            KVLayout *nkv = kvStore->preput(pkv);
+            KVLayout *nkv = preputObject(object, *(rpc->requestPayload), objectOffset);
             if (nkv == NULL) {
                 respHdr->common.status = STATUS_NO_TABLE_SPACE;
                 respHdr->vote = WireFormat::TxPrepare::ABORT;
                 break;
             }
-            void* ptr = kvStore->findKVSPtr(pkv.k);
+            void* ptr = kvStore->findKVSPtr(nkv->k);
             txEntry->insertWriteSet(nkv, writeSetIdx);
             txEntry->cacheWriteSetKVPtr(ptr, writeSetIdx);
             writeSetIdx++;
@@ -842,7 +822,6 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
              * to do validation, there will not be self-inflicted pi equal to eta violation.
              */
             if (*type == WireFormat::TxPrepare::READ_MODIFY_WRITE) {
-                void* ptr = kvStore->findKVSPtr(pkv.k);
                 txEntry->insertReadSet(nkv, readSetIdx);
                 txEntry->cacheReadSetKVPtr(ptr, readSetIdx);
                 readSetIdx++;
@@ -864,6 +843,22 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
 
         Transport::ServerRpc* srpc = handle->getServerRpc();
         srpc->endRpcPreProcessingTimer();
+
+        //A read-only tx is decided without entering the validation pipeline. All
+        //the participants of a cross-shard one must take that path, so it has to
+        //be read-only as a whole, and its reply is up to the validator.
+        bool isCrossShard = txEntry->getParticipantSet().size() > 0;
+        if ((isCrossShard ? isReadOnlyTx : numReadRequests == numRequests)
+                && validator->commitReadOnlyTx(txEntry)) {
+            if (isCrossShard)
+                return; //delay reply and freeing memory
+            respHdr->vote = txEntry->getTxState() == TxEntry::TX_COMMIT ?
+                    WireFormat::TxPrepare::COMMITTED : WireFormat::TxPrepare::ABORT;
+            handle->sendReplyAsync();
+            delete txEntry;
+            return;
+        }
+
         if (validator->insertTxEntry(txEntry)) {
             while (validator->testRun()) {
                 if (txEntry->getTxCIState() < TxEntry::TX_CI_FINISHED)
@@ -873,12 +868,64 @@ DSSNService::txCommit(const WireFormat::TxCommitDSSN::Request* reqHdr,
 
             return; //delay reply and freeing memory
         }
-        respHdr->vote = WireFormat::TxPrepare::ABORT;
+        if (!replyRetryIfDeferred(txEntry, rpc))
+            respHdr->vote = WireFormat::TxPrepare::ABORT;
     }
     handle->sendReplyAsync(); //optional but can make send quicker
     delete txEntry;
 }
 
+/*
+ * Turn the reply to a CI that the validator deferred for lack of admission
+ * credits into a STATUS_RETRY, which has the client resend it after the
+ * suggested delay. The response header must not be touched afterwards.
+ * Return false if the CI was not deferred.
+ */
+bool
+DSSNService::replyRetryIfDeferred(TxEntry *txEntry, Rpc* rpc)
+{
+    uint32_t minDelayMicros, maxDelayMicros;
+    if (!validator->isDeferred(txEntry, minDelayMicros, maxDelayMicros))
+        return false;
+    prepareRetryResponse(rpc->replyPayload, minDelayMicros, maxDelayMicros, NULL);
+    return true;
+}
+
+/**
+ * Prepare the KV tuple of an object carried in a request payload. The value
+ * is copied once, from the payload fragments straight into the value arena,
+ * instead of being made contiguous inside the payload and then copied again.
+ * An empty value makes a tombstone.
+ *
+ * \param object
+ *      The object parsed out of the payload at objectOffset.
+ * \return
+ *      The new tuple, or NULL if the object is malformed or no space is left.
+ */
+KVLayout*
+DSSNService::preputObject(Object& object, Buffer& payload, uint32_t objectOffset)
+{
+    KeyLength keyLen;
+    const void* pKey = object.getKey(0, &keyLen);
+    uint32_t valueOffset;
+    if (pKey == NULL || !object.getValueOffset(&valueOffset))
+        return NULL;
+
+    uint64_t tableId = object.getTableId();
+    uint32_t valLen = object.getValueLength();
+    KLayout k(keyLen + sizeof(tableId)); //make room composite key in KVStore
+    k.setkey(&tableId, sizeof(tableId), 0);
+    k.setkey(pKey, keyLen, sizeof(tableId));
+    KVLayout *nkv = kvStore->preput(k, valLen);
+    if (nkv == NULL)
+        return NULL;
+    if (valLen == 0)
+        nkv->v.isTombstone = true;
+    else
+        payload.copy(objectOffset + valueOffset, valLen, nkv->v.valuePtr);
+    return nkv;
+}
+
 void
 DSSNService::txDecision(const WireFormat::TxDecisionDSSN::Request* reqHdr,
         WireFormat::TxDecisionDSSN::Response* respHdr,
@@ -948,28 +995,22 @@ DSSNService::sendDSSNInfo(__uint128_t cts, TxEntry *txEntry, bool isSpecific, ui
             (uint64_t)(cts >> 64), isSpecific, target, txEntry->getPeerPosition());
     Metric* m = mMonitor->getOpMetric(DSSNServiceSendDSSNInfo);
     OpTrace t(m);
-    WireFormat::DSSNSendInfoAsync::Request req;
-    req.senderPeerId = getServerId();
+    PeerChannel::Record rec;
+    rec.opcode = WireFormat::DSSN_SEND_INFO_ASYNC;
     assert(txEntry != NULL);
-    req.cts = txEntry->getCTS();
-    assert(cts == req.cts);
-    req.pstamp = txEntry->getPStamp();
-    req.sstamp = txEntry->getSStamp();
-    req.txState = txEntry->getTxState();
-    req.senderPeerPosition = txEntry->getPeerPosition();
-
-    char *msg = reinterpret_cast<char *>(&req) + sizeof(WireFormat::Notification::Request);
-    uint32_t length = sizeof(req) - sizeof(WireFormat::Notification::Request);
+    rec.cts = txEntry->getCTS();
+    assert(cts == rec.cts);
+    rec.pstamp = txEntry->getPStamp();
+    rec.sstamp = txEntry->getSStamp();
+    rec.txState = txEntry->getTxState();
+    rec.senderPeerPosition = txEntry->getPeerPosition();
+
+    uint64_t sender = getServerId();
     if (isSpecific) {
-        ServerId sid(target);
-        Notifier::notify(context, WireFormat::DSSN_SEND_INFO_ASYNC,
-                msg, length, sid);
+        peerChannel->post(target, sender, rec);
     } else if (txEntry != NULL) {
-        std::set<uint64_t>::iterator it;
-        for (it = txEntry->getParticipantSet().begin(); it != txEntry->getParticipantSet().end(); it++) {
-            ServerId sid(*it);
-            Notifier::notify(context, WireFormat::DSSN_SEND_INFO_ASYNC,
-                    msg, length, sid);
+        for (uint64_t peer : txEntry->getParticipantSet()) {
+            peerChannel->post(peer, sender, rec);
         }
     }
     return true;
@@ -980,20 +1021,14 @@ DSSNService::sendDSSNInfo(__uint128_t cts, uint8_t txState, uint64_t pStamp, uin
 {
     RAMCLOUD_LOG(NOTICE, "%s", __FUNCTION__);
 
-    WireFormat::DSSNSendInfoAsync::Request req;
-    req.senderPeerId = getServerId();
-
-    req.cts = cts;
-    req.pstamp = pStamp;
-    req.sstamp = sStamp;
-    req.txState = txState;
-    req.senderPeerPosition = position;
-
-    char *msg = reinterpret_cast<char *>(&req) + sizeof(WireFormat::Notification::Request);
-    uint32_t length = sizeof(req) - sizeof(WireFormat::Notification::Request);
-    ServerId sid(target);
-    Notifier::notify(context, WireFormat::DSSN_SEND_INFO_ASYNC,
-            msg, length, sid);
+    PeerChannel::Record rec;
+    rec.opcode = WireFormat::DSSN_SEND_INFO_ASYNC;
+    rec.cts = cts;
+    rec.pstamp = pStamp;
+    rec.sstamp = sStamp;
+    rec.txState = txState;
+    rec.senderPeerPosition = position;
+    peerChannel->post(target, getServerId(), rec);
 
     return true;
 }
@@ -1003,32 +1038,45 @@ DSSNService::requestDSSNInfo(TxEntry *txEntry, bool isSpecific, uint64_t target)
 {
     Metric* m = mMonitor->getOpMetric(DSSNServiceSendDSSNInfoReq);
     OpTrace t(m);
-    WireFormat::DSSNRequestInfoAsync::Request req;
-    req.cts = txEntry->getCTS();
-    req.pstamp = txEntry->getPStamp();
-    req.sstamp = txEntry->getSStamp();;
-    req.senderPeerId = getServerId();
-    req.txState = txEntry->getTxState();
-
-    char *msg = reinterpret_cast<char *>(&req) + sizeof(WireFormat::Notification::Request);
-    uint32_t length = sizeof(req) - sizeof(WireFormat::Notification::Request);
+    PeerChannel::Record rec;
+    rec.opcode = WireFormat::DSSN_REQUEST_INFO_ASYNC;
+    rec.cts = txEntry->getCTS();
+    rec.pstamp = txEntry->getPStamp();
+    rec.sstamp = txEntry->getSStamp();
+    rec.txState = txEntry->getTxState();
+    rec.senderPeerPosition = 0;
+
+    uint64_t sender = getServerId();
     if (isSpecific) {
-        ServerId sid(target);
-        assert(target != getServerId());
-        Notifier::notify(context, WireFormat::DSSN_REQUEST_INFO_ASYNC,
-                msg, length, sid);
+        assert(target != sender);
+        peerChannel->post(target, sender, rec);
         RAMCLOUD_LOG(NOTICE, "notify cts %lu to peer %lu", (uint64_t)(txEntry->getCTS() >> 64), target);
     } else {
-        std::set<uint64_t>::iterator it;
-        for (it = txEntry->getParticipantSet().begin(); it != txEntry->getParticipantSet().end(); it++) {
-            ServerId sid(*it);
-            Notifier::notify(context, WireFormat::DSSN_REQUEST_INFO_ASYNC,
-                    msg, length, sid);
+        for (uint64_t peer : txEntry->getParticipantSet()) {
+            peerChannel->post(peer, sender, rec);
         }
     }
     return true;
 }
 
+bool
+DSSNService::sendReadOnlyInfo(TxEntry *txEntry)
+{
+    PeerChannel::Record rec;
+    rec.opcode = WireFormat::DSSN_READ_ONLY_INFO_ASYNC;
+    rec.cts = txEntry->getCTS();
+    rec.pstamp = txEntry->getPStamp();
+    rec.sstamp = txEntry->getSStamp();
+    rec.txState = txEntry->getTxState();
+    rec.senderPeerPosition = txEntry->getPeerPosition();
+
+    uint64_t sender = getServerId();
+    for (uint64_t peer : txEntry->getParticipantSet()) {
+        peerChannel->post(peer, sender, rec);
+    }
+    return true;
+}
+
 void
 DSSNService::handleSendInfoAsync(Rpc* rpc)
 {
@@ -1057,6 +1105,42 @@ DSSNService::handleRequestInfoAsync(Rpc* rpc)
     validator->replySSNInfo(reqHdr->senderPeerId, reqHdr->cts, reqHdr->pstamp, reqHdr->sstamp, reqHdr->txState, reqHdr->senderPeerPosition);
 }
 
+void
+DSSNService::handleInfoBatchAsync(Rpc* rpc)
+{
+    assert(rpc->replyPayload->size() == 0);
+    WireFormat::DSSNInfoBatchAsync::Request* reqHdr =
+            rpc->requestPayload->getStart<WireFormat::DSSNInfoBatchAsync::Request>();
+    if (reqHdr == NULL)
+        throw MessageTooShortError(HERE);
+    // bound the count by the payload first, lest the length overflow
+    if (reqHdr->count > (rpc->requestPayload->size() - sizeof32(*reqHdr)) / sizeof32(PeerChannel::Record))
+        throw MessageTooShortError(HERE);
+    const PeerChannel::Record *recs = static_cast<const PeerChannel::Record *>(
+            rpc->requestPayload->getRange(sizeof32(*reqHdr), reqHdr->count * sizeof32(PeerChannel::Record)));
+    if (recs == NULL)
+        throw MessageTooShortError(HERE);
+    RAMCLOUD_LOG(NOTICE, "%s %u", __FUNCTION__, reqHdr->count);
+
+    for (uint32_t i = 0; i < reqHdr->count; i++) {
+        const PeerChannel::Record &rec = recs[i];
+        if (rec.opcode == WireFormat::DSSN_SEND_INFO_ASYNC) {
+            validator->receiveSSNInfo(reqHdr->senderPeerId, rec.cts,
+                    rec.pstamp, rec.sstamp, rec.txState, rec.senderPeerPosition);
+        } else if (rec.opcode == WireFormat::DSSN_REQUEST_INFO_ASYNC) {
+            validator->replySSNInfo(reqHdr->senderPeerId, rec.cts,
+                    rec.pstamp, rec.sstamp, rec.txState, rec.senderPeerPosition);
+        } else if (rec.opcode == WireFormat::DSSN_READ_ONLY_INFO_ASYNC) {
+            validator->receiveReadOnlyInfo(reqHdr->senderPeerId, rec.cts,
+                    rec.pstamp, rec.sstamp, rec.senderPeerPosition);
+        } else {
+            // the batch is one-way, so there is no reply to reject it with
+            RAMCLOUD_LOG(WARNING, "skipped record %u of opcode %u from peer %lu",
+                    i, rec.opcode, reqHdr->senderPeerId);
+        }
+    }
+}
+
 void
 DSSNService::recordTxCommitDispatch(TxEntry *txEntry)
 {
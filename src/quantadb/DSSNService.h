@@ -24,6 +24,15 @@
 #include "Validator.h"
 #include "TabletManager.h"
 #include "Notifier.h"
+#include "PeerChannel.h"
+
+/*
+ * Read replies refer to stored values at least this long instead of
+ * copying them; shorter values are cheaper to copy than to pin.
+ */
+#ifndef DSSN_REPLY_BY_REFERENCE_MIN
+#define DSSN_REPLY_BY_REFERENCE_MIN 256
+#endif
 
 namespace QDB {
 using namespace RAMCloud;
@@ -43,6 +52,7 @@ class DSSNService : public Service {
    bool sendDSSNInfo(__uint128_t cts, uint8_t txState, uint64_t pStamp, uint64_t sStamp, uint8_t position, uint64_t target);
    void recordTxCommitDispatch(TxEntry *txEntry);
    bool requestDSSNInfo(TxEntry *txEntry, bool isSpecific = false, uint64_t target = 0);
+   bool sendReadOnlyInfo(TxEntry *txEntry);
 
    const std::string& getServerAddress() {
        static ServiceLocator sl(serverConfig->localLocator);
@@ -98,8 +108,11 @@ class DSSNService : public Service {
 		   const WireFormat::TxDecisionDSSN::Request* reqHdr,
 		   WireFormat::TxDecisionDSSN::Response* respHdr,
 		   Rpc* rpc);
+   bool replyRetryIfDeferred(TxEntry *txEntry, Rpc* rpc);
+   KVLayout* preputObject(Object& object, Buffer& payload, uint32_t objectOffset);
    void handleSendInfoAsync(Rpc* rpc);
    void handleRequestInfoAsync(Rpc* rpc);
+   void handleInfoBatchAsync(Rpc* rpc);
    Context* context;
    ServerList* serverList;
    const ServerConfig* serverConfig;
@@ -109,6 +122,7 @@ class DSSNService : public Service {
    Validator* validator;
    TabletManager *tabletManager;
    DSSNServiceMonitor *mMonitor;
+   PeerChannel *peerChannel;
 };
 
 
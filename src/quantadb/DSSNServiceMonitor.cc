@@ -37,6 +37,16 @@ DSSNServiceMonitor::DSSNServiceMonitor(DSSNService *service, Exposer* exposer) {
 	    for (uint32_t i = 0; i < DSSNServiceOpsMax; i++)
 	        addDxMetric((DSSNServiceOp)i);
 	    exposer->RegisterCollectable(mPDxRegistry);
+
+	    mPArRegistry = std::make_shared<Registry>();
+	    mPArGauges = &BuildGauge()
+	      .Name("DSSNService_value_arena")
+	      .Help("Value arena occupancy per size class")
+	      .Register(*mPArRegistry);
+	    for (uint32_t i = 0; i < ValueArena::NUM_CLASSES; i++)
+	        addArenaMetric(i);
+	    mPArHugeHandle = &mPArGauges->Add({{"class", "huge"}, {"stat", "in_use"}});
+	    exposer->RegisterCollectable(mPArRegistry);
 	    startSampler = true;
 	}
         if (IS_PERF_MONITOR_ENABLED()) {
@@ -50,6 +60,20 @@ DSSNServiceMonitor::DSSNServiceMonitor(DSSNService *service, Exposer* exposer) {
 	        addPfMetric((DSSNServiceOp)i);
 	    exposer->RegisterCollectable(mPPfRegistry);
 	    startSampler = true;
+
+	    //Create the per-stage latency histograms of the commit pipeline
+	    mPStRegistry = std::make_shared<Registry>();
+	    mPStCounters = &BuildHistogram()
+	      .Name("DSSNService_CI_stage")
+	      .Help("Time commit-intents spend in each stage of the commit pipeline")
+	      .Register(*mPStRegistry);
+	    addCIStage(TxEntry::TX_CI_QUEUED, "queued");
+	    addCIStage(TxEntry::TX_CI_SCHEDULED, "scheduled");
+	    addCIStage(TxEntry::TX_CI_LISTENING, "listening");
+	    addCIStage(TxEntry::TX_CI_CONCLUDED, "concluded");
+	    addCIStage(TxEntry::TX_CI_SEALED, "sealed");
+	    addCIStage(TxEntry::TX_CI_FINISHED, "total");
+	    exposer->RegisterCollectable(mPStRegistry);
 	}
 	if (IS_TRACING_MONITOR_ENABLED()) {
 	    //Create the list of tracing Metrics
@@ -70,6 +94,7 @@ DSSNServiceMonitor::DSSNServiceMonitor(DSSNService *service, Exposer* exposer) {
 	      .Help("Operation histogram")
 	      .Register(*mPDlRegistry);
 	    addDistLatency();
+	    addArrivalSlack();
 	    exposer->RegisterCollectable(mPDlRegistry);
 	}
 	if (startSampler) {
@@ -118,6 +143,20 @@ DSSNServiceMonitor::collectTcMetrics() {
 #endif
 }
 
+void
+DSSNServiceMonitor::collectArenaMetrics() {
+#ifdef MONITOR
+  if (mEnabled && mPArGauges) {
+      ValueArena &arena = ValueArena::instance();
+      for(uint32_t i = 0; i < ValueArena::NUM_CLASSES; i++) {
+	  mPArCapacityHandle[i]->Set((double)arena.getCapacity(i));
+	  mPArInUseHandle[i]->Set((double)arena.getInUse(i));
+      }
+      mPArHugeHandle->Set((double)arena.getHugeInUse());
+  }
+#endif
+}
+
 void
 DSSNServiceMonitor::collectDistTxLatency(uint64_t latency) {
 #ifdef MONITOR
@@ -127,6 +166,43 @@ DSSNServiceMonitor::collectDistTxLatency(uint64_t latency) {
 #endif
 }
 
+void
+DSSNServiceMonitor::collectArrivalSlack(int64_t slack) {
+#ifdef MONITOR
+  if (mEnabled && mPSlHandle) {
+	mPSlHandle->Observe((double)slack/1000); // slack is in nanoseconds
+  }
+#endif
+}
+
+/*
+ * Observe the stages of a finished CI. A stage lasts from entering its state to
+ * entering the next one the CI went through; a local CI skips the peer exchange.
+ * The FINISHED slot takes the whole time from being queued.
+ */
+void
+DSSNServiceMonitor::collectCIStages(TxEntry *txEntry) {
+#ifdef MONITOR
+  if (mEnabled && mPStCounters) {
+      uint32_t stage = 0;
+      uint64_t from = 0;
+      for (uint32_t s = TxEntry::TX_CI_QUEUED; s <= TxEntry::TX_CI_FINISHED; s++) {
+	  uint64_t t = txEntry->getTxCIStateTime(s);
+	  if (t == 0 || t < from)
+	      continue; //not entered, or re-entered out of order
+	  if (stage != 0)
+	      mPStHandle[stage]->Observe(Cycles::toMicroseconds(t - from));
+	  stage = s;
+	  from = t;
+      }
+      uint64_t queued = txEntry->getTxCIStateTime(TxEntry::TX_CI_QUEUED);
+      uint64_t finished = txEntry->getTxCIStateTime(TxEntry::TX_CI_FINISHED);
+      if (queued != 0 && finished >= queued)
+	  mPStHandle[TxEntry::TX_CI_FINISHED]->Observe(Cycles::toMicroseconds(finished - queued));
+  }
+#endif
+}
+
 void
 DSSNServiceMonitor::clearMetrics() {
   if (mEnabled) {
@@ -143,6 +219,7 @@ DSSNServiceMonitor::sample(DSSNServiceMonitor* mon) {
         std::this_thread::sleep_for(std::chrono::milliseconds(MONITOR_SAMPLING_INTERVAL_IN_MS));
         if (IS_DIAG_MONITOR_ENABLED()) {
 	    mon->collectDxMetrics();
+	    mon->collectArenaMetrics();
 	}
 	if (IS_PERF_MONITOR_ENABLED()) {
 	    mon->collectPfMetrics();
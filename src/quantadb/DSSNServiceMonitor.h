@@ -22,6 +22,8 @@
 #include <prometheus/registry.h>
 
 #include "OpTrace.h"
+#include "TxEntry.h"
+#include "ValueArena.h"
 
 namespace QDB {
 class DSSNService;
@@ -36,6 +38,7 @@ enum DSSNServiceOp {
     DSSNServiceRecvDSSNInfo,
     DSSNServiceSendDSSNInfoReq,
     DSSNServiceRecvDSSNInfoReq,
+    DSSNServiceRecvDSSNInfoBatch,
     DSSNServiceWrite,
     DSSNServiceWriteMulti,
     DSSNServiceOpsMax
@@ -51,6 +54,7 @@ static const char* DssnOpLabels[] = {
     "recv_dssninfo",
     "send_dssninfo_request",
     "recv_dssninfo_request",
+    "recv_dssninfo_batch",
     "write",
     "write_multiops",
     "invalid"
@@ -67,6 +71,9 @@ class DSSNServiceMonitor {
      void collectPfMetrics();
      void collectTcMetrics();
      void collectDistTxLatency(uint64_t latency);
+     void collectArrivalSlack(int64_t slack);
+     void collectCIStages(TxEntry *txEntry);
+     void collectArenaMetrics();
      void clearMetrics();
      bool isEnabled() { return mEnabled; }
     /**
@@ -102,6 +109,30 @@ class DSSNServiceMonitor {
         prometheus::Histogram::BucketBoundaries bucketsInMicroSec{10, 50, 100, 200, 300, 400, 500, 750, 1000, 5000, 10000, 50000, 100000, 500000};
 	mPDlHandle = &mPDlCounter->Add({{"label", "DistTxLatency"}}, bucketsInMicroSec);
     }
+    /**
+     * Helper function to add the CI arrival slack histogram; negative is late
+     */
+    void addArrivalSlack() {
+        prometheus::Histogram::BucketBoundaries bucketsInMicroSec{-100, -10, -1, 0, 1, 5, 10, 20, 30, 50, 100, 200, 500, 1000};
+	mPSlHandle = &mPDlCounter->Add({{"label", "CIArrivalSlack"}}, bucketsInMicroSec);
+    }
+    /**
+     * Helper function to add the histogram of the time CIs spend in a TX_CI_xxx state,
+     * with log-spaced buckets to keep the tail readable
+     */
+    void addCIStage(uint32_t state, const char* stage) {
+        prometheus::Histogram::BucketBoundaries bucketsInMicroSec{1, 2, 5, 10, 20, 50, 100, 200, 500,
+	    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000};
+	mPStHandle[state] = &mPStCounters->Add({{"stage", stage}}, bucketsInMicroSec);
+    }
+    /**
+     * Helper function to add the occupancy gauges of a value arena size class
+     */
+    void addArenaMetric(uint32_t cls) {
+        std::string size = std::to_string(ValueArena::instance().getClassSize(cls));
+        mPArCapacityHandle[cls] = &mPArGauges->Add({{"class", size}, {"stat", "capacity"}});
+        mPArInUseHandle[cls] = &mPArGauges->Add({{"class", size}, {"stat", "in_use"}});
+    }
     /**
      * The Diagnostic related counter
      */
@@ -127,6 +158,23 @@ class DSSNServiceMonitor {
     std::shared_ptr<prometheus::Registry> mPDlRegistry;
     prometheus::Family<prometheus::Histogram>* mPDlCounter = nullptr;
     prometheus::Histogram* mPDlHandle = nullptr;
+    prometheus::Histogram* mPSlHandle = nullptr;
+
+    /*
+     * The commit pipeline latency per TX_CI_xxx state, and from queued to finished
+     */
+    std::shared_ptr<prometheus::Registry> mPStRegistry;
+    prometheus::Family<prometheus::Histogram>* mPStCounters = nullptr;
+    prometheus::Histogram* mPStHandle[TxEntry::TX_CI_FINISHED + 1] = {};
+
+    /*
+     * The value arena occupancy, in objects per size class
+     */
+    std::shared_ptr<prometheus::Registry> mPArRegistry;
+    prometheus::Family<prometheus::Gauge>* mPArGauges = nullptr;
+    prometheus::Gauge* mPArCapacityHandle[ValueArena::NUM_CLASSES];
+    prometheus::Gauge* mPArInUseHandle[ValueArena::NUM_CLASSES];
+    prometheus::Gauge* mPArHugeHandle = nullptr;
 
     DSSNService* mService;
     Metric mOps[DSSNServiceOpsMax];
@@ -107,6 +107,57 @@ TEST_F(DSSNServiceTest, notification_send_dssn_info) {
     EXPECT_EQ(0, (int)TestLog::get().find("handleRequestInfoAsync"));
 }
 
+TEST_F(DSSNServiceTest, peerChannel_coalesce) {
+    TestLog::reset();
+    QDB::PeerChannel channel(&context);
+    QDB::PeerChannel::Record rec;
+    rec.opcode = WireFormat::DSSN_REQUEST_INFO_ASYNC;
+    rec.txState = QDB::TxEntry::TX_PENDING;
+    rec.senderPeerPosition = 0;
+    rec.pstamp = 0;
+    rec.sstamp = 0;
+
+    //full batches go out as they fill up
+    channel.setFlushDelay(~0ul);
+    for (uint64_t i = 0; i < 2 * PEER_CHANNEL_BATCH; i++) {
+        rec.cts = i;
+        channel.post(serverId.getId(), serverId.getId(), rec);
+    }
+    EXPECT_EQ(2u * PEER_CHANNEL_BATCH, channel.getPostedCount());
+    EXPECT_EQ(2u, channel.getRpcCount());
+    EXPECT_NE(string::npos, TestLog::get().find("handleInfoBatchAsync: 64"));
+
+    //the rest once it is due
+    channel.setFlushDelay(0);
+    rec.cts = 2 * PEER_CHANNEL_BATCH;
+    channel.post(serverId.getId(), serverId.getId(), rec);
+    for (int i = 0; i < 1000 && channel.getRpcCount() < 3; i++)
+        usleep(1000);
+    EXPECT_EQ(3u, channel.getRpcCount());
+    EXPECT_NE(string::npos, TestLog::get().find("handleInfoBatchAsync: 1"));
+}
+
+TEST_F(DSSNServiceTest, peerChannel_noSession) {
+    TestLog::reset();
+    QDB::PeerChannel channel(&context);
+    QDB::PeerChannel::Record rec;
+    rec.opcode = WireFormat::DSSN_SEND_INFO_ASYNC;
+    rec.txState = QDB::TxEntry::TX_PENDING;
+    rec.senderPeerPosition = 0;
+    rec.pstamp = 0;
+    rec.sstamp = 0;
+
+    //the records for an unknown peer are dropped, not sent
+    channel.setFlushDelay(~0ul);
+    for (uint64_t i = 0; i < PEER_CHANNEL_BATCH; i++) {
+        rec.cts = i;
+        channel.post(99, serverId.getId(), rec);
+    }
+    EXPECT_EQ(0u, channel.getRpcCount());
+    EXPECT_EQ(uint64_t(PEER_CHANNEL_BATCH), channel.getDroppedCount());
+    EXPECT_NE(string::npos, TestLog::get().find("can't locate participate server id: 99"));
+}
+
 TEST_F(DSSNServiceTest, OpTrace) {
     QDB::Metric td1;
     QDB::Metric td2;
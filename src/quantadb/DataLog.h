@@ -51,6 +51,9 @@ namespace QDB {
  *
  * void dump(int fd)
  *      Debugging dump to file descriptor 'fd'
+ *
+ * Each record carries the CRC32C of its data in the tailer. On construction, the log is cut
+ * behind the last intact record, dropping records torn by a crash.
  */
 class DataLog {
   private:
@@ -72,6 +75,7 @@ class DataLog {
         std::string s(logdir);
         log = new DLog<DATALOG_CHUNK_SIZE>(s, true);
 
+        drop_torn_tail();
         bgn_off = (size() > 0)?  ((LogHeader_t*)log->getaddr(0))->doff - sizeof(LogHeader_t) : 0;
     }
 
@@ -81,7 +85,7 @@ class DataLog {
     {
         uint32_t totalsz = dlen + sizeof(LogHeader_t) + sizeof(LogTailer_t);
         LogHeader_t hdr = {LOG_HEAD_SIG, 0, totalsz};
-        LogTailer_t tal = {LOG_TAIL_SIG, totalsz};
+        LogTailer_t tal = {LOG_TAIL_SIG, totalsz, log->checksum(dblob, dlen)};
         
         void *dst = log->reserve(totalsz, &hdr.doff);
         hdr.doff += bgn_off + sizeof(LogHeader_t);
@@ -179,6 +183,7 @@ class DataLog {
     typedef struct {
         uint32_t sig;   // signature
         uint32_t length;// log record size, include header and tailer
+        uint32_t crc;   // CRC32C of the data
     } LogTailer_t;
 
     // private variables
@@ -186,6 +191,29 @@ class DataLog {
     uint32_t datalog_id;
     uint64_t bgn_off;
 
+    // Cut the log behind the last intact record
+    void drop_torn_tail()
+    {
+        uint32_t dlen;
+        uint64_t off = 0;
+        size_t hdrsz = sizeof(LogTailer_t) + sizeof(LogHeader_t);
+        LogHeader_t *hdr;
+        while ((hdr = (LogHeader_t*)log->getaddr(off, &dlen))) {
+            if (dlen < sizeof(LogHeader_t) || hdr->sig != LOG_HEAD_SIG
+                    || hdr->length < hdrsz || hdr->length > dlen)
+                break;
+            LogTailer_t *tal = (LogTailer_t*)((char *)hdr + hdr->length - sizeof(LogTailer_t));
+            if (tal->sig != LOG_TAIL_SIG || tal->length != hdr->length
+                    || tal->crc != log->checksum(&hdr[1], hdr->length - hdrsz))
+                break;
+            off += hdr->length;
+        }
+        if (off < size()) {
+            uint64_t torn = log->truncate(off);
+            std::cout << "Info: DataLog " << datalog_id << " dropped " << torn << " torn bytes" << std::endl;
+        }
+    }
+
     // Returns NULL if offset is invalid.
     inline bool valid_offset(uint64_t offset, LogHeader_t **hdrpp = NULL/*out*/, uint32_t *len = NULL/*out*/)
     {
@@ -18,7 +18,7 @@
 
 #include "TxEntry.h"
 #include "ActiveTxSet.h"
-#include "CountBloomFilter.h"
+#include "BlockedBloomFilter.h"
 #include "WaitList.h"
 
 namespace QDB {
@@ -60,9 +60,10 @@ class DistributedTxSet {
 	WaitList coldDependQueue{coldDependQueueSize};
 	WaitList hotDependQueue{hotDependQueueSize};
 
-	CountBloomFilter<uint8_t> independentCBF = CountBloomFilter<uint8_t>((1 << 18), 255);
-	CountBloomFilter<uint8_t> coldDependCBF = CountBloomFilter<uint8_t>((1 << 15), 255);
-	CountBloomFilter<uint32_t> hotDependCBF = CountBloomFilter<uint32_t>((1 << 10), 0xffffffff);
+	//same counter memory as before: 256KB and 32KB of 8-bit counters, 4KB of 16-bit ones
+	BlockedBloomFilter<8> independentCBF{(1 << 15), 2};
+	BlockedBloomFilter<8> coldDependCBF{(1 << 12), 2};
+	BlockedBloomFilter<16> hotDependCBF{(1 << 9), 2};
 
 	uint32_t hotThreshold = 255;
 
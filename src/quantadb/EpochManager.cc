@@ -0,0 +1,237 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <new>
+#include <cstdlib>
+#include "EpochManager.h"
+#include "Logger.h"
+
+using namespace RAMCloud;
+
+namespace QDB {
+
+/*
+ * Releases the calling thread's slot when the thread exits. Anything still
+ * in its limbo list stays with the slot and is reclaimed by the next owner.
+ */
+struct EpochRecordHolder {
+    EpochManager *mgr = NULL;
+    EpochManager::ThreadRecord *rec = NULL;
+    ~EpochRecordHolder() {
+        if (mgr && rec)
+            mgr->releaseRecord(rec);
+    }
+};
+
+static thread_local EpochRecordHolder myRecord;
+
+EpochManager&
+EpochManager::instance()
+{
+    //never destroyed, so that thread_local holders may outlive static destruction
+    //placed by hand, as plain new does not honor the cache line alignment before C++17
+    static EpochManager *mgr = [] {
+        void *mem;
+        if (posix_memalign(&mem, alignof(EpochManager), sizeof(EpochManager)) != 0)
+            abort();
+        return new (mem) EpochManager();
+    }();
+    return *mgr;
+}
+
+EpochManager::EpochManager()
+{
+    for (uint32_t i = 0; i < MAX_PINS; i++)
+        pins[i].store(QUIESCENT);
+}
+
+EpochManager::~EpochManager()
+{
+    for (uint32_t i = 0; i < highMark.load(); i++) {
+        for (auto &r : records[i].limbo)
+            r.deleter(r.ptr);
+        records[i].limbo.clear();
+    }
+}
+
+EpochManager::ThreadRecord*
+EpochManager::getRecord()
+{
+    if (myRecord.rec != NULL)
+        return myRecord.rec;
+
+    for (uint32_t i = 0; i < MAX_THREADS; i++) {
+        bool expected = false;
+        if (!records[i].inUse.load() && records[i].inUse.compare_exchange_strong(expected, true)) {
+            uint32_t mark = highMark.load();
+            while (mark < i + 1 && !highMark.compare_exchange_weak(mark, i + 1));
+            myRecord.mgr = this;
+            myRecord.rec = &records[i];
+            return &records[i];
+        }
+    }
+    RAMCLOUD_LOG(ERROR, "EpochManager: out of thread slots");
+    abort();
+    return NULL;
+}
+
+void
+EpochManager::releaseRecord(ThreadRecord *rec)
+{
+    rec->epoch.store(QUIESCENT);
+    rec->nesting = 0;
+    rec->online = false;
+    rec->inUse.store(false);
+}
+
+void
+EpochManager::enter()
+{
+    ThreadRecord *rec = getRecord();
+    if (rec->nesting++ == 0 && !rec->online)
+        rec->epoch.store(globalEpoch.load()); //seq_cst: ordered before the reader's loads
+}
+
+void
+EpochManager::exit()
+{
+    ThreadRecord *rec = getRecord();
+    assert(rec->nesting > 0);
+    if (--rec->nesting == 0 && !rec->online)
+        rec->epoch.store(QUIESCENT, std::memory_order_release);
+}
+
+void
+EpochManager::registerThread()
+{
+    ThreadRecord *rec = getRecord();
+    rec->online = true;
+    if (rec->nesting == 0)
+        rec->epoch.store(globalEpoch.load());
+}
+
+void
+EpochManager::unregisterThread()
+{
+    ThreadRecord *rec = getRecord();
+    rec->online = false;
+    if (rec->nesting == 0)
+        rec->epoch.store(QUIESCENT, std::memory_order_release);
+    reclaim();
+}
+
+void
+EpochManager::quiescent()
+{
+    ThreadRecord *rec = getRecord();
+    if (!rec->online || rec->nesting > 0)
+        return;
+    rec->epoch.store(globalEpoch.load());
+    if (rec->limbo.size() >= RECLAIM_THRESHOLD)
+        reclaim();
+}
+
+void
+EpochManager::retire(void *ptr, Deleter deleter)
+{
+    ThreadRecord *rec = getRecord();
+
+    //the caller has already unlinked ptr; order that before sampling the epoch
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    rec->limbo.push_back({ptr, deleter, globalEpoch.load()});
+    retiredCount++;
+
+    if (rec->limbo.size() >= RECLAIM_THRESHOLD)
+        reclaim();
+}
+
+uint32_t
+EpochManager::pin()
+{
+    static thread_local uint32_t cursor = 0;
+    ThreadRecord *rec = getRecord();
+    uint64_t epoch = rec->epoch.load();
+    assert(epoch != QUIESCENT);
+
+    //the pin inherits the epoch the caller entered at, not the current one:
+    //whatever the caller has read may have been retired since then
+    for (uint32_t n = 0; n < MAX_PINS; n++) {
+        uint32_t i = cursor++ % MAX_PINS;
+        uint64_t expected = QUIESCENT;
+        if (pins[i].load(std::memory_order_relaxed) == QUIESCENT
+                && pins[i].compare_exchange_strong(expected, epoch)) {
+            uint32_t mark = pinMark.load();
+            while (mark < i + 1 && !pinMark.compare_exchange_weak(mark, i + 1));
+            return i;
+        }
+    }
+    return NO_PIN;
+}
+
+void
+EpochManager::unpin(uint32_t pin)
+{
+    assert(pin < MAX_PINS && pins[pin].load() != QUIESCENT);
+    pins[pin].store(QUIESCENT, std::memory_order_release);
+}
+
+uint64_t
+EpochManager::minActiveEpoch()
+{
+    uint64_t min = QUIESCENT;
+    uint32_t mark = highMark.load();
+    for (uint32_t i = 0; i < mark; i++) {
+        uint64_t e = records[i].epoch.load();
+        if (e < min)
+            min = e;
+    }
+    //scanned after the records: a pin is taken before its owner's record is released
+    mark = pinMark.load();
+    for (uint32_t i = 0; i < mark; i++) {
+        uint64_t e = pins[i].load();
+        if (e < min)
+            min = e;
+    }
+    return min;
+}
+
+uint32_t
+EpochManager::reclaim()
+{
+    ThreadRecord *rec = getRecord();
+    if (rec->limbo.empty())
+        return 0;
+
+    globalEpoch.fetch_add(1);
+    uint64_t safe = minActiveEpoch();
+
+    //an object retired at epoch e may still be held by a reader that entered at or before e
+    uint32_t freed = 0;
+    auto &limbo = rec->limbo;
+    size_t keep = 0;
+    for (size_t i = 0; i < limbo.size(); i++) {
+        if (limbo[i].epoch < safe) {
+            limbo[i].deleter(limbo[i].ptr);
+            freed++;
+        } else {
+            limbo[keep++] = limbo[i];
+        }
+    }
+    limbo.resize(keep);
+    freedCount += freed;
+    return freed;
+}
+
+} // end namespace QDB
@@ -0,0 +1,148 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef EPOCH_MANAGER_H
+#define EPOCH_MANAGER_H
+
+#include <atomic>
+#include <vector>
+#include "Common.h"
+
+namespace QDB {
+
+/**
+ * Epoch-based reclamation of memory that lock-free readers may still be
+ * dereferencing.
+ *
+ * A reader brackets its accesses with enter()/exit() (or an EpochGuard).
+ * A writer first unlinks an object so that no new reader can reach it and then
+ * hands it to retire(). The object is freed only after every thread that was
+ * inside a critical section at unlink time has left it.
+ *
+ * Long-running loop threads (serialize, scheduling, peer, monitor) instead
+ * register once and go online; they are then treated as readers at all times
+ * and only need to announce a quiescent state, i.e. a point where they hold
+ * no reference to shared objects, once per loop iteration (QSBR).
+ *
+ * Each thread owns a slot in a fixed table, claimed on first use and released
+ * at thread exit. Retired objects are kept in the retiring thread's slot, so
+ * retire() takes no lock.
+ */
+class EpochManager {
+    PUBLIC:
+    typedef void (*Deleter)(void *ptr);
+
+    static const uint32_t MAX_THREADS = 512;
+    static const uint64_t QUIESCENT = ~0ul;
+    static const uint32_t RECLAIM_THRESHOLD = 64;
+    static const uint32_t MAX_PINS = 1024;
+    static const uint32_t NO_PIN = ~0u;
+
+    /// the one instance per process, shared by the KV store and the validator threads
+    static EpochManager& instance();
+
+    // begin/end a read-side critical section; may be nested
+    void enter();
+    void exit();
+
+    // QSBR: an online thread is a reader until it announces a quiescent state
+    void registerThread();
+    void unregisterThread();
+    void quiescent();
+
+    // hand the caller's critical section over to a pin that outlives it, e.g.,
+    // for memory referenced by an RPC reply; unpin() may run on any thread.
+    // Must be called inside a critical section; NO_PIN if all pins are taken
+    uint32_t pin();
+    void unpin(uint32_t pin);
+
+    // defer deleter(ptr) until no reader can still hold ptr
+    void retire(void *ptr, Deleter deleter);
+
+    template<typename T>
+    void retireObject(T *obj)
+    {
+        retire(obj, [](void *ptr) { delete static_cast<T *>(ptr); });
+    }
+
+    // free whatever the calling thread has retired and is now safe; returns count freed
+    uint32_t reclaim();
+
+    uint64_t getEpoch() { return globalEpoch.load(); }
+    uint64_t getRetiredCount() { return retiredCount.load(); }
+    uint64_t getFreedCount() { return freedCount.load(); }
+
+    PROTECTED:
+    EpochManager();
+    ~EpochManager();
+
+    struct Retired {
+        void *ptr;
+        Deleter deleter;
+        uint64_t epoch;
+    };
+
+    struct ThreadRecord {
+        std::atomic<uint64_t> epoch{QUIESCENT};
+        std::atomic<bool> inUse{false};
+        uint32_t nesting = 0;
+        bool online = false;
+        std::vector<Retired> limbo;
+    } __attribute__((aligned(64)));
+
+    ThreadRecord* getRecord();
+    void releaseRecord(ThreadRecord *rec);
+    uint64_t minActiveEpoch();
+
+    std::atomic<uint64_t> globalEpoch{1};
+    std::atomic<uint32_t> highMark{0};
+    std::atomic<uint64_t> retiredCount{0};
+    std::atomic<uint64_t> freedCount{0};
+    std::atomic<uint32_t> pinMark{0};
+    ThreadRecord records[MAX_THREADS];
+    std::atomic<uint64_t> pins[MAX_PINS];
+
+    friend struct EpochRecordHolder;
+}; // end EpochManager class
+
+/**
+ * Keeps the calling thread registered (online) with the process-wide
+ * EpochManager for the lifetime of the object.
+ */
+class EpochThread {
+    PUBLIC:
+    EpochThread() { EpochManager::instance().registerThread(); }
+    ~EpochThread() { EpochManager::instance().unregisterThread(); }
+
+    PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(EpochThread);
+};
+
+/**
+ * Scoped read-side critical section on the process-wide EpochManager.
+ */
+class EpochGuard {
+    PUBLIC:
+    EpochGuard() : mgr(EpochManager::instance()) { mgr.enter(); }
+    ~EpochGuard() { mgr.exit(); }
+
+    PRIVATE:
+    EpochManager &mgr;
+    DISALLOW_COPY_AND_ASSIGN(EpochGuard);
+};
+
+} // end namespace QDB
+
+#endif  /* EPOCH_MANAGER_H */
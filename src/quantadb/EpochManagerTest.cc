@@ -0,0 +1,156 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "EpochManager.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static std::atomic<uint32_t> freedObjects{0};
+
+static void
+countingDeleter(void *ptr)
+{
+    delete (uint64_t *)ptr;
+    freedObjects++;
+}
+
+class EpochManagerTest : public ::testing::Test {
+  public:
+  EpochManagerTest() : epoch(EpochManager::instance())
+  {
+    epoch.reclaim(); // drain whatever other tests left on this thread
+    freedObjects = 0;
+  };
+  ~EpochManagerTest() {};
+
+  EpochManager &epoch;
+
+  DISALLOW_COPY_AND_ASSIGN(EpochManagerTest);
+};
+
+TEST_F(EpochManagerTest, retireWithoutReaders) {
+    epoch.retire(new uint64_t(1), countingDeleter);
+    epoch.retire(new uint64_t(2), countingDeleter);
+    EXPECT_EQ(epoch.reclaim(), 2u);
+    EXPECT_EQ(freedObjects.load(), 2u);
+    EXPECT_EQ(epoch.reclaim(), 0u);
+}
+
+TEST_F(EpochManagerTest, nestedGuard) {
+    {
+        EpochGuard outer;
+        {
+            EpochGuard inner;
+        }
+        // still pinned by the outer guard
+        epoch.retire(new uint64_t(1), countingDeleter);
+        EXPECT_EQ(epoch.reclaim(), 0u);
+    }
+    EXPECT_EQ(epoch.reclaim(), 1u);
+}
+
+TEST_F(EpochManagerTest, readerBlocksReclaim) {
+    std::atomic<int> step{0};
+    std::thread reader([&]() {
+        EpochGuard guard;
+        step = 1;
+        while (step.load() != 2)
+            std::this_thread::yield();
+    });
+    while (step.load() != 1)
+        std::this_thread::yield();
+
+    epoch.retire(new uint64_t(1), countingDeleter);
+    EXPECT_EQ(epoch.reclaim(), 0u);
+    EXPECT_EQ(freedObjects.load(), 0u);
+
+    step = 2;
+    reader.join();
+    EXPECT_EQ(epoch.reclaim(), 1u);
+    EXPECT_EQ(freedObjects.load(), 1u);
+}
+
+TEST_F(EpochManagerTest, retirerPinned) {
+    EpochGuard guard;
+    // the retiring thread's own critical section counts as a reader
+    epoch.retire(new uint64_t(1), countingDeleter);
+    EXPECT_EQ(epoch.reclaim(), 0u);
+    EXPECT_EQ(freedObjects.load(), 0u);
+}
+
+TEST_F(EpochManagerTest, pinOutlivesGuard) {
+    uint32_t pin = EpochManager::NO_PIN;
+    std::thread reader([&]() {
+        EpochGuard guard;
+        pin = epoch.pin();
+    });
+    reader.join();
+    ASSERT_TRUE(pin != EpochManager::NO_PIN);
+
+    // the reader has left, but its pin is released from this thread
+    epoch.retire(new uint64_t(1), countingDeleter);
+    EXPECT_EQ(epoch.reclaim(), 0u);
+    epoch.unpin(pin);
+    EXPECT_EQ(epoch.reclaim(), 1u);
+    EXPECT_EQ(freedObjects.load(), 1u);
+}
+
+TEST_F(EpochManagerTest, onlineThreadBlocksUntilQuiescent) {
+    std::atomic<int> step{0};
+    std::thread peer([&]() {
+        EpochThread online;
+        step = 1;
+        while (step.load() != 2)
+            std::this_thread::yield();
+        EpochManager::instance().quiescent();
+        step = 3;
+        while (step.load() != 4)
+            std::this_thread::yield();
+    });
+    while (step.load() != 1)
+        std::this_thread::yield();
+
+    epoch.retireObject(new uint64_t(1));
+    EXPECT_EQ(epoch.reclaim(), 0u);
+
+    step = 2;
+    while (step.load() != 3)
+        std::this_thread::yield();
+    // still online, but it has passed a quiescent state since the retirement
+    EXPECT_EQ(epoch.reclaim(), 1u);
+
+    step = 4;
+    peer.join();
+}
+
+TEST_F(EpochManagerTest, registerInsideGuard) {
+    EpochGuard guard;
+    epoch.retire(new uint64_t(1), countingDeleter);
+    {
+        // a loop function run inline under a guard, as testRun() does
+        EpochThread online;
+        epoch.quiescent();
+    }
+    EXPECT_EQ(epoch.reclaim(), 0u);
+    EXPECT_EQ(freedObjects.load(), 0u);
+}
+
+}  // namespace RAMCloud
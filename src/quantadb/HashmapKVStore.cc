@@ -26,24 +26,31 @@ namespace QDB {
 
 KVLayout* HashmapKVStore::preput(KVLayout &kvIn)
 {
-    //Fixme: need to allocate from a garbage-collecting pool and report any failure
-    KVLayout* kvOut = new KVLayout(kvIn.k.keyLength);
+    KVLayout* kvOut = preput(kvIn.k, kvIn.v.valueLength);
     if (kvOut == NULL)
         return NULL;
-    kvOut->k.setkey(kvIn.k.getkeybuf(), kvOut->k.keyLength, 0);
-    kvOut->v.valueLength = kvIn.v.valueLength;
-    if (kvIn.v.valueLength > 0) {
-        //Fixme: need to allocate from "persistent memory" and report any failure
-    	kvOut->v.valuePtr = new uint8_t[kvIn.v.valueLength];
-    	if (kvOut->v.valuePtr == NULL)
-    	    return NULL;
+    if (kvIn.v.valueLength > 0)
     	std::memcpy((void *)kvOut->v.valuePtr, (void *)kvIn.v.valuePtr, kvIn.v.valueLength);
-    }
     kvOut->v.meta = kvIn.v.meta;
     kvOut->v.isTombstone = kvIn.v.isTombstone;
     return kvOut;
 }
 
+KVLayout* HashmapKVStore::preput(KLayout &kIn, uint32_t valueLength)
+{
+    //Fixme: need to allocate from a garbage-collecting pool and report any failure
+    KVLayout* kvOut = new KVLayout(kIn.keyLength);
+    if (kvOut == NULL)
+        return NULL;
+    kvOut->k.setkey(kIn.getkeybuf(), kvOut->k.keyLength, 0);
+    kvOut->v.valueLength = valueLength;
+    if (valueLength > 0) {
+        //Fixme: need to allocate from "persistent memory"
+    	kvOut->v.valuePtr = ValueArena::instance().alloc(valueLength);
+    }
+    return kvOut;
+}
+
 bool HashmapKVStore::putNew(KVLayout *kv, __uint128_t cts, uint64_t pi)
 {
     kv->meta().cStamp = kv->meta().pStamp = cts >> 64;
@@ -52,6 +59,8 @@ bool HashmapKVStore::putNew(KVLayout *kv, __uint128_t cts, uint64_t pi)
     kv->meta().sStamp = (uint64_t) -1; //not overwritten yet
     if (kv->v.valuePtr == NULL || kv->v.valueLength == 0)
     	kv->v.isTombstone = true;
+    kv->v.version = NULL;
+    publishVersion(kv);
     elem_pointer<KVLayout> lptr = my_hashtable->put(kv->getKey(), kv);
     /*
      * Fixme! XXX
@@ -67,18 +76,89 @@ bool HashmapKVStore::putNew(KVLayout *kv, __uint128_t cts, uint64_t pi)
     return lptr.ptr_ != NULL;
 }
 
+bool HashmapKVStore::putRestored(KVLayout *kv)
+{
+    if (kv->v.valuePtr == NULL || kv->v.valueLength == 0)
+    	kv->v.isTombstone = true;
+    kv->v.version = NULL;
+    publishVersion(kv);
+    kv->v.version->sStamp = kv->meta().sStamp;
+    elem_pointer<KVLayout> lptr = my_hashtable->put(kv->getKey(), kv);
+    if (lptr.ptr_ == NULL) {
+        RAMCLOUD_LOG(ERROR,"pmemhash bucket full\n");
+        exit(1);
+    }
+    return true;
+}
+
 bool HashmapKVStore::put(KVLayout *kv, __uint128_t cts, uint64_t pi, uint8_t *valuePtr, uint32_t valueLength)
 {
     kv->meta().cStamp = kv->meta().pStamp = cts >> 64;
     kv->meta().pStampPrev = kv->meta().pStamp;
     kv->meta().sStampPrev = pi;
     kv->meta().sStamp = (uint64_t) -1; //not overwritten yet
-    if (kv->v.valuePtr)
-        delete kv->v.valuePtr;
+    if (kv->v.version)
+        kv->v.version->sStamp = pi;
+    //The old value buffer belongs to the old version; readers may still be
+    //copying it, so it is freed only when that version is retired.
     kv->v.valueLength = valueLength;
     kv->v.valuePtr = valuePtr;
-    if (valuePtr == NULL || valueLength == 0)
-    	kv->v.isTombstone = true;
+    kv->v.isTombstone = (valuePtr == NULL || valueLength == 0);
+    publishVersion(kv);
+    return true;
+}
+
+void
+HashmapKVStore::publishVersion(KVLayout *kv)
+{
+    VersionLayout *ver = new VersionLayout;
+    ver->valuePtr = kv->v.valuePtr;
+    ver->valueLength = kv->v.valueLength;
+    ver->isTombstone = kv->v.isTombstone;
+    ver->cStamp = kv->meta().cStamp;
+    ver->sStamp = (uint64_t) -1;
+    ver->prev = kv->v.version;
+    __atomic_store_n(&kv->v.version, ver, __ATOMIC_SEQ_CST);
+
+    //Only the committer of kv modifies the chain, so the walk needs no atomics;
+    //readers may still be on the cut-off tail, hence the retirement.
+    VersionLayout *last = ver;
+    for (uint32_t depth = 1; depth < MAX_VERSION_CHAIN && last->prev; depth++)
+        last = last->prev;
+    VersionLayout *tail = last->prev;
+    if (tail == NULL)
+        return;
+    __atomic_store_n(&last->prev, (VersionLayout *)NULL, __ATOMIC_SEQ_CST);
+    while (tail) {
+        VersionLayout *next = tail->prev;
+        EpochManager::instance().retire(tail, freeVersion);
+        tail = next;
+    }
+}
+
+void
+HashmapKVStore::freeVersion(void *ptr)
+{
+    VersionLayout *ver = (VersionLayout *)ptr;
+    ValueArena::instance().free(ver->valuePtr);
+    delete ver;
+}
+
+bool
+HashmapKVStore::getVersion(KVLayout *kv, VLayout &vOut, uint64_t asOf)
+{
+    VersionLayout *ver = __atomic_load_n(&kv->v.version, __ATOMIC_SEQ_CST);
+    while (ver && ver->cStamp > asOf)
+        ver = __atomic_load_n(&ver->prev, __ATOMIC_ACQUIRE);
+    if (ver == NULL)
+        return false;
+    vOut.valuePtr = ver->valuePtr;
+    vOut.valueLength = ver->valueLength;
+    vOut.isTombstone = ver->isTombstone;
+    vOut.meta.cStamp = ver->cStamp;
+    vOut.meta.sStamp = __atomic_load_n(&ver->sStamp, __ATOMIC_RELAXED);
+    vOut.meta.pStamp = __atomic_load_n(&kv->v.meta.pStamp, __ATOMIC_RELAXED);
+    vOut.version = ver;
     return true;
 }
 
@@ -21,6 +21,7 @@
 #include "clhash.h"
 #include "hash_map.h"
 #include "KVStore.h"
+#include "EpochManager.h"
 
 #define	ROUND_DOWN(n,p)			(n & ~(p-1))
 #define	ROUND_UP(n,p)			((n + p - 1) & ~(p - 1))
@@ -33,6 +34,9 @@ struct HashKLayout{
 
 #define MAX_KEYLEN  127
 
+/// number of committed versions kept reachable per key; older ones are retired
+#define MAX_VERSION_CHAIN 2
+
 class HashmapKVStore : public KVStore
 {
 public:
@@ -51,8 +55,19 @@ public:
         delete my_hashtable;
     }
     KVLayout* preput(KVLayout &kvIn);
+    /*
+     * Like preput(kvIn), but leaves the valueLength bytes at v.valuePtr for
+     * the caller to fill, e.g., straight out of an RPC payload.
+     */
+    KVLayout* preput(KLayout &kIn, uint32_t valueLength);
     bool putNew(KVLayout *kv, __uint128_t cts, uint64_t pi);
     bool put(KVLayout *kv, __uint128_t cts, uint64_t pi, uint8_t *valuePtr, uint32_t valueLength);
+    /*
+     * Lock-free snapshot of the latest version of kv committed at or before
+     * asOf. The value in vOut stays valid while the caller is inside an
+     * EpochGuard; meta.pStamp is the tuple's current pStamp.
+     */
+    bool getVersion(KVLayout *kv, VLayout &vOut, uint64_t asOf = (uint64_t)-1);
     KVLayout * fetch(KLayout& k);
     void * findKVSPtr(KLayout& k);
     inline KVLayout *fetch_by_KVSPtr(KLayout& k, void* kvsptr)
@@ -68,9 +83,25 @@ public:
     //bool getValue(KLayout& k, uint8_t *&valuePtr, uint32_t &valueLength);
     //bool getValue(KLayout& k, KVLayout *&kv);
     bool remove(KLayout& k, DSSNMeta &meta);
+    /*
+     * Add kv rebuilt from a checkpoint, keeping its meta. Distinct keys may be
+     * restored from several threads at once.
+     */
+    bool putRestored(KVLayout *kv);
+    /*
+     * Visit the KVs of buckets [first, last) while commits go on, for a fuzzy
+     * checkpoint; fn(KVLayout *) should read the value through getVersion()
+     * inside an EpochGuard.
+     */
+    template <typename F>
+    void forEach(uint32_t first, uint32_t last, F fn) { my_hashtable->for_each(first, last, fn); }
+    uint32_t getBucketCount() { return bucket_count; }
     uint32_t get_evict_count() { return my_hashtable->get_evict_count(); }
     uint32_t get_avg_elem_iter_len() { return my_hashtable->get_avg_elem_iter_len(); }
 private:
+    void publishVersion(KVLayout *kv);
+    static void freeVersion(void *ptr);
+
     hash_table<KVLayout, KLayout, VLayout, HashKLayout> * my_hashtable;
     uint32_t            bucket_count;
 };
@@ -13,6 +13,7 @@
  *  limitations under the License.
  */
 
+#include <thread>
 #include "TestUtil.h"
 #include "HashmapKVStore.h"
 #include "Cycles.h"
@@ -43,6 +44,24 @@ TEST_F(HashmapKVTest, preput) {
     delete kvOut;
 }
 
+TEST_F(HashmapKVTest, preputInPlace) {
+    const char *keystr = "HashmapKVTest-preputInPlace";
+    const char *valstr = "filled by the caller";
+    KLayout k(32);
+    k.setkey(keystr, strlen(keystr), 0);
+    KVLayout *kvOut = KVStore.preput(k, (uint32_t)strlen(valstr));
+    ASSERT_TRUE(kvOut != NULL);
+    EXPECT_EQ(0, std::memcmp(kvOut->k.getkeybuf(), k.getkeybuf(), k.keyLength));
+    EXPECT_EQ(strlen(valstr), kvOut->v.valueLength);
+    ASSERT_TRUE(kvOut->v.valuePtr != NULL);
+    std::memcpy(kvOut->v.valuePtr, valstr, strlen(valstr));
+    EXPECT_TRUE(KVStore.putNew(kvOut, 0, 0));
+    KVLayout *kv = KVStore.fetch(k);
+    ASSERT_TRUE(kv != NULL);
+    EXPECT_EQ(0, std::memcmp(kv->v.valuePtr, valstr, strlen(valstr)));
+    EXPECT_FALSE(kv->v.isTombstone);
+}
+
 TEST_F(HashmapKVTest, putNew) {
     int keySize = 32;
     const char *key = "HashmapKVTest-key-1";
@@ -128,4 +147,83 @@ TEST_F(HashmapKVTest, fetch) {
     GTEST_COUT << "HashmapKVwStore fetch passed!" << std::endl;
 }
 
+static uint8_t *
+makeValue(uint8_t fill, uint32_t len)
+{
+    uint8_t *val = ValueArena::instance().alloc(len);
+    memset(val, fill, len);
+    return val;
+}
+
+TEST_F(HashmapKVTest, versionChain) {
+    const char *key = "HashmapKVTest-version-key";
+    KVLayout *kv = new KVLayout(32);
+    kv->k.setkey(key, strlen(key), 0);
+    kv->v.valuePtr = makeValue(1, 16);
+    kv->v.valueLength = 16;
+    EXPECT_TRUE(KVStore.putNew(kv, (__uint128_t)1 << 64, 0));
+
+    VLayout v;
+    EXPECT_TRUE(KVStore.getVersion(kv, v));
+    EXPECT_EQ(v.meta.cStamp, 1u);
+    EXPECT_EQ(v.valuePtr[0], 1);
+    EXPECT_EQ(v.meta.sStamp, (uint64_t)-1);
+
+    EXPECT_TRUE(KVStore.put(kv, (__uint128_t)2 << 64, 5, makeValue(2, 32), 32));
+    EXPECT_TRUE(KVStore.getVersion(kv, v));
+    EXPECT_EQ(v.meta.cStamp, 2u);
+    EXPECT_EQ(v.valueLength, 32u);
+    EXPECT_EQ(v.valuePtr[31], 2);
+
+    // the overwritten version stays readable and carries the overwriter's pi
+    EXPECT_TRUE(KVStore.getVersion(kv, v, 1));
+    EXPECT_EQ(v.meta.cStamp, 1u);
+    EXPECT_EQ(v.valuePtr[15], 1);
+    EXPECT_EQ(v.meta.sStamp, 5u);
+
+    // a third commit pushes the first version off the chain
+    uint64_t retired = EpochManager::instance().getRetiredCount();
+    EXPECT_TRUE(KVStore.put(kv, (__uint128_t)3 << 64, 6, NULL, 0));
+    EXPECT_EQ(EpochManager::instance().getRetiredCount(), retired + 1);
+    EXPECT_FALSE(KVStore.getVersion(kv, v, 1));
+    EXPECT_TRUE(KVStore.getVersion(kv, v));
+    EXPECT_TRUE(v.isTombstone);
+    EXPECT_TRUE(KVStore.getVersion(kv, v, 2));
+    EXPECT_FALSE(v.isTombstone);
+}
+
+TEST_F(HashmapKVTest, concurrentReadDuringPut) {
+    const char *key = "HashmapKVTest-race-key";
+    KVLayout *kv = new KVLayout(32);
+    kv->k.setkey(key, strlen(key), 0);
+    kv->v.valuePtr = makeValue(0, 64);
+    kv->v.valueLength = 64;
+    KVStore.putNew(kv, 0, 0);
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> mismatches{0};
+    auto reader = [&]() {
+        while (!done.load()) {
+            EpochGuard guard;
+            VLayout v;
+            if (!KVStore.getVersion(kv, v))
+                continue;
+            // every version is filled with its own cStamp and sized from it
+            uint8_t fill = (uint8_t)v.meta.cStamp;
+            if (v.valueLength != 64 + (v.meta.cStamp % 64)
+                    || v.valuePtr[0] != fill || v.valuePtr[v.valueLength - 1] != fill)
+                mismatches++;
+        }
+    };
+    std::thread r1(reader), r2(reader);
+    for (uint64_t c = 1; c < 20000; c++) {
+        uint32_t len = 64 + (c % 64);
+        KVStore.put(kv, (__uint128_t)c << 64, 0, makeValue((uint8_t)c, len), len);
+    }
+    done = true;
+    r1.join();
+    r2.join();
+    EXPECT_EQ(mismatches.load(), 0u);
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,257 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "KVCheckpoint.h"
+#include "EpochManager.h"
+#include "Logger.h"
+
+using namespace RAMCloud;
+
+namespace QDB {
+
+// persist the entries of dir, e.g., a rename into it
+static bool
+syncDir(const std::string &dir)
+{
+    int dfd = open(dir.c_str(), O_RDONLY|O_DIRECTORY);
+    if (dfd < 0)
+        return false;
+    bool isOk = fsync(dfd) == 0;
+    close(dfd);
+    return isOk;
+}
+
+static void
+makeDir(const std::string &dir)
+{
+    for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)) {
+        mkdir(dir.substr(0, pos).c_str(), 0777);
+        if (pos == std::string::npos)
+            break;
+    }
+}
+
+KVCheckpoint::KVCheckpoint(std::string id)
+{
+    std::string dir(CHECKPOINT_DIR);
+    makeDir(dir);
+    path = dir + "/KVCheckpoint-" + (id.empty() ? "0" : id);
+}
+
+KVCheckpoint::~KVCheckpoint()
+{
+    if (base)
+        munmap(base, mapSize);
+    if (fd >= 0)
+        close(fd);
+}
+
+bool
+KVCheckpoint::reserve(uint64_t offset, uint64_t len)
+{
+    if (offset + len <= mapSize)
+        return true;
+    uint64_t size = ROUND_UP(offset + len, (uint64_t)CHECKPOINT_GROW_BYTES);
+    if (ftruncate(fd, size) != 0)
+        return false;
+    void *addr = base ? mremap(base, mapSize, size, MREMAP_MAYMOVE)
+            : mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return false;
+    base = (uint8_t *)addr;
+    mapSize = size;
+    return true;
+}
+
+bool
+KVCheckpoint::write(HashmapKVStore &kvStore, uint64_t id, __uint128_t cts)
+{
+    std::string tmpPath = path + ".tmp";
+    fd = open(tmpPath.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0) {
+        RAMCLOUD_LOG(ERROR, "failed to create %s: %s", tmpPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::vector<uint64_t> segments;
+    uint64_t offset = sizeof(Header);
+    uint64_t count = 0;
+    bool isOk = reserve(0, offset);
+    uint32_t bucketCount = kvStore.getBucketCount();
+    for (uint32_t bucket = 0; bucket < bucketCount && isOk; bucket += CHECKPOINT_BUCKET_BATCH) {
+        //short critical sections, so that reclamation is not held off for the whole walk
+        EpochGuard guard;
+        kvStore.forEach(bucket, bucket + CHECKPOINT_BUCKET_BATCH, [&](KVLayout *kv) {
+            VLayout v;
+            if (!isOk || !kvStore.getVersion(kv, v))
+                return;
+            uint32_t valueLength = v.isTombstone ? 0 : v.valueLength;
+            uint64_t len = recordSize(kv->k.keyLength, valueLength);
+            if (!reserve(offset, len)) {
+                isOk = false;
+                return;
+            }
+            if (count % CHECKPOINT_SEGMENT_RECORDS == 0)
+                segments.push_back(offset);
+
+            Record *rec = (Record *)(base + offset);
+            rec->keyLength = kv->k.keyLength;
+            rec->valueLength = valueLength;
+            rec->isTombstone = v.isTombstone;
+            rec->meta = kv->meta();
+            //the version snapshot is what matches the value
+            rec->meta.cStamp = v.meta.cStamp;
+            rec->meta.sStamp = v.meta.sStamp;
+            rec->meta.pStamp = v.meta.pStamp;
+            memcpy((uint8_t *)(rec + 1), kv->k.getkeybuf(), kv->k.keyLength);
+            if (valueLength > 0)
+                memcpy((uint8_t *)(rec + 1) + kv->k.keyLength, v.valuePtr, valueLength);
+            offset += len;
+            count++;
+        });
+    }
+
+    uint64_t tableOffset = offset;
+    uint64_t fileSize = tableOffset + segments.size() * sizeof(uint64_t);
+    isOk = isOk && reserve(tableOffset, fileSize - tableOffset);
+    if (isOk) {
+        if (!segments.empty())
+            memcpy(base + tableOffset, segments.data(), segments.size() * sizeof(uint64_t));
+        Header *hdr = (Header *)base;
+        hdr->sig = CHECKPOINT_SIG;
+        hdr->version = 1;
+        hdr->id = id;
+        hdr->cts = cts;
+        hdr->recordCount = count;
+        hdr->segmentCount = segments.size();
+        hdr->segmentTableOffset = tableOffset;
+        hdr->fileSize = fileSize;
+        isOk = msync(base, fileSize, MS_SYNC) == 0;
+    }
+    munmap(base, mapSize);
+    base = NULL;
+    mapSize = 0;
+    isOk = isOk && ftruncate(fd, fileSize) == 0 && fdatasync(fd) == 0;
+    close(fd);
+    fd = -1;
+
+    if (!isOk || rename(tmpPath.c_str(), path.c_str()) != 0
+            || !syncDir(path.substr(0, path.rfind('/')))) {
+        RAMCLOUD_LOG(ERROR, "failed to write checkpoint %s: %s", path.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    recordCount = count;
+    bytes = fileSize;
+    return true;
+}
+
+void
+KVCheckpoint::loadSegments(HashmapKVStore &kvStore, const uint8_t *map, uint32_t first, uint32_t step,
+        std::atomic<bool> &isOk)
+{
+    const Header *hdr = (const Header *)map;
+    const uint64_t *segments = (const uint64_t *)(map + hdr->segmentTableOffset);
+    for (uint64_t seg = first; seg < hdr->segmentCount && isOk; seg += step) {
+        uint64_t end = (seg + 1 < hdr->segmentCount) ? segments[seg + 1] : hdr->segmentTableOffset;
+        for (uint64_t offset = segments[seg]; offset < end; ) {
+            const Record *rec = (const Record *)(map + offset);
+            const uint8_t *key = (const uint8_t *)(rec + 1);
+            KVLayout *kv = new KVLayout(rec->keyLength);
+            kv->k.setkey(key, rec->keyLength, 0);
+            if (rec->valueLength > 0) {
+                kv->v.valuePtr = ValueArena::instance().alloc(rec->valueLength);
+                if (kv->v.valuePtr == NULL) {
+                    RAMCLOUD_LOG(ERROR, "no memory for a value of %u bytes", rec->valueLength);
+                    delete kv;
+                    isOk = false;
+                    return;
+                }
+                memcpy(kv->v.valuePtr, key + rec->keyLength, rec->valueLength);
+            }
+            kv->v.valueLength = rec->valueLength;
+            kv->v.meta = rec->meta;
+            kv->v.isTombstone = rec->isTombstone;
+            kvStore.putRestored(kv);
+            offset += recordSize(rec->keyLength, rec->valueLength);
+        }
+    }
+}
+
+bool
+KVCheckpoint::load(HashmapKVStore &kvStore, uint32_t nThreads, uint64_t &id, __uint128_t &cts)
+{
+    int rfd = open(path.c_str(), O_RDONLY);
+    if (rfd < 0)
+        return false;
+    struct stat st;
+    if (fstat(rfd, &st) != 0 || (uint64_t)st.st_size < sizeof(Header)) {
+        close(rfd);
+        return false;
+    }
+    uint64_t size = st.st_size;
+    void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, rfd, 0);
+    close(rfd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    const uint8_t *map = (const uint8_t *)addr;
+    const Header *hdr = (const Header *)map;
+    if (hdr->sig != CHECKPOINT_SIG || hdr->version != 1 || hdr->fileSize != size
+            || hdr->segmentTableOffset + hdr->segmentCount * sizeof(uint64_t) != size) {
+        RAMCLOUD_LOG(ERROR, "ignoring malformed checkpoint %s", path.c_str());
+        munmap(addr, size);
+        return false;
+    }
+
+    std::atomic<bool> isOk(true);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < nThreads; i++)
+        threads.push_back(std::thread(&KVCheckpoint::loadSegments, std::ref(kvStore), map, i, nThreads,
+                std::ref(isOk)));
+    loadSegments(kvStore, map, 0, std::max(nThreads, 1u), isOk);
+    for (auto &t : threads)
+        t.join();
+    if (!isOk) {
+        RAMCLOUD_LOG(ERROR, "failed to load checkpoint %s", path.c_str());
+        munmap(addr, size);
+        return false;
+    }
+
+    id = hdr->id;
+    cts = hdr->cts;
+    recordCount = hdr->recordCount;
+    bytes = size;
+    munmap(addr, size);
+    return true;
+}
+
+void
+KVCheckpoint::clear()
+{
+    unlink(path.c_str());
+    unlink((path + ".tmp").c_str());
+}
+
+} // end namespace QDB
@@ -0,0 +1,110 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef KV_CHECKPOINT_H
+#define KV_CHECKPOINT_H
+
+#include <atomic>
+#include <string>
+#include "Common.h"
+#include "HashmapKVStore.h"
+#include "TxLog.h"
+
+namespace QDB {
+
+/**
+ * Checkpoint of the KV store (key, latest value, DSSNMeta) in a memory-mapped
+ * file, so that a restart loads the tuples instead of replaying the TxLog
+ * history.
+ *
+ * A checkpoint is fuzzy: write() walks the hash buckets while commits go on,
+ * and a tuple is saved as of whenever its bucket was visited. The validator
+ * therefore tags the TxLog with a marker before the walk and, on recovery,
+ * replays the committed txs logged after the marker on top of the loaded
+ * tuples, newer cStamp winning.
+ *
+ * The file is written under a temporary name and renamed once complete, and
+ * the directory synced, so a crash while writing leaves the previous
+ * checkpoint in place. Records are
+ * grouped into segments of CHECKPOINT_SEGMENT_RECORDS, listed in a table at
+ * the end of the file, which load() hands out to its threads.
+ */
+class KVCheckpoint {
+    //next to the TxLog chunks, as durable as the log that is trimmed behind it
+    #define CHECKPOINT_DIR TXLOG_DIR "/checkpoint"
+    #define CHECKPOINT_SEGMENT_RECORDS (64*1024)
+    #define CHECKPOINT_GROW_BYTES (64*1024*1024)
+    #define CHECKPOINT_BUCKET_BATCH 1024 //buckets walked per epoch critical section
+    PUBLIC:
+    KVCheckpoint(std::string id = "");
+    ~KVCheckpoint();
+
+    // save the tuples of kvStore, tagged with the TxLog marker id and the CTS at the start
+    bool write(HashmapKVStore &kvStore, uint64_t id, __uint128_t cts);
+
+    // load the last complete checkpoint into kvStore using nThreads threads; false if there is none
+    // or it fails to load
+    bool load(HashmapKVStore &kvStore, uint32_t nThreads, uint64_t &id, __uint128_t &cts);
+
+    // remove the checkpoint files
+    void clear();
+
+    // of the last write() or load()
+    inline uint64_t getRecordCount() { return recordCount; }
+    inline uint64_t getBytes() { return bytes; }
+
+    PROTECTED:
+    struct Header {
+        #define CHECKPOINT_SIG 0x51444243 //"QDBC"
+        uint32_t sig;
+        uint32_t version;
+        uint64_t id;            // TxLog marker the replay starts after
+        __uint128_t cts;        // CTS when the checkpoint started
+        uint64_t recordCount;
+        uint64_t segmentCount;
+        uint64_t segmentTableOffset; // uint64_t offsets of the segments
+        uint64_t fileSize;
+    } __attribute__((packed));
+
+    // followed by the key and the value, padded to 8 bytes
+    struct Record {
+        DSSNMeta meta;
+        uint32_t keyLength;
+        uint32_t valueLength;
+        bool isTombstone;
+    };
+    static inline uint64_t recordSize(uint32_t keyLength, uint32_t valueLength) {
+        return ROUND_UP(sizeof(Record) + keyLength + valueLength, 8ul);
+    }
+
+    // make the mapping of the file being written cover [0, offset + len); false on failure
+    bool reserve(uint64_t offset, uint64_t len);
+    // restore every step-th segment from first; clears isOk on failure, and stops once it is clear
+    static void loadSegments(HashmapKVStore &kvStore, const uint8_t *map, uint32_t first, uint32_t step,
+            std::atomic<bool> &isOk);
+
+    std::string path;
+    int fd = -1;
+    uint8_t *base = NULL;
+    uint64_t mapSize = 0;
+    uint64_t recordCount = 0;
+    uint64_t bytes = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(KVCheckpoint);
+}; // end KVCheckpoint class
+
+} // end namespace QDB
+
+#endif  /* KV_CHECKPOINT_H */
@@ -0,0 +1,155 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "KVCheckpoint.h"
+#include "Cycles.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+//the default table is too big for running several stores side by side
+#define TEST_BUCKET_COUNT (64*1024)
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+class KVCheckpointTest : public ::testing::Test {
+  public:
+  KVCheckpointTest() : checkpoint("test") { checkpoint.clear(); };
+  ~KVCheckpointTest() { checkpoint.clear(); };
+
+  KVCheckpoint checkpoint;
+
+  DISALLOW_COPY_AND_ASSIGN(KVCheckpointTest);
+};
+
+static KVLayout *
+makeKV(uint32_t idx, uint8_t fill, uint32_t len)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "KVCheckpointTest-key-%06u", idx);
+    KVLayout *kv = new KVLayout(32);
+    kv->k.setkey(key, strlen(key), 0);
+    if (len > 0) {
+        kv->v.valuePtr = ValueArena::instance().alloc(len);
+        memset(kv->v.valuePtr, fill, len);
+    }
+    kv->v.valueLength = len;
+    return kv;
+}
+
+TEST_F(KVCheckpointTest, noCheckpoint) {
+    HashmapKVStore kvStore(TEST_BUCKET_COUNT);
+    uint64_t id = 0;
+    __uint128_t cts = 0;
+    EXPECT_FALSE(checkpoint.load(kvStore, 2, id, cts));
+}
+
+TEST_F(KVCheckpointTest, writeLoad) {
+    //more than a segment, so that the loader threads share the work
+    const uint32_t n = CHECKPOINT_SEGMENT_RECORDS + 1000;
+    HashmapKVStore kvStore(TEST_BUCKET_COUNT);
+    for (uint32_t i = 0; i < n; i++) {
+        //every 10th key is a tombstone
+        KVLayout *kv = makeKV(i, (uint8_t)i, (i % 10 == 0) ? 0 : 1 + i % 100);
+        kvStore.putNew(kv, (__uint128_t)(i + 1) << 64, 0);
+        kv->meta().pStamp = i + 2;
+    }
+    EXPECT_TRUE(checkpoint.write(kvStore, 77, (__uint128_t)5 << 64));
+    EXPECT_EQ(n, checkpoint.getRecordCount());
+    GTEST_COUT << "checkpoint bytes: " << checkpoint.getBytes() << std::endl;
+
+    HashmapKVStore restored(TEST_BUCKET_COUNT);
+    uint64_t id = 0;
+    __uint128_t cts = 0;
+    uint64_t start = Cycles::rdtsc();
+    EXPECT_TRUE(checkpoint.load(restored, 4, id, cts));
+    GTEST_COUT << "load " << n << " KVs: "
+            << Cycles::toNanoseconds(Cycles::rdtsc() - start) / 1000 << " usec" << std::endl;
+    EXPECT_EQ(77u, id);
+    EXPECT_TRUE(cts == (__uint128_t)5 << 64);
+    EXPECT_EQ(n, checkpoint.getRecordCount());
+
+    for (uint32_t i = 0; i < n; i++) {
+        KVLayout *key = makeKV(i, 0, 0);
+        KVLayout *kv = restored.fetch(key->k);
+        delete key;
+        ASSERT_TRUE(kv != NULL);
+        EXPECT_EQ(i + 1, kv->meta().cStamp);
+        EXPECT_EQ(i + 2, kv->meta().pStamp);
+        VLayout v;
+        EXPECT_TRUE(restored.getVersion(kv, v));
+        EXPECT_EQ(i + 1, v.meta.cStamp);
+        if (i % 10 == 0) {
+            EXPECT_TRUE(v.isTombstone);
+        } else {
+            EXPECT_FALSE(v.isTombstone);
+            EXPECT_EQ(1 + i % 100, v.valueLength);
+            EXPECT_EQ((uint8_t)i, v.valuePtr[0]);
+            EXPECT_EQ((uint8_t)i, v.valuePtr[v.valueLength - 1]);
+        }
+    }
+}
+
+TEST_F(KVCheckpointTest, MtWriteWhilePutting) {
+    const uint32_t n = 10000;
+    HashmapKVStore kvStore(TEST_BUCKET_COUNT);
+    std::vector<KVLayout *> kvs;
+    for (uint32_t i = 0; i < n; i++) {
+        kvs.push_back(makeKV(i, 1, 64));
+        kvStore.putNew(kvs.back(), (__uint128_t)1 << 64, 0);
+    }
+
+    //each value is filled with its own cStamp, so a torn record shows up on load
+    std::atomic<bool> isDone(false);
+    std::thread writer([&]() {
+        EpochThread epochThread;
+        for (uint64_t c = 2; !isDone.load(); c++) {
+            uint32_t len = 64 + c % 64;
+            uint8_t *val = ValueArena::instance().alloc(len);
+            memset(val, (uint8_t)c, len);
+            kvStore.put(kvs[c % n], (__uint128_t)c << 64, 0, val, len);
+            if (c % 1024 == 0)
+                EpochManager::instance().quiescent();
+        }
+    });
+    for (uint32_t round = 0; round < 5; round++)
+        EXPECT_TRUE(checkpoint.write(kvStore, round, 0));
+    isDone = true;
+    writer.join();
+
+    HashmapKVStore restored(TEST_BUCKET_COUNT);
+    uint64_t id = 0;
+    __uint128_t cts = 0;
+    EXPECT_TRUE(checkpoint.load(restored, 3, id, cts));
+    EXPECT_EQ(4u, id);
+    EXPECT_EQ(n, checkpoint.getRecordCount());
+    uint64_t mismatches = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        KVLayout *kv = restored.fetch(kvs[i]->k);
+        ASSERT_TRUE(kv != NULL);
+        VLayout v;
+        EXPECT_TRUE(restored.getVersion(kv, v));
+        uint8_t fill = (uint8_t)v.meta.cStamp;
+        uint32_t len = v.meta.cStamp == 1 ? 64 : 64 + v.meta.cStamp % 64;
+        if (v.valueLength != len || v.valuePtr[0] != fill || v.valuePtr[len - 1] != fill)
+            mismatches++;
+    }
+    EXPECT_EQ(0u, mismatches);
+}
+
+}  // namespace RAMCloud
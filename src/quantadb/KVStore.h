@@ -21,6 +21,7 @@
 #include "MemStreamIo.h"
 #include <boost/scoped_array.hpp>
 #include "Slab.h"
+#include "ValueArena.h"
 
 namespace QDB {
 
@@ -42,6 +43,21 @@ struct DSSNMeta {
 	}
 };
 
+/*
+ * One committed version of a tuple value. A version is immutable once it is
+ * published, except for sStamp which is set once when the version gets
+ * overwritten. Newer versions are prepended, so a reader that loads the chain
+ * head always sees a matching value, length and cStamp without locking.
+ */
+struct VersionLayout {
+	uint8_t *valuePtr;
+	uint32_t valueLength;
+	bool isTombstone;
+	uint64_t cStamp;
+	uint64_t sStamp;
+	VersionLayout *prev; //next older version, or NULL
+};
+
 struct VLayout {
 	uint32_t valueLength = 0;
 	union {
@@ -50,6 +66,7 @@ struct VLayout {
 	};
 	DSSNMeta meta;
 	bool isTombstone = false;
+	VersionLayout *version = NULL; //version chain head, maintained by the KV store
     VLayout() {
         valuePtr = NULL;
     }
@@ -71,7 +88,7 @@ struct VLayout {
     {
         in.read(&valueLength, sizeof(valueLength));
         if (valueLength > 0) {
-            valuePtr = (uint8_t*)malloc(valueLength);
+            valuePtr = ValueArena::instance().alloc(valueLength);
             in.read(valuePtr, valueLength);
         } else 
             valuePtr = NULL;
@@ -250,6 +267,13 @@ class KVStore {
      */
     KVLayout* preput(KVLayout &kvIn);
 
+    /*
+     * Same as above, except that only the key is copied. The returned tuple has
+     * valueLength bytes of KVStore-managed memory at v.valuePtr for the caller
+     * to fill in place, which saves staging the value in a contiguous buffer first.
+     */
+    KVLayout* preput(KLayout &kIn, uint32_t valueLength);
+
     /*
      * The caller provides k.keyLength and k.key.
      * If the tuple exists in KV store, the stored KVLayout pointer is returned,
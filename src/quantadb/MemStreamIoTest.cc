@@ -82,7 +82,7 @@ TEST_F(MemStreamIoTest, MemStreamIoUnitTest)
     TxEntry tx1(1, WRITESET_SIZE), tx2(1, 1);
 
     char kbuf[30];
-    // KVLayout **writeSet = tx1.getWriteSet().get();
+    // KVLayout **writeSet = tx1.getWriteSet();
     for (uint32_t idx = 0; idx < WRITESET_SIZE; idx++) {
         KVLayout kvbuf(30);
         sprintf(kbuf, "MemStreamIoTestKey-%d", idx);
@@ -113,8 +113,8 @@ TEST_F(MemStreamIoTest, MemStreamIoUnitTest)
     EXPECT_EQ(tx1.getWriteSetSize(), tx2.getWriteSetSize());
 
 
-    KVLayout **writeSet1 = tx1.getWriteSet().get();
-    KVLayout **writeSet2 = tx2.getWriteSet().get();
+    KVLayout **writeSet1 = tx1.getWriteSet();
+    KVLayout **writeSet2 = tx2.getWriteSet();
 
     for(uint32_t idx = 0; idx < tx2.getWriteSetSize(); idx++) {
         KVLayout *kv1 = writeSet1[idx],
@@ -129,4 +129,57 @@ TEST_F(MemStreamIoTest, MemStreamIoUnitTest)
     EXPECT_EQ(tx1.getPeerSet(), tx2.getPeerSet());
 }
 
+TEST_F(MemStreamIoTest, TxEntryLayout)
+{
+    uint8_t *valstr = const_cast<uint8_t *>((const uint8_t*)"MemStreamIoTestValue");
+    char kbuf[30];
+
+    // past the inline tuples, with every key twice in the write set
+    #define LARGE_SET_SIZE 24
+    TxEntry *tx1 = new TxEntry(LARGE_SET_SIZE, LARGE_SET_SIZE);
+    for (uint32_t idx = 0; idx < LARGE_SET_SIZE; idx++) {
+        KVLayout kvbuf(30);
+        sprintf(kbuf, "TxEntryLayoutKey-%d", idx / 2);
+        kvbuf.k.setkey(kbuf, strlen(kbuf), 0);
+        kvbuf.v.valuePtr = valstr;
+        kvbuf.v.valueLength = strlen((char *)valstr);
+        tx1->insertWriteSet(kvStore.preput(kvbuf), idx);
+    }
+    for (uint32_t idx = 0; idx < LARGE_SET_SIZE; idx++) {
+        EXPECT_EQ(idx % 2 == 1, tx1->isWriteTupleSkipLock(idx));
+        EXPECT_EQ(tx1->getWriteSet()[idx]->k.getKeyHash(), tx1->getWriteSetHash()[idx]);
+        EXPECT_TRUE(tx1->getWriteSetInStore()[idx] == NULL);
+        EXPECT_TRUE(tx1->getReadSet()[idx] == NULL);
+    }
+
+    // kept in order, without duplicates, past the inline peers
+    uint64_t peers[] = {9, 3, 12, 1, 3, 7, 10, 2, 11, 5, 4};
+    for (uint64_t peer : peers)
+        tx1->insertPeerSet(peer);
+    std::vector<uint64_t> sorted(tx1->getParticipantSet().begin(), tx1->getParticipantSet().end());
+    EXPECT_EQ(std::vector<uint64_t>({1, 2, 3, 4, 5, 7, 9, 10, 11, 12}), sorted);
+
+    tx1->correctReadSet(0);
+    outMemStream out(buf, sizeof(buf));
+    tx1->serialize(out);
+    EXPECT_EQ(out.dsize(), tx1->serializeSize());
+
+    // a scan entry takes the sizes of the record
+    TxEntry tx2(1, 1);
+    inMemStream in(buf, out.dsize());
+    tx2.deSerialize(in);
+    EXPECT_EQ((uint32_t)LARGE_SET_SIZE, tx2.getWriteSetSize());
+    EXPECT_EQ(0u, tx2.getReadSetSize());
+    for (uint32_t idx = 0; idx < LARGE_SET_SIZE; idx++)
+        EXPECT_EQ(tx1->getWriteSet()[idx]->k, tx2.getWriteSet()[idx]->k);
+    std::vector<uint64_t> sorted2(tx2.getParticipantSet().begin(), tx2.getParticipantSet().end());
+    EXPECT_EQ(sorted, sorted2);
+
+    // freed objects are reused by the thread
+    delete tx1;
+    TxEntry *tx3 = new TxEntry(1, 1);
+    EXPECT_EQ(tx1, tx3);
+    delete tx3;
+}
+
 }  // namespace RAMCloud
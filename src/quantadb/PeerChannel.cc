@@ -0,0 +1,202 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Cycles.h"
+#include "FailSession.h"
+#include "ServerList.h"
+#include "PeerChannel.h"
+
+namespace QDB {
+
+PeerChannel::PeerChannel(Context *context)
+    : context(context)
+{
+    flusherThread = new std::thread(&PeerChannel::flusher, this);
+}
+
+PeerChannel::~PeerChannel()
+{
+    isAlive = false;
+    {
+        std::lock_guard<std::mutex> lock(idleLock);
+        idleCond.notify_one();
+    }
+    flusherThread->join();
+    delete flusherThread;
+    flushDue(true);
+    reap(true);
+    for (auto it = outboxes.begin(); it != outboxes.end(); it++)
+        delete it->second;
+}
+
+PeerChannel::BatchRpc::BatchRpc(Context* context, Transport::SessionRef session,
+        uint64_t sender, const Record *records, uint32_t count)
+    : RpcWrapper(0, NULL, false)
+{
+    WireFormat::DSSNInfoBatchAsync::Request* reqHdr(
+            allocHeader<WireFormat::DSSNInfoBatchAsync>(WireFormat::DSSNInfoBatchAsync::opcode));
+    reqHdr->length = sizeof32(WireFormat::DSSNInfoBatchAsync::Request)
+            - sizeof32(WireFormat::Notification::Request) + count * sizeof32(Record);
+    reqHdr->senderPeerId = sender;
+    reqHdr->count = count;
+    request.appendCopy(records, count * sizeof32(Record));
+    this->session = session;
+    send();
+}
+
+PeerChannel::Outbox *
+PeerChannel::getOutbox(uint64_t target)
+{
+    auto it = outboxes.find(target);
+    if (it != outboxes.end())
+        return it->second;
+
+    std::lock_guard<std::mutex> lock(outboxesLock);
+    it = outboxes.find(target);
+    if (it != outboxes.end())
+        return it->second;
+    Outbox *box = new Outbox;
+    box->target = target;
+    outboxes.insert(std::make_pair(target, box));
+    return box;
+}
+
+void
+PeerChannel::post(uint64_t target, uint64_t sender, const Record &record)
+{
+    Outbox *box = getOutbox(target);
+    bool isFull = false;
+    bool isFirst = false;
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(box->lock);
+        box->sender = sender;
+        if (box->records.empty()) {
+            box->oldestTsc = Cycles::rdtsc();
+            isFirst = true;
+        }
+        box->records.push_back(record);
+        isFull = box->records.size() >= PEER_CHANNEL_BATCH;
+    }
+    postedCount++;
+
+    if (isFull) {
+        sendOutbox(box);
+    } else if (isFirst) {
+        //the flusher may be asleep with nothing to time
+        std::lock_guard<std::mutex> lock(idleLock);
+        isWoken = true;
+        idleCond.notify_one();
+    }
+}
+
+void
+PeerChannel::send(uint64_t target, uint64_t sender, std::vector<Record> &records)
+{
+    pending -= records.size();
+    if (!context->serverList) {
+        RAMCLOUD_LOG(ERROR, "the serverList is not initialized");
+        return;
+    }
+    Transport::SessionRef session = context->serverList->getSession(ServerId(target));
+    if (session == FailSession::get()) {
+        RAMCLOUD_LOG(ERROR, "can't locate participate server id: %lu", target);
+        droppedCount += records.size();
+        return;
+    }
+    BatchRpc *rpc = new BatchRpc(context, session, sender, records.data(), downCast<uint32_t>(records.size()));
+    rpcCount++;
+    std::lock_guard<std::mutex> lock(inflightLock);
+    inflight.push_back(rpc);
+}
+
+void
+PeerChannel::sendOutbox(Outbox *box)
+{
+    //a batch taken out later must not overtake this one
+    std::lock_guard<std::mutex> sendLock(box->sendLock);
+    std::vector<Record> records;
+    uint64_t sender;
+    {
+        std::lock_guard<std::mutex> lock(box->lock);
+        records.swap(box->records);
+        box->oldestTsc = 0;
+        sender = box->sender;
+    }
+    if (!records.empty())
+        send(box->target, sender, records);
+}
+
+uint64_t
+PeerChannel::flushDue(bool isAll)
+{
+    uint64_t waitNs = UINT64_MAX;
+    uint64_t flushDelay = flushDelayNs.load();
+    uint64_t now = Cycles::rdtsc();
+    for (auto it = outboxes.begin(); it != outboxes.end(); it++) {
+        Outbox *box = it->second;
+        uint64_t oldest = box->oldestTsc.load();
+        if (oldest == 0)
+            continue;
+        uint64_t age = Cycles::toNanoseconds(now - oldest);
+        if (!isAll && age < flushDelay) {
+            waitNs = std::min(waitNs, flushDelay - age);
+            continue;
+        }
+        sendOutbox(box);
+    }
+    return waitNs;
+}
+
+void
+PeerChannel::reap(bool isAll)
+{
+    std::lock_guard<std::mutex> lock(inflightLock);
+    uint32_t kept = 0;
+    for (BatchRpc *rpc : inflight) {
+        if (isAll || rpc->isReady())
+            delete rpc; //an unfinished one is canceled
+        else
+            inflight[kept++] = rpc;
+    }
+    inflight.resize(kept);
+}
+
+void
+PeerChannel::flusher()
+{
+    while (isAlive) {
+        uint64_t waitNs = flushDue(false);
+        reap(false);
+
+        {
+            //the transport does not tell when it is done, so poll while anything is out
+            std::lock_guard<std::mutex> lock(inflightLock);
+            if (!inflight.empty())
+                waitNs = std::min<uint64_t>(waitNs, PEER_CHANNEL_REAP_NS);
+        }
+        if (waitNs != UINT64_MAX)
+            waitNs = std::min<uint64_t>(waitNs, PEER_CHANNEL_IDLE_NS); //look at the flush delay again
+        std::unique_lock<std::mutex> lock(idleLock);
+        auto isWake = [this] { return isWoken || !isAlive; };
+        if (waitNs == UINT64_MAX)
+            idleCond.wait(lock, isWake);
+        else
+            idleCond.wait_for(lock, std::chrono::nanoseconds(waitNs), isWake);
+        isWoken = false;
+    }
+}
+
+} // end namespace QDB
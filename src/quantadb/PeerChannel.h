@@ -0,0 +1,118 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef PEER_CHANNEL_H
+#define PEER_CHANNEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Context.h"
+#include "RpcWrapper.h"
+#include "WireFormat.h"
+#include "tbb/concurrent_unordered_map.h"
+
+namespace QDB {
+using namespace RAMCloud;
+
+/**
+ * Outbound SSN info channel to the validator peers.
+ *
+ * Sending SSN info or a request for it used to be one blocking notification
+ * per peer per tx. Instead, post() appends a record to the outbox of the
+ * destination and returns. The records of an outbox go out together in one
+ * DSSNInfoBatchAsync notification once PEER_CHANNEL_BATCH of them are there,
+ * sent by the posting thread, or once the oldest has waited
+ * PEER_CHANNEL_FLUSH_NS, sent by the flusher thread. No thread waits for a
+ * notification to go out; the flusher reaps them once the transport is done,
+ * checking every PEER_CHANNEL_REAP_NS while any are out. The flusher sleeps
+ * until the next outbox is due otherwise. The sends of an outbox are
+ * serialized, so the batches for a peer go out in posting order. The records
+ * for a peer without a session are dropped.
+ */
+class PeerChannel {
+    #define PEER_CHANNEL_BATCH 64
+    #define PEER_CHANNEL_FLUSH_NS 10000
+    #define PEER_CHANNEL_REAP_NS 50000
+    #define PEER_CHANNEL_IDLE_NS 1000000
+    PUBLIC:
+    typedef WireFormat::DSSNInfoBatchAsync::Record Record;
+
+    PeerChannel(Context *context);
+    ~PeerChannel();
+
+    // queue a record for peer 'target' on behalf of peer 'sender'
+    void post(uint64_t target, uint64_t sender, const Record &record);
+
+    inline void setFlushDelay(uint64_t ns) { flushDelayNs = ns; }
+    inline uint64_t getPostedCount() { return postedCount.load(); }
+    inline uint64_t getRpcCount() { return rpcCount.load(); }
+    inline uint64_t getDroppedCount() { return droppedCount.load(); }
+
+    PROTECTED:
+    // records bound for one peer
+    struct Outbox {
+        std::mutex lock;
+        std::mutex sendLock; //taken before lock, held from taking the records to sending them
+        uint64_t target;
+        uint64_t sender = 0;
+        std::vector<Record> records;
+        std::atomic<uint64_t> oldestTsc{0}; //posting time of the oldest record; 0 if none
+    };
+
+    // one coalesced notification, alive until the transport is done with it
+    class BatchRpc : public RpcWrapper {
+      public:
+        BatchRpc(Context* context, Transport::SessionRef session,
+                uint64_t sender, const Record *records, uint32_t count);
+      private:
+        DISALLOW_COPY_AND_ASSIGN(BatchRpc);
+    };
+
+    Outbox * getOutbox(uint64_t target);
+    void send(uint64_t target, uint64_t sender, std::vector<Record> &records);
+    // send whatever the outbox holds
+    void sendOutbox(Outbox *box);
+    // send the outboxes due, all if isAll; return the ns until the next one is due, UINT64_MAX if none
+    uint64_t flushDue(bool isAll);
+    void reap(bool isAll);
+    void flusher();
+
+    Context *context;
+    tbb::concurrent_unordered_map<uint64_t, Outbox *> outboxes;
+    std::mutex outboxesLock; //serializes the creation of outboxes
+    std::mutex inflightLock;
+    std::vector<BatchRpc *> inflight;
+
+    std::thread *flusherThread;
+    std::atomic<bool> isAlive{true};
+    std::atomic<uint64_t> pending{0}; //records posted but not yet sent
+    std::mutex idleLock;
+    std::condition_variable idleCond;
+    bool isWoken = false; //under idleLock: a first record was posted
+    std::atomic<uint64_t> flushDelayNs{PEER_CHANNEL_FLUSH_NS};
+
+    std::atomic<uint64_t> postedCount{0};
+    std::atomic<uint64_t> rpcCount{0};
+    std::atomic<uint64_t> droppedCount{0};
+
+    DISALLOW_COPY_AND_ASSIGN(PeerChannel);
+}; // end PeerChannel class
+
+} // end namespace QDB
+
+#endif  /* PEER_CHANNEL_H */
@@ -0,0 +1,224 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef PEER_ENTRY_TABLE_H
+#define PEER_ENTRY_TABLE_H
+
+#include <atomic>
+#include "Common.h"
+#include "CtsHash.h"
+#include "TxEntry.h"
+#include "EpochManager.h"
+
+namespace QDB {
+
+typedef __uint128_t CTS;
+
+struct PeerEntry {
+    CTS cts = 0;
+    bool isConcluded = true;
+    uint64_t peerSeenSet; //peers seen so far
+    uint64_t peerAlertSet; //peers seen currently in alert state
+    uint32_t peerTxState = TxEntry::TX_PENDING; //summary state of all seen peers
+    DSSNMeta meta; //summary of pstamp and sstamp of all seen peers
+    TxEntry *txEntry = NULL; //reference to the associated commit intent
+
+    // deadline list linkage, see PeerEntryTable
+    uint64_t deadline = 0;
+    PeerEntry *prev = NULL;
+    PeerEntry *next = NULL;
+    bool isArmed = false;
+
+    inline bool isExclusionViolated() { return meta.sStamp <= meta.pStamp; }
+};
+
+#define PEER_ENTRY_TOMBSTONE ((PeerEntry *)1)
+
+/**
+ * Table of the PeerEntries of one peer thread, keyed by CTS.
+ *
+ * The table is open-addressed with linear probing. Once live entries and
+ * tombstones fill 3/4 of it, it is rehashed, to twice the size if more than
+ * half is live, so the number of txs in flight is not capped.
+ *
+ * The owning peer thread is the only writer. Other threads may find()
+ * without a lock from within an epoch critical section: a grown table and
+ * removed entries are freed through the EpochManager.
+ *
+ * An entry may also be armed with a deadline. Armed entries are kept on an
+ * intrusive list ordered by deadline, so popDue() touches the overdue entries
+ * only, however many are in flight. The list is private to the owner.
+ */
+class PeerEntryTable {
+    PUBLIC:
+    static const uint64_t INIT_SLOTS = 1024;
+
+    PeerEntryTable() {
+        slots = new Slots(INIT_SLOTS);
+    }
+
+    ~PeerEntryTable() {
+        Slots *s = slots.load();
+        for (uint64_t i = 0; i <= s->mask; i++) {
+            PeerEntry *entry = s->slot[i].load();
+            if (entry && entry != PEER_ENTRY_TOMBSTONE)
+                delete entry;
+        }
+        delete s;
+    }
+
+    // the entry of cts, NULL if none; safe from any thread inside an epoch
+    PeerEntry * find(CTS cts) {
+        Slots *s = slots.load(std::memory_order_acquire);
+        uint64_t idx = hashCts(cts) & s->mask;
+        while (true) {
+            PeerEntry *entry = s->slot[idx].load(std::memory_order_acquire);
+            if (entry == NULL)
+                return NULL;
+            if (entry != PEER_ENTRY_TOMBSTONE && entry->cts == cts)
+                return entry;
+            idx = (idx + 1) & s->mask;
+        }
+    }
+
+    // owner only: add an entry for cts, which must not be in the table
+    PeerEntry * insert(CTS cts) {
+        Slots *s = slots.load();
+        if ((live + tombstones + 1) * 4 > (s->mask + 1) * 3)
+            s = rehash(live * 2 > s->mask + 1 ? (s->mask + 1) * 2 : s->mask + 1);
+        PeerEntry *entry = new PeerEntry();
+        entry->cts = cts;
+        uint64_t idx = hashCts(cts) & s->mask;
+        while (true) {
+            PeerEntry *old = s->slot[idx].load();
+            if (old == NULL || old == PEER_ENTRY_TOMBSTONE) {
+                if (old == PEER_ENTRY_TOMBSTONE)
+                    tombstones--;
+                s->slot[idx].store(entry, std::memory_order_release);
+                live++;
+                return entry;
+            }
+            assert(old->cts != cts);
+            idx = (idx + 1) & s->mask;
+        }
+    }
+
+    // owner only: take entry out of the table and retire it; its txEntry is not touched
+    void erase(PeerEntry *entry) {
+        disarm(entry);
+        Slots *s = slots.load();
+        uint64_t idx = hashCts(entry->cts) & s->mask;
+        while (s->slot[idx].load() != entry) {
+            assert(s->slot[idx].load() != NULL);
+            idx = (idx + 1) & s->mask;
+        }
+        s->slot[idx].store(PEER_ENTRY_TOMBSTONE, std::memory_order_release);
+        live--;
+        tombstones++;
+        EpochManager::instance().retireObject(entry);
+    }
+
+    // owner only: (re)arm entry to fall due at deadline
+    void arm(PeerEntry *entry, uint64_t deadline) {
+        disarm(entry);
+        entry->deadline = deadline;
+        entry->isArmed = true;
+        //deadlines mostly come in order, so look from the tail
+        PeerEntry *after = tail;
+        while (after && after->deadline > deadline)
+            after = after->prev;
+        entry->prev = after;
+        entry->next = after ? after->next : head;
+        if (entry->next)
+            entry->next->prev = entry;
+        else
+            tail = entry;
+        if (after)
+            after->next = entry;
+        else
+            head = entry;
+    }
+
+    // owner only
+    void disarm(PeerEntry *entry) {
+        if (!entry->isArmed)
+            return;
+        if (entry->prev)
+            entry->prev->next = entry->next;
+        else
+            head = entry->next;
+        if (entry->next)
+            entry->next->prev = entry->prev;
+        else
+            tail = entry->prev;
+        entry->prev = entry->next = NULL;
+        entry->isArmed = false;
+    }
+
+    // owner only: disarm and return the earliest entry due at now, NULL if none
+    PeerEntry * popDue(uint64_t now) {
+        PeerEntry *entry = head;
+        if (entry == NULL || entry->deadline > now)
+            return NULL;
+        disarm(entry);
+        return entry;
+    }
+
+    inline uint64_t size() { return live; }
+    inline uint64_t capacity() { return slots.load()->mask + 1; }
+
+    PROTECTED:
+    struct Slots {
+        uint64_t mask;
+        std::atomic<PeerEntry *> *slot;
+        Slots(uint64_t n) : mask(n - 1) {
+            slot = new std::atomic<PeerEntry *>[n];
+            for (uint64_t i = 0; i < n; i++)
+                slot[i].store(NULL, std::memory_order_relaxed);
+        }
+        ~Slots() { delete[] slot; }
+    };
+
+    // move the live entries into a table of n slots, dropping the tombstones
+    Slots * rehash(uint64_t n) {
+        Slots *old = slots.load();
+        Slots *s = new Slots(n);
+        for (uint64_t i = 0; i <= old->mask; i++) {
+            PeerEntry *entry = old->slot[i].load();
+            if (entry == NULL || entry == PEER_ENTRY_TOMBSTONE)
+                continue;
+            uint64_t idx = hashCts(entry->cts) & s->mask;
+            while (s->slot[idx].load() != NULL)
+                idx = (idx + 1) & s->mask;
+            s->slot[idx].store(entry, std::memory_order_relaxed);
+        }
+        slots.store(s, std::memory_order_release);
+        tombstones = 0;
+        EpochManager::instance().retireObject(old);
+        return s;
+    }
+
+    std::atomic<Slots *> slots;
+    uint64_t live = 0;
+    uint64_t tombstones = 0;
+    PeerEntry *head = NULL; //earliest deadline
+    PeerEntry *tail = NULL;
+
+    DISALLOW_COPY_AND_ASSIGN(PeerEntryTable);
+}; // end PeerEntryTable class
+
+} // end namespace QDB
+
+#endif  /* PEER_ENTRY_TABLE_H */
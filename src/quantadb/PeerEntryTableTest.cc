@@ -0,0 +1,161 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "PeerEntryTable.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static inline CTS
+makeCTS(uint64_t nsec, uint64_t id)
+{
+    return ((CTS)nsec << 64) + id;
+}
+
+class PeerEntryTableTest : public ::testing::Test {
+  public:
+  PeerEntryTableTest() {};
+  ~PeerEntryTableTest() {};
+
+  PeerEntryTable table;
+
+  DISALLOW_COPY_AND_ASSIGN(PeerEntryTableTest);
+};
+
+TEST_F(PeerEntryTableTest, insertFindErase) {
+    EXPECT_EQ((PeerEntry *)NULL, table.find(makeCTS(1, 1)));
+    PeerEntry *e1 = table.insert(makeCTS(1, 1));
+    PeerEntry *e2 = table.insert(makeCTS(1, 2));
+    EXPECT_EQ(e1, table.find(makeCTS(1, 1)));
+    EXPECT_EQ(e2, table.find(makeCTS(1, 2)));
+    EXPECT_EQ(2u, table.size());
+
+    table.erase(e1);
+    EXPECT_EQ((PeerEntry *)NULL, table.find(makeCTS(1, 1)));
+    EXPECT_EQ(e2, table.find(makeCTS(1, 2)));
+    EXPECT_EQ(1u, table.size());
+}
+
+TEST_F(PeerEntryTableTest, grow) {
+    //more than the old fixed 8192 entries per peer thread
+    const uint64_t n = 100000;
+    for (uint64_t i = 0; i < n; i++)
+        table.insert(makeCTS(1000 + i / 8, i));
+    EXPECT_EQ(n, table.size());
+    EXPECT_LE(n * 4 / 3, table.capacity());
+    for (uint64_t i = 0; i < n; i++) {
+        PeerEntry *entry = table.find(makeCTS(1000 + i / 8, i));
+        ASSERT_TRUE(entry != NULL);
+        EXPECT_TRUE(entry->cts == makeCTS(1000 + i / 8, i));
+    }
+
+    //a steady flow of inserts and erases reuses the tombstones instead of growing
+    uint64_t capacity = table.capacity();
+    for (uint64_t i = 0; i < n; i++) {
+        table.erase(table.find(makeCTS(1000 + i / 8, i)));
+        table.insert(makeCTS(1000 + (n + i) / 8, n + i));
+    }
+    EXPECT_EQ(n, table.size());
+    EXPECT_EQ(capacity, table.capacity());
+    EXPECT_EQ((PeerEntry *)NULL, table.find(makeCTS(1000, 0)));
+    EXPECT_TRUE(table.find(makeCTS(1000 + (2 * n - 1) / 8, 2 * n - 1)) != NULL);
+}
+
+TEST_F(PeerEntryTableTest, deadlines) {
+    PeerEntry *e[5];
+    for (uint64_t i = 0; i < 5; i++)
+        e[i] = table.insert(makeCTS(i, 0));
+    table.arm(e[0], 300);
+    table.arm(e[1], 100);
+    table.arm(e[2], 200);
+    table.arm(e[3], 400);
+    table.arm(e[4], 50);
+    table.disarm(e[2]);
+    table.arm(e[3], 150); //re-arming moves it
+
+    EXPECT_EQ((PeerEntry *)NULL, table.popDue(10));
+    EXPECT_EQ(e[4], table.popDue(120));
+    EXPECT_EQ(e[1], table.popDue(120));
+    EXPECT_EQ((PeerEntry *)NULL, table.popDue(120));
+    table.erase(e[0]); //erasing disarms
+    EXPECT_EQ(e[3], table.popDue(1000));
+    EXPECT_EQ((PeerEntry *)NULL, table.popDue(1000));
+    EXPECT_FALSE(e[3]->isArmed);
+}
+
+void entryFinder(PeerEntryTable *table, uint64_t len, std::atomic<bool> *isDone, uint64_t *hits)
+{
+    EpochThread epochThread;
+    while (!isDone->load()) {
+        EpochGuard guard;
+        for (uint64_t i = 0; i < len; i += 7) {
+            PeerEntry *entry = table->find(makeCTS(i, 0));
+            if (entry) {
+                EXPECT_TRUE(entry->cts == makeCTS(i, 0));
+                (*hits)++;
+            }
+        }
+    }
+}
+
+TEST_F(PeerEntryTableTest, MtFindWhileGrowing) {
+    const uint64_t len = 200000;
+    std::atomic<bool> isDone(false);
+    uint64_t hits = 0;
+    std::thread finder(entryFinder, &table, len, &isDone, &hits);
+
+    {
+        EpochThread epochThread;
+        for (uint64_t i = 0; i < len; i++) {
+            table.insert(makeCTS(i, 0));
+            if (i % 1024 == 0)
+                EpochManager::instance().quiescent();
+        }
+    }
+    isDone = true;
+    finder.join();
+    EXPECT_EQ(len, table.size());
+    GTEST_COUT << "capacity: " << table.capacity() << ", hits while inserting: " << hits << std::endl;
+}
+
+TEST_F(PeerEntryTableTest, benchPopDue) {
+    //the monitor cost depends on the overdue entries, not on those in flight
+    const uint64_t n = 1000000;
+    for (uint64_t i = 0; i < n; i++)
+        table.arm(table.insert(makeCTS(i, 0)), 1000 + i);
+    uint64_t start = Cycles::rdtsc();
+    uint64_t count = 0;
+    for (uint64_t tick = 0; tick < 1000; tick++)
+        while (table.popDue(1000 + tick))
+            count++;
+    uint64_t stop = Cycles::rdtsc();
+    EXPECT_EQ(1000u, count);
+    GTEST_COUT << "popDue 1000 ticks with " << n << " entries: "
+            << Cycles::toNanoseconds(stop - start) << " nsec" << std::endl;
+
+    start = Cycles::rdtsc();
+    for (uint64_t i = 0; i < n; i++)
+        table.find(makeCTS(i, 0));
+    stop = Cycles::rdtsc();
+    GTEST_COUT << "find: " << Cycles::toNanoseconds(stop - start) / n << " nsec" << std::endl;
+}
+
+}  // namespace RAMCloud
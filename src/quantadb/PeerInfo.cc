@@ -21,8 +21,6 @@ namespace QDB {
 
 PeerInfo::PeerInfo(uint32_t tid) {
     this->tid = tid;
-    for (uint32_t i = 0; i < TBLSZ; i++)
-        recycleQueue.push(i);
 }
 
 PeerInfo::~PeerInfo() {
@@ -74,18 +72,19 @@ PeerInfo::processEvent(Validator *validator) {
             add(peerEvent->cts, peerEvent->txEntry, validator);
             validator->getCounters().peerEventAdds++;
         } else if (peerEvent->eventType == 2) { //remove (triggered by conclude)
-            PeerInfoIterator it = peerInfo.find(peerEvent->cts);
-            peerEntryTable[it->second].isConcluded = true;
-            recycleQueue.push(it->second);
-            RAMCLOUD_LOG(NOTICE, "recycle idx %u cts %lu", it->second, (uint64_t)(peerEvent->cts >> 64));
+            PeerEntry *peerEntry = peerEntryTable.find(peerEvent->cts);
+            assert(peerEntry != NULL);
+            peerEntry->isConcluded = true;
+            peerEntryTable.disarm(peerEntry);
+            concludedQueue.push(peerEntry);
+            RAMCLOUD_LOG(NOTICE, "recycle cts %lu", (uint64_t)(peerEvent->cts >> 64));
             validator->getCounters().peerEventDels++;
         } else if (peerEvent->eventType == 4) { //info request (triggered by peer info handler)
             uint32_t myTxState = 0;
             uint8_t myPeerPosition = 0;
             uint64_t myPStamp = 0, mySStamp = -1;
-            PeerInfoIterator it = peerInfo.find(peerEvent->cts);
-            if (it != peerInfo.end()) {
-                PeerEntry* peerEntry = &peerEntryTable[it->second];
+            PeerEntry* peerEntry = peerEntryTable.find(peerEvent->cts);
+            if (peerEntry != NULL) {
                 TxEntry* txEntry = peerEntry->txEntry;
                 if (txEntry) {
                     validator->sendSSNInfo(peerEvent->cts,
@@ -110,33 +109,28 @@ PeerInfo::processEvent(Validator *validator) {
 
 bool
 PeerInfo::add(CTS cts, TxEntry *txEntry, Validator *validator) {
-    PeerInfoIterator it = peerInfo.find(cts);
-    if (it == peerInfo.end()) {
-        if (recycleQueue.empty()) {
-            RAMCLOUD_LOG(ERROR, "addPeer failed %lu full", (uint64_t)(cts >> 64));
-            return false;
+    PeerEntry* existing = peerEntryTable.find(cts);
+    if (existing == NULL) {
+        //retire the oldest concluded entries, which late peer messages are no longer expected for
+        while (concludedQueue.size() >= PEER_RETAIN_CONCLUDED) {
+            PeerEntry* old = concludedQueue.front();
+            concludedQueue.pop();
+            RAMCLOUD_LOG(NOTICE, "remove old cts %lu for cts %lu",
+                    (uint64_t)(old->cts >> 64), (uint64_t)(cts >> 64));
+            if (old->txEntry) {
+                EpochManager::instance().retireObject(old->txEntry);
+                old->txEntry = NULL;
+                validator->getCounters().deletedPeers++;
+            }
+            peerEntryTable.erase(old);
         }
-        uint32_t freeIdx = recycleQueue.front();
-        PeerEntry* entry = &peerEntryTable[freeIdx];
 
-        RAMCLOUD_LOG(NOTICE, "addPeer %lu %lu txEntry %lu idx %u", (uint64_t)(cts >> 64),
-                (uint64_t)(cts & (((__uint128_t)1<<64) -1)), (uint64_t)txEntry, freeIdx);
+        PeerEntry* entry = peerEntryTable.insert(cts);
+
+        RAMCLOUD_LOG(NOTICE, "addPeer %lu %lu txEntry %lu", (uint64_t)(cts >> 64),
+                (uint64_t)(cts & (((__uint128_t)1<<64) -1)), (uint64_t)txEntry);
 
-        if (!peerInfo.insert(std::make_pair(cts, freeIdx)).second) {
-            RAMCLOUD_LOG(NOTICE, "addPeer failed %lu %lu txEntry %lu idx %u", (uint64_t)(cts >> 64),
-                    (uint64_t)(cts & (((__uint128_t)1<<64) -1)), (uint64_t)txEntry, freeIdx);
-            return false;
-        }
-        if (entry->txEntry) {
-            RAMCLOUD_LOG(NOTICE, "remove old cts %lu for cts %lu idx %u",
-                    (uint64_t)(entry->cts >> 64), (uint64_t)(cts >> 64), freeIdx);
-            peerInfo.erase(entry->cts);
-            delete entry->txEntry;
-            entry->txEntry = NULL;
-            validator->getCounters().deletedPeers++;
-        }
         entry->isConcluded = false;
-        entry->cts = cts;
         entry->peerAlertSet = 0;;
         entry->peerSeenSet = 0;
         entry->peerTxState = TxEntry::TX_PENDING;
@@ -148,15 +142,18 @@ PeerInfo::add(CTS cts, TxEntry *txEntry, Validator *validator) {
             entry->meta.pStamp = txEntry->getPStamp();
             entry->meta.sStamp = txEntry->getSStamp();
             entry->txEntry = txEntry;
-            send(&peerEntryTable[freeIdx], validator);
+            peerEntryTable.arm(entry, (uint64_t)(cts >> 64) + alertThreshold);
+            send(entry, validator);
+        } else {
+            //made for peer info ahead of the CI, which may never arrive
+            uint64_t nsTime = validator->getClockValue();
+            peerEntryTable.arm(entry, std::max((uint64_t)(cts >> 64), nsTime) + orphanTimeout);
         }
-        recycleQueue.pop();
         validator->getCounters().addPeers.fetch_add(1);
     } else if (txEntry != NULL) {
-        PeerEntry* existing = &peerEntryTable[it->second];
-
         if (existing->txEntry == NULL) {
             existing->txEntry = txEntry;
+            peerEntryTable.arm(existing, (uint64_t)(cts >> 64) + alertThreshold);
             existing->meta.pStamp = std::max(txEntry->getPStamp(), existing->meta.pStamp);
             existing->meta.sStamp = std::min(txEntry->getSStamp(), existing->meta.sStamp);
             txEntry->setPStamp(existing->meta.pStamp);
@@ -178,10 +175,13 @@ PeerInfo::add(CTS cts, TxEntry *txEntry, Validator *validator) {
 
 inline bool
 PeerInfo::evaluate(PeerEntry *peerEntry, TxEntry *txEntry, Validator *validator) {
+    //whether the decision is reached before all peers have been heard of
+    bool isEarly = false;
 
     //Currently only in the TX_CI_LISTENING state, the txEntry has updated its local
     //pstamp and sstamp and has been scheduled to use peer pstamp and sstamp to evaluate.
     if (txEntry->getTxCIState() == TxEntry::TX_CI_LISTENING) {
+        isEarly = (txEntry->getPeerSet() != peerEntry->peerSeenSet);
         if (txEntry->getTxState() == TxEntry::TX_ALERT) {
             //An alerted state is only allowed to transit into commit state by a peer in commit state
             //so that there will be no race condition into conflict state, where the local would commit
@@ -208,11 +208,23 @@ PeerInfo::evaluate(PeerEntry *peerEntry, TxEntry *txEntry, Validator *validator)
                 txEntry->setTxResult(TxEntry::TX_ABORT_PISI);
             }
         } else if (txEntry->getTxState() == TxEntry::TX_PENDING) {
+            //Peer stamps can only raise pstamp and lower sstamp, so a violation
+            //seen now stands whatever the unseen peers would send. Likewise, a peer
+            //commits only after seeing the stamps of all peers without violation,
+            //so its commit settles ours. Neither needs to wait for the other peers.
             //if (peerEntry->isExclusionViolated()) {
             if (txEntry->isExclusionViolated()) {
                 txEntry->setTxState(TxEntry::TX_ABORT);
                 txEntry->setTxCIState(TxEntry::TX_CI_CONCLUDED);
                 txEntry->setTxResult(TxEntry::TX_ABORT_PISI_INIT);
+                if (isEarly)
+                    validator->getCounters().earlyAborts++;
+            } else if (peerEntry->peerTxState == TxEntry::TX_COMMIT) {
+                txEntry->setTxState(TxEntry::TX_COMMIT);
+                txEntry->setTxCIState(TxEntry::TX_CI_CONCLUDED);
+                txEntry->setTxResult(TxEntry::TX_COMMIT_PEER);
+                if (isEarly)
+                    validator->getCounters().earlyCommits++;
             } else if (txEntry->getPeerSet() == peerEntry->peerSeenSet
                     && !peerEntry->peerAlertSet) {
                 txEntry->setTxState(TxEntry::TX_COMMIT);
@@ -229,8 +241,12 @@ PeerInfo::evaluate(PeerEntry *peerEntry, TxEntry *txEntry, Validator *validator)
     if (txEntry->getTxCIState() == TxEntry::TX_CI_CONCLUDED) {
         txEntry->setPStamp(peerEntry->meta.pStamp);
         txEntry->setSStamp(peerEntry->meta.sStamp);
+        validator->beginSeal(txEntry);
         if (validator->logTx(LOG_ALWAYS, txEntry)) {
             txEntry->setTxCIState(TxEntry::TX_CI_SEALED);
+            //the peers still waiting on the unseen ones can decide on ours
+            if (isEarly)
+                validator->sendSSNInfo(txEntry);
             validator->insertConcludeQueue(txEntry); //or validator->conclude(txEntry);
         } else
             abort();
@@ -273,17 +289,9 @@ PeerInfo::logAndSend(TxEntry *txEntry, Validator *validator) {
 bool
 PeerInfo::update(CTS cts, uint64_t peerId, uint32_t peerTxState, uint64_t pstamp, uint64_t sstamp, uint8_t peerPosition, Validator *validator) {
     TxEntry *txEntry= NULL;
-    PeerInfoIterator it;
-
-    //Make sure that the peerInfo by CTS is valid
-    it = peerInfo.find(cts);
-    if (it != peerInfo.end()) {
-        PeerEntry* entry = &peerEntryTable[it->second];
-        if (entry->cts != cts) {
-            RAMCLOUD_LOG(ERROR, "updatePeer mismatch cts %lu old cts %lu idx %u",
-                    (uint64_t)(cts >> 64), (uint64_t)(entry->cts >> 64), it->second);
-            return false;
-        }
+
+    PeerEntry* entry = peerEntryTable.find(cts);
+    if (entry != NULL) {
         if (!entry->isConcluded) {
             entry->meta.pStamp = std::max(entry->meta.pStamp, pstamp);
             entry->meta.sStamp = std::min(entry->meta.sStamp, sstamp);
@@ -348,39 +356,23 @@ PeerInfo::monitor(Validator *validator) {
     uint64_t nsTime = validator->getClockValue();
     uint64_t currentTick = nsTime / tickUnit;
     PeerEntry *peerEntry;
-    uint32_t count = TBLSZ;
 
     if (currentTick <= lastTick)
         return true;
 
-    while (count > 0) {
-        count--;
-        peerEntry = &peerEntryTable[count];
+    //only the entries overdue are visited; the table is ordered by deadline
+    while ((peerEntry = peerEntryTable.popDue(nsTime)) != NULL) {
+        TxEntry* txEntry = peerEntry->txEntry;
         if (peerEntry->isConcluded) {
             continue;
         }
-
-        TxEntry* txEntry = peerEntry->txEntry;
         if (txEntry == NULL) {
+            RAMCLOUD_LOG(NOTICE, "expire orphan cts %lu", (uint64_t)(peerEntry->cts >> 64));
+            peerEntryTable.erase(peerEntry);
+            validator->getCounters().expiredPeers++;
             continue;
         }
 
-        if ((nsTime - (txEntry->getCTS() >> 64)) > 1000000000) {
-            /*
-            RAMCLOUD_LOG(NOTICE, "finding: cts %lu states %u %u %u %lu %lu now %lu",
-                (uint64_t)(txEntry->getCTS() >> 64), txEntry->getTxState(),
-                txEntry->getTxCIState(), peerEntry->peerTxState,
-                peerEntry->peerSeenSet, peerEntry->peerAlertSet, nsTime);
-
-            for (uint32_t i = 0; i < TBLSZ; i++) {
-                if (this->peerEntryTable[i].txEntry && (this->peerEntry[i].txEntry->getTxState() & 2) == 0)
-                    RAMCLOUD_LOG(NOTICE, "table %u: cts %lu state %u %u", i,
-                            (uint64_t)(this->peerEntryTable[i].cts>>64),
-                            this->peerEntryTable[i].isConcluded,
-                            this->peerEntryTable[i].txEntry ? this->peerEntryTable[i].txEntry->getTxState() : 0);
-            }*/
-        }
-
         if (txEntry->getTxCIState() == TxEntry::TX_CI_LISTENING) {
             if (txEntry->getTxState() != TxEntry::TX_ALERT
                 && nsTime > (uint64_t)(txEntry->getCTS() >> 64)
@@ -396,18 +388,17 @@ PeerInfo::monitor(Validator *validator) {
                 validator->requestSSNInfo(txEntry, false, 0);
             }
         }
+        //check again next tick until concluded
+        peerEntryTable.arm(peerEntry, nsTime + tickUnit);
     }
     lastTick = currentTick;
 
-    //std::this_thread::sleep_for(std::chrono::microseconds(1000000));
-
     return true;
 }
 
 uint32_t
 PeerInfo::size() {
-    return peerInfo.size();
+    return downCast<uint32_t>(peerEntryTable.size());
 }
 
 } // end PeerInfo class
-
@@ -18,6 +18,7 @@
 #include "Common.h"
 #include "TxEntry.h"
 #include "Validator.h"
+#include "PeerEntryTable.h"
 #include "tbb/concurrent_unordered_map.h"
 #include <boost/lockfree/queue.hpp>
 
@@ -37,32 +38,18 @@ namespace QDB {
  * for fear that SSN messages might be lost and some exchanges would not complete
  * without further triggering message exchange.
  *
- * Considering all those concurrency concerns, we would use TBB concurrent_unordered_map
- * which supports concurrent insert, find, and iteration. However, a concurrent erase would disrupt
- * the iteration, so we would have to use that thread to erase finished entries while scanning.
- *
- * Compared to TBB concurrent_hash_map, our choice would perform better as the frequent
- * inserts and finds are lock-free while using finer per TxEntry locking to protect concurrent value
- * modification.
- *
+ * All changes are made by the owning peer thread, which drains the event queue
+ * posed by the other threads, so the PeerEntryTable needs no locks. Other threads
+ * may still find() entries lock-free, but the tx state and stamps of an entry
+ * are read by the owner only, as it writes them non-atomically. The same
+ * thread times out the listening txs, visiting the overdue entries only.
+ * Concluded entries are kept for a while so that late peer messages are
+ * recognized. An entry made for peer info ahead of its CI is dropped if the
+ * CI has not arrived within orphanTimeout.
  */
 
-#define TBLSZ 8192
-
-typedef __uint128_t CTS;
-typedef std::map<CTS, uint32_t>::iterator PeerInfoIterator;
-
-struct PeerEntry {
-    CTS cts = 0;
-    bool isConcluded = true;
-    uint64_t peerSeenSet; //peers seen so far
-    uint64_t peerAlertSet; //peers seen currently in alert state
-    uint32_t peerTxState = TxEntry::TX_PENDING; //summary state of all seen peers
-    DSSNMeta meta; //summary of pstamp and sstamp of all seen peers
-    TxEntry *txEntry = NULL; //reference to the associated commit intent
-
-    inline bool isExclusionViolated() { return meta.sStamp <= meta.pStamp; }
-};
+// concluded entries kept per peer thread, to recognize late peer messages
+#define PEER_RETAIN_CONCLUDED 8192
 
 class  Validator;
 
@@ -80,12 +67,12 @@ struct PeerEvent {
 
 class PeerInfo {
     PROTECTED:
-    std::map<CTS, uint32_t> peerInfo;
-    PeerEntry peerEntryTable[TBLSZ];
-    std::queue<uint32_t> recycleQueue;
+    PeerEntryTable peerEntryTable;
+    std::queue<PeerEntry *> concludedQueue; //oldest first
     uint64_t lastTick = 0;
     uint64_t tickUnit = 10000000; //10ms per tick
     uint64_t alertThreshold = 10 * tickUnit;
+    uint64_t orphanTimeout = 100 * tickUnit;
     boost::lockfree::queue<PeerEvent *> eventQueue{1000};
     uint32_t tid;
 
@@ -106,9 +93,12 @@ class PeerInfo {
     //send tx SSN info to peers
     bool send(PeerEntry *peerEntry, Validator *validator);
 
-    //monitor SSN peer status
+    //monitor SSN peer status of the txs overdue; to be called by the owning peer thread
     bool monitor(Validator *validator);
 
+    //lock-free lookup for any thread within an epoch; fields are written by the owning peer thread
+    inline PeerEntry * find(CTS cts) { return peerEntryTable.find(cts); }
+
     //update peer info of a tx identified by cts
     bool update(CTS cts, uint64_t peerId, uint32_t peerTxState, uint64_t eta, uint64_t pi, uint8_t peerPosition, Validator *validator);
 
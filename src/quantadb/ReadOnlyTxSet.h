@@ -0,0 +1,176 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef READ_ONLY_TX_SET_H
+#define READ_ONLY_TX_SET_H
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Common.h"
+#include "CtsHash.h"
+#include "TxEntry.h"
+
+namespace QDB {
+
+/**
+ * The cross-shard read-only txs exchanging their stamps with their peers.
+ *
+ * A read-only tx writes nothing, so it needs none of the CI states, alerts and
+ * logging that PeerInfo keeps for the others: its participants only have to
+ * agree on the largest pstamp and the smallest sstamp of its reads. Each one
+ * settles its local stamps, sends them to the others, and merges theirs here.
+ * The tx is decided once its own stamps are settled and those of all peers
+ * are in, or as soon as the merged stamps violate the exclusion window, which
+ * no further stamp can undo.
+ *
+ * An entry is made either by the local tx or by the first peer stamps ahead
+ * of it. A tx whose reads could not be settled yet is left unsettled for the
+ * sweeper to retry. Entries past their deadline are dropped by sweep(); the
+ * tx of one is handed back with its sstamp zeroed, so that it aborts.
+ *
+ * The entries are spread over READ_ONLY_TX_SHARDS maps, each with its own
+ * lock. A decided or expired tx is removed from its map before it is handed
+ * back, so its caller owns it. An unsettled tx is touched by the sweeper only.
+ */
+class ReadOnlyTxSet {
+    #define READ_ONLY_TX_SHARDS 16
+    PUBLIC:
+    ReadOnlyTxSet() {}
+
+    // track txEntry, settled or not; return it if decided already, NULL otherwise
+    /// a duplicate of a tracked CTS is returned right away with its sstamp zeroed
+    TxEntry * add(TxEntry *txEntry, bool isSettled, uint64_t deadline) {
+        Shard &shard = shards[hash(txEntry->getCTS())];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.txs.find(txEntry->getCTS());
+        if (it == shard.txs.end()) {
+            it = shard.txs.emplace(txEntry->getCTS(), Entry()).first;
+            count++;
+        } else if (it->second.txEntry != NULL) {
+            txEntry->setSStamp(0);
+            return txEntry;
+        }
+        Entry &entry = it->second;
+        entry.txEntry = txEntry;
+        entry.isSettled = isSettled;
+        entry.deadline = deadline;
+        return decide(shard, it);
+    }
+
+    // the local stamps of an unsettled tx are final; return it if decided, NULL otherwise
+    TxEntry * settle(TxEntry *txEntry) {
+        Shard &shard = shards[hash(txEntry->getCTS())];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.txs.find(txEntry->getCTS());
+        assert(it != shard.txs.end() && it->second.txEntry == txEntry);
+        it->second.isSettled = true;
+        return decide(shard, it);
+    }
+
+    // merge the stamps of a peer; return the tx if decided, NULL otherwise
+    /// deadline applies to an entry made ahead of the local tx
+    TxEntry * merge(__uint128_t cts, uint8_t peerPosition, uint64_t pstamp, uint64_t sstamp,
+            uint64_t deadline) {
+        Shard &shard = shards[hash(cts)];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.txs.find(cts);
+        if (it == shard.txs.end()) {
+            it = shard.txs.emplace(cts, Entry()).first;
+            it->second.deadline = deadline;
+            count++;
+        }
+        Entry &entry = it->second;
+        entry.pstamp = std::max(entry.pstamp, pstamp);
+        entry.sstamp = std::min(entry.sstamp, sstamp);
+        entry.peerSeenSet |= (1ul << peerPosition);
+        return decide(shard, it);
+    }
+
+    // hand out the unsettled txs to retry and the expired ones, which are removed
+    void sweep(uint64_t now, std::vector<TxEntry *> &unsettled, std::vector<TxEntry *> &expired) {
+        if (count.load() == 0)
+            return;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            for (auto it = shard.txs.begin(); it != shard.txs.end(); ) {
+                Entry &entry = it->second;
+                if (entry.deadline <= now) {
+                    if (entry.txEntry) {
+                        entry.txEntry->setSStamp(0);
+                        expired.push_back(entry.txEntry);
+                    }
+                    it = shard.txs.erase(it);
+                    count--;
+                    continue;
+                }
+                if (entry.txEntry && !entry.isSettled)
+                    unsettled.push_back(entry.txEntry);
+                ++it;
+            }
+        }
+    }
+
+    inline uint64_t size() { return count.load(); }
+
+    PROTECTED:
+    struct Entry {
+        TxEntry *txEntry = NULL; //NULL until the local tx arrives
+        bool isSettled = false; //whether the local stamps of txEntry are final
+        uint64_t peerSeenSet = 0; //positions of the peers whose stamps are in
+        uint64_t pstamp = 0; //of the peers
+        uint64_t sstamp = 0xffffffffffffffff;
+        uint64_t deadline = 0;
+    };
+
+    //a cache line of padding keeps neighbouring shards apart without over-aligning the owner
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<__uint128_t, Entry, CtsHash> txs;
+        char pad[64];
+    };
+
+    typedef std::unordered_map<__uint128_t, Entry, CtsHash>::iterator Iterator;
+
+    // fold the peer stamps into a settled tx and remove it if decided; caller holds the lock
+    TxEntry * decide(Shard &shard, Iterator it) {
+        Entry &entry = it->second;
+        TxEntry *txEntry = entry.txEntry;
+        if (txEntry == NULL || !entry.isSettled)
+            return NULL;
+        txEntry->setPStamp(std::max(txEntry->getPStamp(), entry.pstamp));
+        txEntry->setSStamp(std::min(txEntry->getSStamp(), entry.sstamp));
+        if (!txEntry->isExclusionViolated() && entry.peerSeenSet != txEntry->getPeerSet())
+            return NULL;
+        shard.txs.erase(it);
+        count--;
+        return txEntry;
+    }
+
+    static inline uint32_t hash(__uint128_t cts) {
+        return (uint32_t)(hashCts(cts) % READ_ONLY_TX_SHARDS);
+    }
+
+    Shard shards[READ_ONLY_TX_SHARDS];
+    std::atomic<uint64_t> count{0};
+
+    DISALLOW_COPY_AND_ASSIGN(ReadOnlyTxSet);
+}; // end ReadOnlyTxSet class
+
+} // end namespace QDB
+
+#endif  /* READ_ONLY_TX_SET_H */
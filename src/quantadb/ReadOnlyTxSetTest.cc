@@ -0,0 +1,142 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "TestUtil.h"
+#include "ReadOnlyTxSet.h"
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static inline __uint128_t
+makeCTS(uint64_t nsec, uint64_t id)
+{
+    return ((__uint128_t)nsec << 64) + id;
+}
+
+class ReadOnlyTxSetTest : public ::testing::Test {
+  public:
+  ReadOnlyTxSetTest() {};
+  ~ReadOnlyTxSetTest() {};
+
+  ReadOnlyTxSet txSet;
+
+  //a read-only tx at position 0 of three participants
+  TxEntry * makeTx(__uint128_t cts, uint64_t pstamp, uint64_t sstamp) {
+      TxEntry *txEntry = new TxEntry(1, 0);
+      txEntry->setCTS(cts);
+      txEntry->setPStamp(pstamp);
+      txEntry->setSStamp(sstamp);
+      txEntry->setPeerPosition(0);
+      txEntry->insertPeerSet(1);
+      txEntry->insertPeerSet(2);
+      return txEntry;
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(ReadOnlyTxSetTest);
+};
+
+TEST_F(ReadOnlyTxSetTest, decideOnAllPeers) {
+    TxEntry *txEntry = makeTx(makeCTS(100, 1), 10, 100);
+    EXPECT_TRUE(NULL == txSet.add(txEntry, true, 1000));
+    EXPECT_TRUE(NULL == txSet.merge(makeCTS(100, 1), 1, 20, 90, 1000));
+    EXPECT_EQ(1u, txSet.size());
+    EXPECT_TRUE(txEntry == txSet.merge(makeCTS(100, 1), 2, 15, 80, 1000));
+    EXPECT_EQ(0u, txSet.size());
+    EXPECT_EQ(20u, txEntry->getPStamp());
+    EXPECT_EQ(80u, txEntry->getSStamp());
+    EXPECT_FALSE(txEntry->isExclusionViolated());
+    delete txEntry;
+
+    //the peers ahead of the tx, which is decided once settled
+    txEntry = makeTx(makeCTS(200, 1), 10, 200);
+    EXPECT_TRUE(NULL == txSet.merge(makeCTS(200, 1), 2, 20, 190, 1000));
+    EXPECT_TRUE(NULL == txSet.merge(makeCTS(200, 1), 1, 20, 190, 1000));
+    EXPECT_TRUE(NULL == txSet.add(txEntry, false, 1000));
+    EXPECT_TRUE(txEntry == txSet.settle(txEntry));
+    EXPECT_EQ(0u, txSet.size());
+    delete txEntry;
+}
+
+TEST_F(ReadOnlyTxSetTest, decideEarlyOnViolation) {
+    TxEntry *txEntry = makeTx(makeCTS(100, 1), 10, 100);
+    EXPECT_TRUE(NULL == txSet.add(txEntry, true, 1000));
+    //a peer that aborted locally sends a zero sstamp; the other one need not be waited for
+    EXPECT_TRUE(txEntry == txSet.merge(makeCTS(100, 1), 1, 10, 0, 1000));
+    EXPECT_TRUE(txEntry->isExclusionViolated());
+    EXPECT_EQ(0u, txSet.size());
+    delete txEntry;
+
+    //nor for an unsettled tx, which the violation is kept for
+    txEntry = makeTx(makeCTS(200, 1), 10, 200);
+    EXPECT_TRUE(NULL == txSet.add(txEntry, false, 1000));
+    EXPECT_TRUE(NULL == txSet.merge(makeCTS(200, 1), 1, 300, 400, 1000));
+    EXPECT_TRUE(txEntry == txSet.settle(txEntry));
+    EXPECT_TRUE(txEntry->isExclusionViolated());
+    delete txEntry;
+}
+
+TEST_F(ReadOnlyTxSetTest, duplicate) {
+    TxEntry *txEntry = makeTx(makeCTS(100, 1), 10, 100);
+    TxEntry *dup = makeTx(makeCTS(100, 1), 10, 100);
+    EXPECT_TRUE(NULL == txSet.add(txEntry, true, 1000));
+    EXPECT_TRUE(dup == txSet.add(dup, true, 1000));
+    EXPECT_TRUE(dup->isExclusionViolated());
+    EXPECT_FALSE(txEntry->isExclusionViolated());
+    EXPECT_EQ(1u, txSet.size());
+    delete dup;
+
+    std::vector<TxEntry *> unsettled, expired;
+    txSet.sweep(1000, unsettled, expired);
+    EXPECT_EQ(1u, expired.size());
+    delete txEntry;
+}
+
+TEST_F(ReadOnlyTxSetTest, sweep) {
+    TxEntry *settled = makeTx(makeCTS(100, 1), 10, 100);
+    TxEntry *unsettled = makeTx(makeCTS(200, 1), 10, 200);
+    EXPECT_TRUE(NULL == txSet.add(settled, true, 1000));
+    EXPECT_TRUE(NULL == txSet.add(unsettled, false, 2000));
+    EXPECT_TRUE(NULL == txSet.merge(makeCTS(300, 1), 1, 10, 300, 1500)); //an orphan
+    EXPECT_EQ(3u, txSet.size());
+
+    //the unsettled tx is handed out to retry and kept
+    std::vector<TxEntry *> retry, expired;
+    txSet.sweep(500, retry, expired);
+    EXPECT_EQ(1u, retry.size());
+    EXPECT_TRUE(unsettled == retry[0]);
+    EXPECT_EQ(0u, expired.size());
+    EXPECT_EQ(3u, txSet.size());
+
+    //the tx waiting on its peers expires and aborts, the orphan is dropped
+    retry.clear();
+    txSet.sweep(1500, retry, expired);
+    EXPECT_EQ(1u, retry.size());
+    EXPECT_EQ(1u, expired.size());
+    EXPECT_TRUE(settled == expired[0]);
+    EXPECT_TRUE(settled->isExclusionViolated());
+    EXPECT_EQ(1u, txSet.size());
+
+    retry.clear();
+    expired.clear();
+    txSet.sweep(2000, retry, expired);
+    EXPECT_EQ(0u, retry.size());
+    EXPECT_EQ(1u, expired.size());
+    EXPECT_EQ(0u, txSet.size());
+    delete settled;
+    delete unsettled;
+}
+
+}  // namespace RAMCloud
@@ -23,7 +23,9 @@
 #include <ifaddrs.h>
 #include <assert.h>
 #include <iostream>
+#include <algorithm>
 #include "Cycles.h"
+#include "Logger.h"
 #include "ClusterTimeService.h"
 #include "Sequencer.h"
 #include "HashmapKVStore.h"
@@ -127,5 +129,92 @@ __uint128_t Sequencer::getCTS()
     return ((__uint128_t)(clock.getLocalTime() + SEQUENCER_DELTA) << 64) + uniqueId;
 }
 
+__uint128_t Sequencer::getCTS(uint64_t shardSet, uint64_t &delta)
+{
+    delta = getDelta(shardSet);
+    uint64_t uniqueId;
+    uniqueId = (node_id << 48) | (getpid() & 0x0000FFFFFFFFFFFF);
+    return ((__uint128_t)(clock.getLocalTime() + delta) << 64) + uniqueId;
+}
+
+uint64_t Sequencer::getDelta(uint64_t shardSet)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = controllers.find(shardSet);
+    return it == controllers.end() ? SEQUENCER_DELTA : it->second.delta;
+}
+
+void Sequencer::reportSlack(uint64_t shardSet, uint64_t delta, int64_t slack)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = controllers.find(shardSet);
+    if (it == controllers.end()) {
+        if (controllers.size() >= SEQUENCER_MAX_SHARD_SETS)
+            evictIdlest();
+        it = controllers.emplace(shardSet, DeltaController()).first;
+    }
+    DeltaController &ctl = it->second;
+    ctl.lastReport = ++reportSeq;
+    if (slack < 0)
+        lates++;
+
+    //the time from issuing the CTS to the CI being due at the validator
+    int64_t transit = (int64_t)delta - slack;
+    if (ctl.transit.size() < SEQUENCER_WINDOW) {
+        ctl.transit.push_back(transit);
+    } else {
+        ctl.transit[ctl.next] = transit;
+        ctl.next = (ctl.next + 1) % SEQUENCER_WINDOW;
+    }
+    if (++ctl.sinceAdapt >= SEQUENCER_ADAPT_EVERY)
+        adapt(ctl);
+}
+
+uint64_t Sequencer::getLateCount()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return lates;
+}
+
+size_t Sequencer::getShardSetCount()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return controllers.size();
+}
+
+// drop the delta reported on least recently; caller holds the lock
+void Sequencer::evictIdlest()
+{
+    auto idlest = controllers.begin();
+    for (auto it = controllers.begin(); it != controllers.end(); it++) {
+        if (it->second.lastReport < idlest->second.lastReport)
+            idlest = it;
+    }
+    if (idlest != controllers.end())
+        controllers.erase(idlest);
+}
+
+void Sequencer::adapt(DeltaController &ctl)
+{
+    ctl.sinceAdapt = 0;
+    std::vector<int64_t> sorted(ctl.transit);
+    size_t rank = (size_t)((double)(sorted.size() - 1) * (1 - SEQUENCER_TARGET_LATE));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    int64_t target = sorted[rank] + SEQUENCER_MARGIN;
+    target = std::max<int64_t>(SEQUENCER_MIN_DELTA, std::min<int64_t>(SEQUENCER_MAX_DELTA, target));
+
+    if ((uint64_t)target >= ctl.delta)
+        ctl.delta = target;
+    else
+        ctl.delta -= (ctl.delta - target) / 8;
+
+    uint64_t now = clock.getLocalTime();
+    if (now - lastLogTime > 10000000000) { //every 10s
+        RAMCLOUD_LOG(NOTICE, "delta %lu ns, transit p%.0f %ld ns, lates %lu",
+                ctl.delta, (1 - SEQUENCER_TARGET_LATE) * 100, sorted[rank], lates);
+        lastLogTime = now;
+    }
+}
+
 } // QDB
 
@@ -17,6 +17,9 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "ClusterTimeService.h"
 
 namespace QDB {
@@ -31,19 +34,62 @@ namespace QDB {
  *
  * Therefore, CTS = Cluster Time Stamp + 'delta'.
  *
+ * A delta too short gets CIs aborted as late, and one too long delays every tx. So the delta is adapted
+ * per destination shard set: a validator replies with the slack of the CI, its CTS minus the local time
+ * on arrival, and the delta used minus the slack is the time the CI took to be due there. The delta
+ * tracks the (1 - SEQUENCER_TARGET_LATE) quantile of that over the last SEQUENCER_WINDOW replies plus
+ * SEQUENCER_MARGIN, within [SEQUENCER_MIN_DELTA, SEQUENCER_MAX_DELTA]. It rises at once and falls by
+ * 1/8 of the gap per adaptation, so a burst is answered right away and a quiet period is not overfit.
+ * At most SEQUENCER_MAX_SHARD_SETS deltas are kept; the one reported on least recently makes room for
+ * a new shard set, which starts over from SEQUENCER_DELTA.
+ *
  */
 
-#define SEQUENCER_DELTA 30000    // 30 usec delay
+#define SEQUENCER_DELTA 30000    // 30 usec delay, the initial delta of a shard set
+#define SEQUENCER_MIN_DELTA 5000
+#define SEQUENCER_MAX_DELTA 1000000  // within the horizon of the TimingWheel reorderQueue
+#define SEQUENCER_MARGIN 2000
+#define SEQUENCER_TARGET_LATE 0.01
+#define SEQUENCER_WINDOW 256
+#define SEQUENCER_ADAPT_EVERY 32
+#define SEQUENCER_MAX_SHARD_SETS 1024
 
 class Sequencer {
     public:
     Sequencer ();
-    __uint128_t   getCTS();    	     // return CTS
+    __uint128_t   getCTS();    	     // return CTS, using the initial delta
+
+    // return CTS for a tx bound for the shard set, and the delta used
+    __uint128_t   getCTS(uint64_t shardSet, uint64_t &delta);
+
+    // feedback from a validator of the shard set on a CTS issued with delta
+    void reportSlack(uint64_t shardSet, uint64_t delta, int64_t slack);
+
+    uint64_t getDelta(uint64_t shardSet);
+    uint64_t getLateCount();
+    size_t getShardSetCount();
 
     private:
+    // delta of one shard set
+    struct DeltaController {
+        uint64_t delta = SEQUENCER_DELTA;
+        std::vector<int64_t> transit;   //ring of the recent transit times, ns
+        uint32_t next = 0;
+        uint32_t sinceAdapt = 0;
+        uint64_t lastReport = 0;        //reportSeq at its latest report
+    };
+
+    void adapt(DeltaController &ctl);
+    void evictIdlest();
+
     // ClusterTimeClient clock;
     ClusterTimeService clock;   // Use server class for now.
     uint64_t    node_id;
+    std::mutex  lock;
+    std::unordered_map<uint64_t, DeltaController> controllers;
+    uint64_t    lates = 0;
+    uint64_t    reportSeq = 0;
+    uint64_t    lastLogTime = 0;
 }; // Sequencer
 
 } // end namespace QDB
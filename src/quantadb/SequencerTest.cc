@@ -40,6 +40,52 @@ TEST_F(SequencerTest, getCTS) {
     EXPECT_GT(cts2, cts1);
 }
 
+TEST_F(SequencerTest, adaptDelta) {
+    uint64_t delta;
+    seq.getCTS(1, delta);
+    EXPECT_EQ((uint64_t)SEQUENCER_DELTA, delta);
+
+    //CIs due 8 usec after the CTS was issued: the delta decays toward 8 + margin
+    for (int i = 0; i < 64 * SEQUENCER_ADAPT_EVERY; i++)
+        seq.reportSlack(1, seq.getDelta(1), (int64_t)seq.getDelta(1) - 8000);
+    EXPECT_GT(seq.getDelta(1), 8000u + SEQUENCER_MARGIN - 500);
+    EXPECT_LT(seq.getDelta(1), 8000u + SEQUENCER_MARGIN + 500);
+    EXPECT_EQ((uint64_t)SEQUENCER_DELTA, seq.getDelta(2));
+    EXPECT_EQ(0u, seq.getLateCount());
+
+    //a burst of late CIs raises it within one adaptation
+    for (int i = 0; i < SEQUENCER_ADAPT_EVERY; i++)
+        seq.reportSlack(1, seq.getDelta(1), (int64_t)seq.getDelta(1) - 50000);
+    EXPECT_EQ(50000u + SEQUENCER_MARGIN, seq.getDelta(1));
+    EXPECT_EQ((uint64_t)SEQUENCER_ADAPT_EVERY, seq.getLateCount());
+
+    //and it stays clamped
+    for (int i = 0; i < SEQUENCER_ADAPT_EVERY; i++)
+        seq.reportSlack(1, seq.getDelta(1), -100000000);
+    EXPECT_EQ((uint64_t)SEQUENCER_MAX_DELTA, seq.getDelta(1));
+}
+
+TEST_F(SequencerTest, shardSetsCapped) {
+    //one delta per shard set, however many shard sets are seen
+    for (uint64_t set = 1; set <= SEQUENCER_MAX_SHARD_SETS + 16; set++) {
+        seq.reportSlack(set, SEQUENCER_DELTA, 0);
+        seq.reportSlack(1, SEQUENCER_DELTA, 0);
+    }
+    EXPECT_EQ((size_t)SEQUENCER_MAX_SHARD_SETS, seq.getShardSetCount());
+
+    //a busy shard set keeps its delta while idle ones make room
+    for (int i = 0; i < 64 * SEQUENCER_ADAPT_EVERY; i++)
+        seq.reportSlack(1, seq.getDelta(1), (int64_t)seq.getDelta(1) - 8000);
+    uint64_t delta = seq.getDelta(1);
+    EXPECT_LT(delta, (uint64_t)SEQUENCER_DELTA);
+    for (uint64_t set = 2 * SEQUENCER_MAX_SHARD_SETS; set < 3 * SEQUENCER_MAX_SHARD_SETS; set++) {
+        seq.reportSlack(set, SEQUENCER_DELTA, 0);
+        seq.reportSlack(1, seq.getDelta(1), (int64_t)seq.getDelta(1) - 8000);
+    }
+    EXPECT_EQ((size_t)SEQUENCER_MAX_SHARD_SETS, seq.getShardSetCount());
+    EXPECT_LT(seq.getDelta(1), (uint64_t)SEQUENCER_DELTA);
+}
+
 TEST_F(SequencerTest, benchGetCTS) {
     int loop = 1024*1024;
     uint64_t start, stop;
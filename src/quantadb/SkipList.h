@@ -14,7 +14,7 @@
  */
 
 /*
- * C++ Program to Implement Skip List 
+ * Lock-free skip list, ordered by key, used as a priority queue of commit intents
  */
 #pragma once
 
@@ -24,8 +24,12 @@
 #include <cstring>
 #include <assert.h>
 #include <atomic>
+#include <immintrin.h>
+#include "EpochManager.h"
+#include "Slab.h"
 
 #define MAX_LEVEL 16
+#define SKIPLIST_MAGAZINE 4096 //nodes per magazine of the height-1 Slab, halved per level up
 
 using namespace std;
 
@@ -33,46 +37,99 @@ namespace QDB {
 
 /*
  * Skip Node Declaration
+ *
+ * Nodes are variable-height: next[] holds 'height' links and the node is
+ * carved from a Slab of its own height, shared by the lists of a key type and
+ * never freed. The low bit of a link marks the node owning the link as
+ * logically removed.
  */
 template <typename Key_t>
 struct SkipNode
 {
     Key_t key;
-    void * value;
-    SkipNode<Key_t> *forw[MAX_LEVEL+1];
+    std::atomic<void *> value;
+    uint32_t height;
+    std::atomic<bool> fullyLinked;
+    std::atomic<uintptr_t> next[1]; //actually 'height' entries
+
+    static SkipNode<Key_t> * create(Key_t k, void *v, uint32_t h)
+    {
+        void *mem = slab(h)->get();
+        assert(((uintptr_t)mem & (alignof(SkipNode<Key_t>) - 1)) == 0);
+        SkipNode<Key_t> *node = new(mem) SkipNode<Key_t>(k, v, h);
+        for (uint32_t i = 1; i < h; i++)
+            node->next[i].store(0, std::memory_order_relaxed);
+        return node;
+    }
+
+    static void destroy(void *node)
+    {
+        slab(static_cast<SkipNode<Key_t> *>(node)->height)->put(node);
+    }
+
+    static inline bool isMarked(uintptr_t link) { return link & 1; }
+    static inline SkipNode<Key_t> * toNode(uintptr_t link) { return (SkipNode<Key_t> *)(link & ~1ul); }
+
+  private:
+    static Slab * slab(uint32_t h)
+    {
+        struct Slabs {
+            Slab *byHeight[MAX_LEVEL];
+            Slabs() {
+                for (uint32_t i = 0; i < MAX_LEVEL; i++) {
+                    // a multiple of the alignment, as the Slab only keeps objects 8-byte aligned
+                    uint32_t size = sizeof(SkipNode<Key_t>) + i * sizeof(std::atomic<uintptr_t>);
+                    size = ROUNDUP(size, alignof(SkipNode<Key_t>));
+                    byHeight[i] = new Slab(size, std::max(16, SKIPLIST_MAGAZINE >> i));
+                }
+            }
+        };
+        static Slabs slabs;
+        return slabs.byHeight[h - 1];
+    }
 
-    SkipNode(Key_t k, void *v) : key(k), value(v)
+    SkipNode(Key_t k, void *v, uint32_t h) : key(k), value(v), height(h), fullyLinked(false)
     {
-        bzero(forw, sizeof(forw));
+        next[0].store(0, std::memory_order_relaxed);
     }
 };
 
 /*
  * Skip List Declaration
+ *
+ * insert(), remove() and the pops run concurrently without a lock, after
+ * Fraser and Herlihy-Shavit: a node is removed by marking its links top-down,
+ * and the thread that marks level 0 owns the removal. Marked nodes are
+ * unlinked by whichever traversal meets them, and the owner hands the node to
+ * the EpochManager, so a thread still walking over it never touches freed
+ * memory. Every operation runs in an epoch critical section of its own.
+ *
+ * A node is removable only once fully linked; a pop meeting a node still being
+ * linked waits for its inserter, which is never blocked.
  */
 template <typename Key_t>
 class SkipList {
   public:
-    SkipNode<Key_t> *head;
-    int level;
-    SkipList(float p = 0.5) : level(0)
+    typedef SkipNode<Key_t> Node;
+
+    Node *head;
+    SkipList(float p = 0.5)
     {
         probability = p;
-        head = new SkipNode<Key_t>(0, (void *)const_cast<char *>("head"));
+        head = Node::create(0, (void *)const_cast<char *>("head"), MAX_LEVEL);
+        head->fullyLinked = true;
         ctr = 0;
-        lock_ = 0;
+        level = 1;
     }
 
-    ~SkipList() 
+    ~SkipList()
     {
-        // delete all nodes
-        SkipNode<Key_t> * tmp;
-        SkipNode<Key_t> * nxt;
-        tmp = head;
-        while ( tmp )
+        // delete all nodes; the list is no longer shared
+        Node *tmp = head;
+        while (tmp)
         {
-            nxt = tmp->forw[0];
-            delete tmp;
+            Node *nxt = Node::toNode(tmp->next[0].load());
+            Node::destroy(tmp);
             tmp = nxt;
         }
     }
@@ -80,243 +137,279 @@ class SkipList {
     /*
      * Display Elements of Skip List
      */
-    void print() 
+    void print()
     {
+        EpochGuard guard;
         std::cout <<"=======\n";
 
-        SkipNode<Key_t> * node = head;
+        Node * node = head;
         do {
-            std::cout << "key: " << node->key << " val: " << (char *)node->value;
-            for(int lvl = 0; lvl < MAX_LEVEL; lvl++) {
-                if (!node->forw[lvl])
+            std::cout << "key: " << node->key << " val: " << (char *)node->value.load();
+            for (uint32_t lvl = 0; lvl < node->height; lvl++) {
+                Node *n = Node::toNode(node->next[lvl].load());
+                if (!n)
                     break;
-                std::cout << " [" << lvl << "]" << "->key:" << node->forw[lvl]->key;
+                std::cout << " [" << lvl << "]" << "->key:" << n->key;
             }
             std::cout <<"\n";
-        } while ((node = node->forw[0]) != nullptr);
+        } while ((node = Node::toNode(node->next[0].load())) != nullptr);
 
         std::cout <<"=======\n";
     }
 
     inline bool contains(Key_t key)
     {
-        lock();
-        bool ret = find(key) != NULL;
-        unlock();
-        return ret;
+        EpochGuard guard;
+        return search(key) != NULL;
     }
 
     /*
-     * Insert Element to Skip List
+     * Insert Element to Skip List. Returns false, leaving the list as it is,
+     * if the key is there already: its node may be claimed by a pop at any
+     * time, so its value is not to be replaced.
      */
     bool insert(Key_t key, void *value)
     {
-        SkipNode<Key_t> *new_node = new SkipNode<Key_t>(key, value);
-
-        if (!new_node)
-            return false;
-
-        int lvl = random_level();
-
-        lock();
-        SkipNode<Key_t> *x = head;	
-        SkipNode<Key_t> *update[MAX_LEVEL + 1];
-        memset(update, 0, sizeof(SkipNode<Key_t>*) * (MAX_LEVEL + 1));
-
-        for (int i = level; i >= 0; i--)
-        {
-            while (x->forw[i] != NULL && x->forw[i]->key < key) 
-            {
-                x = x->forw[i];
+        uint32_t height = random_level();
+        Node *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+
+        EpochGuard guard;
+        uint32_t top = level.load();
+        while (top < height && !level.compare_exchange_weak(top, height));
+
+        Node *node = NULL;
+        while (true) {
+            if (find(key, preds, succs)) {
+                if (node)
+                    Node::destroy(node);
+                return false;
             }
-            update[i] = x; 
+            if (!node)
+                node = Node::create(key, value, height);
+            node->next[0].store((uintptr_t)succs[0], std::memory_order_relaxed);
+            uintptr_t expected = (uintptr_t)succs[0];
+            if (preds[0]->next[0].compare_exchange_strong(expected, (uintptr_t)node))
+                break;
         }
-
-        x = x->forw[0];
-
-        if (x == NULL || x->key != key) 
-        {        
-            if (lvl > level) 
-            {
-                for (int i = level + 1;i <= lvl;i++) 
-                {
-                    update[i] = head;
-                }
-                level = lvl;
-            }
-
-            // x = new SkipNode(lvl, key, value);
-            x = new_node;
-            ctr++;
-
-            for (int i = 0;i <= lvl;i++) 
-            {
-                x->forw[i] = update[i]->forw[i];
-                update[i]->forw[i] = x;
+        ctr++;
+
+        // the node is in the list; link its upper levels
+        for (uint32_t i = 1; i < height; i++) {
+            while (true) {
+                node->next[i].store((uintptr_t)succs[i], std::memory_order_relaxed);
+                uintptr_t expected = (uintptr_t)succs[i];
+                if (preds[i]->next[i].compare_exchange_strong(expected, (uintptr_t)node))
+                    break;
+                find(key, preds, succs);
             }
-        } else {
-            x->value = value;
         }
-        unlock();
-        if (x != new_node)
-            delete new_node;
+        node->fullyLinked.store(true, std::memory_order_release);
         return true;
     }
 
     /*
      * Delete Element from Skip List
      */
-    void remove(Key_t key) 
+    void remove(Key_t key)
+    {
+        Node *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+        EpochGuard guard;
+        if (find(key, preds, succs) && claim(succs[0]))
+            unlink(succs[0]);
+    }
+
+    inline void * get()
     {
-        SkipNode<Key_t> *update[MAX_LEVEL + 1];
-        memset (update, 0, sizeof(SkipNode<Key_t>*) * (MAX_LEVEL + 1));
-        lock();
-        remove_internal(key, update);
-        unlock();
+        EpochGuard guard;
+        Node *first = firstNode();
+        return (first)? first->value.load() : NULL;
     }
 
-    inline void * get() { return (head->forw[0])?  head->forw[0]->value : NULL; }
-    
     inline void * get(Key_t key)
     {
-        lock();
-        SkipNode<Key_t> * n = find(key);
-        unlock();
-        return (n)? n->value : NULL;
+        EpochGuard guard;
+        Node * n = search(key);
+        return (n)? n->value.load() : NULL;
     }
 
     inline void * pop()
     {
         void * val = NULL;
-        SkipNode<Key_t> *update[MAX_LEVEL + 1];
-        memset (update, 0, sizeof(SkipNode<Key_t>*) * (MAX_LEVEL + 1));
-        lock();
-        if (head->forw[0]) { 
-            val = head->forw[0]->value;
-            remove_internal(head->forw[0]->key, update);
-        }
-        unlock();
+        pop_until((Key_t)-1, &val, 1);
         return val;
     }
 
     inline void * try_pop(Key_t key)
     {
-      void * val = NULL;
-      if (head->forw[0]) {
-        SkipNode<Key_t> *update[MAX_LEVEL + 1];
-        memset (update, 0, sizeof(SkipNode<Key_t>*) * (MAX_LEVEL + 1));
-        lock();
-        if (head->forw[0] && (key >= head->forw[0]->key)) {
-            val = head->forw[0]->value;
-            remove_internal(head->forw[0]->key, update);
+        void * val = NULL;
+        pop_until(key, &val, 1);
+        return val;
+    }
+
+    /*
+     * Remove up to 'max' of the smallest elements whose keys are not above
+     * 'key', returning their values in vals[] and their count. Each element is
+     * the smallest at the time it is taken, so the values come in key order
+     * unless smaller keys are inserted meanwhile.
+     */
+    uint32_t pop_until(Key_t key, void **vals, uint32_t max)
+    {
+        uint32_t count = 0;
+        EpochGuard guard;
+        while (count < max) {
+            Node *first = firstNode();
+            if (first == NULL || first->key > key)
+                break;
+            if (claim(first)) {
+                vals[count++] = first->value.load();
+                unlink(first);
+            }
         }
-        unlock();
-      }
-      return val;
+        return count;
     }
 
-    inline uint64_t firstkey()  { return (head->forw[0])?  head->forw[0]->key : head->key; }
+    inline uint64_t firstkey()
+    {
+        EpochGuard guard;
+        Node *first = firstNode();
+        return (first)?  first->key : head->key;
+    }
 
     inline uint64_t lastkey()
     {
-        SkipNode<Key_t> *tmp = head;
-        while (tmp->forw[0]) tmp = tmp->forw[0];
+        EpochGuard guard;
+        Node *tmp = head;
+        for (int i = (int)level.load() - 1; i >= 0; i--) {
+            Node *n;
+            while ((n = Node::toNode(tmp->next[i].load())) != NULL)
+                tmp = n;
+        }
         return tmp->key;
     }
-    
+
     uint32_t maxLevel = MAX_LEVEL;
     float probability;
     atomic<uint32_t> ctr;
 
   private:
+    atomic<uint32_t> level; //height of the tallest node ever inserted
 
-    inline int random_level()
+    inline uint32_t random_level()
     {
-        int v = 1;
-
-        while ((((double)std::rand() / RAND_MAX)) < probability && 
-           std::abs(v) < MAX_LEVEL) {
-            v += 1;
+        static thread_local uint64_t seed = (uint64_t)&seed ^ 0x9E3779B97F4A7C15ul;
+        uint32_t threshold = (uint32_t)(probability * 4294967295.0);
+        uint32_t v = 1;
+        while (v < MAX_LEVEL) {
+            //xorshift64
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            if ((uint32_t)seed >= threshold)
+                break;
+            v++;
         }
-        return std::abs(v);
-        //return std::rand() % MAX_LEVEL;
+        return v;
     }
 
     /*
-     * Search Elemets in Skip List
+     * Locate the predecessor and successor of key at each level, unlinking
+     * the marked nodes met on the way. Returns true if succs[0] holds key.
      */
-    SkipNode<Key_t> * find(Key_t key) 
+    bool find(Key_t key, Node **preds, Node **succs)
     {
-        SkipNode<Key_t> *x = head, *ret;
-
-        for (int i = level; i >= 0; i--)
-        {
-            while (x->forw[i] != NULL && x->forw[i]->key < key)
-            {
-                x = x->forw[i];
+    retry:
+        Node *pred = head;
+        for (int i = (int)level.load() - 1; i >= 0; i--) {
+            Node *curr = Node::toNode(pred->next[i].load());
+            while (curr) {
+                uintptr_t succ = curr->next[i].load();
+                while (Node::isMarked(succ)) {
+                    uintptr_t expected = (uintptr_t)curr;
+                    if (!pred->next[i].compare_exchange_strong(expected, succ & ~1ul))
+                        goto retry;
+                    curr = Node::toNode(succ);
+                    if (!curr)
+                        break;
+                    succ = curr->next[i].load();
+                }
+                if (curr && curr->key < key) {
+                    pred = curr;
+                    curr = Node::toNode(succ);
+                } else {
+                    break;
+                }
             }
+            preds[i] = pred;
+            succs[i] = curr;
         }
-
-        x = x->forw[0];
-        ret = (x != NULL && x->key == key)? x : NULL;
-        return ret;
+        return succs[0] && succs[0]->key == key;
     }
 
     /*
-     * Delete Element from Skip List
+     * Locate key without unlinking anything; the node returned is not removed.
      */
-    void remove_internal(Key_t key, SkipNode<Key_t> **update)
+    Node * search(Key_t key)
     {
-        SkipNode<Key_t> *x = head;
-        /* The update buffer (below 2 lines) is now passed in by the caller to shorten critical section */
-        // SkipNode<Key_t> *update[MAX_LEVEL + 1];
-        // memset (update, 0, sizeof(SkipNode<Key_t>*) * (MAX_LEVEL + 1));
-
-        for (int i = level; i >= 0; i--)
-        {
-            while (x->forw[i] != NULL && x->forw[i]->key < key)
-            {
-                x = x->forw[i];
+        Node *pred = head;
+        Node *curr = NULL;
+        for (int i = (int)level.load() - 1; i >= 0; i--) {
+            curr = Node::toNode(pred->next[i].load());
+            while (curr) {
+                uintptr_t succ = curr->next[i].load();
+                if (Node::isMarked(succ)) {
+                    curr = Node::toNode(succ);
+                } else if (curr->key < key) {
+                    pred = curr;
+                    curr = Node::toNode(succ);
+                } else {
+                    break;
+                }
             }
-            update[i] = x;
         }
+        return (curr && curr->key == key && !Node::isMarked(curr->next[0].load())) ? curr : NULL;
+    }
 
-        x = x->forw[0];
-
-        if (x != NULL && x->key == key) 
-        {
-            for (int i = 0;i <= level;i++)
-            {
-                if (update[i]->forw[i] != x)
-                    break;
-
-                update[i]->forw[i] = x->forw[i];
-            }
+    // the smallest element not being removed
+    inline Node * firstNode()
+    {
+        Node *curr = Node::toNode(head->next[0].load());
+        while (curr && Node::isMarked(curr->next[0].load()))
+            curr = Node::toNode(curr->next[0].load());
+        return curr;
+    }
 
-            delete x;
-            ctr--;
-            while (level > 0 && head->forw[level] == NULL)
-            {
-                level--;
-            }
+    /*
+     * Mark the links of node top-down. Returns true if this thread marked
+     * level 0, which makes it the owner of the removal.
+     */
+    bool claim(Node *node)
+    {
+        while (!node->fullyLinked.load(std::memory_order_acquire))
+            _mm_pause();
+        for (int i = (int)node->height - 1; i >= 1; i--) {
+            uintptr_t succ = node->next[i].load();
+            while (!Node::isMarked(succ))
+                node->next[i].compare_exchange_weak(succ, succ | 1);
+        }
+        uintptr_t succ = node->next[0].load();
+        while (!Node::isMarked(succ)) {
+            if (node->next[0].compare_exchange_weak(succ, succ | 1))
+                return true;
         }
+        return false;
     }
 
-	int volatile lock_;	// CAS spin lock
-    inline void lock()
+    // physically remove a claimed node and retire it
+    void unlink(Node *node)
     {
-        // Disable retry and implement a pure spin lcok for now.
-        // uint32_t ntry = 0;
-        while (!__sync_bool_compare_and_swap (&lock_, 0, 1)) {
-            /*
-            if (ntry++ > 20) {
-                sched_yield();
-                ntry = 0;
-            }
-            */
-        }
+        Node *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+        find(node->key, preds, succs);
+        ctr--;
+        EpochManager::instance().retire(node, Node::destroy);
     }
-    inline void unlock() { assert(lock_ == 1); while (!__sync_bool_compare_and_swap (&lock_, 1, 0)); }
 };
 
 } // QDB
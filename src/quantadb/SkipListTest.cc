@@ -290,4 +290,93 @@ TEST_F(SkiplistTest, MtCorrectnessTest) {
     EXPECT_EQ(s.ctr, (uint32_t)0);
 }
 
+TEST_F(SkiplistTest, popUntil) {
+    void *vals[16];
+    EXPECT_EQ(0u, s.pop_until(100, vals, 16));
+
+    for (uint64_t i = 0; i < 100; ++i)
+        s.insert(99 - i, buf[99 - i]);
+    EXPECT_EQ(100u, s.ctr.load());
+
+    // only the due elements, in key order, at most 'max' at a time
+    EXPECT_EQ(10u, s.pop_until(9, vals, 16));
+    for (uint32_t i = 0; i < 10; ++i)
+        EXPECT_EQ(buf[i], vals[i]);
+    EXPECT_EQ(16u, s.pop_until(50, vals, 16));
+    for (uint32_t i = 0; i < 16; ++i)
+        EXPECT_EQ(buf[10 + i], vals[i]);
+    EXPECT_EQ(0u, s.pop_until(5, vals, 16));
+    EXPECT_EQ(26u, s.firstkey());
+    EXPECT_EQ(99u, s.lastkey());
+    EXPECT_EQ(74u, s.ctr.load());
+    EXPECT_FALSE(s.contains(25));
+    EXPECT_TRUE(s.contains(26));
+}
+
+TEST_F(SkiplistTest, duplicateKey) {
+    // the first element of a key stays, a second one is turned away
+    EXPECT_TRUE(s.insert(5, buf[5]));
+    EXPECT_FALSE(s.insert(5, buf[6]));
+    EXPECT_EQ(buf[5], s.get(5));
+    EXPECT_EQ(1u, s.ctr.load());
+
+    EXPECT_EQ(buf[5], s.pop());
+    EXPECT_TRUE(s.insert(5, buf[6]));
+    EXPECT_EQ(buf[6], s.get(5));
+}
+
+void mtProduceTest(SkiplistTest *t, uint32_t start, uint32_t stride, uint32_t len)
+{
+    for (uint32_t i = start; i < len; i += stride) {
+        t->s.insert(i, t->buf[i]);
+    }
+}
+
+TEST_F(SkiplistTest, MtPopUntilTest) {
+    // three producers insert interleaved keys while one consumer drains them
+    const uint32_t len = 30000;
+    std::thread t1(mtProduceTest, this, 0, 3, len);
+    std::thread t2(mtProduceTest, this, 1, 3, len);
+    std::thread t3(mtProduceTest, this, 2, 3, len);
+
+    std::vector<bool> seen(len, false);
+    uint32_t total = 0;
+    void *vals[32];
+    while (total < len) {
+        uint32_t n = s.pop_until((uint64_t)-1, vals, 32);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint64_t key = atol((char *)vals[i]);
+            EXPECT_FALSE(seen[key]);
+            seen[key] = true;
+        }
+        total += n;
+    }
+    t1.join();
+    t2.join();
+    t3.join();
+
+    EXPECT_EQ(len, total);
+    EXPECT_EQ(0u, s.ctr.load());
+    EXPECT_EQ(nullptr, s.pop());
+}
+
+TEST_F(SkiplistTest, benchPopUntil) {
+    uint64_t start, stop;
+    const uint32_t batch = 32;
+    void *vals[batch];
+
+    for (uint64_t i = 0; i < loop; ++i)
+        s.insert(randkey[i], buf[randkey[i]]);
+    uint32_t count = s.ctr;
+
+    start = Cycles::rdtscp();
+    uint32_t popped = 0;
+    while (popped < count)
+        popped += s.pop_until((uint64_t)-1, vals, batch);
+    stop = Cycles::rdtscp();
+    EXPECT_EQ(count, popped);
+    GTEST_COUT << "Skiplist pop_until() of " << batch << ":"
+    << Cycles::toNanoseconds(stop - start)/count << " nano sec per element " << std::endl;
+}
+
 }  // namespace RAMCloud
@@ -13,6 +13,7 @@
  *  limitations under the License.
  */
 
+#pragma once
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -47,12 +48,28 @@ class Slab {
         uint64_t        sig;
         struct  magazine * next;
         objhdr_t * objptr;
+        uint64_t        mapsz; // non-zero if mmap'ed
     } magazine_t;
 
+    #define SLAB_TAG_SHIFT  48
+    #define SLAB_PTR_MASK   ((1ul << SLAB_TAG_SHIFT) - 1)
+    static inline objhdr_t * toObj(uint64_t head) { return (objhdr_t *)(head & SLAB_PTR_MASK); }
+
   public:
-    Slab(uint32_t objsize, uint32_t mag_capacity = 1024*1024) {
+    /*
+     * With hugepage set, magazines are mmap'ed and rounded up to 2MB, using
+     * MAP_HUGETLB when huge pages are reserved and MADV_HUGEPAGE otherwise.
+     *
+     * get() and put() may run concurrently from any threads. The free list
+     * head carries a tag in its top 16 bits, bumped by every get(), so that a
+     * get() racing with another that takes the head and puts it back fails
+     * its CAS instead of installing a stale next (ABA). Magazines are never
+     * unmapped before the Slab, so reading the next of a taken object is safe.
+     */
+    Slab(uint32_t objsize, uint32_t mag_capacity = 1024*1024, bool hugepage = false) {
         objsz   = objsize;
         magacap = mag_capacity;
+        use_hugepage = hugepage;
         bullet_size = sizeof(objhdr_t) + SIZEOF8(objsz);
         add_magazine();
     }
@@ -62,17 +79,22 @@ class Slab {
             magazine_t * mag = maghead;
             assert(mag->sig == SLAB_MAG_SIG);
             maghead = maghead->next;
-            free(mag);
+            if (mag->mapsz)
+                munmap(mag, mag->mapsz);
+            else
+                free(mag);
         }
     };
 
     void * get()
     {
+        uint64_t head;
         objhdr_t *obj;
         do {
-            while (!(obj = objfree))
+            while (!(obj = toObj(head = objfree)))
                 add_magazine();
-        } while (!__sync_bool_compare_and_swap(&objfree, obj, obj->next));
+        } while (!__sync_bool_compare_and_swap(&objfree, head,
+                (uint64_t)obj->next | ((head & ~SLAB_PTR_MASK) + (1ul << SLAB_TAG_SHIFT))));
         return &obj[1];
     }
 
@@ -80,14 +102,16 @@ class Slab {
     {
         objhdr_t *obj = &((objhdr_t*)ptr)[-1];
         assert(obj->sig == SLAB_OBJ_SIG);
+        uint64_t head;
         do {
-            obj->next = objfree;
-        } while (!__sync_bool_compare_and_swap(&objfree, obj->next, obj));
+            head = objfree;
+            obj->next = toObj(head);
+        } while (!__sync_bool_compare_and_swap(&objfree, head, (uint64_t)obj | (head & ~SLAB_PTR_MASK)));
     }
 
     uint32_t count_free()
     {
-        objhdr_t *obj = objfree;
+        objhdr_t *obj = toObj(objfree);
         uint32_t cnt = 0;
         while (obj) {
             cnt++;
@@ -96,12 +120,39 @@ class Slab {
         return cnt;
     }
 
+    uint32_t count_magazines() { return nmagazine; }
+
+    uint32_t capacity() { return nmagazine * magacap; }
+
   private:
+    magazine_t * alloc_magazine()
+    {
+        uint64_t size = sizeof(magazine_t) + (uint64_t)bullet_size * magacap;
+        if (!use_hugepage) {
+            magazine_t *mag = (magazine_t *)malloc(size);
+            mag->mapsz = 0;
+            return mag;
+        }
+        #define SLAB_HUGEPAGE_SIZE (2UL*1024*1024)
+        size = ROUNDUP(size, SLAB_HUGEPAGE_SIZE);
+        void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED) {
+            ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            assert(ptr != MAP_FAILED);
+            madvise(ptr, size, MADV_HUGEPAGE);
+        }
+        magazine_t *mag = (magazine_t *)ptr;
+        mag->mapsz = size;
+        return mag;
+    }
+
     void add_magazine()
     {
-        magazine_t *mag = (magazine_t *)malloc(sizeof(magazine_t) + bullet_size * magacap);
+        magazine_t *mag = alloc_magazine();
         mag->sig    = SLAB_MAG_SIG;
         mag->objptr = (objhdr_t *)&mag[1]; 
+        __sync_fetch_and_add(&nmagazine, 1);
 
         do {
             mag->next = maghead;
@@ -115,10 +166,12 @@ class Slab {
         }
     }
 
-    objhdr_t   * objfree = NULL;
+    volatile uint64_t objfree = 0;  // tagged head of the free list
     magazine_t * maghead = NULL;
     uint32_t objsz; 
     uint32_t magacap; // magazine capacity
     uint32_t bullet_size;
+    uint32_t nmagazine = 0;
+    bool     use_hugepage;
 };
 } // End QDB namespace
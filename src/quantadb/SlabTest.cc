@@ -61,6 +61,38 @@ TEST_F(SlabTest, SlabUnitTest)
     free (foo);
 }
 
+void slabChurn(Slab *slab, uint64_t id, std::atomic<uint64_t> *collisions)
+{
+    void *held[8];
+    for (uint32_t round = 0; round < 100000; round++) {
+        for (uint32_t i = 0; i < 8; i++) {
+            held[i] = slab->get();
+            *(uint64_t *)held[i] = id;
+        }
+        for (uint32_t i = 0; i < 8; i++) {
+            if (*(uint64_t *)held[i] != id)
+                (*collisions)++; // handed out to another thread too
+            slab->put(held[i]);
+        }
+    }
+}
+
+TEST_F(SlabTest, SlabMtTest)
+{
+    // threads taking and putting back the same few objects, where an ABA would hand one out twice
+    std::atomic<uint64_t> collisions{0};
+    std::thread t1(slabChurn, slab, 1, &collisions);
+    std::thread t2(slabChurn, slab, 2, &collisions);
+    std::thread t3(slabChurn, slab, 3, &collisions);
+    std::thread t4(slabChurn, slab, 4, &collisions);
+    t1.join();
+    t2.join();
+    t3.join();
+    t4.join();
+    EXPECT_EQ(0u, collisions.load());
+    EXPECT_EQ(slab->capacity(), slab->count_free());
+}
+
 TEST_F(SlabBench, SlabBench)
 {
     uint32_t loop = 1024*1024;
@@ -0,0 +1,154 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <algorithm>
+#include "TimingWheel.h"
+#include "ValueArena.h"
+
+namespace QDB {
+
+const uint32_t TimingWheel::TICK_SHIFT;
+const uint64_t TimingWheel::SLOTS;
+
+TimingWheel::TimingWheel() {
+    //the cursor starts at tick 0, so every bucket is open for rotation 0
+    for (uint64_t i = 0; i < SLOTS; i++)
+        slots[i].store(0);
+}
+
+TimingWheel::~TimingWheel() {
+    for (uint64_t i = 0; i < SLOTS; i++)
+        take(slots[i].exchange(0));
+    take(lateList.exchange(0));
+    void *far[32];
+    uint32_t n;
+    while ((n = overflow.pop_until((__uint128_t)-1, far, 32)) > 0) {
+        for (uint32_t i = 0; i < n; i++)
+            ValueArena::instance().free(far[i]);
+    }
+    //the CIs themselves are not owned
+}
+
+inline bool
+TimingWheel::push(std::atomic<uint64_t> &head, Node *node, uint64_t tag) {
+    uint64_t old = head.load();
+    do {
+        if ((old & ~PTR_MASK) != tag)
+            return false; //the bucket has been drained for this rotation
+        node->next = (Node *)(old & PTR_MASK);
+    } while (!head.compare_exchange_weak(old, (uint64_t)node | tag));
+    return true;
+}
+
+bool
+TimingWheel::insert(__uint128_t cts, void *value) {
+    uint64_t tick = toTick(cts);
+    uint64_t now = cursor.load();
+    Node *node = (Node *)ValueArena::instance().alloc(sizeof(Node));
+    assert(((uint64_t)node & ~PTR_MASK) == 0);
+    node->cts = cts;
+    node->value = value;
+    ctr++;
+    if (tick >= now + SLOTS) {
+        //like the reorderQueue, the overflow turns away a second CI of a CTS
+        if (!overflow.insert(cts, node)) {
+            ctr--;
+            ValueArena::instance().free(node);
+            return false;
+        }
+        overflowCount++;
+        return true;
+    }
+    if (tick >= now && push(slots[tick % SLOTS], node, toTag(tick)))
+        return true;
+
+    //due already: the late list is open for any rotation
+    lateCount++;
+    push(lateList, node, 0);
+    return true;
+}
+
+void
+TimingWheel::take(uint64_t list) {
+    Node *node = (Node *)(list & PTR_MASK);
+    if (node)
+        isPendingSorted = false;
+    while (node) {
+        Node *next = node->next;
+        pending.push_back({node->cts, node->value});
+        ValueArena::instance().free(node);
+        node = next;
+    }
+}
+
+void
+TimingWheel::drainTo(uint64_t dueTick) {
+    uint64_t tick = cursor.load();
+    if (dueTick < tick)
+        return;
+
+    if (dueTick - tick >= SLOTS) {
+        //a jump of a whole rotation or more: drain every bucket once and open
+        //it for the rotation of its first tick past dueTick
+        uint64_t next = dueTick + 1;
+        for (uint64_t i = 0; i < SLOTS; i++) {
+            uint64_t first = next + (i + SLOTS - next % SLOTS) % SLOTS;
+            take(slots[i].exchange(toTag(first)));
+        }
+        cursor.store(next);
+        return;
+    }
+
+    for (; tick <= dueTick; tick++)
+        take(slots[tick % SLOTS].exchange(toTag(tick + SLOTS)));
+    cursor.store(tick);
+}
+
+uint32_t
+TimingWheel::pop_until(__uint128_t cts, void **vals, uint32_t max) {
+    drainTo(toTick(cts));
+    take(lateList.exchange(0));
+    void *far[32];
+    uint32_t n;
+    while ((n = overflow.pop_until(cts, far, 32)) > 0) {
+        for (uint32_t i = 0; i < n; i++) {
+            Node *node = (Node *)far[i];
+            pending.push_back({node->cts, node->value});
+            ValueArena::instance().free(node);
+        }
+        isPendingSorted = false;
+    }
+
+    if (!isPendingSorted) {
+        std::sort(pending.begin() + pendingHead, pending.end(),
+                [](const Entry &a, const Entry &b) { return a.cts < b.cts; });
+        isPendingSorted = true;
+    }
+
+    uint32_t count = 0;
+    while (count < max && pendingHead < pending.size() && pending[pendingHead].cts <= cts)
+        vals[count++] = pending[pendingHead++].value;
+    if (pendingHead == pending.size()) {
+        pending.clear();
+        pendingHead = 0;
+    } else if (pendingHead >= SLOTS && pendingHead * 2 >= pending.size()) {
+        pending.erase(pending.begin(), pending.begin() + pendingHead);
+        pendingHead = 0;
+    }
+    ctr -= count;
+    return count;
+}
+
+} // end namespace QDB
@@ -0,0 +1,106 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <atomic>
+#include <vector>
+#include "Common.h"
+#include "SkipList.h"
+
+namespace QDB {
+
+/**
+ * Reorder buffer of commit intents keyed by CTS, an alternative to the
+ * SkipList reorderQueue (see REORDER_TIMING_WHEEL).
+ *
+ * The Sequencer stamps a CI with its local time plus SEQUENCER_DELTA, so
+ * nearly every CI arriving here is due within a short, known window. The
+ * wheel has SLOTS buckets of 2^TICK_SHIFT ns each, about 1us, covering about
+ * 1ms ahead of the drain cursor. A CI is pushed onto the bucket of its tick
+ * with one CAS. CIs beyond the horizon go to an overflow SkipList, the outer
+ * level of the wheel, and CIs whose tick has already been drained go to a
+ * late list that is drained first.
+ *
+ * Expect many producers and one consumer. pop_until() drains the buckets up
+ * to the due tick, sorts what it took and hands the due CIs out in CTS order,
+ * so insertion is O(1) and extraction amortized O(1) per CI plus the sort
+ * within a bucket.
+ *
+ * Each bucket head carries the rotation it is open for in the top 16 bits, so
+ * a producer racing with the drain of its bucket finds the bucket already
+ * moved to the next rotation and diverts its CI to the late list.
+ */
+class TimingWheel {
+    PUBLIC:
+    static const uint32_t TICK_SHIFT = 10;
+    static const uint64_t SLOTS = 1024;
+
+    TimingWheel();
+    ~TimingWheel();
+
+    // false if turned away; a second CI of a CTS is, beyond the horizon only
+    bool insert(__uint128_t cts, void *value);
+
+    // up to max of the due CIs, in CTS order; returns their count
+    uint32_t pop_until(__uint128_t cts, void **vals, uint32_t max);
+
+    uint64_t count() { return ctr.load(); }
+    uint64_t getLateCount() { return lateCount.load(); }
+    uint64_t getOverflowCount() { return overflowCount.load(); }
+
+    PROTECTED:
+    struct Node {
+        __uint128_t cts;
+        void *value;
+        Node *next;
+    };
+
+    struct Entry {
+        __uint128_t cts;
+        void *value;
+    };
+
+    static const uint64_t TAG_SHIFT = 48;
+    static const uint64_t PTR_MASK = (1ul << TAG_SHIFT) - 1;
+
+    static inline uint64_t toTick(__uint128_t cts) { return (uint64_t)(cts >> 64) >> TICK_SHIFT; }
+    static inline uint64_t toTag(uint64_t tick) { return (tick / SLOTS) << TAG_SHIFT; }
+
+    inline bool push(std::atomic<uint64_t> &head, Node *node, uint64_t tag);
+    void take(uint64_t list);
+    void drainTo(uint64_t dueTick);
+
+    std::atomic<uint64_t> slots[SLOTS];
+    std::atomic<uint64_t> lateList{0};
+    std::atomic<uint64_t> cursor{0}; //ticks below it have been drained
+    SkipList<__uint128_t> overflow;
+
+    // consumer-side state: CIs taken out of the buckets but not yet due
+    std::vector<Entry> pending;
+    uint64_t pendingHead = 0;
+    bool isPendingSorted = true;
+
+    std::atomic<uint64_t> ctr{0};
+    std::atomic<uint64_t> lateCount{0};
+    std::atomic<uint64_t> overflowCount{0};
+
+    DISALLOW_COPY_AND_ASSIGN(TimingWheel);
+}; // end TimingWheel class
+
+} // end namespace QDB
+
+#endif  /* TIMING_WHEEL_H */
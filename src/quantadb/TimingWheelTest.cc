@@ -0,0 +1,195 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "TimingWheel.h"
+#include "SkipList.h"
+#include "Cycles.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+static inline __uint128_t
+makeCTS(uint64_t nsec, uint64_t id)
+{
+    return ((__uint128_t)nsec << 64) + id;
+}
+
+class TimingWheelTest : public ::testing::Test {
+  public:
+  TimingWheelTest() {};
+  ~TimingWheelTest() {};
+
+  TimingWheel wheel;
+  uint64_t base = 1000000000000ul; //an arbitrary cluster time, in nsec
+
+  DISALLOW_COPY_AND_ASSIGN(TimingWheelTest);
+};
+
+TEST_F(TimingWheelTest, order) {
+    void *vals[64];
+    //CIs spread over 50us, inserted out of order
+    for (uint64_t i = 0; i < 50; i++) {
+        uint64_t j = (i * 17) % 50;
+        EXPECT_TRUE(wheel.insert(makeCTS(base + j * 1000, j), (void *)(j + 1)));
+    }
+    EXPECT_EQ(50u, wheel.count());
+    EXPECT_EQ(0u, wheel.pop_until(makeCTS(base - 1, 0), vals, 64));
+
+    //due up to the middle of a bucket: only the CIs at or before the CTS
+    EXPECT_EQ(20u, wheel.pop_until(makeCTS(base + 19 * 1000, 19), vals, 64));
+    for (uint64_t i = 0; i < 20; i++)
+        EXPECT_EQ((void *)(i + 1), vals[i]);
+
+    //no more than max at a time
+    EXPECT_EQ(8u, wheel.pop_until(makeCTS(base + 100000, 0), vals, 8));
+    EXPECT_EQ(22u, wheel.pop_until(makeCTS(base + 100000, 0), vals, 64));
+    for (uint64_t i = 0; i < 22; i++)
+        EXPECT_EQ((void *)(i + 29), vals[i]);
+    EXPECT_EQ(0u, wheel.count());
+}
+
+TEST_F(TimingWheelTest, lateAndOverflow) {
+    void *vals[8];
+    EXPECT_EQ(0u, wheel.pop_until(makeCTS(base, 0), vals, 8));
+
+    //a CI of a tick already drained is still handed out, ahead of later ones
+    EXPECT_TRUE(wheel.insert(makeCTS(base + 2000, 2), (void *)2));
+    EXPECT_TRUE(wheel.insert(makeCTS(base - 5000, 1), (void *)1));
+    EXPECT_EQ(1u, wheel.getLateCount());
+    EXPECT_EQ(2u, wheel.pop_until(makeCTS(base + 3000, 0), vals, 8));
+    EXPECT_EQ((void *)1, vals[0]);
+    EXPECT_EQ((void *)2, vals[1]);
+
+    //beyond the horizon of the wheel
+    uint64_t far = base + 10 * (TimingWheel::SLOTS << TimingWheel::TICK_SHIFT);
+    EXPECT_TRUE(wheel.insert(makeCTS(far, 3), (void *)3));
+    EXPECT_FALSE(wheel.insert(makeCTS(far, 3), (void *)5));
+    EXPECT_EQ(1u, wheel.getOverflowCount());
+    EXPECT_EQ(1u, wheel.count());
+
+    //within the horizon a second CI of a CTS gets in, handed out next to the first
+    EXPECT_TRUE(wheel.insert(makeCTS(base + 4000, 6), (void *)6));
+    EXPECT_TRUE(wheel.insert(makeCTS(base + 4000, 6), (void *)7));
+    EXPECT_EQ(2u, wheel.pop_until(makeCTS(base + 5000, 0), vals, 8));
+    EXPECT_EQ(0u, wheel.pop_until(makeCTS(far - 1, 0), vals, 8));
+    EXPECT_EQ(1u, wheel.pop_until(makeCTS(far, 3), vals, 8));
+    EXPECT_EQ((void *)3, vals[0]);
+
+    //a jump of many rotations leaves every bucket open for its next tick
+    EXPECT_TRUE(wheel.insert(makeCTS(far + 2000, 4), (void *)4));
+    EXPECT_EQ(1u, wheel.pop_until((__uint128_t)-1, vals, 8));
+    EXPECT_EQ((void *)4, vals[0]);
+    EXPECT_EQ(0u, wheel.count());
+}
+
+void wheelProducer(TimingWheel *wheel, uint64_t base, uint32_t id, uint32_t producers, uint32_t len)
+{
+    for (uint32_t i = id; i < len; i += producers) {
+        wheel->insert(makeCTS(base + i * 100, i), (void *)(uint64_t)(i + 1));
+    }
+}
+
+TEST_F(TimingWheelTest, MtProducers) {
+    //four producers race with a consumer sweeping the due time forward
+    const uint32_t len = 100000;
+    std::thread t1(wheelProducer, &wheel, base, 0, 4, len);
+    std::thread t2(wheelProducer, &wheel, base, 1, 4, len);
+    std::thread t3(wheelProducer, &wheel, base, 2, 4, len);
+    std::thread t4(wheelProducer, &wheel, base, 3, 4, len);
+
+    std::vector<bool> seen(len, false);
+    uint32_t total = 0;
+    uint64_t now = base;
+    void *vals[32];
+    while (total < len) {
+        uint32_t n = wheel.pop_until(makeCTS(now, 0), vals, 32);
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t idx = (uint64_t)vals[i] - 1;
+            EXPECT_FALSE(seen[idx]);
+            seen[idx] = true;
+        }
+        total += n;
+        now += 50;
+    }
+    t1.join();
+    t2.join();
+    t3.join();
+    t4.join();
+    EXPECT_EQ(len, total);
+    EXPECT_EQ(0u, wheel.count());
+}
+
+/*
+ * CIs stamped 30us ahead of the local clock, as by the Sequencer, inserted by
+ * 'producers' threads while one thread takes them out as they fall due.
+ */
+template <class Q>
+void
+benchReorder(const char *name, uint32_t producers)
+{
+    Q queue;
+    const uint32_t perThread = 200000 / producers;
+    const uint32_t total = perThread * producers;
+    std::atomic<uint64_t> insertCycles{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            while (!go.load());
+            uint64_t start = Cycles::rdtsc();
+            for (uint32_t i = 0; i < perThread; i++) {
+                uint64_t now = Cycles::toNanoseconds(Cycles::rdtsc());
+                queue.insert(makeCTS(now + 30000, (uint64_t)p * perThread + i + 1), (void *)1);
+            }
+            insertCycles += Cycles::rdtsc() - start;
+        });
+    }
+    void *vals[32];
+    uint32_t popped = 0;
+    uint64_t popCycles = 0;
+    go = true;
+    uint64_t start = Cycles::rdtsc();
+    while (popped < total) {
+        uint64_t now = Cycles::toNanoseconds(Cycles::rdtsc());
+        uint64_t t = Cycles::rdtsc();
+        uint32_t n = queue.pop_until(makeCTS(now, 0), vals, 32);
+        if (n) {
+            popCycles += Cycles::rdtsc() - t;
+            popped += n;
+        }
+    }
+    uint64_t stop = Cycles::rdtsc();
+    for (auto &t : threads)
+        t.join();
+    EXPECT_EQ(total, popped);
+    GTEST_COUT << name << " producers=" << producers
+            << " insert:" << Cycles::toNanoseconds(insertCycles) / total << " ns"
+            << " pop_until:" << Cycles::toNanoseconds(popCycles) / total << " ns per CI"
+            << " total:" << Cycles::toNanoseconds(stop - start) / 1000 << " us" << std::endl;
+}
+
+TEST_F(TimingWheelTest, benchVsSkipList) {
+    for (uint32_t producers = 1; producers <= 32; producers *= 2) {
+        benchReorder<TimingWheel>("TimingWheel", producers);
+        benchReorder<SkipList<__uint128_t>>("SkipList   ", producers);
+    }
+}
+
+}  // namespace RAMCloud
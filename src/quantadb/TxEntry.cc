@@ -14,11 +14,76 @@
  */
 
 #include <iostream>
+#include <algorithm>
 #include "TxEntry.h"
-#include "ConcurrentBitmap.h"
+#include "ActiveTxSet.h"
 
 namespace QDB {
 
+/*
+ * Per-thread cache of TxEntry objects, trading with a shared Slab one object at
+ * a time. The RPC threads allocate the commit intents and the conclude threads
+ * retire them, so the objects go round through the Slab.
+ */
+static Slab&
+txEntrySlab()
+{
+    //never destroyed, so that thread caches may flush during static destruction
+    static Slab *slab = new Slab(sizeof(TxEntry), 1024);
+    return *slab;
+}
+
+struct TxEntryCache {
+    void *objs[TXENTRY_CACHE_CAPACITY];
+    uint32_t count = 0;
+    ~TxEntryCache() {
+        while (count > 0)
+            txEntrySlab().put(objs[--count]);
+    }
+};
+
+static thread_local TxEntryCache txEntryCache;
+
+void *
+TxEntry::operator new(size_t size)
+{
+    assert(size == sizeof(TxEntry));
+    //Slab bullets are 16-byte aligned for a size in multiples of 16, as for the 128-bit cts
+    if (txEntryCache.count > 0)
+        return txEntryCache.objs[--txEntryCache.count];
+    return txEntrySlab().get();
+}
+
+void
+TxEntry::operator delete(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    if (txEntryCache.count < TXENTRY_CACHE_CAPACITY)
+        txEntryCache.objs[txEntryCache.count++] = ptr;
+    else
+        txEntrySlab().put(ptr);
+}
+
+void
+TxPeerSet::insert(uint64_t peerId)
+{
+    uint32_t pos = std::lower_bound(peers, peers + count, peerId) - peers;
+    if (pos < count && peers[pos] == peerId)
+        return;
+    if (count == capacity) {
+        uint64_t *grown = new uint64_t[capacity * 2];
+        memcpy(grown, peers, sizeof(uint64_t) * count);
+        if (peers != inlinePeers)
+            delete[] peers;
+        peers = grown;
+        capacity *= 2;
+    }
+    memmove(&peers[pos + 1], &peers[pos], sizeof(uint64_t) * (count - pos));
+    peers[pos] = peerId;
+    count++;
+}
+
 TxEntry::TxEntry(uint32_t _readSetSize, uint32_t _writeSetSize) {
     if (_readSetSize > TUPLE_ENTRY_MAX || _writeSetSize > TUPLE_ENTRY_MAX) {
         printf("read or write set of the transaction exceeded the maximum supported size: %d", TUPLE_ENTRY_MAX);
@@ -29,54 +94,60 @@ TxEntry::TxEntry(uint32_t _readSetSize, uint32_t _writeSetSize) {
     txState = TX_PENDING;
     commitIntentState = TX_CI_UNQUEUED;
     cts = 0;
-    writeSetSize = _writeSetSize;
-    readSetSize = _readSetSize;
     readSetIndex = writeSetIndex = 0;
-    if (writeSetSize > 0) {
-        writeSet.reset(new KVLayout *[writeSetSize]);
-        writeSetHash.reset(new uint64_t[writeSetSize]);
-        writeSetInStore.reset(new KVLayout *[writeSetSize]);
-        writeSetKVSPtr.reset(new void *[writeSetSize]);
-        for (uint32_t i = 0; i < writeSetSize; i++) {
-            writeSet[i] = NULL;
-            writeSetInStore[i] = NULL;
-            writeSetKVSPtr[i] = NULL;
-            writeTupleSkipLock[i] = false;
-        }
-    }
-    if (readSetSize > 0) {
-        readSet.reset(new KVLayout *[readSetSize]);
-        readSetHash.reset(new uint64_t[readSetSize]);
-        readSetInStore.reset(new KVLayout *[readSetSize]);
-        readSetKVSPtr.reset(new void *[readSetSize]);
-        for (uint32_t i = 0; i < readSetSize; i++) {
-            readSet[i] = NULL;
-            readSetInStore[i] = NULL;
-            readSetKVSPtr[i] = NULL;
-            readTupleSkipLock[i] = false;
-        }
-    }
+    tupleBuf = NULL;
+    layoutSets(_readSetSize, _writeSetSize);
 
     rpcHandle = NULL;
 }
 
 
 TxEntry::~TxEntry() {
-    //Free KVLayout allocated in txCommit RPC handler
+    //Free KVLayout allocated in txCommit RPC handler, along with any value
+    //not handed over to the KV store
     for (uint32_t i = 0; i < writeSetSize; i++) {
         if (writeSet[i]) {
             if (writeSet[i]->meta().cStamp > 0)
                 continue; //a RMW - let it be free from read set
+            ValueArena::instance().free(writeSet[i]->v.valuePtr);
             delete writeSet[i];
             writeSet[i] = NULL;
         }
     }
     for (uint32_t i = 0; i < readSetSize; i++) {
         if (readSet[i]) {
+            ValueArena::instance().free(readSet[i]->v.valuePtr);
             delete readSet[i];
             readSet[i] = NULL;
         }
     }
+    delete[] tupleBuf;
+}
+
+void
+TxEntry::layoutSets(uint32_t _readSetSize, uint32_t _writeSetSize) {
+    writeSetSize = _writeSetSize;
+    readSetSize = _readSetSize;
+    uint32_t tuples = writeSetSize + readSetSize;
+    delete[] tupleBuf;
+    tupleBuf = (tuples > TXENTRY_INLINE_TUPLES) ? new uint64_t[tuples * TUPLE_WORDS] : NULL;
+    uint64_t *buf = tupleBuf ? tupleBuf : inlineTuples;
+    memset(buf, 0, sizeof(uint64_t) * tuples * TUPLE_WORDS);
+
+    //the arrays one after another, so that a scan of one is over contiguous memory
+    writeSet = (KVLayout **)buf;
+    writeSetHash = buf + writeSetSize;
+    writeSetInStore = (KVLayout **)(buf + writeSetSize * 2);
+    writeSetKVSPtr = (void **)(buf + writeSetSize * 3);
+    buf += writeSetSize * 4;
+    readSet = (KVLayout **)buf;
+    readSetHash = buf + readSetSize;
+    readSetInStore = (KVLayout **)(buf + readSetSize * 2);
+    readSetKVSPtr = (void **)(buf + readSetSize * 3);
+    lockIds = buf + readSetSize * 4;
+    lockIdCount = 0;
+    memset(writeTupleSkipLock, 0, sizeof(writeTupleSkipLock));
+    memset(readTupleSkipLock, 0, sizeof(readTupleSkipLock));
 }
 
 bool
@@ -87,12 +158,11 @@ TxEntry::insertReadSet(KVLayout* kv, uint32_t i) {
     readSetHash[i] = hash;
 
     //Apply local lock filter
-    uint64_t loc = ConcurrentBitmap::getBitLocation(hash);
-    auto lookup = lockTableFilter.find(loc);
-    if (lookup != lockTableFilter.end()) {
-        readTupleSkipLock[i] = true;
+    uint64_t loc = ActiveTxSet::getLockId(hash);
+    if (std::find(lockIds, lockIds + lockIdCount, loc) != lockIds + lockIdCount) {
+        readTupleSkipLock[i / 64] |= 1ul << (i % 64);
     } else {
-        lockTableFilter.insert(loc);
+        lockIds[lockIdCount++] = loc;
     }
     return true;
 }
@@ -105,12 +175,11 @@ TxEntry::insertWriteSet(KVLayout* kv, uint32_t i) {
     writeSetHash[i] = hash;
 
     //Apply local lock filter
-    uint64_t loc = ConcurrentBitmap::getBitLocation(hash);
-    auto lookup = lockTableFilter.find(loc);
-    if (lookup != lockTableFilter.end()) {
-      writeTupleSkipLock[i] = true;
+    uint64_t loc = ActiveTxSet::getLockId(hash);
+    if (std::find(lockIds, lockIds + lockIdCount, loc) != lockIds + lockIdCount) {
+        writeTupleSkipLock[i / 64] |= 1ul << (i % 64);
     } else {
-        lockTableFilter.insert(loc);
+        lockIds[lockIdCount++] = loc;
     }
 
     return true;
@@ -119,7 +188,7 @@ TxEntry::insertWriteSet(KVLayout* kv, uint32_t i) {
 bool
 TxEntry::correctReadSet(uint32_t size) {
     //This is a workaround function to correct the size of a possibly over-provisioned readSet.
-    //Because scoped_array vars are used, we do not need to worry about memory leak.
+    //The arrays stay where they are, so we do not need to worry about memory leak.
     //If there is over-provisioning, the null elements will be at the tail of the arrays.
     //By changing the readSetSize, the handling of the readSet will be the same as if there
     //were no over-provisioning at all.
@@ -211,8 +280,7 @@ TxEntry::serialize( outMemStream& out )
         // peerSet
         uint32_t peerSetSize = peerSet.size();
         out.write(&peerSetSize, sizeof(peerSetSize));
-        for(std::set<uint64_t>::iterator it = peerSet.begin(); it != peerSet.end(); it++) {
-            uint64_t peer = *it;
+        for (uint64_t peer : peerSet) {
             out.write(&peer, sizeof(peer));
         }
         out.write(&myPeerPosition, sizeof(myPeerPosition));
@@ -239,20 +307,21 @@ TxEntry::deSerialize_additional( inMemStream& in )
     in.read(&tmp, sizeof(commitIntentState));
     commitIntentState = tmp;
 
-    // writeSet
+    // writeSet, held aside until the size of readSet is known
+    KVLayout *ws[TUPLE_ENTRY_MAX];
     in.read(&nWriteSet, sizeof(nWriteSet));
-    writeSetSize = nWriteSet;
-    writeSet.reset(new KVLayout *[nWriteSet]);
+    assert(nWriteSet <= TUPLE_ENTRY_MAX);
     for (uint32_t i = 0; i < nWriteSet; i++) {
         KVLayout* kv = new KVLayout(0);
         kv->deSerialize(in);
-        writeSet[i] = kv;
+        ws[i] = kv;
     }
 
     // readSet
     in.read(&nReadSet, sizeof(nReadSet));
-    readSetSize = nReadSet;
-    readSet.reset(new KVLayout *[nReadSet]);
+    assert(nReadSet <= TUPLE_ENTRY_MAX);
+    layoutSets(nReadSet, nWriteSet);
+    memcpy(writeSet, ws, sizeof(KVLayout *) * nWriteSet);
     for (uint32_t i = 0; i < nReadSet; i++) {
         KVLayout* kv = new KVLayout(0);
         kv->deSerialize(in);
@@ -17,6 +17,7 @@
 #define TX_ENTRY_H
 
 #include "Common.h"
+#include "Cycles.h"
 #include "KVStore.h"
 #include <mutex>
 
@@ -24,6 +25,42 @@ namespace QDB {
 
 #define TUPLE_ENTRY_MAX 128
 
+//Read and write set tuples held in the TxEntry itself; larger sets take one allocation
+#ifndef TXENTRY_INLINE_TUPLES
+#define TXENTRY_INLINE_TUPLES 16
+#endif
+
+//Peers held in the TxEntry itself; more spill into an allocation
+#define TXENTRY_INLINE_PEERS 8
+
+//TxEntry objects cached per thread, see TxEntry::operator new
+#define TXENTRY_CACHE_CAPACITY 64
+
+/**
+ * Set of IDs of the participant shards of a transaction, excluding self.
+ * It is kept as a sorted array, in the order a std::set would iterate, so that
+ * the TxLog records are the same. A transaction has few participants, which fit
+ * in the array inline.
+ */
+class TxPeerSet {
+    PUBLIC:
+    TxPeerSet() : peers(inlinePeers), count(0), capacity(TXENTRY_INLINE_PEERS) {}
+    ~TxPeerSet() { if (peers != inlinePeers) delete[] peers; }
+    inline const uint64_t *begin() const { return peers; }
+    inline const uint64_t *end() const { return peers + count; }
+    inline uint32_t size() const { return count; }
+    inline void clear() { count = 0; }
+    void insert(uint64_t peerId);
+
+    PROTECTED:
+    uint64_t *peers;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t inlinePeers[TXENTRY_INLINE_PEERS];
+
+    DISALLOW_COPY_AND_ASSIGN(TxPeerSet);
+};
+
 /**
  * Each TxEntry object represents a single transaction.
  *
@@ -38,6 +75,11 @@ namespace QDB {
  * At the validator, its object contains the read set and write set of the local shard.
  * It uses the read set Bloom Filter and write set Bloom Filter to facilitate
  * dependency checking for serialization.
+ *
+ * The per-tuple arrays of both sets are carved out of one buffer, which is inline
+ * for sets of up to TXENTRY_INLINE_TUPLES tuples in total. Heap objects come from
+ * a per-thread cache, so a commit intent usually costs no allocation for the
+ * TxEntry itself.
  */
 class TxEntry {
     PROTECTED:
@@ -56,33 +98,32 @@ class TxEntry {
     void *rpcHandle;
 
     //Set of IDs of participant shards excluding self
-    ///use std::set for sake of equality check
-    std::set<uint64_t> peerSet;
+    TxPeerSet peerSet;
     uint8_t myPeerPosition = 0;
 
     //write set and read set under validation
     uint32_t writeSetSize;
     uint32_t readSetSize;
-    boost::scoped_array<KVLayout *> writeSet;
-    boost::scoped_array<KVLayout *> readSet;
+    KVLayout **writeSet;
+    KVLayout **readSet;
     /*
-     * Track the Tuple lock state.  If the lockTableFilter lookup performance
-     * is ok, we can elminate the write/readSetLockState array.  When we
-     * validate the transaction, we can simply iterate through the
-     * lockTableFilter to acquire the tuple locks.
+     * Track the Tuple lock state, one bit per tuple: set for a tuple whose
+     * lock is already taken by an earlier tuple of the transaction.
      */
-    bool writeTupleSkipLock[TUPLE_ENTRY_MAX];
-    bool readTupleSkipLock[TUPLE_ENTRY_MAX];
-    std::set<uint64_t> lockTableFilter;
+    uint64_t writeTupleSkipLock[TUPLE_ENTRY_MAX / 64];
+    uint64_t readTupleSkipLock[TUPLE_ENTRY_MAX / 64];
+    //IDs of the tuple locks taken so far, to fill in the bits above
+    uint64_t *lockIds;
+    uint32_t lockIdCount;
 
     //Cache the KVStore address, where the KV pointer is stored
-    boost::scoped_array<void *> writeSetKVSPtr;
-    boost::scoped_array<void *> readSetKVSPtr;
+    void **writeSetKVSPtr;
+    void **readSetKVSPtr;
 
     //TODO: remove KVLayout pointers cache
     //Handy pointer to KV store tuple that is matching the readSet/writeSet key
-    boost::scoped_array<KVLayout *> writeSetInStore;
-    boost::scoped_array<KVLayout *> readSetInStore;
+    KVLayout **writeSetInStore;
+    KVLayout **readSetInStore;
 
     //Handy index to resume active tx filter check
     uint32_t writeSetIndex;
@@ -90,12 +131,21 @@ class TxEntry {
 
     //Handy hash value of write/read key for Bloom Filter etc.
     //a 64-bit number is composed of 2 32-bit numbers in upper 32 bits and lower 32 bits
-    boost::scoped_array<uint64_t> writeSetHash;
-    boost::scoped_array<uint64_t> readSetHash;
+    uint64_t *writeSetHash;
+    uint64_t *readSetHash;
+
+    //Where the arrays above are: tupleBuf, or inlineTuples while the sets fit in
+    static const uint32_t TUPLE_WORDS = 5; //set, hash, in-store, KVS pointer, lock ID
+    uint64_t *tupleBuf;
+    uint64_t inlineTuples[TXENTRY_INLINE_TUPLES * TUPLE_WORDS];
+
+    void layoutSets(uint32_t readSetSize, uint32_t writeSetSize);
     PUBLIC:
     bool isOutOfOrder = false; //Fixme: can overload TxCIState later
+    uint32_t sealGeneration = 0; //nonzero while sealed but not yet in the KV store, see Validator::beginSeal()
     // local timer to track performance 
     uint64_t local_commit = 0; 
+    uint64_t admitTime = 0; //when it took an admission credit, 0 if it holds none
     enum {
     	//TX_CI_xxx states are for validator internal use to track the progress
     	//through the processing stages. The sequential order must be maintained.
@@ -122,6 +172,9 @@ class TxEntry {
 		TX_CI_FINISHED,
     };
 
+    //per-stage latency tracing, see setTxCIState(); not serialized
+    uint64_t ciStateTime[TX_CI_FINISHED + 1] = {};
+
     enum {
     	//TX_xxx states track tx state visible to outside components like peers and coordinator
 
@@ -160,6 +213,8 @@ class TxEntry {
 
     TxEntry(uint32_t readSetSize, uint32_t writeSetSize);
     ~TxEntry();
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr);
     inline __uint128_t getCTS() { return cts; }
     inline uint64_t getPStamp() { return pstamp; }
     inline uint64_t getSStamp() { return sstamp; }
@@ -168,27 +223,34 @@ class TxEntry {
     inline uint8_t getPeerPosition() { return myPeerPosition; }
     inline void* getRpcHandle() { return rpcHandle; }
     inline void insertPeerSet(uint64_t peerId) { peerSet.insert(peerId); }
-    inline  std::set< uint64_t>& getParticipantSet() { return peerSet; }
+    inline TxPeerSet& getParticipantSet() { return peerSet; }
     inline uint64_t getPeerSet() { return ((uint64_t)(1 << (peerSet.size() + 1)) - 1 ) ^ (1 << myPeerPosition); }
-    inline boost::scoped_array<KVLayout *>& getWriteSet() { return writeSet; }
-    inline boost::scoped_array<KVLayout *>& getReadSet() { return readSet; }
+    inline KVLayout **getWriteSet() { return writeSet; }
+    inline KVLayout **getReadSet() { return readSet; }
     inline uint32_t getWriteSetSize() { return writeSetSize; }
     inline uint32_t getReadSetSize() { return readSetSize; }
-    inline boost::scoped_array<uint64_t>& getWriteSetHash() { return writeSetHash; }
-    inline boost::scoped_array<uint64_t>& getReadSetHash() { return readSetHash; }
-    inline boost::scoped_array<KVLayout *>& getWriteSetInStore() { return writeSetInStore; }
-    inline boost::scoped_array<KVLayout *>& getReadSetInStore() { return readSetInStore; }
+    inline uint64_t *getWriteSetHash() { return writeSetHash; }
+    inline uint64_t *getReadSetHash() { return readSetHash; }
+    inline KVLayout **getWriteSetInStore() { return writeSetInStore; }
+    inline KVLayout **getReadSetInStore() { return readSetInStore; }
     inline void *getReadSetKVSPtr(uint64_t i) { return readSetKVSPtr[i]; }
     inline void *getWriteSetKVSPtr(uint64_t i) { return writeSetKVSPtr[i]; }
-    inline bool isReadTupleSkipLock(uint64_t i) { return readTupleSkipLock[i]; }
-    inline bool isWriteTupleSkipLock(uint64_t i) { return writeTupleSkipLock[i]; }
+    inline bool isReadTupleSkipLock(uint64_t i) { return (readTupleSkipLock[i / 64] >> (i % 64)) & 1; }
+    inline bool isWriteTupleSkipLock(uint64_t i) { return (writeTupleSkipLock[i / 64] >> (i % 64)) & 1; }
     inline uint32_t& getWriteSetIndex() { return writeSetIndex; }
     inline uint32_t& getReadSetIndex() { return readSetIndex; }
     inline void setCTS(__uint128_t val) { cts = val; }
     inline void setSStamp(uint64_t val) { sstamp = val; }
     inline void setPStamp(uint64_t val) { pstamp = val; }
     inline void setTxState(uint32_t val) { txState = val; }
-    inline void setTxCIState(uint32_t val) { commitIntentState = val; }
+    inline void setTxCIState(uint32_t val) {
+        commitIntentState = val;
+#if defined(MONITOR) || defined(TESTING)
+        ciStateTime[val] = RAMCloud::Cycles::rdtsc();
+#endif
+    }
+    // rdtsc when the CI last entered the state, 0 if it never did or is not traced
+    inline uint64_t getTxCIStateTime(uint32_t state) { return ciStateTime[state]; }
     inline void setPeerPosition(uint32_t val) { myPeerPosition = val; }
     inline void setTxResult(uint32_t val) { commitResult = val; }
     inline void setRpcHandle(void *rpc) { rpcHandle = rpc; }
@@ -235,6 +297,8 @@ class TxEntry {
     void deSerialize_common( inMemStream& in );
     void deSerialize_additional( inMemStream& in );
     void deSerialize( inMemStream& in );
+
+    DISALLOW_COPY_AND_ASSIGN(TxEntry);
 }; // end TXEntry class
 
 class TxComparator {
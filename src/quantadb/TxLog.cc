@@ -13,20 +13,76 @@
  *  limitations under the License.
  */
 
+#include <algorithm>
+#include <unordered_map>
+#include "Cycles.h"
+#include "Logger.h"
 #include "TxLog.h"
+#include "CtsHash.h"
 
 namespace QDB {
 
+using namespace RAMCloud;
+
+TxLog::TxLog(bool recovery_mode, std::string logid, bool group_commit,
+        DLogBackend backend, uint32_t async_flush_us)
+{
+    static std::atomic<uint64_t> nextLogNo{0};
+    std::string txlog_id(TXLOG_DIR);
+    txlog_id += "/" + logid;
+    log = new DLog<TXLOG_CHUNK_SIZE, 16>(txlog_id, recovery_mode, backend);
+    max_cts = 0;
+    logNo = nextLogNo++;
+    asyncFlushUs = async_flush_us;
+    isPersistPerRecord = !group_commit && async_flush_us == 0 && backend != DLOG_BACKEND_SHM;
+    if (recovery_mode)
+        buildIndex();
+    if (group_commit)
+        writer = new std::thread(&TxLog::groupCommitWriter, this);
+    else if (async_flush_us > 0)
+        flusher = new std::thread(&TxLog::asyncFlusher, this);
+}
+
+TxLog::~TxLog()
+{
+    if (writer) {
+        isAlive = false;
+        {
+            std::lock_guard<std::mutex> lock(writerLock);
+            writerCond.notify_one();
+        }
+        writer->join();
+        delete writer;
+    }
+    if (flusher) {
+        isAlive = false;
+        flusher->join();
+        delete flusher;
+        log->sync();
+    }
+    for (StagingBuffer_t *stage : stages)
+        delete stage;
+    //the log is left in place, for a later TxLog to recover from
+}
+
 bool
 TxLog::add(TxEntry *txEntry)
 {
+    if (writer)
+        return addGroupCommit(txEntry);
+
     uint32_t cts_marking = 0;
     __uint128_t cts = txEntry->getCTS();
 
     uint32_t logsize = txEntry->serializeSize();
     uint32_t totalsz = logsize + sizeof(TxLogHeader_t) + sizeof(TxLogTailer_t);
 
-    void *dst = log->reserve(totalsz); // First secure our position in the log space
+    std::unique_lock<std::mutex> appendGuard(appendLock, std::defer_lock);
+    if (isPersistPerRecord)
+        appendGuard.lock();
+    uint64_t seq = trimSeq.load();
+    uint64_t off;
+    void *dst = log->reserve(totalsz, &off); // First secure our position in the log space
 
     while (cts > max_cts) {
         __uint128_t curr_max = max_cts;
@@ -38,15 +94,370 @@ TxLog::add(TxEntry *txEntry)
     }
 
     TxLogHeader_t hdr = {totalsz|cts_marking, TX_LOG_HEAD_SIG};
-    TxLogTailer_t tal = {totalsz|cts_marking, TX_LOG_TAIL_SIG};
+    TxLogTailer_t tal = {totalsz|cts_marking, TX_LOG_TAIL_SIG, 0};
 
     outMemStream out((uint8_t*)dst, totalsz);
     out.write(&hdr, sizeof(hdr));
     txEntry->serialize( out );
+    tal.crc = log->checksum((uint8_t*)dst + sizeof(hdr), logsize);
     out.write(&tal, sizeof(tal));
+    if (isPersistPerRecord)
+        log->persist(dst, totalsz);
+    ctsIndex.put(cts, toPosition(dst, off, seq));
+    return true;
+}
+
+bool
+TxLog::isRecordIntact(TxLogHeader_t *hdr, uint32_t len)
+{
+    size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
+    uint32_t record_length = LOG_RECORD_LENGTH(hdr->length);
+    if (len < sizeof(TxLogHeader_t) || hdr->sig != TX_LOG_HEAD_SIG
+            || record_length < hdrsz || record_length > len)
+        return false;
+    TxLogTailer_t *tal = (TxLogTailer_t*)((char *)hdr + record_length - sizeof(TxLogTailer_t));
+    return tal->sig == TX_LOG_TAIL_SIG && tal->length == hdr->length
+            && tal->crc == log->checksum(&hdr[1], record_length - hdrsz);
+}
+
+void
+TxLog::asyncFlusher()
+{
+    while (isAlive) {
+        usleep(asyncFlushUs);
+        log->sync();
+    }
+}
+
+uint64_t
+TxLog::toPosition(void *addr, uint64_t off, uint64_t seq)
+{
+    uint64_t trimmed = trimmedBytes;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    while ((seq & 1) || trimSeq.load() != seq) {
+        // a trim ran since the reservation: off may be from before or after it
+        seq = trimSeq.load();
+        if (seq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        off = log->offset_of(addr);
+        trimmed = trimmedBytes;
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return off + trimmed;
+}
+
+void
+TxLog::buildIndex()
+{
+    uint32_t dlen;
+    uint64_t off = 0;
+    TxLogHeader_t * hdr;
+    size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
+
+    while ((hdr = (TxLogHeader_t*)log->getaddr (off, &dlen))) {
+        if (!isRecordIntact(hdr, dlen))
+            break; // torn by the crash
+        uint32_t record_length = LOG_RECORD_LENGTH(hdr->length);
+        inMemStream in((uint8_t*)&hdr[1], record_length - hdrsz);
+        TxEntry tx(1,1);
+        tx.deSerialize_common( in );
+        if (tx.getCTS() > max_cts)
+            max_cts = tx.getCTS();
+        ctsIndex.put(tx.getCTS(), off);
+        off += record_length;
+    }
+
+    // appends go on from the last intact record
+    if (off < log->size()) {
+        tornBytes = log->truncate(off);
+        RAMCLOUD_LOG(WARNING, "dropped %lu bytes torn by the crash from the tail of the TxLog", tornBytes);
+    }
+}
+
+void
+TxLog::trim(size_t off)
+{
+    std::lock_guard<std::mutex> trimGuard(trimMutex);
+    trimSeq++;
+    trimmedBytes += log->trim(off);
+    trimSeq++;
+    ctsIndex.dropBelow(trimmedBytes);
+}
+
+uint64_t
+TxLog::getTrimPoint(__uint128_t lowWatermark, uint64_t checkpointId, uint64_t &watermarkPoint)
+{
+    std::lock_guard<std::mutex> trimGuard(trimMutex);
+    std::unordered_map<__uint128_t, uint64_t, CtsHash> unconcluded; // CTS -> offset of its CI
+    uint64_t marker = UINT64_MAX; // offset of the checkpoint marker
+    bool isMarkerNeeded = checkpointId != 0;
+    size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
+
+    uint32_t dlen;
+    uint64_t off = 0;
+    TxLogHeader_t *hdr;
+    TxEntry tx(1,1);
+    bool isWatermarkReached = false;
+    while ((hdr = (TxLogHeader_t*)log->getaddr (off, &dlen))) {
+        if (!isRecordIntact(hdr, dlen))
+            break; // being written
+        uint32_t record_length = LOG_RECORD_LENGTH(hdr->length);
+        inMemStream in((uint8_t*)&hdr[1], record_length - hdrsz);
+        tx.deSerialize_common( in );
+        if (tx.getCTS() >= lowWatermark) {
+            isWatermarkReached = true;
+            break;
+        }
+        if (tx.getTxState() == TxEntry::TX_FABRICATED) {
+            if (isMarkerNeeded && marker == UINT64_MAX && isCheckpointMarker(hdr, checkpointId))
+                marker = off;
+        } else if (isMarkerNeeded && marker == UINT64_MAX) {
+            // the CIs concluded after the marker are replayed from their CI
+            if (tx.getTxState() == TxEntry::TX_PENDING)
+                unconcluded.emplace(tx.getCTS(), off);
+            else
+                unconcluded.erase(tx.getCTS());
+        }
+        off += record_length;
+    }
+    watermarkPoint = off;
+    if (isMarkerNeeded && marker == UINT64_MAX && !isWatermarkReached)
+        return 0; // no such marker, keep everything
+
+    uint64_t point = std::min(off, marker);
+    for (auto &it : unconcluded)
+        point = std::min(point, it.second);
+    return point;
+}
+
+uint64_t
+TxLog::trimBehind(__uint128_t lowWatermark, uint64_t checkpointId)
+{
+    uint64_t watermarkPoint;
+    uint64_t before = trimmedBytes;
+    uint64_t point = getTrimPoint(lowWatermark, checkpointId, watermarkPoint);
+
+    uint64_t trimmed = 0;
+    {
+        std::lock_guard<std::mutex> trimGuard(trimMutex);
+        if (trimmedBytes != before)
+            return 0; // the offsets moved under us
+        uint64_t length = log->chunk_aligned(point);
+        if (length > 0) {
+            trimSeq++;
+            trimmed = log->trim(length);
+            trimmedBytes += trimmed;
+            trimSeq++;
+            ctsIndex.dropBelow(trimmedBytes);
+            trimCount++;
+        }
+    }
+    trimLagBytes = watermarkPoint - trimmed;
+    return trimmed;
+}
+
+TxLog::StagingBuffer_t *
+TxLog::getStagingBuffer()
+{
+    //keyed by log number rather than address, as a TxLog may be replaced by another at the same address
+    static thread_local std::unordered_map<uint64_t, StagingBuffer_t *> myStages;
+    auto it = myStages.find(logNo);
+    if (it != myStages.end())
+        return it->second;
+
+    StagingBuffer_t *stage = new StagingBuffer_t;
+    std::lock_guard<std::mutex> lock(stagesLock);
+    stages.push_back(stage);
+    stageCount++;
+    myStages[logNo] = stage;
+    return stage;
+}
+
+bool
+TxLog::addGroupCommit(TxEntry *txEntry)
+{
+    StagingBuffer_t *stage = getStagingBuffer();
+    uint32_t logsize = txEntry->serializeSize();
+    uint32_t totalsz = logsize + sizeof(TxLogHeader_t) + sizeof(TxLogTailer_t);
+    uint64_t ticket;
+    uint64_t bytes;
+    bool isFirst = false;
+    bool isLast = false;
+
+    {
+        std::lock_guard<std::mutex> lock(stage->lock);
+        uint32_t off = stage->data.size();
+        stage->data.resize(off + totalsz);
+
+        // the writer sets the CTS marking, and the tail signature once the batch is in place
+        TxLogHeader_t hdr = {totalsz, TX_LOG_HEAD_SIG};
+        TxLogTailer_t tal = {totalsz, 0, 0};
+        outMemStream out(&stage->data[off], totalsz);
+        out.write(&hdr, sizeof(hdr));
+        txEntry->serialize( out );
+        tal.crc = log->checksum(&stage->data[off + sizeof(hdr)], logsize);
+        out.write(&tal, sizeof(tal));
+
+        if (stage->records.empty()) {
+            stage->oldestTsc = Cycles::rdtsc();
+            uint32_t waiting = waitingStages.fetch_add(1) + 1;
+            isFirst = waiting == 1;
+            isLast = waiting >= stageCount.load();
+        }
+        stage->records.push_back({off, totalsz, txEntry->getCTS()});
+        ticket = ++stage->staged;
+        bytes = pendingBytes += totalsz;
+    }
+
+    // the writer parks under writerLock after a last look at the stages, so it either sees
+    // this record or gets woken; a parked writer times the batch delay itself
+    if ((isFirst || isLast || bytes >= batchBytes) && isWriterParked.load()) {
+        std::lock_guard<std::mutex> lock(writerLock);
+        writerCond.notify_one();
+    }
+
+    while (stage->durable.load(std::memory_order_acquire) < ticket)
+        std::this_thread::yield();
     return true;
 }
 
+void
+TxLog::groupCommitWriter()
+{
+    uint64_t waitNs;
+    std::unique_lock<std::mutex> lock(writerLock);
+    while (isAlive) {
+        if (isBatchDue(waitNs)) {
+            lock.unlock();
+            writeBatch();
+            lock.lock();
+            continue;
+        }
+        isWriterParked = true;
+        if (isAlive && !isBatchDue(waitNs)) {
+            if (waitNs == UINT64_MAX)
+                writerCond.wait(lock);
+            else
+                writerCond.wait_for(lock, std::chrono::nanoseconds(waitNs));
+        }
+        isWriterParked = false;
+    }
+    lock.unlock();
+    writeBatch(); //let no thread wait forever
+}
+
+bool
+TxLog::isBatchDue(uint64_t &waitNs)
+{
+    waitNs = UINT64_MAX;
+    uint64_t bytes = pendingBytes.load();
+    if (bytes == 0)
+        return false;
+    // a thread with a record staged waits for it, so no more records can come
+    if (bytes >= batchBytes || waitingStages.load() >= stageCount.load())
+        return true;
+
+    uint64_t now = Cycles::rdtsc();
+    std::lock_guard<std::mutex> lock(stagesLock);
+    for (StagingBuffer_t *stage : stages) {
+        uint64_t oldest = stage->oldestTsc.load();
+        if (oldest == 0)
+            continue;
+        uint64_t age = Cycles::toNanoseconds(now - oldest);
+        if (age >= batchDelayNs)
+            return true;
+        waitNs = std::min(waitNs, batchDelayNs - age);
+    }
+    return false;
+}
+
+void
+TxLog::writeBatch()
+{
+    struct Taken {
+        StagingBuffer_t *stage;
+        std::vector<uint8_t> data;
+        std::vector<StagedRecord_t> records;
+        uint64_t staged;
+        uint64_t oldestTsc;
+    };
+    std::vector<Taken> taken;
+    uint64_t totalsz = 0;
+    uint64_t count = 0;
+
+    // take what every thread has staged
+    {
+        std::lock_guard<std::mutex> lock(stagesLock);
+        for (StagingBuffer_t *stage : stages) {
+            std::lock_guard<std::mutex> stageLock(stage->lock);
+            if (stage->records.empty())
+                continue;
+            taken.push_back({stage, {}, {}, stage->staged, stage->oldestTsc.load()});
+            taken.back().data.swap(stage->data);
+            taken.back().records.swap(stage->records);
+            stage->oldestTsc = 0;
+            waitingStages--;
+            totalsz += taken.back().data.size();
+            count += taken.back().records.size();
+        }
+    }
+    if (count == 0)
+        return;
+    pendingBytes -= totalsz;
+
+    // one region for the batch, with the records in log order
+    uint64_t seq = trimSeq.load();
+    uint64_t base;
+    uint8_t *dst = (uint8_t *)log->reserve(totalsz, &base);
+    base = toPosition(dst, base, seq);
+    uint8_t *pos = dst;
+    for (Taken &t : taken) {
+        memcpy(pos, t.data.data(), t.data.size());
+        for (StagedRecord_t &rec : t.records) {
+            if (rec.cts > max_cts) {
+                max_cts = rec.cts;
+                TxLogHeader_t *hdr = (TxLogHeader_t *)(pos + rec.offset);
+                TxLogTailer_t *tal = (TxLogTailer_t *)(pos + rec.offset + rec.length - sizeof(TxLogTailer_t));
+                hdr->length |= 0x80000000;
+                tal->length |= 0x80000000;
+            }
+        }
+        pos += t.data.size();
+    }
+
+    // readers take a valid tail signature to mean the record is complete
+    std::atomic_thread_fence(std::memory_order_release);
+    pos = dst;
+    for (Taken &t : taken) {
+        for (StagedRecord_t &rec : t.records) {
+            TxLogTailer_t *tal = (TxLogTailer_t *)(pos + rec.offset + rec.length - sizeof(TxLogTailer_t));
+            tal->sig = TX_LOG_TAIL_SIG;
+            ctsIndex.put(rec.cts, base + (pos - dst) + rec.offset);
+        }
+        pos += t.data.size();
+    }
+
+    log->persist(dst, totalsz);
+
+    uint64_t now = Cycles::rdtsc();
+    for (Taken &t : taken) {
+        t.stage->durable.store(t.staged, std::memory_order_release);
+        commitLatencyHist[histBucket(Cycles::toMicroseconds(now - t.oldestTsc))]++;
+
+        // hand the buffer back, to keep its capacity
+        std::lock_guard<std::mutex> stageLock(t.stage->lock);
+        if (t.stage->data.empty()) {
+            t.data.clear();
+            t.stage->data.swap(t.data);
+        }
+    }
+    batchRecordsHist[histBucket(count)]++;
+    batchCount++;
+    batchedBytes += totalsz;
+}
+
 bool
 TxLog::getFirstPendingTx(uint64_t &idOut, DSSNMeta &meta, std::set<uint64_t> &peerSet,
                         boost::scoped_array<KVLayout*> &writeSet)
@@ -63,9 +474,10 @@ TxLog::getNextPendingTx(uint64_t idIn, uint64_t &idOut, DSSNMeta &meta, std::set
         meta.pStamp = tx.getPStamp();
         meta.sStamp = tx.getSStamp();
         meta.cStamp = tx.getCTS();
-        peerSet =   tx.getParticipantSet();
+        peerSet.clear();
+        peerSet.insert(tx.getParticipantSet().begin(), tx.getParticipantSet().end());
         writeSet.reset(new KVLayout*[tx.getWriteSetIndex()]);
-        memcpy(writeSet.get(), tx.getWriteSet().get(), sizeof(KVLayout*) * tx.getWriteSetIndex()); 
+        memcpy(writeSet.get(), tx.getWriteSet(), sizeof(KVLayout*) * tx.getWriteSetIndex()); 
         return true;
     }
     return false;
@@ -74,6 +486,7 @@ TxLog::getNextPendingTx(uint64_t idIn, uint64_t &idOut, DSSNMeta &meta, std::set
 bool
 TxLog::getNextPendingTx(uint64_t idIn, uint64_t &idOut, TxEntry *txOut)
 {
+    std::lock_guard<std::mutex> trimGuard(trimMutex);
     uint32_t dlen, retry = 0;
     uint64_t off = idIn;
     TxLogHeader_t * hdr;
@@ -92,7 +505,7 @@ TxLog::getNextPendingTx(uint64_t idIn, uint64_t &idOut, TxEntry *txOut)
         retry = 0;
         off += record_length;
 
-        inMemStream in((uint8_t*)&hdr[1], record_length - sizeof(hdr) - sizeof(tal));
+        inMemStream in((uint8_t*)&hdr[1], record_length - sizeof(TxLogHeader_t) - sizeof(TxLogTailer_t));
         txOut->deSerialize( in );
         if (txOut->getTxState() == TxEntry::TX_PENDING) {
             idOut = off;
@@ -102,73 +515,186 @@ TxLog::getNextPendingTx(uint64_t idIn, uint64_t &idOut, TxEntry *txOut)
     return false;
 }
 
-uint32_t
-TxLog::getTxState(__uint128_t cts)
+bool
+TxLog::markCheckpoint(__uint128_t cts, uint64_t id)
+{
+    uint8_t key[] = {TXLOG_CHECKPOINT_KEY};
+    return fabricate(cts, key, sizeof(key), (uint8_t *)&id, sizeof(id));
+}
+
+bool
+TxLog::isCheckpointMarker(TxLogHeader_t *hdr, uint64_t id)
 {
-    uint32_t dlen, retry = 0;
-    TxLogTailer_t * tal;
     size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
+    inMemStream in((uint8_t*)&hdr[1], LOG_RECORD_LENGTH(hdr->length) - hdrsz);
+    TxEntry tx(0,0);
+    tx.deSerialize( in );
+    if (tx.getWriteSetSize() != 1)
+        return false;
+    KVLayout *kv = tx.getWriteSet()[0];
+    bool isMarker = kv->k.keyLength == 1 && kv->k.getkeybuf()[0] == TXLOG_CHECKPOINT_KEY
+            && kv->v.valueLength == sizeof(id) && memcmp(kv->v.valuePtr, &id, sizeof(id)) == 0;
+    return isMarker;
+}
 
-    // Search backward to find the latest matching Tx
-    size_t tail_off = size() - sizeof(TxLogTailer_t);;
-    while ((tail_off > 0) && (tal = (TxLogTailer_t*)log->getaddr (tail_off, &dlen))) {
-        if (tal->sig != TX_LOG_TAIL_SIG) {
-            usleep(1);
-            assert(retry++ < 100);
+bool
+TxLog::recoverFrom(uint64_t checkpointId, uint32_t nThreads,
+        std::vector<TxEntry *> &committed, std::vector<TxEntry *> &pending)
+{
+    struct TxRecords {
+        int64_t ci = -1;        // record with the CI
+        int64_t last = -1;      // latest record
+        uint32_t state = 0;     // of the latest record
+        uint64_t pStamp = 0;
+        uint64_t sStamp = 0;
+    };
+    std::lock_guard<std::mutex> trimGuard(trimMutex);
+    std::vector<TxLogHeader_t *> records;
+    std::unordered_map<__uint128_t, TxRecords, CtsHash> txs;
+    int64_t marker = (checkpointId == 0) ? -1 : INT64_MAX;
+    size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
+
+    // one pass over the fixed part of the records
+    uint32_t dlen;
+    uint64_t off = 0;
+    TxLogHeader_t *hdr;
+    TxEntry tx(1,1);
+    while ((hdr = (TxLogHeader_t*)log->getaddr (off, &dlen))) {
+        if (!isRecordIntact(hdr, dlen))
+            break; // torn by the crash
+        uint32_t record_length = LOG_RECORD_LENGTH(hdr->length);
+        off += record_length;
+        int64_t idx = records.size();
+        records.push_back(hdr);
+
+        inMemStream in((uint8_t*)&hdr[1], record_length - hdrsz);
+        tx.deSerialize_common( in );
+        if (tx.getTxState() == TxEntry::TX_FABRICATED) {
+            if (marker == INT64_MAX && isCheckpointMarker(hdr, checkpointId))
+                marker = idx;
             continue;
         }
-        retry = 0;
-        uint32_t record_length = LOG_RECORD_LENGTH(tal->length);
-        tail_off -= record_length;
+        TxRecords &recs = txs[tx.getCTS()];
+        if (tx.getTxState() == TxEntry::TX_PENDING && recs.ci < 0)
+            recs.ci = idx;
+        recs.last = idx;
+        recs.state = tx.getTxState();
+        recs.pStamp = tx.getPStamp();
+        recs.sStamp = tx.getSStamp();
+    }
+    if (marker == INT64_MAX) {
+        RAMCLOUD_LOG(ERROR, "checkpoint marker %lu not in the log", checkpointId);
+        return false;
+    }
 
-        inMemStream in((uint8_t*)tal - record_length + hdrsz, record_length - hdrsz);
-        TxEntry tx(1,1);
-        tx.deSerialize_common( in );
-        if (tx.getCTS() == cts) { 
-            return tx.getTxState(); 
+    // pick the txs to rebuild
+    struct Job {
+        int64_t ci;
+        TxRecords *recs;
+        TxEntry *txEntry;
+    };
+    std::vector<Job> jobs;
+    uint64_t lost = 0;
+    for (auto &it : txs) {
+        TxRecords &recs = it.second;
+        bool isNeeded = recs.state == TxEntry::TX_PENDING
+                || (recs.state == TxEntry::TX_COMMIT && recs.last > marker);
+        if (!isNeeded)
+            continue;
+        if (recs.ci < 0) {
+            lost++; // the CI has been trimmed
+            continue;
         }
+        jobs.push_back({recs.ci, &recs, NULL});
     }
-    return TxEntry::TX_ALERT; // indicating not found here
+    if (lost)
+        RAMCLOUD_LOG(ERROR, "%lu committed txs past the checkpoint have no CI in the log", lost);
+    std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.ci < b.ci; });
+
+    // deserialize the CIs in parallel
+    auto worker = [&](uint32_t first) {
+        for (size_t i = first; i < jobs.size(); i += nThreads) {
+            TxLogHeader_t *hdr = records[jobs[i].ci];
+            inMemStream in((uint8_t*)&hdr[1], LOG_RECORD_LENGTH(hdr->length) - hdrsz);
+            TxEntry *txEntry = new TxEntry(0,0);
+            txEntry->deSerialize( in );
+            if (jobs[i].recs->state == TxEntry::TX_COMMIT) {
+                txEntry->setTxState(TxEntry::TX_COMMIT);
+                txEntry->setPStamp(jobs[i].recs->pStamp);
+                txEntry->setSStamp(jobs[i].recs->sStamp);
+            }
+            jobs[i].txEntry = txEntry;
+        }
+    };
+    nThreads = std::max(nThreads, 1u);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < nThreads; i++)
+        threads.push_back(std::thread(worker, i));
+    worker(0);
+    for (auto &t : threads)
+        t.join();
+
+    for (Job &job : jobs) {
+        if (job.txEntry->getTxState() == TxEntry::TX_COMMIT)
+            committed.push_back(job.txEntry);
+        else
+            pending.push_back(job.txEntry);
+    }
+    return true;
 }
 
 bool
-TxLog::getTxInfo(__uint128_t cts, uint32_t &txState, uint64_t &pStamp, uint64_t &sStamp, uint8_t &myPosition)
+TxLog::lookup(__uint128_t cts, TxEntry &tx)
 {
-    uint32_t dlen, retry = 0;
-    TxLogTailer_t * tal;
+    uint64_t pos;
+    uint32_t dlen;
     size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
 
-    // Search backward to find the latest matching Tx
-    size_t tail_off = size() - sizeof(TxLogTailer_t);;
-    while ((tail_off > 0) && (tal = (TxLogTailer_t*)log->getaddr (tail_off, &dlen))) {
-        if (tal->sig != TX_LOG_TAIL_SIG) {
-            usleep(1);
-            assert(retry++ < 100);
+    if (!ctsIndex.get(cts, pos))
+        return false;
+    // the record stays mapped while the guard is held, even if trimmed meanwhile
+    EpochGuard guard;
+    TxLogHeader_t *hdr;
+    while (true) {
+        uint64_t seq = trimSeq.load();
+        if (seq & 1) {
+            std::this_thread::yield(); // being trimmed
             continue;
         }
-        retry = 0;
-        bool cts_marked = CTS_MARKED(tal->length);
-        uint32_t record_length = LOG_RECORD_LENGTH(tal->length);
-        tail_off -= record_length; // next tail
+        uint64_t trimmed = trimmedBytes;
+        if (pos < trimmed)
+            return false;
+        hdr = (TxLogHeader_t*)log->getaddr (pos - trimmed, &dlen);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (trimSeq.load() == seq)
+            break;
+    }
+    if (!hdr || hdr->sig != TX_LOG_HEAD_SIG)
+        return false;
+    inMemStream in((uint8_t*)&hdr[1], LOG_RECORD_LENGTH(hdr->length) - hdrsz);
+    tx.deSerialize_common( in );
+    return tx.getCTS() == cts;
+}
 
-        inMemStream in((uint8_t*)tal - record_length + hdrsz, record_length - hdrsz);
-        TxEntry tx(1,1);
-        tx.deSerialize_common( in );
-        __uint128_t myCTS = tx.getCTS();
-        uint32_t myState = tx.getTxState();
-        if (myCTS == cts) {
-            txState = myState;
-            pStamp = tx.getPStamp();
-            sStamp = tx.getSStamp();
-            myPosition = tx.getPeerPosition();
-            return true;
-        }
+uint32_t
+TxLog::getTxState(__uint128_t cts)
+{
+    TxEntry tx(1,1);
+    if (lookup(cts, tx))
+        return tx.getTxState();
+    return TxEntry::TX_ALERT; // indicating not found here
+}
 
-        if ((myCTS < cts) && cts_marked) {
-            // CTS_MARKED records are sorted (by CYS) in the txlog.
-            // If we see an older cts marked entry, no need to look further.
-            break;
-        }
+bool
+TxLog::getTxInfo(__uint128_t cts, uint32_t &txState, uint64_t &pStamp, uint64_t &sStamp, uint8_t &myPosition)
+{
+    TxEntry tx(1,1);
+    if (lookup(cts, tx)) {
+        txState = tx.getTxState();
+        pStamp = tx.getPStamp();
+        sStamp = tx.getSStamp();
+        myPosition = tx.getPeerPosition();
+        return true;
     }
     return false; // indicating not found here
 }
@@ -185,6 +711,7 @@ TxLog::fabricate(__uint128_t cts, uint8_t *key, uint32_t keyLength, uint8_t *val
     kvLayout->v.valueLength = valueLength;
     txEntry->insertWriteSet(kvLayout, 0);
     add(txEntry);
+    kvLayout->v.valuePtr = NULL; //caller's buffer, not from the value arena
     delete txEntry;
     return true;
 }
@@ -208,8 +735,8 @@ TxLog::dump(int fd)
 {
     TxLogTailer_t * tal;
     size_t hdrsz = sizeof(TxLogTailer_t) + sizeof(TxLogHeader_t);
-    std::set<uint64_t> peerSet;
 
+    std::lock_guard<std::mutex> trimGuard(trimMutex);
     dprintf(fd, "Dumping TxLog backward. Log data size: %ld bytes, free space %ld bytes\n\n", size(), free_space());
 
     // Search backward to find the latest matching Tx
@@ -217,7 +744,7 @@ TxLog::dump(int fd)
     while ((tail_off > 0) && (tal = (TxLogTailer_t*)log->getaddr (tail_off))) {
         uint32_t record_length = LOG_RECORD_LENGTH(tal->length);
         assert(tal->sig == TX_LOG_TAIL_SIG);
-        TxLogHeader_t *hdr = (TxLogHeader_t*) ((char*)tal - record_length + sizeof(TxLogHeader_t));
+        TxLogHeader_t *hdr = (TxLogHeader_t*) ((char*)tal - record_length + sizeof(TxLogTailer_t));
         assert(hdr->sig == TX_LOG_HEAD_SIG);
         assert(tal->length == hdr->length);
 
@@ -229,7 +756,7 @@ TxLog::dump(int fd)
         txSz = tx->serializeSize(&wsetSz, &rsetSz, &peerSz);
 
         dprintf(fd, "Head_off %ld, Tail_off %ld, LogSz: %d, txSz:%d wrSetSz:%d rdSetSz:%d peerSetSz:%d \n",
-                tail_off - record_length + sizeof(TxLogHeader_t), tail_off, record_length,
+                tail_off - record_length + sizeof(TxLogTailer_t), tail_off, record_length,
                 txSz, wsetSz, rsetSz, peerSz);
 
         dprintf(fd, "CTS: %lu:%lu, TxState: %s, pStamp: %lu, sStamp: %lu, %s\n",
@@ -238,14 +765,12 @@ TxLog::dump(int fd)
             CTS_MARKED(tal->length)? "CTS MArking" : "");
 
         dprintf(fd, "\tpeerSet: ");
-        peerSet =   tx->getParticipantSet();
-        for(std::set<uint64_t>::iterator it = peerSet.begin(); it != peerSet.end(); it++) {
-            uint64_t peer = *it;
+        for (uint64_t peer : tx->getParticipantSet()) {
             dprintf(fd, "%lu, ", peer);
         }
         dprintf(fd, "\n\n");
 
-        KVLayout **writeSet = tx->getWriteSet().get();
+        KVLayout **writeSet = tx->getWriteSet();
         dprintf(fd, "\twriteSet: \n");
         for (uint32_t widx = 0; widx < tx->getWriteSetSize(); widx++) {
             KVLayout *kv = writeSet[widx];
@@ -262,7 +787,7 @@ TxLog::dump(int fd)
         }
         dprintf(fd, "\n");
 
-        KVLayout **readSet = tx->getReadSet().get();
+        KVLayout **readSet = tx->getReadSet();
         dprintf(fd, "\treadSet: \n");
         for (uint32_t ridx = 0; ridx < tx->getReadSetSize(); ridx++) {
             KVLayout *kv = readSet[ridx];
@@ -15,9 +15,32 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "Common.h"
 #include "TxEntry.h"
 #include "DLog.h"
+#include "CtsIndex.h"
+
+//make add() go through the group-commit writer
+#ifndef TXLOG_GROUP_COMMIT
+#define TXLOG_GROUP_COMMIT false
+#endif
+
+//where the log chunk files are, and what it takes to persist them; see DLogBackend
+#ifndef TXLOG_DIR
+#define TXLOG_DIR   "/dev/shm/txlog"
+#endif
+#ifndef TXLOG_BACKEND
+#define TXLOG_BACKEND DLOG_BACKEND_SHM
+#endif
+
+//persist the log every that many usec in the background instead of in add(), if not 0
+#ifndef TXLOG_ASYNC_FLUSH_US
+#define TXLOG_ASYNC_FLUSH_US 0
+#endif
 
 namespace QDB {
 /**
@@ -27,19 +50,53 @@ namespace QDB {
  * and detect not-yet-validated commit intents upon recovery.
  *
  * The class is responsible for maintaining and cleaning the logged tx info.
+ *
+ * In group-commit mode, add() serializes the record into a staging buffer of
+ * the calling thread and waits. A writer thread takes the records staged by
+ * all threads, reserves one log region for them, and makes the whole batch
+ * durable with a single DLog::persist(). A batch is written as soon as every
+ * thread with a staging buffer has a record waiting in it, as no more can come
+ * then; otherwise once it holds batchBytes or its oldest record has waited
+ * batchDelayNs, which trades commit latency against log bandwidth. The writer
+ * sleeps on writerCond in between.
+ *
+ * How a record is made durable depends on the backend of the log, see
+ * DLogBackend, and on the mode: a group-commit writer persists each batch; in
+ * async mode, a flusher thread persists the log every asyncFlushUs and a crash
+ * may lose the records of the last period; otherwise add() persists its own
+ * record. A record is persisted only after those in front of it, as recovery
+ * keeps the log up to the first torn record: per-record mode appends under
+ * appendLock, unless on tmpfs, where there is nothing to persist.
+ *
+ * The tailer of a record carries the CRC32C of the serialized tx. On recovery,
+ * buildIndex() truncates the log at the first record with a bad signature,
+ * length or checksum.
+ *
+ * getTxState() and getTxInfo() find the latest record of a CTS through an
+ * in-memory CtsIndex of log positions, rebuilt from the log on recovery. A
+ * position counts the bytes ever logged, so that it survives trims, which
+ * shift DLog offsets.
+ *
+ * trimBehind() releases the whole DLog chunks in front of the oldest record
+ * still needed, by peers asking for a tx state or by a restart. A trim shifts
+ * the DLog offsets, so it bumps trimSeq before and after changing them and
+ * trimmedBytes; appending and lookups read the offsets and trimmedBytes as
+ * under a seqlock, and retry on a trim. DLog keeps a trimmed chunk mapped for
+ * the lookups still reading it under an EpochGuard. The scans of the whole
+ * log hold trimMutex, which otherwise only the trims take.
  */
 class TxLog {
-    #define TXLOG_DIR   "/dev/shm/txlog"
     #define TXLOG_CHUNK_SIZE (1024*1024*1024)
+    #define TXLOG_BATCH_BYTES (256*1024)
+    #define TXLOG_BATCH_DELAY_NS 20000
+    #define TXLOG_HIST_BUCKETS 16
+    #define TXLOG_CHECKPOINT_KEY 3 //fabricated key of the checkpoint markers
     public:
 
-    TxLog(bool recovery_mode, std::string logid = "")
-    {
-        std::string txlog_id(TXLOG_DIR);
-        txlog_id += "/" + logid;
-        log = new DLog<TXLOG_CHUNK_SIZE, 16>(txlog_id, recovery_mode);
-        max_cts = 0;
-    }
+    TxLog(bool recovery_mode, std::string logid = "", bool group_commit = TXLOG_GROUP_COMMIT,
+            DLogBackend backend = TXLOG_BACKEND, uint32_t async_flush_us = TXLOG_ASYNC_FLUSH_US);
+
+    ~TxLog();
 
     //add to the log, where txEntry->getTxState() decides the handling within
     ///expected to be used for persisting the tx state then and the read and write sets
@@ -69,6 +126,17 @@ class TxLog {
 
     bool getNextPendingTx(uint64_t idIn, uint64_t &idOut, TxEntry *txOut);
 
+    // log the marker a KV checkpoint tagged id replays after; see KVCheckpoint
+    bool markCheckpoint(__uint128_t cts, uint64_t id);
+
+    // collect what a restart needs on top of the checkpoint tagged checkpointId (0 for none):
+    ///the committed txs whose conclusion is logged after the checkpoint marker, and the CIs
+    ///never concluded, each in the log order of its CI, with the read and write sets.
+    ///The records are located by one pass over their fixed headers and only those needed are
+    ///deserialized, by nThreads threads. The caller owns the returned entries.
+    bool recoverFrom(uint64_t checkpointId, uint32_t nThreads,
+            std::vector<TxEntry *> &committed, std::vector<TxEntry *> &pending);
+
     // Return data size of TxLog
     inline size_t size() { return log->size(); }
 
@@ -77,8 +145,25 @@ class TxLog {
     // Clear TxLog. Remove all chunk files.
     inline void clear() { log->cleanup(); }
 
-    // Trim
-    inline void trim(size_t off = 0) { log->trim(off); }
+    // Trim the first off bytes, all if 0
+    ///may cut into the active chunk, unlike trimBehind(), so not while records are being added
+    void trim(size_t off = 0);
+
+    // trim the whole chunks in front of the records to keep: those from the first one of a CTS
+    ///from lowWatermark on, those from the marker of checkpoint checkpointId on, and the CIs not
+    ///concluded before that marker. checkpointId 0 is for a log not used for recovery.
+    ///Return the bytes reclaimed.
+    uint64_t trimBehind(__uint128_t lowWatermark, uint64_t checkpointId);
+
+    // the log offset trimBehind() may trim to, before rounding down to whole chunks,
+    ///and in watermarkPoint the one lowWatermark alone would allow
+    uint64_t getTrimPoint(__uint128_t lowWatermark, uint64_t checkpointId, uint64_t &watermarkPoint);
+
+    // trim stats
+    inline uint64_t getTrimmedBytes() { return trimmedBytes.load(); }
+    inline uint64_t getTrimCount() { return trimCount.load(); }
+    /// bytes in front of the watermark point still in the log after the last trimBehind()
+    inline uint64_t getTrimLagBytes() { return trimLagBytes.load(); }
 
     // For debugging. Dump log content to file descriptor 'fd'
     void dump(int fd);
@@ -86,6 +171,22 @@ class TxLog {
     // For debugging. Fabricate a tx log entry that records arbitrary information
     bool fabricate(__uint128_t cts, uint8_t *key, uint32_t keyLength, uint8_t *value, uint32_t valueLength);
 
+    // Group commit tuning
+    inline void setBatchLimits(uint32_t bytes, uint64_t delayNs) { batchBytes = bytes; batchDelayNs = delayNs; }
+    inline bool isGroupCommit() { return writer != NULL; }
+
+    // Group commit histograms, in log2 buckets: bucket i counts values in [2^i, 2^(i+1)),
+    // bucket 0 also counts 0 and the last bucket everything above
+    /// records per batch
+    inline uint64_t getBatchRecordsHist(uint32_t i) { return batchRecordsHist[i].load(); }
+    /// usec from staging to durable, of the oldest record of each thread in a batch
+    inline uint64_t getCommitLatencyHist(uint32_t i) { return commitLatencyHist[i].load(); }
+    inline uint64_t getBatchCount() { return batchCount.load(); }
+    inline uint64_t getBatchedBytes() { return batchedBytes.load(); }
+
+    // bytes dropped from the tail by recovery, as torn by the crash
+    inline uint64_t getTornBytes() { return tornBytes; }
+
     private:
     // private struct
     typedef struct TxLogMarker {
@@ -96,13 +197,90 @@ class TxLog {
         #define TX_LOG_HEAD_SIG 0xA5A5F0F0
         #define TX_LOG_TAIL_SIG 0xF0F0A5A5
         uint32_t sig;   // signature
-    } TxLogHeader_t, TxLogTailer_t;
+    } TxLogHeader_t;
+
+    typedef struct TxLogTailer {
+        uint32_t length;// same as in the header
+        uint32_t sig;   // signature
+        uint32_t crc;   // CRC32C of the serialized tx between the header and the tailer
+    } TxLogTailer_t;
+
+    // a record serialized into a staging buffer, not yet in the log
+    typedef struct StagedRecord {
+        uint32_t offset;
+        uint32_t length;
+        __uint128_t cts;
+    } StagedRecord_t;
+
+    // one per logging thread
+    typedef struct StagingBuffer {
+        std::mutex lock;
+        std::vector<uint8_t> data;
+        std::vector<StagedRecord_t> records;
+        uint64_t staged = 0;                    // records ever staged
+        std::atomic<uint64_t> durable{0};       // records ever made durable
+        std::atomic<uint64_t> oldestTsc{0};     // staging time of the oldest record; 0 if none
+    } StagingBuffer_t;
+
+    // the latest record of cts deserialized into tx; false if none
+    bool lookup(__uint128_t cts, TxEntry &tx);
+    // the position of the record at addr, reserved at DLog offset off when trimSeq was seq
+    uint64_t toPosition(void *addr, uint64_t off, uint64_t seq);
+    void buildIndex();
+    bool isCheckpointMarker(TxLogHeader_t *hdr, uint64_t id);
+    // whether the record at hdr, within a log buffer of len bytes, is complete and intact
+    bool isRecordIntact(TxLogHeader_t *hdr, uint32_t len);
+    void asyncFlusher();
+
+    bool addGroupCommit(TxEntry *txEntry);
+    StagingBuffer_t * getStagingBuffer();
+    void groupCommitWriter();
+    // whether the staged records are to be written now; if not, waitNs is how long until they are
+    bool isBatchDue(uint64_t &waitNs);
+    void writeBatch();
+    static inline uint32_t histBucket(uint64_t value) {
+        return (value == 0) ? 0 : std::min(63 - __builtin_clzl(value), TXLOG_HIST_BUCKETS - 1);
+    }
 
     // private variables
     DLog<TXLOG_CHUNK_SIZE, 16> *log;
 
     // Max recorded CTS
     __uint128_t max_cts;
+
+    // CTS -> position of its latest record; a position is a DLog offset plus trimmedBytes
+    CtsIndex ctsIndex;
+    std::atomic<uint64_t> trimmedBytes{0};
+    std::atomic<uint64_t> trimSeq{0};           // odd while a trim moves the offsets
+    std::mutex trimMutex;
+    std::atomic<uint64_t> trimCount{0};
+    std::atomic<uint64_t> trimLagBytes{0};
+
+    // persistence
+    bool isPersistPerRecord;                    // add() persists its record
+    std::mutex appendLock;                      // orders the per-record persists
+    uint32_t asyncFlushUs;
+    std::thread *flusher = NULL;
+    uint64_t tornBytes = 0;
+
+    // group commit
+    uint64_t logNo;                             // tells apart the staging buffers of TxLog instances
+    std::thread *writer = NULL;
+    std::atomic<bool> isAlive{true};
+    std::mutex stagesLock;
+    std::vector<StagingBuffer_t *> stages;
+    std::atomic<uint32_t> stageCount{0};
+    std::atomic<uint32_t> waitingStages{0};    // stages holding records not taken by the writer yet
+    std::atomic<uint64_t> pendingBytes{0};
+    std::mutex writerLock;
+    std::condition_variable writerCond;
+    std::atomic<bool> isWriterParked{false};
+    uint32_t batchBytes = TXLOG_BATCH_BYTES;
+    uint64_t batchDelayNs = TXLOG_BATCH_DELAY_NS;
+    std::atomic<uint64_t> batchRecordsHist[TXLOG_HIST_BUCKETS] = {};
+    std::atomic<uint64_t> commitLatencyHist[TXLOG_HIST_BUCKETS] = {};
+    std::atomic<uint64_t> batchCount{0};
+    std::atomic<uint64_t> batchedBytes{0};
 }; // TxLog
 
 } // end namespace QDB
@@ -265,4 +265,315 @@ TEST_F(TxLogTest, TxLogMtRwTest)
 }
 
 
+TEST_F(TxLogTest, TxLogIndexTest)
+{
+    // a pending record and then its conclusion, for every other tx
+    for (uint64_t idx = 0; idx < NUM_ENTRY; idx++) {
+        TxEntry tx(0,0);
+        tx.setCTS(idx);
+        tx.setPStamp(idx);
+        tx.setSStamp(idx);
+        tx.setTxState(TxEntry::TX_PENDING);
+        txlog->add(&tx);
+        if (idx % 2) {
+            tx.setTxState(TxEntry::TX_COMMIT);
+            txlog->add(&tx);
+        }
+    }
+    for (uint64_t idx = 0; idx < NUM_ENTRY; idx++) {
+        EXPECT_EQ(((idx % 2) == 0)? TxEntry::TX_PENDING : TxEntry::TX_COMMIT, txlog->getTxState(idx));
+    }
+    EXPECT_EQ((uint32_t)TxEntry::TX_ALERT, txlog->getTxState(NUM_ENTRY));
+
+    // positions survive a trim of the log head
+    size_t half = txlog->size() / 2;
+    uint64_t idIn = 0, idOut;
+    TxEntry tx(1,1);
+    while (idIn < half && txlog->getNextPendingTx(idIn, idOut, &tx))
+        idIn = idOut;
+    txlog->trim(idIn);
+    uint32_t found = 0;
+    for (uint64_t idx = 0; idx < NUM_ENTRY; idx++) {
+        uint32_t txState = txlog->getTxState(idx);
+        if (txState != TxEntry::TX_ALERT) {
+            EXPECT_EQ(((idx % 2) == 0)? TxEntry::TX_PENDING : TxEntry::TX_COMMIT, txState);
+            found++;
+        }
+    }
+    EXPECT_GT(found, 0u);
+    EXPECT_LT(found, (uint32_t)NUM_ENTRY);
+    EXPECT_EQ((uint32_t)TxEntry::TX_COMMIT, txlog->getTxState(NUM_ENTRY - 1));
+
+    // and are found again by a recovering TxLog
+    delete txlog;
+    txlog = new TxLog(true, "unittest");
+    for (uint64_t idx = NUM_ENTRY - found; idx < NUM_ENTRY; idx++) {
+        EXPECT_EQ(((idx % 2) == 0)? TxEntry::TX_PENDING : TxEntry::TX_COMMIT, txlog->getTxState(idx));
+    }
+}
+
+TEST_F(TxLogTest, TxLogTornRecordTest)
+{
+    for (uint64_t idx = 0; idx < 10; idx++) {
+        TxEntry *tx = new TxEntry(1, 1);
+        tx->setCTS(idx);
+        tx->setTxState(TxEntry::TX_COMMIT);
+        tx->insertWriteSet(kvStore.preput(*writeKV[idx % RWSetSize]), 0);
+        txlog->add(tx);
+        delete tx;
+    }
+    size_t logged = txlog->size();
+    delete txlog;
+
+    // flip a checksum byte of the last record, as if the crash tore it
+    // left in place, as TxLog leaves its own log
+    DLog<TXLOG_CHUNK_SIZE, 16> *raw = new DLog<TXLOG_CHUNK_SIZE, 16>(TXLOG_DIR "/unittest", true);
+    ((uint8_t *)raw->getaddr(logged - 1))[0] ^= 0xFF;
+
+    // recovery drops it, and appends go on from the record in front of it
+    txlog = new TxLog(true, "unittest");
+    EXPECT_GT(txlog->getTornBytes(), 0u);
+    EXPECT_EQ(logged - txlog->getTornBytes(), txlog->size());
+    EXPECT_EQ((uint32_t)TxEntry::TX_COMMIT, txlog->getTxState(8));
+    EXPECT_EQ((uint32_t)TxEntry::TX_ALERT, txlog->getTxState(9));
+
+    TxEntry *tx = new TxEntry(1, 1);
+    tx->setCTS(9);
+    tx->setTxState(TxEntry::TX_COMMIT);
+    tx->insertWriteSet(kvStore.preput(*writeKV[0]), 0);
+    txlog->add(tx);
+    delete tx;
+    EXPECT_EQ(logged, txlog->size());
+    EXPECT_EQ((uint32_t)TxEntry::TX_COMMIT, txlog->getTxState(9));
+}
+
+TEST_F(TxLogTest, TxLogCheckpointTest)
+{
+    // txs 0-3 commit before the checkpoint marker, 4-7 after it, 8-9 never conclude
+    TxEntry *tx[10];
+    for (uint64_t idx = 0; idx < 10; idx++) {
+        tx[idx] = new TxEntry(1, 1);
+        tx[idx]->setCTS((__uint128_t)(idx + 1) << 64);
+        tx[idx]->setPStamp(idx);
+        tx[idx]->setSStamp(100 + idx);
+        tx[idx]->setTxState(TxEntry::TX_PENDING);
+        tx[idx]->insertWriteSet(kvStore.preput(*writeKV[idx % RWSetSize]), 0);
+        tx[idx]->insertReadSet(kvStore.preput(*readKV[idx % RWSetSize]), 0);
+        txlog->add(tx[idx]);
+        if (idx < 4) {
+            tx[idx]->setTxState(TxEntry::TX_COMMIT);
+            txlog->add(tx[idx]);
+        }
+    }
+    EXPECT_TRUE(txlog->markCheckpoint((__uint128_t)20 << 64, 42));
+    for (uint64_t idx = 4; idx < 8; idx++) {
+        tx[idx]->setTxState(TxEntry::TX_COMMIT);
+        txlog->add(tx[idx]);
+    }
+
+    std::vector<TxEntry *> committed, pending;
+    EXPECT_FALSE(txlog->recoverFrom(43, 2, committed, pending));
+
+    EXPECT_TRUE(txlog->recoverFrom(42, 2, committed, pending));
+    ASSERT_EQ(4u, committed.size());
+    ASSERT_EQ(2u, pending.size());
+    for (uint64_t idx = 0; idx < 4; idx++) {
+        EXPECT_TRUE(committed[idx]->getCTS() == (__uint128_t)(idx + 5) << 64);
+        EXPECT_EQ((uint32_t)TxEntry::TX_COMMIT, committed[idx]->getTxState());
+        EXPECT_EQ(104 + idx, committed[idx]->getSStamp());
+        EXPECT_EQ(1u, committed[idx]->getWriteSetSize());
+        EXPECT_TRUE(committed[idx]->getWriteSet()[0]->k == writeKV[(idx + 4) % RWSetSize]->k);
+    }
+    EXPECT_TRUE(pending[0]->getCTS() == (__uint128_t)9 << 64);
+    EXPECT_TRUE(pending[1]->getCTS() == (__uint128_t)10 << 64);
+    for (TxEntry *txEntry : committed)
+        delete txEntry;
+    for (TxEntry *txEntry : pending)
+        delete txEntry;
+    committed.clear();
+    pending.clear();
+
+    // without a checkpoint every committed tx is replayed
+    EXPECT_TRUE(txlog->recoverFrom(0, 3, committed, pending));
+    EXPECT_EQ(8u, committed.size());
+    EXPECT_EQ(2u, pending.size());
+    for (TxEntry *txEntry : committed)
+        delete txEntry;
+    for (TxEntry *txEntry : pending)
+        delete txEntry;
+    for (uint64_t idx = 0; idx < 10; idx++)
+        delete tx[idx];
+}
+
+TEST_F(TxLogTest, TxLogTrimPointTest)
+{
+    // tx 2 is concluded after the checkpoint marker, the others before it
+    uint64_t pos[6];
+    auto logTx = [&](uint64_t cts, uint32_t txState) {
+        TxEntry tx(1, 1);
+        tx.setCTS((__uint128_t)cts << 64);
+        tx.setTxState(txState);
+        tx.insertWriteSet(kvStore.preput(*writeKV[cts % RWSetSize]), 0);
+        if (txState == TxEntry::TX_PENDING)
+            pos[cts] = txlog->size();
+        txlog->add(&tx);
+    };
+    logTx(1, TxEntry::TX_PENDING);
+    logTx(1, TxEntry::TX_COMMIT);
+    logTx(2, TxEntry::TX_PENDING);
+    logTx(3, TxEntry::TX_PENDING);
+    logTx(3, TxEntry::TX_ABORT);
+    uint64_t marker = txlog->size();
+    EXPECT_TRUE(txlog->markCheckpoint((__uint128_t)4 << 64, 42));
+    logTx(2, TxEntry::TX_COMMIT);
+    logTx(5, TxEntry::TX_PENDING);
+    logTx(5, TxEntry::TX_COMMIT);
+    __uint128_t none = (__uint128_t)100 << 64;
+
+    // a log not used for recovery is kept for the peers only
+    uint64_t watermarkPoint;
+    EXPECT_EQ(txlog->size(), txlog->getTrimPoint(none, 0, watermarkPoint));
+    EXPECT_EQ(txlog->size(), watermarkPoint);
+    EXPECT_EQ(pos[3], txlog->getTrimPoint((__uint128_t)3 << 64, 0, watermarkPoint));
+    EXPECT_EQ(pos[3], watermarkPoint);
+
+    // a restart replays tx 2 from its CI
+    EXPECT_EQ(pos[2], txlog->getTrimPoint(none, 42, watermarkPoint));
+    EXPECT_EQ(txlog->size(), watermarkPoint);
+    EXPECT_LT(pos[2], marker);
+    EXPECT_EQ(pos[2], txlog->getTrimPoint((__uint128_t)3 << 64, 42, watermarkPoint));
+    EXPECT_EQ(pos[3], watermarkPoint);
+
+    // nothing goes without the marker
+    EXPECT_EQ(0u, txlog->getTrimPoint(none, 43, watermarkPoint));
+
+    // no whole chunk is behind any of it
+    EXPECT_EQ(0u, txlog->trimBehind(none, 0));
+    EXPECT_EQ(txlog->size(), txlog->getTrimLagBytes());
+    EXPECT_EQ(0u, txlog->getTrimCount());
+}
+
+void trimFromLog(TxLogTest *c)
+{
+    while (c->txlog->size() > 10000) {
+        c->txlog->trim(1000);
+        usleep(10);
+    }
+}
+
+TEST_F(TxLogTest, TxLogMtTrimTest)
+{
+    std::thread tW1(writeToLog, this, 0);
+    std::thread tW2(writeToLog, this, 1);
+    tW1.join();
+    tW2.join();
+
+    // lookups by CTS while the log is trimmed under them
+    int run_run = 1;
+    std::thread tR1(readBackwardFromLog, this, &run_run);
+    std::thread tR2(readBackwardFromLog, this, &run_run);
+    trimFromLog(this);
+    run_run = 0;
+    tR1.join();
+    tR2.join();
+
+    // about all of the records not trimmed are found where they were logged
+    uint64_t trimmed = txlog->getTrimmedBytes();
+    uint64_t recordSize = (txlog->size() + trimmed) / (NUM_ENTRY * 2);
+    EXPECT_GT(trimmed, 0u);
+    uint32_t found = 0;
+    for (__uint128_t cts = 0; cts < NUM_ENTRY * 2; cts++) {
+        uint32_t txState;
+        uint64_t pStamp, sStamp;
+        uint8_t position;
+        if (txlog->getTxInfo(cts, txState, pStamp, sStamp, position)) {
+            EXPECT_EQ(cts, pStamp);
+            found++;
+        }
+    }
+    EXPECT_LT(found, (uint32_t)NUM_ENTRY * 2);
+    EXPECT_GE(found, NUM_ENTRY * 2 - trimmed / recordSize - 2);
+}
+
+TEST_F(TxLogTest, TxLogGroupCommitTest)
+{
+    delete txlog;
+    txlog = new TxLog(false, "unittest", true);
+    EXPECT_TRUE(txlog->isGroupCommit());
+
+    // every add() returns once its batch is durable
+    std::thread tW1(writeToLog, this, 0);
+    std::thread tW2(writeToLog, this, 1);
+    std::thread tW3(writeToLog, this, 2);
+    std::thread tW4(writeToLog, this, 3);
+    tW1.join();
+    tW2.join();
+    tW3.join();
+    tW4.join();
+
+    for (__uint128_t cts = 0; cts < NUM_ENTRY * 4; cts++) {
+        uint32_t txState;
+        uint64_t pStamp, sStamp;
+        uint8_t position;
+        EXPECT_TRUE(txlog->getTxInfo(cts, txState, pStamp, sStamp, position));
+        EXPECT_EQ(txState, ((cts % 2) == 0)? TxEntry::TX_PENDING : TxEntry::TX_COMMIT);
+        EXPECT_EQ(cts, pStamp);
+    }
+
+    uint64_t batches = 0, latencies = 0;
+    for (uint32_t i = 0; i < TXLOG_HIST_BUCKETS; i++) {
+        batches += txlog->getBatchRecordsHist(i);
+        latencies += txlog->getCommitLatencyHist(i);
+    }
+    EXPECT_EQ(txlog->getBatchCount(), batches);
+    EXPECT_LE(batches, latencies);
+    EXPECT_EQ(txlog->size(), txlog->getBatchedBytes());
+    GTEST_COUT << "group commit: " << NUM_ENTRY * 4 << " txs in " << batches << " batches" << std::endl;
+}
+
+TEST_F(TxLogTest, TxLogGroupCommitAllWaitingTest)
+{
+    delete txlog;
+    txlog = new TxLog(false, "unittest", true);
+    txlog->setBatchLimits(UINT32_MAX, 60ul * 1000000000);
+
+    // a lone logging thread is all there is to wait for, so its batches go out at once
+    uint64_t start = Cycles::rdtsc();
+    writeToLog(this, 0);
+    EXPECT_LT(Cycles::toSeconds(Cycles::rdtsc() - start), 10.0);
+    EXPECT_EQ(txlog->getBatchCount(), (uint64_t)NUM_ENTRY);
+}
+
+TEST_F(TxLogTest, benchTxInfoLookup)
+{
+    // lookup latency should not grow with the log
+    uint64_t logged = 0;
+    for (uint64_t entries = NUM_ENTRY; entries <= NUM_ENTRY * 1000; entries *= 10) {
+        for (; logged < entries; logged++) {
+            TxEntry tx(0,0);
+            tx.setCTS(logged);
+            tx.setPStamp(logged);
+            tx.setSStamp(logged);
+            tx.setTxState(((logged % 2) == 0)? TxEntry::TX_PENDING : TxEntry::TX_COMMIT);
+            tx.insertPeerSet(logged);
+            txlog->add(&tx);
+        }
+
+        uint32_t txState;
+        uint64_t pStamp, sStamp;
+        uint8_t position;
+        const uint32_t lookups = 100000;
+        uint64_t start = Cycles::rdtsc();
+        for (uint32_t i = 0; i < lookups; i++) {
+            uint64_t cts = (i * 7919ul) % entries;
+            txlog->getTxInfo(cts, txState, pStamp, sStamp, position);
+        }
+        uint64_t stop = Cycles::rdtsc();
+        EXPECT_TRUE(txlog->getTxInfo(entries - 1, txState, pStamp, sStamp, position));
+        EXPECT_EQ(entries - 1, pStamp);
+        GTEST_COUT << "log entries: " << entries << ", size: " << txlog->size() / 1024 << " KB"
+                << ", getTxInfo: " << Cycles::toNanoseconds(stop - start) / lookups << " ns" << std::endl;
+    }
+}
+
 }  // namespace RAMCloud
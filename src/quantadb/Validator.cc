@@ -17,6 +17,7 @@
 #include "Validator.h"
 #include <thread>
 #include "Logger.h"
+#include "TimeTrace.h"
 #include "DSSNServiceMonitor.h"
 
 namespace QDB {
@@ -24,21 +25,39 @@ namespace QDB {
 const uint64_t maxTimeStamp = std::numeric_limits<uint64_t>::max();
 const uint64_t minTimeStamp = 0;
 
+// append to buf[c..s), truncating once it is full; c never gets past s - 1
+static void __attribute__((format(printf, 4, 5)))
+appendf(char *buf, int &c, int s, const char *fmt, ...)
+{
+    if (c >= s - 1)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + c, s - c, fmt, args);
+    va_end(args);
+    if (n > 0)
+        c = std::min(c + n, s - 1);
+}
+
 Validator::Validator(HashmapKVStore &_kvStore, DSSNService *_rpcService, bool _isTesting)
 : kvStore(_kvStore),
   rpcService(_rpcService),
   isUnderTest(_isTesting),
-  localTxQueue(*new WaitList(1000001)),
-  reorderQueue(*new SkipList<__uint128_t>()),
+  reorderQueue(*new ReorderQueue()),
   distributedTxSet(*new DistributedTxSet()),
   activeTxSet(*new ActiveTxSet()),
   concludeQueue(*new ConcludeQueue()),
 #ifdef  QDBTXRECOVERY
-  txLog(*new TxLog(true, _rpcService ?_rpcService->getServerAddress() : "0.0.0.0")) {
+  txLog(*new TxLog(true, _rpcService ?_rpcService->getServerAddress() : "0.0.0.0")),
 #else
-  txLog(*new TxLog(false, _rpcService ?_rpcService->getServerAddress() : "0.0.0.0")) {
+  txLog(*new TxLog(false, _rpcService ?_rpcService->getServerAddress() : "0.0.0.0")),
 #endif
+  kvCheckpoint(*new KVCheckpoint(_rpcService ?_rpcService->getServerAddress() : "0.0.0.0")) {
     lastScheduledTxCTS = 0;
+    for (uint32_t i = 0; i < NUM_SERIALIZE_THREADS; i++) {
+        //admission bounds the queued CIs, bar the recovered ones, which are forced in
+        localTxQueue[i] = new WaitList(ADMISSION_MAX_CREDITS + ADMISSION_RETRY_RESERVE + 1);
+    }
     for (uint32_t i = 0; i < NUM_PEER_THREADS; i++) {
         peerInfo[i] = new PeerInfo(i);
     }
@@ -47,8 +66,12 @@ Validator::Validator(HashmapKVStore &_kvStore, DSSNService *_rpcService, bool _i
     if (!isUnderTest) {
 #ifdef  QDBTXRECOVERY
         recover();
+        checkpointThread = std::thread(&Validator::checkpointer, this);
 #endif
-        serializeThread = std::thread(&Validator::serialize, this);
+        logTrimThread = std::thread(&Validator::logTrimmer, this);
+        for (uint32_t i = 0; i < NUM_SERIALIZE_THREADS; i++) {
+            serializeThread[i] = std::thread(&Validator::serialize, this, i);
+        }
         for (uint32_t i = 0; i < NUM_PEER_THREADS; i++) {
             peeringThread[i] = std::thread(&Validator::peer, this, i);
         }
@@ -62,8 +85,10 @@ Validator::Validator(HashmapKVStore &_kvStore, DSSNService *_rpcService, bool _i
 Validator::~Validator() {
     if (!isUnderTest) {
         isAlive = false;
-        if (serializeThread.joinable())
-            serializeThread.join();
+        for (uint32_t i = 0; i < NUM_SERIALIZE_THREADS; i++) {
+            if (serializeThread[i].joinable())
+                serializeThread[i].join();
+        }
         for (uint32_t i = 0; i < NUM_PEER_THREADS; i++) {
             if (peeringThread[i].joinable())
                 peeringThread[i].join();
@@ -72,10 +97,16 @@ Validator::~Validator() {
             schedulingThread.join();
         if (peerAlertThread.joinable())
             peerAlertThread.join();
+        if (checkpointThread.joinable())
+            checkpointThread.join();
+        if (logTrimThread.joinable())
+            logTrimThread.join();
         logCounters();
     }
     delete concludeThreadPool;
-    delete &localTxQueue;
+    for (uint32_t i = 0; i < NUM_SERIALIZE_THREADS; i++) {
+        delete localTxQueue[i];
+    }
     delete &reorderQueue;
     delete &distributedTxSet;
     delete &activeTxSet;
@@ -90,7 +121,9 @@ Validator::testRun() {
     if (!isUnderTest)
         return false;
     scheduleDistributedTxs();
-    serialize();
+    for (uint32_t i = 0; i < NUM_SERIALIZE_THREADS; i++) {
+        serialize(i);
+    }
     peer(0);
     monitor();
     concludeThreadFunc(0);
@@ -113,7 +146,7 @@ Validator::updateTxPStampSStamp(TxEntry &txEntry) {
     txEntry.setSStamp(std::min(txEntry.getSStamp(), uint64_t(txEntry.getCTS() >> 64)));
 
     //update sstamp of transaction
-    auto &readSet = txEntry.getReadSet();
+    auto readSet = txEntry.getReadSet();
     for (uint32_t i = 0; i < txEntry.getReadSetSize(); i++) {
         if (readSet[i] == NULL)
             abort(); //make sure the size of over-provisioned array has been corrected
@@ -140,7 +173,7 @@ Validator::updateTxPStampSStamp(TxEntry &txEntry) {
     }
 
     //update pstamp of transaction
-    auto  &writeSet = txEntry.getWriteSet();
+    auto writeSet = txEntry.getWriteSet();
     for (uint32_t i = 0; i < txEntry.getWriteSetSize(); i++) {
         KVLayout *kv = kvStore.fetch_by_KVSPtr(writeSet[i]->k, txEntry.getWriteSetKVSPtr(i));
         if (kv) {
@@ -158,7 +191,7 @@ Validator::updateTxPStampSStamp(TxEntry &txEntry) {
 
 bool
 Validator::updateKVReadSetPStamp(TxEntry &txEntry) {
-    auto &readSet = txEntry.getReadSetInStore();
+    auto readSet = txEntry.getReadSetInStore();
     for (uint32_t i = 0; i < txEntry.getReadSetSize(); i++) {
         if (readSet[i]) {
             readSet[i]->meta().pStamp = std::max(uint64_t(txEntry.getCTS() >> 64), readSet[i]->meta().pStamp);
@@ -177,12 +210,13 @@ Validator::updateKVReadSetPStamp(TxEntry &txEntry) {
 
 bool
 Validator::updateKVWriteSet(TxEntry &txEntry) {
-    auto &writeSet = txEntry.getWriteSet();
-    auto &writeSetInStore = txEntry.getWriteSetInStore();
+    auto writeSet = txEntry.getWriteSet();
+    auto writeSetInStore = txEntry.getWriteSetInStore();
     for (uint32_t i = 0; i < txEntry.getWriteSetSize(); i++) {
         if (writeSetInStore[i]) {
             kvStore.put(writeSetInStore[i], txEntry.getCTS(), txEntry.getSStamp(),
                     writeSet[i]->v.valuePtr, writeSet[i]->v.valueLength);
+            writeSet[i]->v.valuePtr = NULL; //the value now belongs to the KV store
             if (writeSetInStore[i]->v.isTombstone)
                 counters.commitDeletes++;
             else
@@ -241,18 +275,19 @@ Validator::initialWrite(KVLayout &kv) {
 }
 
 bool
-Validator::read(KLayout& k, KVLayout *&kv) {
-#ifndef QDB_NO_THROTTLE
+Validator::read(KLayout& k, VLayout &v) {
+#ifdef QDB_READ_THROTTLE
+    //Reads no longer race with conclude(), but rejecting a read of a tuple
+    //under commit may still help a client back off under heavy contention.
     if (activeTxSet.blocks(k.getKeyHash())) {
-        kv = (KVLayout *)1; //any non-zero value as an indicator
         return false;
     }
 #endif
 
-    //FIXME: This read can happen concurrently while conclude() is
-    //modifying the KVLayout instance.
-    kv = kvStore.fetch(k);
-    if (kv != NULL && !kv->isTombstone()) {
+    //conclude() only prepends versions, so the snapshot is consistent even
+    //while the tuple is being overwritten.
+    KVLayout *kv = kvStore.fetch(k);
+    if (kv != NULL && kvStore.getVersion(kv, v) && !v.isTombstone) {
         counters.precommitReads++;
         return true;
     }
@@ -297,18 +332,28 @@ Validator::scheduleDistributedTxs() {
     //Move commit intents from reorder queue when they are due in view of local clock,
     //expressed in the cluster time unit (due to current sequencer implementation).
     //During testing, ignore the timing constraint imposed by the local clock.
-    TxEntry *txEntry;
+    //The RPC threads insert cross-shard CIs into the reorder queue directly; all
+    //the CIs due are taken out with one pop_until() call.
+    TxEntry *due[SCHEDULE_POP_BATCH];
+    EpochThread epochThread;
     do {
-        while (!crossTxQueue.empty()) {
-            crossTxQueue.pop(txEntry);
-            reorderQueue.insert(txEntry->getCTS(), txEntry);
-        }
-
-        if ((txEntry = (TxEntry *)reorderQueue.try_pop(isUnderTest ? (__uint128_t)-1 : get128bClockValue()))) {
+        EpochManager::instance().quiescent();
+        uint32_t count = reorderQueue.pop_until(isUnderTest ? (__uint128_t)-1 : get128bClockValue(),
+                (void **)due, SCHEDULE_POP_BATCH);
+        for (uint32_t i = 0; i < count; i++) {
+            TxEntry *txEntry = due[i];
             if (txEntry->getCTS() == lastScheduledTxCTS) {
+                //a second CI of the CTS, which the reorder queue may have let in;
+                //abort it as if it had failed to be queued
                 RAMCLOUD_LOG(NOTICE, "duplicate %lu", (uint64_t)(txEntry->getCTS() >> 64));
                 counters.duplicates++;
-                continue; //ignore the duplicate
+                txEntry->setTxState(TxEntry::TX_ABORT);
+                txEntry->setTxCIState(TxEntry::TX_CI_CONCLUDED);
+                txEntry->setTxResult(TxEntry::TX_ABORT_TRIVIAL);
+                sendTxCommitReply(txEntry);
+                releaseCredit(txEntry);
+                EpochManager::instance().retireObject(txEntry);
+                continue;
             }
 
             if (txEntry->getCTS() < lastScheduledTxCTS) {
@@ -337,51 +382,80 @@ Validator::scheduleDistributedTxs() {
 }
 
 void
-Validator::serialize() {
+Validator::serialize(uint32_t partition) {
     /*
-     * This loop handles the DSSN serialization window critical section
+     * This loop handles the DSSN serialization window critical section.
+     *
+     * With several partitions, each serialize thread drains its own local tx queue.
+     * A cross-partition tx is queued to one partition only, yet its keys may be
+     * claimed at the same time by other partitions' txs. The activeTxSet.add()
+     * is all-or-nothing, so whichever thread takes a contended key first admits
+     * its tx, and the loser backs out and retries on its next pass. Txs
+     * admitted concurrently therefore never share a key and can be validated
+     * independently. Only partition 0 handles the scheduled cross-shard txs.
+     *
+     * Local txs are admitted a window at a time, so that the filter words
+     * wanted by the whole window are set with one CAS each.
      */
+    WaitList &txQueue = *localTxQueue[partition];
     bool hasEvent = true;
     uint64_t blocks =0;
     uint64_t counts = 0;
+    EpochThread epochThread;
     while (isAlive && (!isUnderTest || hasEvent)) {
         hasEvent = false;
+        EpochManager::instance().quiescent();
 
         // process all commit-intents on local transaction queue
         TxEntry* txEntry;
+        TxEntry* window[SERIALIZE_ADMIT_BATCH];
+        uint64_t windowIt[SERIALIZE_ADMIT_BATCH];
+        bool admitted[SERIALIZE_ADMIT_BATCH];
         uint64_t it;
-        txEntry = localTxQueue.findFirst(it);
+        txEntry = txQueue.findFirst(it);
         while (txEntry) {
-            if (rpcService) {
-                rpcService->recordTxCommitDispatch(txEntry);
+            uint32_t size = 0;
+            while (txEntry && size < SERIALIZE_ADMIT_BATCH) {
+                if (rpcService) {
+                    rpcService->recordTxCommitDispatch(txEntry);
+                }
+                //the last blocking key is checked first, which rejects most blocked txs cheaply
+                if (activeTxSet.blocks(txEntry)) {
+                    blocks++;
+                } else {
+                    window[size] = txEntry;
+                    windowIt[size++] = it;
+                }
+                hasEvent = true;
+                txEntry = txQueue.findNext(it);
+                counts++;
             }
-            if (!activeTxSet.blocks(txEntry)) {
-                /* There is no need to update activeTXs because this tx is validated
-                 * and concluded shortly. If the conclude() does through a queue and another
-                 * task, then we should add tx to active tx set here.
-                 */
-	        if (!activeTxSet.add(txEntry))
-		    abort();
-
-                if (txEntry->getCTS() == 0) {
+
+            /* There is no need to update activeTXs because this tx is validated
+             * and concluded shortly. If the conclude() does through a queue and another
+             * task, then we should add tx to active tx set here.
+             */
+            activeTxSet.addBatch(window, size, admitted);
+            for (uint32_t i = 0; i < size; i++) {
+                if (!admitted[i]) {
+                    blocks++;
+                    continue;
+                }
+                if (window[i]->getCTS() == 0) {
                     //This feature may allow tx client to do without a clock
-                    txEntry->setCTS(get128bClockValue());
+                    window[i]->setCTS(get128bClockValue());
                     counters.ctsSets++;
                 }
 
-                validateLocalTx(*txEntry);
+                validateLocalTx(*window[i]);
 
-                localTxQueue.remove(it, txEntry);
-                insertConcludeQueue(txEntry);
-            } else {
-                blocks++;
+                txQueue.remove(windowIt[i], window[i]);
+                insertConcludeQueue(window[i]);
             }
-            hasEvent = true;
-            txEntry = localTxQueue.findNext(it);
-            counts++;
-            if ((counts % 80000)==0) {
-                RAMCLOUD_LOG(NOTICE, "activeTxSet stats: counts=%lu, blocks=%lu",
-                        counts, blocks);
+
+            if (counts >= 80000) {
+                RAMCLOUD_LOG(NOTICE, "activeTxSet stats: partition=%u, counts=%lu, blocks=%lu",
+                        partition, counts, blocks);
                 counts = 0;
                 blocks = 0;
             }
@@ -392,14 +466,15 @@ Validator::serialize() {
             if (rpcService) {
                 rpcService->recordTxCommitDispatch(txEntry);
             }*/
-        while (!scheduledTxQueue.empty()) {
+        while (partition == 0 && !scheduledTxQueue.empty()) {
             txEntry = scheduledTxQueue.front();
             scheduledTxQueue.pop();
             if (rpcService) {
                 rpcService->recordTxCommitDispatch(txEntry);
             }
 
-            if (activeTxSet.blocks(txEntry)) {
+            //admitting it also blocks incoming dependent transactions
+            if (activeTxSet.blocks(txEntry) || !activeTxSet.add(txEntry)) {
                 txEntry->setSStamp(0); //Fixme: later not needed as event can carry the zero
                 txEntry->isOutOfOrder = true;
                 counters.busyAborts++;
@@ -407,11 +482,6 @@ Validator::serialize() {
                 continue;
             }
 
-
-            //enable blocking incoming dependent transactions
-            if (!activeTxSet.add(txEntry))
-                abort();
-
             //enable sending SSN info to peer
             txEntry->setTxCIState(TxEntry::TX_CI_SCHEDULED);
             peerInfo[hash(txEntry->getCTS())]->poseEvent(3, txEntry->getCTS(), 0, 0, 0, 0, 0, txEntry, NULL);
@@ -434,11 +504,15 @@ Validator::serialize() {
 
 bool
 Validator::conclude(TxEntry *txEntry) {
+    //logTx() below may serialize values that a later commit could retire
+    EpochGuard guard;
+
     //record results and meta data
     if (txEntry->getTxState() == TxEntry::TX_COMMIT) {
         updateKVReadSetPStamp(*txEntry);
         updateKVWriteSet(*txEntry);
     }
+    endSeal(txEntry);
 
     if (txEntry->getParticipantSet().size() >= 1) {
         //for late cross-shard tx, it is never added to activeTxSet; just convert the state
@@ -456,6 +530,9 @@ Validator::conclude(TxEntry *txEntry) {
     }
 
     sendTxCommitReply(txEntry);
+    releaseCredit(txEntry);
+    //whether or not its conclusion has been logged, e.g., a late CI
+    openCIs.remove(txEntry->getCTS());
 
     if (txEntry->getTxState() == TxEntry::TX_COMMIT)
         counters.commits++;
@@ -468,6 +545,7 @@ Validator::conclude(TxEntry *txEntry) {
     }
 
     txEntry->setTxCIState(TxEntry::TX_CI_FINISHED);
+    traceCIStages(txEntry);
 
     //TODO: Eliminate the following for the distributed transaction.
     //The conclude() should be called by conclude thread only.
@@ -476,7 +554,9 @@ Validator::conclude(TxEntry *txEntry) {
     }
 
     logTx(LOG_DEBUG, txEntry); //for debugging only, not for recovery
-    delete txEntry;
+
+    //the RPC handler and monitor may still be looking at it
+    EpochManager::instance().retireObject(txEntry);
     return true;
 }
 
@@ -498,19 +578,28 @@ Validator::concludeThreadFunc(uint64_t tId) {
 
 void
 Validator::peer(uint32_t tid) {
+    EpochThread epochThread;
     do {
+        EpochManager::instance().quiescent();
         peerInfo[tid]->processEvent(this);
+        peerInfo[tid]->monitor(this);
     } while (isAlive && !isUnderTest);
 }
 
 void
 Validator::monitor() {
     uint64_t lastTick = 0;
+    uint64_t lastSweep = 0;
+    EpochThread epochThread;
     do {
-        for (uint32_t i = 0; i < NUM_PEER_THREADS; i++) {
-            peerInfo[i]->monitor(this);
-        }
+        EpochManager::instance().quiescent();
 
+        //retry the unsettled cross-shard read-only txs, and time out those waiting too long
+        uint64_t now = getClockValue();
+        if (now - lastSweep >= READ_ONLY_RETRY_US * 1000) {
+            sweepReadOnlyTxs();
+            lastSweep = now;
+        }
 
         //log counters every 10s
         if (!isUnderTest && logLevel >= LOG_INFO) {
@@ -539,13 +628,23 @@ Validator::insertTxEntry(TxEntry *txEntry) {
         return false; //skip queueing
     }
 
+    //a recovered CI has been voted on by its peers already and so cannot be put off
+    if (!admission.admit(txEntry->getCTS(), txEntry->getTxState() == TxEntry::TX_ALERT))
+        return false; //left unqueued for the client to retry, see isDeferred()
+    txEntry->admitTime = getClockValue();
+
     if (txEntry->getParticipantSet().size() == 0) {
         //single-shard tx
-        RAMCLOUD_LOG(NOTICE, "insert localTx cts %lu txEntry %lu cnt %lu",
-                (uint64_t)(txEntry->getCTS() >> 64), (uint64_t)txEntry,
-                localTxQueue.addedTxCount.load());
+        bool isCrossPartition;
+        uint32_t partition = getPartition(txEntry, isCrossPartition);
+        if (isCrossPartition)
+            counters.crossPartitionTxs++;
+        RAMCLOUD_LOG(NOTICE, "insert localTx cts %lu txEntry %lu partition %u cnt %lu",
+                (uint64_t)(txEntry->getCTS() >> 64), (uint64_t)txEntry, partition,
+                localTxQueue[partition]->addedTxCount.load());
         txEntry->setTxCIState(TxEntry::TX_CI_QUEUED);
-        if (!localTxQueue.add(txEntry)) {
+        if (!localTxQueue[partition]->add(txEntry)) {
+            releaseCredit(txEntry);
             counters.busyAborts.fetch_add(1);
             txEntry->setTxState(TxEntry::TX_ABORT);
             txEntry->setTxCIState(TxEntry::TX_CI_CONCLUDED);
@@ -565,12 +664,15 @@ Validator::insertTxEntry(TxEntry *txEntry) {
         if (txEntry->local_commit >= (txEntry->getCTS() >> 64))
             counters.lates++;
 
-        if (!crossTxQueue.push(txEntry)) {
+        if (!reorderQueue.insert(txEntry->getCTS(), txEntry)) {
+            releaseCredit(txEntry);
             counters.busyAborts.fetch_add(1);
             txEntry->setTxState(TxEntry::TX_ABORT);
             txEntry->setTxCIState(TxEntry::TX_CI_CONCLUDED);
             txEntry->setTxResult(TxEntry::TX_ABORT_TRIVIAL);
-            return false; //fail to be queued
+            //fail to be queued, e.g., a CI of the CTS is in the SkipList already;
+            //the TimingWheel turns one away only beyond its horizon, see scheduleDistributedTxs()
+            return false;
         }
 
         counters.queuedDistributedTxs.fetch_add(1);
@@ -578,6 +680,207 @@ Validator::insertTxEntry(TxEntry *txEntry) {
     return true;
 }
 
+bool
+Validator::isDeferred(TxEntry *txEntry, uint32_t &minDelayMicros, uint32_t &maxDelayMicros) {
+    if (txEntry->getTxCIState() != TxEntry::TX_CI_UNQUEUED)
+        return false;
+    admission.retryDelay(minDelayMicros, maxDelayMicros);
+    return true;
+}
+
+void
+Validator::traceCIStages(TxEntry *txEntry) {
+#ifdef MONITOR
+    if (rpcService)
+        rpcService->getmMonitor()->collectCIStages(txEntry);
+#endif
+#if CI_TRACE_SAMPLE_RATE > 0
+    static std::atomic<uint64_t> finishedCIs{0};
+    if (finishedCIs.fetch_add(1) % CI_TRACE_SAMPLE_RATE != 0)
+        return;
+    static const char* events[TxEntry::TX_CI_FINISHED + 1] = {
+        NULL,
+        NULL,
+        "CI %u.%u queued",
+        "CI %u.%u scheduled",
+        "CI %u.%u listening",
+        "CI %u.%u concluded",
+        "CI %u.%u sealed",
+        "CI %u.%u finished",
+    };
+    //the CTS nanoseconds and sequencer id, both truncated, tell the CIs apart
+    uint32_t nsec = (uint32_t)(uint64_t)(txEntry->getCTS() >> 64);
+    uint32_t id = (uint32_t)txEntry->getCTS();
+    for (uint32_t s = TxEntry::TX_CI_QUEUED; s <= TxEntry::TX_CI_FINISHED; s++) {
+        uint64_t t = txEntry->getTxCIStateTime(s);
+        if (t != 0)
+            TimeTrace::record(t, events[s], nsec, id);
+    }
+#endif
+}
+
+void
+Validator::releaseCredit(TxEntry *txEntry) {
+    if (txEntry->admitTime == 0)
+        return; //e.g., concluded by a unit test without having been inserted
+    admission.release((getClockValue() - txEntry->admitTime) / 1000);
+    txEntry->admitTime = 0;
+}
+
+bool
+Validator::commitReadOnlyTx(TxEntry *txEntry) {
+    /*
+     * A read-only tx writes nothing, so no other tx needs to be ordered after it
+     * other than through the pstamp it leaves on the tuples it has read. It can be
+     * validated right away against the committed versions instead of being
+     * queued, admitted to the activeTxSet, and concluded. A single-shard tx whose
+     * reads cannot be settled yet is left to the pipeline to order.
+     *
+     * A cross-shard tx needs the stamps of its peers, which settle theirs the
+     * same way and exchange them through the readOnlyTxSet rather than PeerInfo
+     * and the TxLog. As every participant must take this path, it is never left
+     * to the pipeline: unsettled reads are retried by the monitor until the tx
+     * times out. The tx is then the validator's to reply to and free.
+     */
+    if (txEntry->getWriteSetSize() > 0)
+        return false;
+
+    EpochGuard guard;
+    if (txEntry->getParticipantSet().size() > 0) {
+        uint64_t deadline = std::max((uint64_t)(txEntry->getCTS() >> 64), getClockValue())
+                + READ_ONLY_PEER_TIMEOUT_MS * 1000000;
+        bool isSettled = settleReadOnlyTx(txEntry);
+        //the stamps go out first, as a decided tx is gone once handed to the set
+        if (isSettled)
+            sendReadOnlyInfo(txEntry);
+        TxEntry *decided = readOnlyTxSet.add(txEntry, isSettled, deadline);
+        if (decided)
+            concludeReadOnlyTx(decided);
+        return true;
+    }
+
+    if (!settleReadOnlyTx(txEntry))
+        return false;
+    if (txEntry->isExclusionViolated()) {
+        txEntry->setTxState(TxEntry::TX_ABORT);
+        txEntry->setTxCIState(TxEntry::TX_CI_FINISHED);
+        txEntry->setTxResult(TxEntry::TX_ABORT_PISI_INIT);
+        counters.readOnlyAborts++;
+        return true;
+    }
+    txEntry->setTxState(TxEntry::TX_COMMIT);
+    txEntry->setTxCIState(TxEntry::TX_CI_FINISHED);
+    txEntry->setTxResult(TxEntry::TX_COMMIT_INIT);
+    counters.readOnlyCommits++;
+    return true;
+}
+
+bool
+Validator::settleReadOnlyTx(TxEntry *txEntry) {
+    /*
+     * The stamps of a read-only tx are final unless a tuple is held by an active
+     * tx, which may be half way through installing its writes, or by one
+     * admitted while we raise the pstamps. The same goes for a writer admitted
+     * and concluded in the meantime, which validated against the old pstamps.
+     */
+    if (activeTxSet.blocks(txEntry))
+        return false;
+
+    //a changed version or a violated exclusion window stands whatever happens next
+    updateTxPStampSStamp(*txEntry);
+    if (txEntry->isExclusionViolated())
+        return true;
+
+    //a tx bound for the pipeline or a retry anyway should not leave pstamps behind
+    if (!isReadSetCurrent(*txEntry))
+        return false;
+
+    //Publish the reads before looking for writers that might have missed them.
+    //Checking first would let a writer be admitted between the check and the
+    //update and validate against the old pstamps. A tx that still falls back to
+    //the pipeline or is retried keeps the raised pstamps; they only make later
+    //writers of those tuples more conservative, which is safe.
+    updateKVReadSetPStamp(*txEntry);
+    return !activeTxSet.blocks(txEntry) && isReadSetCurrent(*txEntry);
+}
+
+void
+Validator::concludeReadOnlyTx(TxEntry *txEntry) {
+    //all participants decide on the same merged stamps, bar an expired one, which aborts
+    if (txEntry->isExclusionViolated()) {
+        txEntry->setTxState(TxEntry::TX_ABORT);
+        txEntry->setTxResult(TxEntry::TX_ABORT_PISI);
+        counters.readOnlyAborts++;
+    } else {
+        txEntry->setTxState(TxEntry::TX_COMMIT);
+        txEntry->setTxResult(TxEntry::TX_COMMIT_PEER);
+        counters.readOnlyCommits++;
+    }
+    txEntry->setTxCIState(TxEntry::TX_CI_FINISHED);
+    sendTxCommitReply(txEntry);
+    delete txEntry;
+}
+
+void
+Validator::sweepReadOnlyTxs() {
+    std::vector<TxEntry *> unsettled, expired;
+    readOnlyTxSet.sweep(getClockValue(), unsettled, expired);
+    EpochGuard guard;
+    for (TxEntry *txEntry : unsettled) {
+        if (!settleReadOnlyTx(txEntry))
+            continue;
+        sendReadOnlyInfo(txEntry);
+        TxEntry *decided = readOnlyTxSet.settle(txEntry);
+        if (decided)
+            concludeReadOnlyTx(decided);
+    }
+    //the peers still waiting need not time out too
+    for (TxEntry *txEntry : expired) {
+        sendReadOnlyInfo(txEntry);
+        counters.readOnlyExpires++;
+        concludeReadOnlyTx(txEntry);
+    }
+}
+
+bool
+Validator::isReadSetCurrent(TxEntry &txEntry) {
+    auto readSet = txEntry.getReadSet();
+    for (uint32_t i = 0; i < txEntry.getReadSetSize(); i++) {
+        KVLayout *kv = kvStore.fetch_by_KVSPtr(readSet[i]->k, txEntry.getReadSetKVSPtr(i));
+        if (kv && kv->meta().cStamp != readSet[i]->meta().cStamp)
+            return false;
+    }
+    return true;
+}
+
+uint32_t
+Validator::getPartition(TxEntry *txEntry, bool &isCrossPartition) {
+    //A tx belongs to the partition of its first locked key. Keys in other
+    //partitions make it a cross-partition tx, which any serializer may admit.
+    isCrossPartition = false;
+    if (NUM_SERIALIZE_THREADS == 1)
+        return 0;
+
+    uint32_t owner = NUM_SERIALIZE_THREADS;
+    for (uint32_t i = 0; i < txEntry->getWriteSetSize(); i++) {
+        if (txEntry->isWriteTupleSkipLock(i)) continue;
+        uint32_t p = ActiveTxSet::getPartition(txEntry->getWriteSetHash()[i], NUM_SERIALIZE_THREADS);
+        if (owner == NUM_SERIALIZE_THREADS)
+            owner = p;
+        else if (p != owner)
+            isCrossPartition = true;
+    }
+    for (uint32_t i = 0; i < txEntry->getReadSetSize(); i++) {
+        if (txEntry->isReadTupleSkipLock(i)) continue;
+        uint32_t p = ActiveTxSet::getPartition(txEntry->getReadSetHash()[i], NUM_SERIALIZE_THREADS);
+        if (owner == NUM_SERIALIZE_THREADS)
+            owner = p;
+        else if (p != owner)
+            isCrossPartition = true;
+    }
+    return (owner == NUM_SERIALIZE_THREADS) ? 0 : owner;
+}
+
 uint64_t
 Validator::getClockValue() {
     //time in ns unit.
@@ -599,6 +902,21 @@ Validator::receiveSSNInfo(uint64_t peerId, __uint128_t cts,
     return peerInfo[hash(cts)]->poseEvent(1, cts, peerId, peerPosition, peerTxState, pstamp, sstamp, NULL, NULL);
 }
 
+bool
+Validator::receiveReadOnlyInfo(uint64_t peerId, __uint128_t cts,
+        uint64_t pstamp, uint64_t sstamp, uint8_t peerPosition) {
+    RAMCLOUD_LOG(NOTICE, "receive read-only cts %lu from %lu", (uint64_t)(cts >> 64), peerId);
+
+    counters.infoReceives++;
+    //an entry made ahead of the local tx waits as long as PeerInfo keeps an orphan
+    uint64_t deadline = std::max((uint64_t)(cts >> 64), getClockValue())
+            + READ_ONLY_ORPHAN_TIMEOUT_MS * 1000000;
+    TxEntry *decided = readOnlyTxSet.merge(cts, peerPosition, pstamp, sstamp, deadline);
+    if (decided)
+        concludeReadOnlyTx(decided);
+    return true;
+}
+
 void
 Validator::replySSNInfo(uint64_t peerId, __uint128_t cts, uint64_t pstamp, uint64_t sstamp, uint8_t peerTxState, uint8_t peerPosition) {
     assert(peerTxState != TxEntry::TX_CONFLICT);
@@ -606,6 +924,7 @@ Validator::replySSNInfo(uint64_t peerId, __uint128_t cts, uint64_t pstamp, uint6
     if (rpcService == NULL) //unit test may make rpcService NULL
         return;
 
+    //the owning peer thread replies, as it writes the tx state and stamps non-atomically
     peerInfo[hash(cts)]->poseEvent(4, cts, peerId, peerPosition, peerTxState, pstamp, sstamp, NULL, NULL);
 
 /*
@@ -652,6 +971,14 @@ Validator::requestSSNInfo(TxEntry *txEntry, bool isSpecific, uint64_t targetPeer
     }
 }
 
+void
+Validator::sendReadOnlyInfo(TxEntry *txEntry) {
+    if (rpcService) {
+        rpcService->sendReadOnlyInfo(txEntry);
+        counters.infoSends.fetch_add(1);
+    }
+}
+
 void
 Validator::sendTxCommitReply(TxEntry *txEntry) {
     if (rpcService) {
@@ -674,80 +1001,291 @@ Validator::sendTxCommitReply(TxEntry *txEntry) {
 
 bool
 Validator::recover() {
-    uint64_t it = 0;
-    DSSNMeta meta;
-    TxEntry *txEntry = new TxEntry(0, 0);
-    while (txLog.getNextPendingTx(it, it, meta, txEntry->getParticipantSet(),
-            txEntry->getWriteSet())) {
+    uint64_t start = getClockValue();
+    uint64_t checkpointId = 0;
+    __uint128_t checkpointCTS = 0;
+    if (kvCheckpoint.load(kvStore, NUM_RECOVER_THREADS, checkpointId, checkpointCTS)) {
+        counters.recoveredKVs = kvCheckpoint.getRecordCount();
+        lastCheckpointId = checkpointId;
+    }
+
+    std::vector<TxEntry *> committed, pending;
+    if (!txLog.recoverFrom(checkpointId, NUM_RECOVER_THREADS, committed, pending)) {
+        //replaying the whole log on top of the checkpoint is still correct, only longer
+        txLog.recoverFrom(0, NUM_RECOVER_THREADS, committed, pending);
+    }
+
+    replayCommitted(committed);
+    counters.replayedTxs = committed.size();
+    for (TxEntry *txEntry : committed)
+        delete txEntry;
+
+    for (TxEntry *txEntry : pending) {
         txEntry->setTxState(TxEntry::TX_ALERT); //indicate a recovered entry
         insertTxEntry(txEntry);
         counters.recovers.fetch_add(1);
-        txEntry = new TxEntry(0, 0);
     }
-    delete txEntry;
 
+    counters.recoverUsec = (getClockValue() - start) / 1000;
+    RAMCLOUD_LOG(NOTICE, "recovered %lu KVs of checkpoint %lu cts %lu, replayed %lu txs, %lu CIs pending, in %lu usec",
+            counters.recoveredKVs.load(), checkpointId, (uint64_t)(checkpointCTS >> 64),
+            counters.replayedTxs.load(), counters.recovers.load(), counters.recoverUsec.load());
     return true;
 }
 
+void
+Validator::replayCommitted(std::vector<TxEntry *> &committed) {
+    //each thread applies the txs to the keys hashing to it only, so it needs no locking,
+    //and a newer cStamp wins, so the order of txs and the checkpoint fuzziness do not matter
+    auto worker = [&](uint32_t part) {
+        for (TxEntry *txEntry : committed) {
+            uint64_t cStamp = txEntry->getCTS() >> 64;
+            auto writeSet = txEntry->getWriteSet();
+            for (uint32_t i = 0; i < txEntry->getWriteSetSize(); i++) {
+                KVLayout *kv = writeSet[i];
+                if (kv == NULL || kv->k.getKeyHash() % NUM_RECOVER_THREADS != part)
+                    continue;
+                KVLayout *existing = kvStore.fetch(kv->k);
+                if (existing == NULL) {
+                    kvStore.putNew(kv, txEntry->getCTS(), txEntry->getSStamp());
+                    writeSet[i] = NULL; //the KV store owns it now
+                } else if (existing->meta().cStamp < cStamp) {
+                    kvStore.put(existing, txEntry->getCTS(), txEntry->getSStamp(),
+                            kv->v.valuePtr, kv->v.valueLength);
+                    kv->v.valuePtr = NULL;
+                }
+            }
+            auto readSet = txEntry->getReadSet();
+            for (uint32_t i = 0; i < txEntry->getReadSetSize(); i++) {
+                KVLayout *kv = readSet[i];
+                if (kv == NULL || kv->k.getKeyHash() % NUM_RECOVER_THREADS != part)
+                    continue;
+                KVLayout *existing = kvStore.fetch(kv->k);
+                if (existing)
+                    existing->meta().pStamp = std::max(existing->meta().pStamp, cStamp);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < NUM_RECOVER_THREADS; i++)
+        threads.push_back(std::thread(worker, i));
+    worker(0);
+    for (auto &t : threads)
+        t.join();
+}
+
+void
+Validator::beginSeal(TxEntry *txEntry) {
+    //count in the current generation, unless a checkpoint moved past it meanwhile
+    while (true) {
+        uint32_t gen = sealGeneration.load();
+        sealing[gen & 1]++;
+        if (sealGeneration.load() == gen) {
+            txEntry->sealGeneration = gen;
+            return;
+        }
+        sealing[gen & 1]--;
+    }
+}
+
+void
+Validator::endSeal(TxEntry *txEntry) {
+    if (txEntry->sealGeneration == 0)
+        return;
+    sealing[txEntry->sealGeneration & 1]--;
+    txEntry->sealGeneration = 0;
+}
+
+bool
+Validator::checkpoint() {
+    uint64_t start = getClockValue();
+    uint64_t id = start;
+
+    //A conclusion logged before the marker began sealing before the generation moves on below,
+    //so once that generation drains, the KV store has it. Any later one is replayed from the log.
+    if (!txLog.markCheckpoint(get128bClockValue(), id)) {
+        counters.checkpointErrors++;
+        return false;
+    }
+    uint32_t gen = sealGeneration.fetch_add(1);
+    while (sealing[gen & 1].load() > 0) {
+        if (!isAlive)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+
+    if (!kvCheckpoint.write(kvStore, id, get128bClockValue())) {
+        counters.checkpointErrors++;
+        return false;
+    }
+    lastCheckpointId = id;
+    counters.checkpoints++;
+    counters.checkpointKVs = kvCheckpoint.getRecordCount();
+    counters.checkpointBytes = kvCheckpoint.getBytes();
+    counters.checkpointUsec = (getClockValue() - start) / 1000;
+    return true;
+}
+
+void
+Validator::checkpointer() {
+    uint64_t last = getClockValue();
+    while (isAlive) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (getClockValue() - last < (uint64_t)CHECKPOINT_INTERVAL_SEC * 1000000000)
+            continue;
+        checkpoint();
+        last = getClockValue();
+    }
+}
+
+bool
+Validator::trimLog() {
+    uint64_t start = getClockValue();
+    //peers may still ask for the state of a CI concluded a while ago
+    __uint128_t watermark = (__uint128_t)(start - (uint64_t)TXLOG_PEER_RETAIN_SEC * 1000000000) << 64;
+    watermark = openCIs.low(watermark);
+#ifdef  QDBTXRECOVERY
+    uint64_t checkpointId = lastCheckpointId;
+    if (checkpointId == 0)
+        return false; //a restart would need the whole log
+#else
+    uint64_t checkpointId = 0;
+#endif
+    txLog.trimBehind(watermark, checkpointId);
+    counters.watermarkLagUsec = (start - std::min(start, (uint64_t)(watermark >> 64))) / 1000;
+    counters.logTrimUsec = (getClockValue() - start) / 1000;
+    return true;
+}
+
+void
+Validator::logTrimmer() {
+    uint64_t last = getClockValue();
+    //not an online thread: asleep most of the time, it must not hold back reclamation
+    while (isAlive) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        //the log chunks and index segments trimmed earlier are retired to this thread
+        EpochManager::instance().reclaim();
+        if (getClockValue() - last < (uint64_t)TXLOG_TRIM_INTERVAL_MS * 1000000)
+            continue;
+        {
+            EpochGuard guard;
+            trimLog();
+        }
+        EpochManager::instance().reclaim();
+        last = getClockValue();
+    }
+}
+
 bool
 Validator::logCounters() {
     if (logLevel < LOG_INFO)
         return false;
     char key[] = {1};
-    char val[3000];
+    char val[4096];
     int c = 0;
     int s = sizeof(val);
-    c += snprintf(val + c, s - c, "serverId:%lu, ", counters.serverId.load());
-    c += snprintf(val + c, s - c, "initialWrites:%lu, ", counters.initialWrites.load());
-    c += snprintf(val + c, s - c, "rejectedWrites:%lu, ", counters.rejectedWrites.load());
-    c += snprintf(val + c, s - c, "precommitReads:%lu, ", counters.precommitReads.load());
-    c += snprintf(val + c, s - c, "commitIntents:%lu, ", counters.commitIntents.load());
-    c += snprintf(val + c, s - c, "lates:%lu, ", counters.lates.load());
-    c += snprintf(val + c, s - c, "recovers:%lu, ", counters.recovers.load());
-    c += snprintf(val + c, s - c, "duplicates:%lu, ", counters.duplicates.load());
-    c += snprintf(val + c, s - c, "trivialAborts:%lu, ", counters.trivialAborts.load());
-    c += snprintf(val + c, s - c, "busyAborts:%lu, ", counters.busyAborts.load());
-    c += snprintf(val + c, s - c, "ctsSets:%lu, ", counters.ctsSets.load());
-    c += snprintf(val + c, s - c, "queuedLocalTxs:%lu, ", localTxQueue.addedTxCount.load());
-    c += snprintf(val + c, s - c, "evaluatedLocalTxs:%lu, ", localTxQueue.removedTxCount.load());
-    c += snprintf(val + c, s - c, "addPeers:%lu, ", counters.addPeers.load());
-    c += snprintf(val + c, s - c, "earlyPeers:%lu, ", counters.earlyPeers.load());
-    c += snprintf(val + c, s - c, "matchEarlyPeers:%lu, ", counters.matchEarlyPeers.load());
-    c += snprintf(val + c, s - c, "deletedPeers:%lu, ", counters.deletedPeers.load());
-    c += snprintf(val + c, s - c, "queuedDistributedTxs:%lu, ", counters.queuedDistributedTxs.load());
-    //c += snprintf(val + c, s - c, "scheduledDistributedTxs:%lu, ", distributedTxSet.addedTxCount.load());
-    //c += snprintf(val + c, s - c, "evaluatedDistributedTxs:%lu, ", distributedTxSet.removedTxCount.load());
-    c += snprintf(val + c, s - c, "indepIns:%lu, ", distributedTxSet.indepIns.load());
-    c += snprintf(val + c, s - c, "indepOuts:%lu, ", distributedTxSet.indepOuts.load());
-    c += snprintf(val + c, s - c, "coldIns:%lu, ", distributedTxSet.coldIns.load());
-    c += snprintf(val + c, s - c, "coldOuts:%lu, ", distributedTxSet.coldOuts.load());
-    c += snprintf(val + c, s - c, "hotIns:%lu, ", distributedTxSet.hotIns.load());
-    c += snprintf(val + c, s - c, "hotOuts:%lu, ", distributedTxSet.hotOuts.load());
-    c += snprintf(val + c, s - c, "concludeQueueIns:%lu, ", concludeQueue.inCount.load());
-    c += snprintf(val + c, s - c, "concludeQueueOuts:%lu, ", concludeQueue.outCount.load());
-    c += snprintf(val + c, s - c, "peerEventAdds:%lu, ", counters.peerEventAdds.load());
-    c += snprintf(val + c, s - c, "peerEventDels:%lu, ", counters.peerEventDels.load());
-    c += snprintf(val + c, s - c, "peerEventUpds:%lu, ", counters.peerEventUpds.load());
-    c += snprintf(val + c, s - c, "infoSends:%lu, ", counters.infoSends.load());
-    c += snprintf(val + c, s - c, "infoReceives:%lu, ", counters.infoReceives.load());
-    c += snprintf(val + c, s - c, "infoRequests:%lu, ", counters.infoRequests.load());
-    c += snprintf(val + c, s - c, "infoReplies:%lu, ", counters.infoReplies.load());
-    c += snprintf(val + c, s - c, "infoLogReplies:%lu, ", counters.infoLogReplies.load());
-    c += snprintf(val + c, s - c, "precommitReadErrors:%lu, ", counters.precommitReadErrors.load());
-    c += snprintf(val + c, s - c, "precommitWriteErrors:%lu, ", counters.precommitWriteErrors.load());
-    c += snprintf(val + c, s - c, "preputErrors:%lu, ", counters.preputErrors.load());
-    c += snprintf(val + c, s - c, "lateScheduleErrors:%lu, ", counters.lateScheduleErrors.load());
-    c += snprintf(val + c, s - c, "readVersionErrors:%lu, ", counters.readVersionErrors.load());
-    c += snprintf(val + c, s - c, "concludeErrors:%lu, ", counters.concludeErrors.load());
-    c += snprintf(val + c, s - c, "alertAborts:%lu, ", counters.alertAborts.load());
-    c += snprintf(val + c, s - c, "commits:%lu, ", counters.commits.load());
-    c += snprintf(val + c, s - c, "aborts:%lu, ", counters.aborts.load());
-    c += snprintf(val + c, s - c, "commitReads:%lu, ", counters.commitReads.load());
-    c += snprintf(val + c, s - c, "commitWrites:%lu, ", counters.commitWrites.load());
-    c += snprintf(val + c, s - c, "commitOverwrites:%lu, ", counters.commitOverwrites.load());
-    c += snprintf(val + c, s - c, "commitDeletes:%lu, ", counters.commitDeletes.load());
-
-    assert(s >= c);
+    appendf(val, c, s, "serverId:%lu, ", counters.serverId.load());
+    appendf(val, c, s, "initialWrites:%lu, ", counters.initialWrites.load());
+    appendf(val, c, s, "rejectedWrites:%lu, ", counters.rejectedWrites.load());
+    appendf(val, c, s, "precommitReads:%lu, ", counters.precommitReads.load());
+    appendf(val, c, s, "commitIntents:%lu, ", counters.commitIntents.load());
+    appendf(val, c, s, "lates:%lu, ", counters.lates.load());
+    appendf(val, c, s, "recovers:%lu, ", counters.recovers.load());
+    appendf(val, c, s, "duplicates:%lu, ", counters.duplicates.load());
+    appendf(val, c, s, "trivialAborts:%lu, ", counters.trivialAborts.load());
+    appendf(val, c, s, "busyAborts:%lu, ", counters.busyAborts.load());
+    appendf(val, c, s, "deferrals:%lu, ", admission.getDeferrals());
+    appendf(val, c, s, "retriesAdmitted:%lu, ", admission.getRetriesAdmitted());
+    appendf(val, c, s, "admitLimit:%lu, ", admission.getLimit());
+    appendf(val, c, s, "admitInFlight:%lu, ", admission.getInFlight());
+    appendf(val, c, s, "ctsSets:%lu, ", counters.ctsSets.load());
+    uint64_t queuedLocalTxs = 0, evaluatedLocalTxs = 0;
+    for (uint32_t i = 0; i < NUM_SERIALIZE_THREADS; i++) {
+        queuedLocalTxs += localTxQueue[i]->addedTxCount.load();
+        evaluatedLocalTxs += localTxQueue[i]->removedTxCount.load();
+    }
+    appendf(val, c, s, "queuedLocalTxs:%lu, ", queuedLocalTxs);
+    appendf(val, c, s, "evaluatedLocalTxs:%lu, ", evaluatedLocalTxs);
+    appendf(val, c, s, "crossPartitionTxs:%lu, ", counters.crossPartitionTxs.load());
+    appendf(val, c, s, "activeTxFalsePositivePpm:%lu, ",
+            (uint64_t)(activeTxSet.getFalsePositiveRate() * 1000000));
+    appendf(val, c, s, "addPeers:%lu, ", counters.addPeers.load());
+    appendf(val, c, s, "earlyPeers:%lu, ", counters.earlyPeers.load());
+    appendf(val, c, s, "matchEarlyPeers:%lu, ", counters.matchEarlyPeers.load());
+    appendf(val, c, s, "deletedPeers:%lu, ", counters.deletedPeers.load());
+    appendf(val, c, s, "expiredPeers:%lu, ", counters.expiredPeers.load());
+    appendf(val, c, s, "queuedDistributedTxs:%lu, ", counters.queuedDistributedTxs.load());
+    //appendf(val, c, s, "scheduledDistributedTxs:%lu, ", distributedTxSet.addedTxCount.load());
+    //appendf(val, c, s, "evaluatedDistributedTxs:%lu, ", distributedTxSet.removedTxCount.load());
+    appendf(val, c, s, "indepIns:%lu, ", distributedTxSet.indepIns.load());
+    appendf(val, c, s, "indepOuts:%lu, ", distributedTxSet.indepOuts.load());
+    appendf(val, c, s, "coldIns:%lu, ", distributedTxSet.coldIns.load());
+    appendf(val, c, s, "coldOuts:%lu, ", distributedTxSet.coldOuts.load());
+    appendf(val, c, s, "hotIns:%lu, ", distributedTxSet.hotIns.load());
+    appendf(val, c, s, "hotOuts:%lu, ", distributedTxSet.hotOuts.load());
+    appendf(val, c, s, "concludeQueueIns:%lu, ", concludeQueue.inCount.load());
+    appendf(val, c, s, "concludeQueueOuts:%lu, ", concludeQueue.outCount.load());
+    appendf(val, c, s, "peerEventAdds:%lu, ", counters.peerEventAdds.load());
+    appendf(val, c, s, "peerEventDels:%lu, ", counters.peerEventDels.load());
+    appendf(val, c, s, "peerEventUpds:%lu, ", counters.peerEventUpds.load());
+    appendf(val, c, s, "infoSends:%lu, ", counters.infoSends.load());
+    appendf(val, c, s, "infoReceives:%lu, ", counters.infoReceives.load());
+    appendf(val, c, s, "infoRequests:%lu, ", counters.infoRequests.load());
+    appendf(val, c, s, "infoReplies:%lu, ", counters.infoReplies.load());
+    appendf(val, c, s, "infoLogReplies:%lu, ", counters.infoLogReplies.load());
+    appendf(val, c, s, "precommitReadErrors:%lu, ", counters.precommitReadErrors.load());
+    appendf(val, c, s, "precommitWriteErrors:%lu, ", counters.precommitWriteErrors.load());
+    appendf(val, c, s, "preputErrors:%lu, ", counters.preputErrors.load());
+    appendf(val, c, s, "lateScheduleErrors:%lu, ", counters.lateScheduleErrors.load());
+    appendf(val, c, s, "readVersionErrors:%lu, ", counters.readVersionErrors.load());
+    appendf(val, c, s, "concludeErrors:%lu, ", counters.concludeErrors.load());
+    appendf(val, c, s, "alertAborts:%lu, ", counters.alertAborts.load());
+    appendf(val, c, s, "earlyCommits:%lu, ", counters.earlyCommits.load());
+    appendf(val, c, s, "earlyAborts:%lu, ", counters.earlyAborts.load());
+    appendf(val, c, s, "readOnlyCommits:%lu, ", counters.readOnlyCommits.load());
+    appendf(val, c, s, "readOnlyAborts:%lu, ", counters.readOnlyAborts.load());
+    appendf(val, c, s, "readOnlyExpires:%lu, ", counters.readOnlyExpires.load());
+    appendf(val, c, s, "commits:%lu, ", counters.commits.load());
+    appendf(val, c, s, "aborts:%lu, ", counters.aborts.load());
+    appendf(val, c, s, "commitReads:%lu, ", counters.commitReads.load());
+    appendf(val, c, s, "commitWrites:%lu, ", counters.commitWrites.load());
+    appendf(val, c, s, "commitOverwrites:%lu, ", counters.commitOverwrites.load());
+    appendf(val, c, s, "commitDeletes:%lu, ", counters.commitDeletes.load());
+    appendf(val, c, s, "checkpoints:%lu, ", counters.checkpoints.load());
+    appendf(val, c, s, "checkpointErrors:%lu, ", counters.checkpointErrors.load());
+    appendf(val, c, s, "checkpointKVs:%lu, ", counters.checkpointKVs.load());
+    appendf(val, c, s, "checkpointBytes:%lu, ", counters.checkpointBytes.load());
+    appendf(val, c, s, "checkpointUsec:%lu, ", counters.checkpointUsec.load());
+    appendf(val, c, s, "recoveredKVs:%lu, ", counters.recoveredKVs.load());
+    appendf(val, c, s, "replayedTxs:%lu, ", counters.replayedTxs.load());
+    appendf(val, c, s, "recoverUsec:%lu, ", counters.recoverUsec.load());
+    appendf(val, c, s, "txLogBytes:%lu, ", (uint64_t)txLog.size());
+    appendf(val, c, s, "txLogTrims:%lu, ", txLog.getTrimCount());
+    appendf(val, c, s, "txLogTrimmedBytes:%lu, ", txLog.getTrimmedBytes());
+    appendf(val, c, s, "txLogTrimLagBytes:%lu, ", txLog.getTrimLagBytes());
+    appendf(val, c, s, "txLogTrimUsec:%lu, ", counters.logTrimUsec.load());
+    appendf(val, c, s, "watermarkLagUsec:%lu, ", counters.watermarkLagUsec.load());
+    appendf(val, c, s, "openCIs:%lu, ", openCIs.size());
+    appendf(val, c, s, "epochRetired:%lu, ", EpochManager::instance().getRetiredCount());
+    appendf(val, c, s, "epochFreed:%lu, ", EpochManager::instance().getFreedCount());
+    appendf(val, c, s, "clockDrift:%ld, ", clock.getLastDrift());
+    appendf(val, c, s, "clockMaxDrift:%lu, ", clock.getMaxDrift());
+    appendf(val, c, s, "clockHolds:%lu, ", clock.getHoldCount());
+    appendf(val, c, s, "clockSteps:%lu, ", clock.getStepCount());
+    if (txLog.isGroupCommit()) {
+        //log2 buckets, see TxLog
+        appendf(val, c, s, "txLogBatches:%lu, ", txLog.getBatchCount());
+        appendf(val, c, s, "txLogBatchedBytes:%lu, ", txLog.getBatchedBytes());
+        appendf(val, c, s, "txLogBatchRecordsHist:");
+        for (uint32_t i = 0; i < TXLOG_HIST_BUCKETS; i++)
+            appendf(val, c, s, "%s%lu", i ? "/" : "", txLog.getBatchRecordsHist(i));
+        appendf(val, c, s, ", txLogCommitUsecHist:");
+        for (uint32_t i = 0; i < TXLOG_HIST_BUCKETS; i++)
+            appendf(val, c, s, "%s%lu", i ? "/" : "", txLog.getCommitLatencyHist(i));
+        appendf(val, c, s, ", ");
+    }
+
+    assert(s > c);
     assert(strlen(val) < sizeof(val));
     RAMCLOUD_LOG(NOTICE, "%s", val);
     txLog.fabricate(get128bClockValue(), (uint8_t *)key, (uint32_t)sizeof(key),
@@ -759,7 +1297,18 @@ bool
 Validator::logTx(uint32_t currentLevel, TxEntry *txEntry) {
     if (logLevel < currentLevel)
         return false;
-    return txLog.add(txEntry);
+    //a CI stays open from logging it to logging its conclusion
+    bool isPending = txEntry->getTxState() == TxEntry::TX_PENDING;
+    if (isPending)
+        openCIs.add(txEntry->getCTS());
+    if (txLog.add(txEntry)) {
+        if (!isPending)
+            openCIs.remove(txEntry->getCTS());
+        return true;
+    }
+    if (isPending)
+        openCIs.remove(txEntry->getCTS());
+    return false;
 }
 
 bool
@@ -22,14 +22,21 @@
 #include "KVStore.h"
 #include "HashmapKVStore.h"
 #include "PeerInfo.h"
+#include "CtsHash.h"
 #include "ConcludeQueue.h"
 #include <boost/lockfree/queue.hpp>
 #include "SkipList.h"
+#include "TimingWheel.h"
 #include "ClusterTimeService.h"
 #include "DistributedTxSet.h"
 #include "DSSNService.h"
 #include "TxLog.h"
+#include "KVCheckpoint.h"
+#include "CtsWatermark.h"
+#include "ReadOnlyTxSet.h"
 #include "WorkerPool.h"
+#include "EpochManager.h"
+#include "AdmissionControl.h"
 #include <stdarg.h>
 
 namespace QDB {
@@ -64,7 +71,9 @@ struct Counters {
     std::atomic<uint64_t> earlyPeers{0};
     std::atomic<uint64_t> matchEarlyPeers{0};
     std::atomic<uint64_t> deletedPeers{0};
+    std::atomic<uint64_t> expiredPeers{0};
     std::atomic<uint64_t> queuedDistributedTxs{0};
+    std::atomic<uint64_t> crossPartitionTxs{0};
     // scheduledDistributedTxs tracked by distributedTxSet
     // evaluatedDistributedTxs tracked bydistributedT
     // queuedLocalTxs tracked by localTxQueue
@@ -84,12 +93,27 @@ struct Counters {
     std::atomic<uint64_t> readVersionErrors{0};
     std::atomic<uint64_t> concludeErrors{0};
     std::atomic<uint64_t> alertAborts{0};
+    std::atomic<uint64_t> earlyCommits{0};
+    std::atomic<uint64_t> earlyAborts{0};
+    std::atomic<uint64_t> readOnlyCommits{0};
+    std::atomic<uint64_t> readOnlyAborts{0};
+    std::atomic<uint64_t> readOnlyExpires{0};
     std::atomic<uint64_t> commits{0};
     std::atomic<uint64_t> aborts{0};
     std::atomic<uint64_t> commitReads{0};
     std::atomic<uint64_t> commitWrites{0};
     std::atomic<uint64_t> commitOverwrites{0};
     std::atomic<uint64_t> commitDeletes{0};
+    std::atomic<uint64_t> checkpoints{0};
+    std::atomic<uint64_t> checkpointErrors{0};
+    std::atomic<uint64_t> checkpointKVs{0}; //of the last checkpoint
+    std::atomic<uint64_t> checkpointBytes{0};
+    std::atomic<uint64_t> checkpointUsec{0};
+    std::atomic<uint64_t> recoveredKVs{0};
+    std::atomic<uint64_t> replayedTxs{0};
+    std::atomic<uint64_t> recoverUsec{0};
+    std::atomic<uint64_t> watermarkLagUsec{0}; //of the last log trim
+    std::atomic<uint64_t> logTrimUsec{0};
 };
 
 static const uint32_t LOG_BASELINE = 0u;
@@ -101,6 +125,41 @@ static const uint32_t LOG_ALWAYS = LOG_BASELINE;
 
 #define NUM_CONCLUDE_THREADS 5
 #define NUM_PEER_THREADS 8
+//serialize threads, each owning a partition of the key-hash space
+#ifndef NUM_SERIALIZE_THREADS
+#define NUM_SERIALIZE_THREADS 1
+#endif
+//local txs taken from the queue per ActiveTxSet::addBatch()
+#define SERIALIZE_ADMIT_BATCH 32
+
+//due cross-shard CIs taken from the reorderQueue per pop_until()
+#define SCHEDULE_POP_BATCH 32
+
+//period of the KV checkpoints, and the threads loading one and replaying the TxLog past it
+#define CHECKPOINT_INTERVAL_SEC 60
+#define NUM_RECOVER_THREADS 8
+
+//period of the TxLog trims, and how long peers may still ask for the state of a concluded CI
+#define TXLOG_TRIM_INTERVAL_MS 1000
+#define TXLOG_PEER_RETAIN_SEC 10
+
+//how long a cross-shard read-only tx waits for the stamps of its peers, how long their stamps
+//wait for its CI, and how often its unsettled reads are retried
+#define READ_ONLY_PEER_TIMEOUT_MS 100
+#define READ_ONLY_ORPHAN_TIMEOUT_MS 1000
+#define READ_ONLY_RETRY_US 100
+
+//every Nth concluded CI leaves its stage timestamps in the TimeTrace; 0 for none
+#ifndef CI_TRACE_SAMPLE_RATE
+#define CI_TRACE_SAMPLE_RATE 0
+#endif
+
+//define REORDER_TIMING_WHEEL to reorder cross-shard CIs on a TimingWheel instead of a SkipList
+#ifdef REORDER_TIMING_WHEEL
+typedef TimingWheel ReorderQueue;
+#else
+typedef SkipList<__uint128_t> ReorderQueue;
+#endif
 
 class Validator {
     PROTECTED:
@@ -110,25 +169,28 @@ class Validator {
     DSSNService *rpcService;
     bool isUnderTest;
     bool isAlive = true;
-	WaitList &localTxQueue;
-    SkipList<__uint128_t> &reorderQueue;
+    WaitList* localTxQueue[NUM_SERIALIZE_THREADS]; //one per serialize partition
+    AdmissionControl admission; //credits of the CIs queued and not concluded yet
+    ReorderQueue &reorderQueue;
     DistributedTxSet &distributedTxSet;
     ActiveTxSet &activeTxSet;
 	ConcludeQueue &concludeQueue;
 	TxLog &txLog;
+	KVCheckpoint &kvCheckpoint;
     ClusterTimeService clock;
     PeerInfo* peerInfo[NUM_PEER_THREADS];
     __uint128_t lastScheduledTxCTS;
     //LATER DependencyMatrix blockedTxSet;
     Counters counters;
     uint32_t logLevel = LOG_INFO;
-    boost::lockfree::queue<TxEntry *> crossTxQueue{1000};
 
     // threads
     std::thread schedulingThread;
-    std::thread serializeThread;
+    std::thread serializeThread[NUM_SERIALIZE_THREADS];
     std::thread peeringThread[NUM_PEER_THREADS];
     std::thread peerAlertThread;
+    std::thread checkpointThread;
+    std::thread logTrimThread;
     WorkerPool* concludeThreadPool;
 
     // all SSN data maintenance operations
@@ -140,8 +202,30 @@ class Validator {
     /// move due CIs from reorderQueue into blockedTxSet
     void scheduleDistributedTxs();
 
-    // serialization of commit-intent validation
-    void serialize();
+    // serialization of commit-intent validation, per partition of the key-hash space
+    void serialize(uint32_t partition = 0);
+
+    // the partition whose serialize thread is to validate a local tx
+    uint32_t getPartition(TxEntry *txEntry, bool &isCrossPartition);
+
+    // whether the read set versions are still the committed ones
+    bool isReadSetCurrent(TxEntry& txEntry);
+
+    // settle the local stamps of a read-only tx; false if its reads are not settled yet
+    bool settleReadOnlyTx(TxEntry *txEntry);
+
+    // decide a cross-shard read-only tx on its merged stamps, reply, and free it
+    void concludeReadOnlyTx(TxEntry *txEntry);
+
+    // cross-shard read-only txs exchanging stamps with their peers
+    ReadOnlyTxSet readOnlyTxSet;
+    void sweepReadOnlyTxs();
+
+    // feed the stage timestamps of a finished CI to the monitor and the TimeTrace
+    void traceCIStages(TxEntry *txEntry);
+
+    // return the admission credit of a CI leaving the pipeline
+    void releaseCredit(TxEntry *txEntry);
 
     // perform SSN validation on a local transaction
     bool validateLocalTx(TxEntry& txEntry);
@@ -152,10 +236,28 @@ class Validator {
     // handle peer info exchange
     void peer(uint32_t tid);
     void monitor();
-    inline uint32_t hash(__uint128_t cts) { return isUnderTest ? 0 : (cts % 7919) % NUM_PEER_THREADS; }
-
-    // reconstruct meta data from tx log
+    inline uint32_t hash(__uint128_t cts) {
+        if (isUnderTest)
+            return 0;
+        //the upper bits, as the PeerEntryTable of a peer thread is indexed by the lower ones
+        return (uint32_t)((hashCts(cts) >> 32) % NUM_PEER_THREADS);
+    }
+
+    // reconstruct meta data from the last KV checkpoint and the tx log past it
     bool recover();
+    void replayCommitted(std::vector<TxEntry *> &committed);
+
+    // take a KV checkpoint every CHECKPOINT_INTERVAL_SEC
+    void checkpointer();
+
+    // CIs between logging their conclusion and updating the KV store, per seal generation
+    std::atomic<uint32_t> sealGeneration{1};
+    std::atomic<uint64_t> sealing[2] = {};
+    std::atomic<uint64_t> lastCheckpointId{0}; //0 if none yet
+
+    // CIs logged and not concluded yet; the TxLog is trimmed up to the oldest
+    CtsWatermark openCIs;
+    void logTrimmer();
 
     // put counters values into tx log, depending on log level
     bool logCounters();
@@ -187,15 +289,24 @@ class Validator {
      * insertConcludeQueue().
      *
      * receive/replySSNInfo handle the peer SSN info exchange.
+     * receiveReadOnlyInfo takes the stamps of a cross-shard read-only tx.
      */
-    bool read(KLayout& k, KVLayout *&kv);
+    /// v is a snapshot of the latest committed version, valid within the caller's EpochGuard
+    bool read(KLayout& k, VLayout &v);
     bool initialWrite(KVLayout &kv);
     bool insertTxEntry(TxEntry *txEntry);
+    // whether a CI that insertTxEntry() turned away was deferred for lack of credits,
+    // rather than aborted, and how long its client is suggested to wait before retrying
+    bool isDeferred(TxEntry *txEntry, uint32_t &minDelayMicros, uint32_t &maxDelayMicros);
+    // decide a read-only tx without the pipeline; false if it needs the pipeline after all
+    /// a cross-shard one is never turned away; it is decided and replied to once the peers' stamps are in
+    bool commitReadOnlyTx(TxEntry *txEntry);
     bool updatePeerInfo(uint64_t cts, uint64_t peerId, uint64_t eta, uint64_t pi, TxEntry *&txEntry);
     bool conclude(TxEntry *txEntry);
     bool insertConcludeQueue(TxEntry *txEntry);
     bool receiveSSNInfo(uint64_t peerId, __uint128_t cts,
             uint64_t pstamp, uint64_t sstamp, uint8_t peerTxState, uint8_t peerPosition);
+    bool receiveReadOnlyInfo(uint64_t peerId, __uint128_t cts, uint64_t pstamp, uint64_t sstamp, uint8_t peerPosition);
     void replySSNInfo(uint64_t peerId, __uint128_t cts, uint64_t pstamp, uint64_t sstamp, uint8_t peerTxState, uint8_t peerPosition);
     void sendTxCommitReply(TxEntry *txEntry);
 
@@ -205,6 +316,7 @@ class Validator {
     // used for invoking RPCs
     void sendSSNInfo(TxEntry *txEntry, bool isSpecific = false, uint64_t targetPeerId = 0);
     void requestSSNInfo(TxEntry *txEntry, bool isSpecific = false, uint64_t targetPeerId = 0);
+    void sendReadOnlyInfo(TxEntry *txEntry);
     void sendSSNInfo(__uint128_t cts, uint8_t txState, uint64_t pStamp, uint64_t sStamp, uint8_t position, uint64_t target = 0);
 
     // used for obtaining clock value in nanosecond unit
@@ -216,6 +328,16 @@ class Validator {
 
     // put commit intent into tx log, depending on log level
     bool logTx(uint32_t currentLevel, TxEntry *txEntry);
+
+    // bracket a CI from logging its conclusion to having its writes in the KV store
+    void beginSeal(TxEntry *txEntry);
+    void endSeal(TxEntry *txEntry);
+
+    // write a fuzzy KV checkpoint that the TxLog past its marker completes
+    bool checkpoint();
+
+    // reclaim the TxLog chunks that neither the peers nor a restart need anymore
+    bool trimLog();
     TxLog& getLog() {return txLog;}
 
     // used for setting debug logging level
@@ -0,0 +1,180 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <new>
+#include <cstdlib>
+#include "ValueArena.h"
+
+namespace QDB {
+
+#define ARENA_MAGAZINE_BYTES (4UL*1024*1024)
+
+/*
+ * Per-thread object cache; flushed back to the slabs when the thread exits.
+ */
+struct ValueArenaCache {
+    void *objs[ValueArena::NUM_CLASSES][ValueArena::CACHE_CAPACITY];
+    uint32_t count[ValueArena::NUM_CLASSES] = {};
+    ~ValueArenaCache() {
+        ValueArena &arena = ValueArena::instance();
+        for (uint32_t cls = 0; cls < ValueArena::NUM_CLASSES; cls++)
+            arena.drain(cls, objs[cls], count[cls], count[cls]);
+    }
+};
+
+static thread_local ValueArenaCache threadCache;
+
+const uint32_t ValueArena::NUM_CLASSES;
+const uint32_t ValueArena::HUGE_CLASS;
+const uint32_t ValueArena::CACHE_CAPACITY;
+const uint32_t ValueArena::CACHE_BYTES;
+
+ValueArena&
+ValueArena::instance()
+{
+    //never destroyed, so that thread caches may flush during static destruction
+    //new of an over-aligned type only honors alignof(ValueArena) from C++17 on
+    static ValueArena *arena = [] {
+        void *mem;
+        if (posix_memalign(&mem, alignof(ValueArena), sizeof(ValueArena)) != 0)
+            abort();
+        return new (mem) ValueArena();
+    }();
+    return *arena;
+}
+
+ValueArena::ValueArena()
+{
+    for (uint32_t cls = 0; cls < NUM_CLASSES; cls++) {
+        //32, 48, 64, 96, 128, ...
+        uint32_t base = ARENA_MIN_CLASS_SIZE << (cls / 2);
+        classSize[cls] = (cls % 2) ? base + base / 2 : base;
+        cacheCapacity[cls] = std::max(1u, std::min(CACHE_CAPACITY, CACHE_BYTES / classSize[cls]));
+        cacheBatch[cls] = std::max(1u, cacheCapacity[cls] / 2);
+        slabs[cls] = NULL;
+    }
+    assert(classSize[NUM_CLASSES - 1] == ARENA_MAX_CLASS_SIZE);
+}
+
+ValueArena::~ValueArena()
+{
+    for (uint32_t cls = 0; cls < NUM_CLASSES; cls++)
+        delete slabs[cls];
+}
+
+uint32_t
+ValueArena::sizeToClass(uint32_t length)
+{
+    if (length <= ARENA_MIN_CLASS_SIZE)
+        return 0;
+    if (length > ARENA_MAX_CLASS_SIZE)
+        return HUGE_CLASS;
+    uint32_t log = 31 - __builtin_clz(length - 1); //floor(log2(length - 1))
+    uint32_t base = 1u << log;
+    uint32_t cls = (log - 5) * 2; //class of 'base'
+    //length lies in (base, 2*base]: the 1.5x class or the next power of two
+    return (length <= base + base / 2) ? cls + 1 : cls + 2;
+}
+
+Slab*
+ValueArena::getSlab(uint32_t cls)
+{
+    //created on first use: most of the classes are never touched by a workload
+    if (slabs[cls] == NULL) {
+        uint32_t bullet = classSize[cls] + sizeof(Header);
+        uint32_t capacity = std::max(8UL, ARENA_MAGAZINE_BYTES / bullet);
+        slabs[cls] = new Slab(bullet, capacity, true);
+    }
+    return slabs[cls];
+}
+
+uint64_t
+ValueArena::getCapacity(uint32_t cls)
+{
+    std::lock_guard<std::mutex> lock(slabLocks[cls]);
+    return slabs[cls] ? slabs[cls]->capacity() : 0;
+}
+
+void
+ValueArena::refill(uint32_t cls, void **cache, uint32_t &count)
+{
+    std::lock_guard<std::mutex> lock(slabLocks[cls]);
+    Slab *slab = getSlab(cls);
+    uint32_t n = cacheBatch[cls] - count;
+    while (count < cacheBatch[cls])
+        cache[count++] = slab->get();
+    classStats[cls].inUse += n;
+}
+
+void
+ValueArena::drain(uint32_t cls, void **cache, uint32_t &count, uint32_t n)
+{
+    if (n == 0)
+        return;
+    std::lock_guard<std::mutex> lock(slabLocks[cls]);
+    for (uint32_t i = 0; i < n; i++)
+        slabs[cls]->put(cache[--count]);
+    classStats[cls].inUse -= n;
+}
+
+uint8_t*
+ValueArena::alloc(uint32_t length)
+{
+    uint32_t cls = sizeToClass(length);
+    Header *hdr;
+    if (cls == HUGE_CLASS) {
+        hdr = (Header *)malloc(sizeof(Header) + length);
+        if (hdr == NULL)
+            abort(); //out of memory, like a failing magazine mmap
+        hugeInUse++;
+    } else {
+        uint32_t &count = threadCache.count[cls];
+        if (count == 0)
+            refill(cls, threadCache.objs[cls], count);
+        hdr = (Header *)threadCache.objs[cls][--count];
+    }
+    hdr->sig = VALUE_ARENA_SIG;
+    hdr->cls = cls;
+    hdr->length = length;
+    return (uint8_t *)&hdr[1];
+}
+
+void
+ValueArena::free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    Header *hdr = &((Header *)ptr)[-1];
+    assert(hdr->sig == VALUE_ARENA_SIG);
+    uint32_t cls = hdr->cls;
+    if (cls == HUGE_CLASS) {
+        ::free(hdr);
+        hugeInUse--;
+        return;
+    }
+    uint32_t &count = threadCache.count[cls];
+    if (count == cacheCapacity[cls])
+        drain(cls, threadCache.objs[cls], count, cacheBatch[cls]);
+    threadCache.objs[cls][count++] = hdr;
+}
+
+void
+ValueArena::flushThreadCache()
+{
+    for (uint32_t cls = 0; cls < NUM_CLASSES; cls++)
+        drain(cls, threadCache.objs[cls], threadCache.count[cls], threadCache.count[cls]);
+}
+
+} // end namespace QDB
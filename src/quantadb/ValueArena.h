@@ -0,0 +1,97 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef VALUE_ARENA_H
+#define VALUE_ARENA_H
+
+#include <atomic>
+#include <mutex>
+#include "Common.h"
+#include "Slab.h"
+
+namespace QDB {
+
+/**
+ * Size-class allocator for tuple values, built on one Slab per class.
+ *
+ * Classes go in half-power-of-two steps (32, 48, 64, 96, ...) up to
+ * ARENA_MAX_CLASS_SIZE; larger values, up to the RPC limit, fall back to malloc.
+ * Each thread keeps a small cache per class and trades objects with the class
+ * Slab in batches of half its size, so the RPC threads allocating values and
+ * the conclude threads freeing them rarely meet on a shared cache line. A cache
+ * holds up to CACHE_BYTES, so the large classes keep only an object or two. Slab magazines are
+ * backed by huge pages when available.
+ *
+ * Every value carries a 16-byte header naming its class, so free() needs only
+ * the pointer. alloc() never returns NULL.
+ */
+class ValueArena {
+    PUBLIC:
+    static const uint32_t ARENA_MIN_CLASS_SIZE = 32;
+    static const uint32_t ARENA_MAX_CLASS_SIZE = 1024 * 1024;
+    static const uint32_t NUM_CLASSES = 31; //32 .. 1M in half-power-of-two steps
+    static const uint32_t HUGE_CLASS = NUM_CLASSES;
+    static const uint32_t CACHE_CAPACITY = 64; //objects per thread per class, at most
+    static const uint32_t CACHE_BYTES = 256 * 1024; //per thread per class, at most one object more
+
+    static ValueArena& instance();
+
+    uint8_t* alloc(uint32_t length);
+    void free(void *ptr);
+
+    // occupancy stats, per size class
+    uint32_t getClassSize(uint32_t cls) { return classSize[cls]; }
+    uint64_t getCapacity(uint32_t cls);     // objects carved out of magazines
+    uint64_t getInUse(uint32_t cls) { return classStats[cls].inUse.load(); } // handed out, incl. thread caches
+    uint64_t getHugeInUse() { return hugeInUse.load(); }
+
+    static uint32_t sizeToClass(uint32_t length);
+
+    // return the calling thread's cached objects to their slabs
+    void flushThreadCache();
+
+    PROTECTED:
+    ValueArena();
+    ~ValueArena();
+
+    struct Header {
+        uint32_t sig;
+        uint32_t cls;
+        uint64_t length;
+    };
+    #define VALUE_ARENA_SIG 0x7A1AE7A5
+
+    struct ClassStats {
+        std::atomic<uint64_t> inUse{0};
+    } __attribute__((aligned(64)));
+
+    Slab* getSlab(uint32_t cls);
+    void refill(uint32_t cls, void **cache, uint32_t &count);
+    void drain(uint32_t cls, void **cache, uint32_t &count, uint32_t n);
+
+    uint32_t classSize[NUM_CLASSES];
+    uint32_t cacheCapacity[NUM_CLASSES];
+    uint32_t cacheBatch[NUM_CLASSES];
+    Slab* slabs[NUM_CLASSES];
+    std::mutex slabLocks[NUM_CLASSES]; //creation of the Slab, and the batches of a class in one go
+    ClassStats classStats[NUM_CLASSES];
+    std::atomic<uint64_t> hugeInUse{0};
+
+    friend struct ValueArenaCache;
+}; // end ValueArena class
+
+} // end namespace QDB
+
+#endif  /* VALUE_ARENA_H */
@@ -0,0 +1,151 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <thread>
+#include "TestUtil.h"
+#include "ValueArena.h"
+#include "Cycles.h"
+
+#define GTEST_COUT  std::cerr << "[ INFO ] "
+
+namespace RAMCloud {
+
+using namespace QDB;
+
+class ValueArenaTest : public ::testing::Test {
+  public:
+  ValueArenaTest() : arena(ValueArena::instance()) {};
+  ~ValueArenaTest() { arena.flushThreadCache(); };
+
+  ValueArena &arena;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueArenaTest);
+};
+
+TEST_F(ValueArenaTest, sizeToClass) {
+    EXPECT_EQ(ValueArena::sizeToClass(1), 0u);
+    EXPECT_EQ(ValueArena::sizeToClass(32), 0u);
+    EXPECT_EQ(ValueArena::sizeToClass(33), 1u);
+    EXPECT_EQ(ValueArena::sizeToClass(48), 1u);
+    EXPECT_EQ(ValueArena::sizeToClass(49), 2u);
+    EXPECT_EQ(ValueArena::sizeToClass(64), 2u);
+    EXPECT_EQ(ValueArena::sizeToClass(65), 3u);
+    EXPECT_EQ(ValueArena::sizeToClass(1024 * 1024), ValueArena::NUM_CLASSES - 1);
+    EXPECT_EQ(ValueArena::sizeToClass(1024 * 1024 + 1), ValueArena::HUGE_CLASS);
+    for (uint32_t len = 1; len <= 70000; len++) {
+        uint32_t cls = ValueArena::sizeToClass(len);
+        EXPECT_GE(arena.getClassSize(cls), len);
+        if (cls > 0) {
+            EXPECT_LT(arena.getClassSize(cls - 1), len);
+        }
+    }
+}
+
+TEST_F(ValueArenaTest, allocFree) {
+    uint32_t cls = ValueArena::sizeToClass(100);
+    uint64_t inUse = arena.getInUse(cls);
+    uint8_t *val = arena.alloc(100);
+    EXPECT_EQ((uint64_t)val % 16, 0u);
+    memset(val, 0xab, 100);
+    EXPECT_GT(arena.getInUse(cls), inUse);
+    EXPECT_GE(arena.getCapacity(cls), arena.getInUse(cls));
+    arena.free(val);
+    arena.free(NULL);
+    arena.flushThreadCache();
+    EXPECT_EQ(arena.getInUse(cls), inUse);
+
+    uint64_t huge = arena.getHugeInUse();
+    val = arena.alloc(2 * 1024 * 1024);
+    EXPECT_EQ(arena.getHugeInUse(), huge + 1);
+    arena.free(val);
+    EXPECT_EQ(arena.getHugeInUse(), huge);
+}
+
+TEST_F(ValueArenaTest, largeClassCache) {
+    //a thread cache holds about CACHE_BYTES of a large class, not CACHE_CAPACITY objects
+    const uint32_t len = 1024 * 1024;
+    uint32_t cls = ValueArena::sizeToClass(len);
+    arena.flushThreadCache();
+    uint64_t inUse = arena.getInUse(cls);
+    uint8_t *vals[8];
+    for (auto &val : vals)
+        val = arena.alloc(len);
+    EXPECT_EQ(inUse + 8, arena.getInUse(cls));
+    for (auto &val : vals)
+        arena.free(val);
+    EXPECT_GE(inUse + 1, arena.getInUse(cls));
+
+    cls = ValueArena::sizeToClass(4096);
+    arena.flushThreadCache();
+    inUse = arena.getInUse(cls);
+    arena.free(arena.alloc(4096));
+    EXPECT_GE(inUse + ValueArena::CACHE_BYTES / 4096, arena.getInUse(cls));
+    arena.flushThreadCache();
+    EXPECT_EQ(inUse, arena.getInUse(cls));
+}
+
+TEST_F(ValueArenaTest, crossThreadFree) {
+    // values allocated by RPC threads are freed by conclude threads
+    const uint32_t count = 100000;
+    std::vector<uint8_t *> vals(count);
+    arena.flushThreadCache();
+    std::vector<uint64_t> inUse(ValueArena::NUM_CLASSES);
+    for (uint32_t cls = 0; cls < ValueArena::NUM_CLASSES; cls++)
+        inUse[cls] = arena.getInUse(cls);
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            vals[i] = arena.alloc(16 + i % 500);
+            memset(vals[i], (uint8_t)i, 16 + i % 500);
+        }
+    });
+    producer.join();
+    std::thread consumer([&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            EXPECT_EQ(vals[i][15 + i % 500], (uint8_t)i);
+            arena.free(vals[i]);
+        }
+    });
+    consumer.join();
+    for (uint32_t cls = 0; cls < ValueArena::NUM_CLASSES; cls++)
+        EXPECT_EQ(arena.getInUse(cls), inUse[cls]);
+}
+
+TEST_F(ValueArenaTest, bench) {
+    const uint32_t loop = 1024 * 1024;
+    uint8_t *vals[64];
+    uint64_t start = Cycles::rdtsc();
+    for (uint32_t i = 0; i < loop; i += 64) {
+        for (uint32_t j = 0; j < 64; j++)
+            vals[j] = arena.alloc(256);
+        for (uint32_t j = 0; j < 64; j++)
+            arena.free(vals[j]);
+    }
+    uint64_t stop = Cycles::rdtsc();
+    GTEST_COUT << "ValueArena alloc+free(256): "
+        << Cycles::toNanoseconds(stop - start) / loop << " nano sec per pair" << std::endl;
+
+    start = Cycles::rdtsc();
+    for (uint32_t i = 0; i < loop; i += 64) {
+        for (uint32_t j = 0; j < 64; j++)
+            vals[j] = new uint8_t[256];
+        for (uint32_t j = 0; j < 64; j++)
+            delete[] vals[j];
+    }
+    stop = Cycles::rdtsc();
+    GTEST_COUT << "new+delete(256): "
+        << Cycles::toNanoseconds(stop - start) / loop << " nano sec per pair" << std::endl;
+}
+
+}  // namespace RAMCloud
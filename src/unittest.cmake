@@ -27,24 +27,34 @@ target_sources(gtest
 
 if(QDBTX)
   file(GLOB unittest
+    quantadb/AdmissionControlTest.cc
+    quantadb/BlockedBloomFilterTest.cc
     quantadb/ClusterTimeServiceTest.cc
+    quantadb/CtsIndexTest.cc
+    quantadb/CtsWatermarkTest.cc
     quantadb/DataLogTest.cc
     quantadb/DLogTest.cc
     quantadb/DSSNServiceTest.cc
+    quantadb/EpochManagerTest.cc
     quantadb/HashmapKVStoreTest.cc
     quantadb/HashmapTest.cc
+    quantadb/KVCheckpointTest.cc
     quantadb/MemStreamIoTest.cc
     quantadb/MultiOpTest.cc
     quantadb/MultiReadTest.cc
     quantadb/MultiRemoveTest.cc
     quantadb/MultiWriteTest.cc
+    quantadb/PeerEntryTableTest.cc
     quantadb/RamCloudDSSNTest.cc
+    quantadb/ReadOnlyTxSetTest.cc
     quantadb/SequencerTest.cc
     quantadb/SkipListTest.cc
+    quantadb/TimingWheelTest.cc
     quantadb/TpcCDSSNTest.cc
     quantadb/TransactionDSSNTest.cc
     quantadb/TxLogTest.cc
     quantadb/ValidatorTest.cc
+    quantadb/ValueArenaTest.cc
     MockCluster.cc
     MockDriver.cc
     MockExternalStorage.cc
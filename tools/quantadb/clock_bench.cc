@@ -0,0 +1,106 @@
+/* Copyright 2020 Futurewei Technologies, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <x86intrin.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "ClusterTimeService.h"
+
+/*
+ * Measures the cost of the local time sources the validator may poll:
+ *   clock_gettime(CLOCK_REALTIME), gettimeofday(), rdtscp, and
+ *   ClusterTimeService::getLocalTime() (TSC time page)
+ * with 1 to N concurrent threads, then reports how far the time page
+ * drifted from the system clock while running.
+ *
+ * Usage: clock_bench [max_threads] [calls_per_thread]
+ */
+
+using namespace QDB;
+
+static ClusterTimeService *cts;
+static std::atomic<uint64_t> regressions(0);
+
+static inline uint64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void run(int type, uint64_t loop, uint64_t *sink)
+{
+    uint64_t sum = 0, last = 0;
+    uint32_t aux;
+    for (uint64_t ii = 0; ii < loop; ii++) {
+        uint64_t t;
+        if (type == 0) {
+            timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            t = ts.tv_nsec;
+        } else if (type == 1) {
+            timeval tv;
+            gettimeofday(&tv, NULL);
+            t = tv.tv_usec;
+        } else if (type == 2) {
+            t = __rdtscp(&aux);
+        } else {
+            t = cts->getLocalTime();
+            if (t <= last)
+                regressions++;
+            last = t;
+        }
+        sum += t;
+    }
+    *sink = sum;
+}
+
+int main(int argc, char *argv[])
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 4;
+    uint64_t loop = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+    const char *names[] = { "clock_gettime", "gettimeofday", "rdtscp", "getLocalTime" };
+
+    cts = new ClusterTimeService();
+    printf("time page: %s\n", cts->isTscClock() ? "TSC" : "clock_gettime fallback");
+
+    for (int nth = 1; nth <= maxThreads; nth *= 2) {
+        for (int type = 0; type < 4; type++) {
+            std::vector<std::thread> threads;
+            std::vector<uint64_t> sinks(nth);
+            uint64_t start = now_ns();
+            for (int ii = 0; ii < nth; ii++)
+                threads.push_back(std::thread(run, type, loop, &sinks[ii]));
+            for (auto &t : threads)
+                t.join();
+            uint64_t stop = now_ns();
+            printf("%-14s threads %2d: %6.1f ns/call\n", names[type], nth,
+                    (double)(stop - start) / loop);
+        }
+    }
+
+    printf("updates %lu, last drift %ld ns, max drift %lu ns, holds %lu, steps %lu, regressions %lu\n",
+            cts->getUpdateCount(), cts->getLastDrift(), cts->getMaxDrift(),
+            cts->getHoldCount(), cts->getStepCount(), regressions.load());
+    delete cts;
+    return 0;
+}